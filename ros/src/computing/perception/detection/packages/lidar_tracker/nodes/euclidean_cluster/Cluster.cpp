@@ -119,13 +119,19 @@ void Cluster::ToRosMessage(std_msgs::Header in_ros_header, autoware_msgs::CloudC
 	out_cluster_message.fpfh_descriptor.data = fpfh_descriptor;*/
 }
 
-void Cluster::SetCloud(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_origin_cloud_ptr, const std::vector<int>& in_cluster_indices, std_msgs::Header in_ros_header, int in_id, int in_r, int in_g, int in_b, std::string in_label, bool in_estimate_pose)
+void Cluster::SetCloud(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_origin_cloud_ptr, const std::vector<int>& in_cluster_indices, std_msgs::Header in_ros_header, int in_id, int in_r, int in_g, int in_b, std::string in_label, bool in_estimate_pose,
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr in_storage_ptr)
 {
 	label_ 	= in_label;	id_		= in_id;
 	r_		= in_r;	g_		= in_g;	b_		= in_b;
 	//extract pointcloud using the indices
 	//calculate min and max points
-	pcl::PointCloud<pcl::PointXYZRGB>::Ptr current_cluster (new pcl::PointCloud<pcl::PointXYZRGB>);
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr current_cluster = in_storage_ptr;
+	if (current_cluster)
+		current_cluster->points.clear();
+	else
+		current_cluster.reset(new pcl::PointCloud<pcl::PointXYZRGB>);
+	current_cluster->points.reserve(in_cluster_indices.size());
 	float min_x=std::numeric_limits<float>::max();float max_x=-std::numeric_limits<float>::max();
 	float min_y=std::numeric_limits<float>::max();float max_y=-std::numeric_limits<float>::max();
 	float min_z=std::numeric_limits<float>::max();float max_z=-std::numeric_limits<float>::max();
@@ -191,6 +197,7 @@ void Cluster::SetCloud(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_origin_cloud
 
 	{
 		std::vector<cv::Point2f> points;
+		points.reserve(current_cluster->points.size());
 		for (unsigned int i=0; i<current_cluster->points.size(); i++)
 		{
 			cv::Point2f pt;
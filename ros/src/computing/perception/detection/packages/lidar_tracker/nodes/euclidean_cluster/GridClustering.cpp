@@ -0,0 +1,226 @@
+/*
+ * GridClustering.cpp
+ *
+ * Euclidean clustering of a flattened cloud on a hashed occupancy grid.
+ */
+
+#include "GridClustering.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+GridClustering::GridClustering()
+{
+	min_cluster_size_ = 1;
+	max_cluster_size_ = std::numeric_limits<int>::max();
+	SetBands(std::vector<double>(), std::vector<double>(1, 0.5));
+}
+
+void GridClustering::SetBands(const std::vector<double>& in_distances, const std::vector<double>& in_thresholds)
+{
+	distances_ = in_distances;
+	thresholds_ = in_thresholds;
+	thresholds_.resize(distances_.size() + 1, thresholds_.empty() ? 0.5 : thresholds_.back());
+
+	//the diagonal of a cell is a bit shorter than the threshold, so the points of a cell are connected
+	cell_sizes_.resize(thresholds_.size());
+	for (size_t i = 0; i < thresholds_.size(); i++)
+	{
+		cell_sizes_[i] = static_cast<float>(std::max(thresholds_[i], 0.01) / std::sqrt(2.0) * (1.0 - 1e-5));
+	}
+}
+
+void GridClustering::SetMinClusterSize(int in_min_cluster_size)
+{
+	min_cluster_size_ = in_min_cluster_size;
+}
+
+void GridClustering::SetMaxClusterSize(int in_max_cluster_size)
+{
+	max_cluster_size_ = in_max_cluster_size;
+}
+
+int GridClustering::GetBand(const pcl::PointXYZ& in_point) const
+{
+	//same expression as segmentByDistance so the points fall in the same bands
+	float origin_distance = sqrt( pow(in_point.x,2) + pow(in_point.y,2) );
+
+	size_t band = 0;
+	while (band < distances_.size() && !(origin_distance < distances_[band]))
+		band++;
+	return band;
+}
+
+uint64_t GridClustering::CellKey(int in_band, int in_x, int in_y)
+{
+	//8 bits of band, 28 bits of each coordinate
+	return (static_cast<uint64_t>(in_band & 0xff) << 56)
+			| ((static_cast<uint64_t>(in_x) & 0xfffffff) << 28)
+			| (static_cast<uint64_t>(in_y) & 0xfffffff);
+}
+
+int GridClustering::FindCell(int in_band, int in_x, int in_y) const
+{
+	std::unordered_map<uint64_t, int>::const_iterator it = cell_map_.find(CellKey(in_band, in_x, in_y));
+	if (it == cell_map_.end())
+		return -1;
+	return it->second;
+}
+
+int GridClustering::FindRoot(int in_cell)
+{
+	while (cells_[in_cell].parent != in_cell)
+	{
+		cells_[in_cell].parent = cells_[cells_[in_cell].parent].parent;
+		in_cell = cells_[in_cell].parent;
+	}
+	return in_cell;
+}
+
+bool GridClustering::CellsConnected(const pcl::PointCloud<pcl::PointXYZ>& in_cloud, const Cell& in_a, const Cell& in_b, float in_squared_threshold) const
+{
+	for (int i = in_a.start; i < in_a.start + in_a.size; i++)
+	{
+		const pcl::PointXYZ& a = in_cloud.points[cell_points_[i]];
+		for (int j = in_b.start; j < in_b.start + in_b.size; j++)
+		{
+			const pcl::PointXYZ& b = in_cloud.points[cell_points_[j]];
+			float dx = a.x - b.x;
+			float dy = a.y - b.y;
+			//strict like the radius search of the kd-tree
+			if (dx * dx + dy * dy < in_squared_threshold)
+				return true;
+		}
+	}
+	return false;
+}
+
+void GridClustering::Extract(const pcl::PointCloud<pcl::PointXYZ>& in_cloud, std::vector< std::vector<pcl::PointIndices> >& out_band_clusters)
+{
+	out_band_clusters.clear();
+	out_band_clusters.resize(thresholds_.size());
+
+	const int points_num = in_cloud.points.size();
+	cell_map_.clear();
+	cells_.clear();
+	point_cells_.assign(points_num, -1);
+
+	//rasterise
+	for (int i = 0; i < points_num; i++)
+	{
+		const pcl::PointXYZ& point = in_cloud.points[i];
+		if (!std::isfinite(point.x) || !std::isfinite(point.y))
+			continue;
+
+		int band = GetBand(point);
+		float cell_x = std::floor(point.x / cell_sizes_[band]);
+		float cell_y = std::floor(point.y / cell_sizes_[band]);
+		//out of the 28 bits of the key, kilometers away
+		if (std::fabs(cell_x) >= (1 << 27) || std::fabs(cell_y) >= (1 << 27))
+			continue;
+		int x = cell_x;
+		int y = cell_y;
+
+		std::pair<std::unordered_map<uint64_t, int>::iterator, bool> inserted =
+				cell_map_.insert(std::make_pair(CellKey(band, x, y), static_cast<int>(cells_.size())));
+		if (inserted.second)
+		{
+			Cell cell;
+			cell.band = band;
+			cell.x = x;
+			cell.y = y;
+			cell.parent = cells_.size();
+			cell.start = 0;
+			cell.size = 0;
+			cells_.push_back(cell);
+		}
+		cells_[inserted.first->second].size++;
+		point_cells_[i] = inserted.first->second;
+	}
+
+	//points sorted by cell, increasing in each cell
+	int start = 0;
+	for (size_t c = 0; c < cells_.size(); c++)
+	{
+		cells_[c].start = start;
+		start += cells_[c].size;
+		cells_[c].size = 0;
+	}
+	cell_points_.resize(start);
+	for (int i = 0; i < points_num; i++)
+	{
+		if (point_cells_[i] < 0)
+			continue;
+		Cell& cell = cells_[point_cells_[i]];
+		cell_points_[cell.start + cell.size++] = i;
+	}
+
+	//join the neighbouring cells, each pair once
+	for (size_t c = 0; c < cells_.size(); c++)
+	{
+		const Cell& cell = cells_[c];
+		float squared_threshold = static_cast<float>(thresholds_[cell.band] * thresholds_[cell.band]);
+		for (int dx = 0; dx <= 2; dx++)
+		{
+			for (int dy = -2; dy <= 2; dy++)
+			{
+				if (dx == 0 && dy <= 0)
+					continue;
+				int neighbour = FindCell(cell.band, cell.x + dx, cell.y + dy);
+				if (neighbour < 0)
+					continue;
+				int root_a = FindRoot(c);
+				int root_b = FindRoot(neighbour);
+				if (root_a == root_b)
+					continue;
+				if (CellsConnected(in_cloud, cell, cells_[neighbour], squared_threshold))
+					cells_[std::max(root_a, root_b)].parent = std::min(root_a, root_b);
+			}
+		}
+	}
+
+	//component sizes on the roots
+	std::vector<int> component_sizes(cells_.size(), 0);
+	for (size_t c = 0; c < cells_.size(); c++)
+	{
+		component_sizes[FindRoot(c)] += cells_[c].size;
+	}
+
+	//clusters numbered in the order of their first point, -2 for dropped components
+	component_clusters_.assign(cells_.size(), -1);
+	std::vector<pcl::PointIndices> clusters;
+	std::vector<int> cluster_bands;
+	for (int i = 0; i < points_num; i++)
+	{
+		if (point_cells_[i] < 0)
+			continue;
+		int root = FindRoot(point_cells_[i]);
+		int& cluster = component_clusters_[root];
+		if (cluster == -1)
+		{
+			if (component_sizes[root] >= min_cluster_size_ && component_sizes[root] <= max_cluster_size_)
+			{
+				cluster = clusters.size();
+				clusters.push_back(pcl::PointIndices());
+				clusters.back().indices.reserve(component_sizes[root]);
+				cluster_bands.push_back(cells_[root].band);
+			}
+			else
+				cluster = -2;
+		}
+		if (cluster >= 0)
+			clusters[cluster].indices.push_back(i);
+	}
+
+	for (size_t k = 0; k < clusters.size(); k++)
+	{
+		out_band_clusters[cluster_bands[k]].push_back(pcl::PointIndices());
+		out_band_clusters[cluster_bands[k]].back().indices.swap(clusters[k].indices);
+	}
+	for (size_t b = 0; b < out_band_clusters.size(); b++)
+	{
+		std::stable_sort(out_band_clusters[b].begin(), out_band_clusters[b].end(),
+				[](const pcl::PointIndices& a, const pcl::PointIndices& b) { return a.indices.size() > b.indices.size(); });
+	}
+}
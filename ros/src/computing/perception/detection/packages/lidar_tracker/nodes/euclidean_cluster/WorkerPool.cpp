@@ -0,0 +1,102 @@
+/*
+ * WorkerPool.cpp
+ *
+ * Threads kept between frames to run independent jobs in parallel.
+ */
+
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(int in_threads)
+{
+	if (in_threads <= 0)
+		in_threads = std::thread::hardware_concurrency();
+	if (in_threads <= 0)
+		in_threads = 1;
+
+	job_ = NULL;
+	count_ = 0;
+	next_ = 0;
+	running_ = 0;
+	generation_ = 0;
+	stop_ = false;
+
+	for (int i = 1; i < in_threads; i++)
+	{
+		workers_.push_back(std::thread(&WorkerPool::WorkerLoop, this));
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	start_.notify_all();
+	for (size_t i = 0; i < workers_.size(); i++)
+	{
+		workers_[i].join();
+	}
+}
+
+int WorkerPool::GetThreads() const
+{
+	return workers_.size() + 1;
+}
+
+void WorkerPool::RunJobs()
+{
+	for (size_t i = next_++; i < count_; i = next_++)
+	{
+		(*job_)(i);
+	}
+}
+
+void WorkerPool::WorkerLoop()
+{
+	unsigned long generation = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			start_.wait(lock, [this, generation] { return stop_ || generation_ != generation; });
+			if (stop_)
+				return;
+			generation = generation_;
+		}
+
+		RunJobs();
+
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			if (--running_ == 0)
+				done_.notify_one();
+		}
+	}
+}
+
+void WorkerPool::Run(size_t in_count, const std::function<void(size_t)>& in_job)
+{
+	if (workers_.empty() || in_count <= 1)
+	{
+		for (size_t i = 0; i < in_count; i++)
+			in_job(i);
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		job_ = &in_job;
+		count_ = in_count;
+		next_ = 0;
+		running_ = workers_.size();
+		generation_++;
+	}
+	start_.notify_all();
+
+	RunJobs();
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	done_.wait(lock, [this] { return running_ == 0; });
+	job_ = NULL;
+}
@@ -56,6 +56,9 @@
 
 #include <limits>
 #include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
 
 #include <opencv/cv.h>
 #include <opencv/highgui.h>
@@ -72,6 +75,8 @@
 #include <sstream>
 
 #include "Cluster.h"
+#include "GridClustering.h"
+#include "WorkerPool.h"
 
 //#include <vector_map/vector_map.h>
 //#include <vector_map_server/GetSignal.h>
@@ -135,6 +140,11 @@ static double _remove_points_upto;
 static double _cluster_merge_threshold;
 
 static bool _use_gpu;
+static bool _use_grid_clustering;
+static GridClustering _grid_clustering;
+static WorkerPool* _worker_pool;
+static std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> _cluster_cloud_arena;
+static size_t _cluster_cloud_arena_used;
 static std::chrono::system_clock::time_point _start, _end;
 
 void transformBoundingBox(const jsk_recognition_msgs::BoundingBox& in_boundingbox, jsk_recognition_msgs::BoundingBox& out_boundingbox, const std::string& in_target_frame, const std_msgs::Header& in_header)
@@ -165,6 +175,8 @@ void publishCloudClusters(const ros::Publisher* in_publisher, const autoware_msg
 		autoware_msgs::CloudClusterArray clusters_transformed;
 		clusters_transformed.header = in_header;
 		clusters_transformed.header.frame_id = in_target_frame;
+		clusters_transformed.stage_names = in_clusters.stage_names;
+		clusters_transformed.stage_times = in_clusters.stage_times;
 		for (auto i=in_clusters.clusters.begin(); i!= in_clusters.clusters.end(); i++)
 		{
 			autoware_msgs::CloudCluster cluster_transformed;
@@ -296,21 +308,72 @@ void keepLanePoints(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr,
 	extract.filter(*out_cloud_ptr);
 }
 
+//indices of a cluster in the cloud it was extracted from
+struct ClusterIndices
+{
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud;
+	std::vector<int> indices;
+	unsigned int id;
+};
+
+//milliseconds since in_start
+double elapsedMs(const std::chrono::system_clock::time_point& in_start)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - in_start).count() / 1000.0;
+}
+
+void addStageTime(autoware_msgs::CloudClusterArray& in_out_clusters, const std::string& in_stage, double in_time)
+{
+	in_out_clusters.stage_names.push_back(in_stage);
+	in_out_clusters.stage_times.push_back(in_time);
+}
+
+//cloud of the arena for the next cluster of the frame, its points keep their memory between frames
+pcl::PointCloud<pcl::PointXYZRGB>::Ptr getArenaCloud()
+{
+	if (_cluster_cloud_arena_used == _cluster_cloud_arena.size())
+		_cluster_cloud_arena.push_back(pcl::PointCloud<pcl::PointXYZRGB>::Ptr(new pcl::PointCloud<pcl::PointXYZRGB>));
+
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr& cloud = _cluster_cloud_arena[_cluster_cloud_arena_used++];
+	//still held out of the node, leave it to its owner
+	if (!cloud.unique())
+		cloud.reset(new pcl::PointCloud<pcl::PointXYZRGB>);
+	return cloud;
+}
+
+//creates the clusters of the indices on the worker pool
+std::vector<ClusterPtr> setClusterClouds(const std::vector<ClusterIndices>& in_cluster_indices)
+{
+	std::vector<ClusterPtr> clusters(in_cluster_indices.size());
+	std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> storage(in_cluster_indices.size());
+	for (size_t i = 0; i < in_cluster_indices.size(); i++)
+	{
+		storage[i] = getArenaCloud();
+	}
+
+	_worker_pool->Run(in_cluster_indices.size(), [&](size_t i)
+	{
+		const ClusterIndices& cluster_indices = in_cluster_indices[i];
+		unsigned int k = cluster_indices.id;
+		ClusterPtr cluster(new Cluster());
+		cluster->SetCloud(cluster_indices.cloud, cluster_indices.indices, _velodyne_header, k, (int)_colors[k].val[0], (int)_colors[k].val[1], (int)_colors[k].val[2], "", _pose_estimation, storage[i]);
+		clusters[i] = cluster;
+	});
+
+	return clusters;
+}
+
 #ifdef GPU_CLUSTERING
-std::vector<ClusterPtr> clusterAndColorGpu(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr,
-											pcl::PointCloud<pcl::PointXYZRGB>::Ptr out_cloud_ptr,
-											jsk_recognition_msgs::BoundingBoxArray& in_out_boundingbox_array,
-											autoware_msgs::centroids& in_out_centroids,
+void clusterAndColorGpu(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr,
+											std::vector<ClusterIndices>& out_cluster_indices,
 											double in_max_cluster_distance=0.5)
 {
-	std::vector<ClusterPtr> clusters;
-
 	//Convert input point cloud to vectors of x, y, and z
 
 	int size = in_cloud_ptr->points.size();
 
 	if (size == 0)
-		return clusters;
+		return;
 
 	float *tmp_x, *tmp_y, *tmp_z;
 
@@ -339,9 +402,11 @@ std::vector<ClusterPtr> clusterAndColorGpu(const pcl::PointCloud<pcl::PointXYZ>:
 
 	for (auto it = cluster_indices.begin(); it != cluster_indices.end(); it++)
 	{
-		ClusterPtr cluster(new Cluster());
-		cluster->SetCloud(in_cloud_ptr, it->points_in_cluster, _velodyne_header, k, (int)_colors[k].val[0], (int)_colors[k].val[1], (int)_colors[k].val[2], "", _pose_estimation);
-		clusters.push_back(cluster);
+		ClusterIndices cluster;
+		cluster.cloud = in_cloud_ptr;
+		cluster.indices.swap(it->points_in_cluster);
+		cluster.id = k;
+		out_cluster_indices.push_back(cluster);
 
 		k++;
 	}
@@ -349,15 +414,11 @@ std::vector<ClusterPtr> clusterAndColorGpu(const pcl::PointCloud<pcl::PointXYZ>:
 	free(tmp_x);
 	free(tmp_y);
 	free(tmp_z);
-
-	return clusters;
 }
 #endif
 
-std::vector<ClusterPtr> clusterAndColor(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr,
-		pcl::PointCloud<pcl::PointXYZRGB>::Ptr out_cloud_ptr,
-		jsk_recognition_msgs::BoundingBoxArray& in_out_boundingbox_array,
-		autoware_msgs::centroids& in_out_centroids,
+void clusterAndColor(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr,
+		std::vector<ClusterIndices>& out_cluster_indices,
 		double in_max_cluster_distance=0.5)
 {
 	pcl::search::KdTree<pcl::PointXYZ>::Ptr tree (new pcl::search::KdTree<pcl::PointXYZ>);
@@ -398,76 +459,155 @@ std::vector<ClusterPtr> clusterAndColor(const pcl::PointCloud<pcl::PointXYZ>::Pt
 	//---	3. Color clustered points
 	/////////////////////////////////
 	unsigned int k = 0;
-	//pcl::PointCloud<pcl::PointXYZRGB>::Ptr final_cluster (new pcl::PointCloud<pcl::PointXYZRGB>);
 
-	std::vector<ClusterPtr> clusters;
-	//pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_cluster (new pcl::PointCloud<pcl::PointXYZRGB>);//coord + color cluster
 	for (auto it = cluster_indices.begin(); it != cluster_indices.end(); ++it)
 	{
-		ClusterPtr cluster(new Cluster());
-		cluster->SetCloud(in_cloud_ptr, it->indices, _velodyne_header, k, (int)_colors[k].val[0], (int)_colors[k].val[1], (int)_colors[k].val[2], "", _pose_estimation);
-		clusters.push_back(cluster);
+		ClusterIndices cluster;
+		cluster.cloud = in_cloud_ptr;
+		cluster.indices.swap(it->indices);
+		cluster.id = k;
+		out_cluster_indices.push_back(cluster);
 
 		k++;
 	}
 	//std::cout << "Clusters: " << k << std::endl;
-	return clusters;
-
 }
 
-void checkClusterMerge(size_t in_cluster_id, std::vector<ClusterPtr>& in_clusters, std::vector<bool>& in_out_visited_clusters, std::vector<size_t>& out_merge_indices, double in_merge_threshold)
+//clusters all the distance segments in one pass, the clusters of each segment are the same as clusterAndColor's
+void clusterAndColorGrid(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr, std::vector<ClusterIndices>& out_cluster_indices)
 {
-	//std::cout << "checkClusterMerge" << std::endl;
-	pcl::PointXYZ point_a = in_clusters[in_cluster_id]->GetCentroid();
-	for(size_t i=0; i< in_clusters.size(); i++)
+	std::vector< std::vector<pcl::PointIndices> > segment_cluster_indices;
+	_grid_clustering.Extract(*in_cloud_ptr, segment_cluster_indices);
+
+	for (size_t i = 0; i < segment_cluster_indices.size(); i++)
 	{
-		if (i != in_cluster_id && !in_out_visited_clusters[i])
+		//numbered per segment like clusterAndColor
+		unsigned int k = 0;
+		for (auto it = segment_cluster_indices[i].begin(); it != segment_cluster_indices[i].end(); ++it)
 		{
-			pcl::PointXYZ point_b = in_clusters[i]->GetCentroid();
-			double distance = sqrt( pow(point_b.x - point_a.x,2) + pow(point_b.y - point_a.y,2) );
-			if (distance <= in_merge_threshold)
-			{
-				in_out_visited_clusters[i] = true;
-				out_merge_indices.push_back(i);
-				//std::cout << "Merging " << in_cluster_id << " with " << i << " dist:" << distance << std::endl;
-				checkClusterMerge(i, in_clusters, in_out_visited_clusters, out_merge_indices, in_merge_threshold);
-			}
+			ClusterIndices cluster;
+			cluster.cloud = in_cloud_ptr;
+			cluster.indices.swap(it->indices);
+			cluster.id = k;
+			out_cluster_indices.push_back(cluster);
+
+			k++;
 		}
 	}
 }
 
-void mergeClusters(const std::vector<ClusterPtr>& in_clusters, std::vector<ClusterPtr>& out_clusters, std::vector<size_t> in_merge_indices, const size_t& current_index, std::vector<bool>& in_out_merged_clusters)
+//centroids of the clusters hashed on a grid of the merge threshold, the clusters closer than it are in the 3x3 cells around
+class CentroidGrid
 {
-	//std::cout << "mergeClusters:" << in_merge_indices.size() << std::endl;
-	pcl::PointCloud<pcl::PointXYZRGB> sum_cloud;
-	pcl::PointCloud<pcl::PointXYZ> mono_cloud;
-	ClusterPtr merged_cluster(new Cluster());
-	for (size_t i=0; i<in_merge_indices.size(); i++)
+	double cell_size_;
+	std::unordered_map<uint64_t, std::vector<size_t> > cells_;
+
+	uint64_t key(int64_t in_x, int64_t in_y) const
+	{
+		return (static_cast<uint64_t>(in_x) << 32) ^ (static_cast<uint64_t>(in_y) & 0xffffffff);
+	}
+
+	int64_t cell(float in_value) const
 	{
-		sum_cloud += *(in_clusters[in_merge_indices[i]]->GetCloud());
-		in_out_merged_clusters[in_merge_indices[i]] = true;
+		return static_cast<int64_t>(std::floor(in_value / cell_size_));
 	}
-	std::vector<int> indices(sum_cloud.points.size(), 0);
-	for (size_t i=0; i<sum_cloud.points.size(); i++)
+
+public:
+	CentroidGrid(const std::vector<pcl::PointXYZ>& in_centroids, double in_cell_size)
 	{
-		indices[i]=i;
+		cell_size_ = (in_cell_size > 0) ? in_cell_size : 1.0;
+		for (size_t i = 0; i < in_centroids.size(); i++)
+		{
+			cells_[key(cell(in_centroids[i].x), cell(in_centroids[i].y))].push_back(i);
+		}
 	}
 
-	if (sum_cloud.points.size() > 0)
+	void neighbours(const pcl::PointXYZ& in_point, std::vector<size_t>& out_candidates) const
+	{
+		out_candidates.clear();
+		int64_t x = cell(in_point.x);
+		int64_t y = cell(in_point.y);
+		for (int64_t dx = -1; dx <= 1; dx++)
+		{
+			for (int64_t dy = -1; dy <= 1; dy++)
+			{
+				auto it = cells_.find(key(x + dx, y + dy));
+				if (it != cells_.end())
+					out_candidates.insert(out_candidates.end(), it->second.begin(), it->second.end());
+			}
+		}
+	}
+};
+
+void checkClusterMerge(size_t in_cluster_id, const std::vector<pcl::PointXYZ>& in_centroids, const CentroidGrid& in_grid, std::vector<bool>& in_out_visited_clusters, std::vector<size_t>& out_merge_indices, double in_merge_threshold)
+{
+	//depth first in increasing index order, as the recursion over all the clusters did, so the merged points keep their order
+	struct Visit
+	{
+		std::vector<size_t> close_clusters;
+		size_t next;
+	};
+	std::vector<Visit> visits;
+	std::vector<size_t> candidates;
+
+	size_t cluster_id = in_cluster_id;
+	while (true)
 	{
-		pcl::copyPointCloud(sum_cloud, mono_cloud);
-		//std::cout << "mergedClusters " << sum_cloud.points.size() << " mono:" << mono_cloud.points.size() << std::endl;
-		//cluster->SetCloud(in_cloud_ptr, it->indices, _velodyne_header, k, (int)_colors[k].val[0], (int)_colors[k].val[1], (int)_colors[k].val[2], "", _pose_estimation);
-		merged_cluster->SetCloud(mono_cloud.makeShared(), indices, _velodyne_header, current_index,(int)_colors[current_index].val[0], (int)_colors[current_index].val[1], (int)_colors[current_index].val[2], "", _pose_estimation);
-		out_clusters.push_back(merged_cluster);
+		Visit visit;
+		visit.next = 0;
+		pcl::PointXYZ point_a = in_centroids[cluster_id];
+		in_grid.neighbours(point_a, candidates);
+		for (size_t c = 0; c < candidates.size(); c++)
+		{
+			size_t i = candidates[c];
+			if (i == cluster_id)
+				continue;
+			pcl::PointXYZ point_b = in_centroids[i];
+			double distance = sqrt( pow(point_b.x - point_a.x,2) + pow(point_b.y - point_a.y,2) );
+			if (distance <= in_merge_threshold)
+				visit.close_clusters.push_back(i);
+		}
+		std::sort(visit.close_clusters.begin(), visit.close_clusters.end());
+		visits.push_back(visit);
+
+		//next cluster not visited yet, going back up when a cluster has none left
+		bool found = false;
+		while (!visits.empty() && !found)
+		{
+			Visit& current = visits.back();
+			while (current.next < current.close_clusters.size() && !found)
+			{
+				size_t i = current.close_clusters[current.next++];
+				if (!in_out_visited_clusters[i])
+				{
+					in_out_visited_clusters[i] = true;
+					out_merge_indices.push_back(i);
+					cluster_id = i;
+					found = true;
+				}
+			}
+			if (!found)
+				visits.pop_back();
+		}
+		if (!found)
+			break;
 	}
 }
 
 void checkAllForMerge(std::vector<ClusterPtr>& in_clusters, std::vector<ClusterPtr>& out_clusters, float in_merge_threshold)
 {
 	//std::cout << "checkAllForMerge" << std::endl;
+	std::vector<pcl::PointXYZ> centroids(in_clusters.size());
+	for (size_t i = 0; i < in_clusters.size(); i++)
+	{
+		centroids[i] = in_clusters[i]->GetCentroid();
+	}
+	CentroidGrid grid(centroids, in_merge_threshold);
+
 	std::vector<bool> visited_clusters(in_clusters.size(), false);
 	std::vector<bool> merged_clusters(in_clusters.size(), false);
+	std::vector< std::vector<size_t> > merge_groups;
+	std::vector<size_t> merge_ids;
 	size_t current_index=0;
 	for (size_t i = 0; i< in_clusters.size(); i++)
 	{
@@ -475,10 +615,62 @@ void checkAllForMerge(std::vector<ClusterPtr>& in_clusters, std::vector<ClusterP
 		{
 			visited_clusters[i] = true;
 			std::vector<size_t> merge_indices;
-			checkClusterMerge(i, in_clusters, visited_clusters, merge_indices, in_merge_threshold);
-			mergeClusters(in_clusters, out_clusters, merge_indices, current_index++, merged_clusters);
+			checkClusterMerge(i, centroids, grid, visited_clusters, merge_indices, in_merge_threshold);
+			if (merge_indices.size() > 0)
+			{
+				for (size_t j = 0; j < merge_indices.size(); j++)
+					merged_clusters[merge_indices[j]] = true;
+				merge_groups.push_back(merge_indices);
+				merge_ids.push_back(current_index);
+			}
+			current_index++;
 		}
 	}
+
+	//merged clusters, on the worker pool
+	std::vector<ClusterPtr> merged(merge_groups.size());
+	std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> storage(merge_groups.size());
+	for (size_t g = 0; g < merge_groups.size(); g++)
+	{
+		storage[g] = getArenaCloud();
+	}
+	_worker_pool->Run(merge_groups.size(), [&](size_t g)
+	{
+		const std::vector<size_t>& merge_indices = merge_groups[g];
+		size_t current_index = merge_ids[g];
+
+		pcl::PointCloud<pcl::PointXYZ>::Ptr mono_cloud(new pcl::PointCloud<pcl::PointXYZ>);
+		for (size_t i=0; i<merge_indices.size(); i++)
+		{
+			const pcl::PointCloud<pcl::PointXYZRGB>& cloud = *(in_clusters[merge_indices[i]]->GetCloud());
+			for (size_t j=0; j<cloud.points.size(); j++)
+			{
+				pcl::PointXYZ point;
+				point.x = cloud.points[j].x;
+				point.y = cloud.points[j].y;
+				point.z = cloud.points[j].z;
+				mono_cloud->points.push_back(point);
+			}
+		}
+		std::vector<int> indices(mono_cloud->points.size(), 0);
+		for (size_t i=0; i<mono_cloud->points.size(); i++)
+		{
+			indices[i]=i;
+		}
+
+		if (mono_cloud->points.size() > 0)
+		{
+			ClusterPtr merged_cluster(new Cluster());
+			merged_cluster->SetCloud(mono_cloud, indices, _velodyne_header, current_index,(int)_colors[current_index].val[0], (int)_colors[current_index].val[1], (int)_colors[current_index].val[2], "", _pose_estimation, storage[g]);
+			merged[g] = merged_cluster;
+		}
+	});
+	for (size_t g = 0; g < merged.size(); g++)
+	{
+		if (merged[g])
+			out_clusters.push_back(merged[g]);
+	}
+
 	for(size_t i =0; i< in_clusters.size(); i++)
 	{
 		//check for clusters not merged, add them to the output
@@ -487,8 +679,6 @@ void checkAllForMerge(std::vector<ClusterPtr>& in_clusters, std::vector<ClusterP
 			out_clusters.push_back(in_clusters[i]);
 		}
 	}
-
-	//ClusterPtr cluster(new Cluster());
 }
 
 void segmentByDistance(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr,
@@ -508,49 +698,63 @@ void segmentByDistance(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr,
 	//3 => 45-60 d=2.1
 	//4 => >60   d=2.6
 
-	std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> cloud_segments_array(5);
+	std::chrono::system_clock::time_point stage_start = std::chrono::system_clock::now();
+	_cluster_cloud_arena_used = 0;
 
-	for(unsigned int i=0; i<cloud_segments_array.size(); i++)
+	std::vector<ClusterIndices> all_cluster_indices;
+	if (_use_grid_clustering)
 	{
-		pcl::PointCloud<pcl::PointXYZ>::Ptr tmp_cloud(new pcl::PointCloud<pcl::PointXYZ>);
-		cloud_segments_array[i] = tmp_cloud;
+		clusterAndColorGrid(in_cloud_ptr, all_cluster_indices);
 	}
-
-	for (unsigned int i=0; i<in_cloud_ptr->points.size(); i++)
+	else
 	{
-		pcl::PointXYZ current_point;
-		current_point.x = in_cloud_ptr->points[i].x;
-		current_point.y = in_cloud_ptr->points[i].y;
-		current_point.z = in_cloud_ptr->points[i].z;
+		std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> cloud_segments_array(5);
 
-		float origin_distance = sqrt( pow(current_point.x,2) + pow(current_point.y,2) );
+		for(unsigned int i=0; i<cloud_segments_array.size(); i++)
+		{
+			pcl::PointCloud<pcl::PointXYZ>::Ptr tmp_cloud(new pcl::PointCloud<pcl::PointXYZ>);
+			cloud_segments_array[i] = tmp_cloud;
+		}
 
-		if 		(origin_distance < _clustering_distances[0] )	{cloud_segments_array[0]->points.push_back (current_point);}
-		else if(origin_distance < _clustering_distances[1])		{cloud_segments_array[1]->points.push_back (current_point);}
-		else if(origin_distance < _clustering_distances[2])		{cloud_segments_array[2]->points.push_back (current_point);}
-		else if(origin_distance < _clustering_distances[3])		{cloud_segments_array[3]->points.push_back (current_point);}
-		else													{cloud_segments_array[4]->points.push_back (current_point);}
-	}
+		for (unsigned int i=0; i<in_cloud_ptr->points.size(); i++)
+		{
+			pcl::PointXYZ current_point;
+			current_point.x = in_cloud_ptr->points[i].x;
+			current_point.y = in_cloud_ptr->points[i].y;
+			current_point.z = in_cloud_ptr->points[i].z;
+
+			float origin_distance = sqrt( pow(current_point.x,2) + pow(current_point.y,2) );
+
+			if 		(origin_distance < _clustering_distances[0] )	{cloud_segments_array[0]->points.push_back (current_point);}
+			else if(origin_distance < _clustering_distances[1])		{cloud_segments_array[1]->points.push_back (current_point);}
+			else if(origin_distance < _clustering_distances[2])		{cloud_segments_array[2]->points.push_back (current_point);}
+			else if(origin_distance < _clustering_distances[3])		{cloud_segments_array[3]->points.push_back (current_point);}
+			else													{cloud_segments_array[4]->points.push_back (current_point);}
+		}
 
-	std::vector <ClusterPtr> all_clusters;
-	for(unsigned int i=0; i<cloud_segments_array.size(); i++)
-	{
+		for(unsigned int i=0; i<cloud_segments_array.size(); i++)
+		{
 #ifdef GPU_CLUSTERING
-    std::vector<ClusterPtr> local_clusters;
-		if (_use_gpu) {
-			local_clusters = clusterAndColorGpu(cloud_segments_array[i], out_cloud_ptr, in_out_boundingbox_array, in_out_centroids, _clustering_thresholds[i]);
-		} else {
-			local_clusters = clusterAndColor(cloud_segments_array[i], out_cloud_ptr, in_out_boundingbox_array, in_out_centroids, _clustering_thresholds[i]);
-		}
+			if (_use_gpu) {
+				clusterAndColorGpu(cloud_segments_array[i], all_cluster_indices, _clustering_thresholds[i]);
+			} else {
+				clusterAndColor(cloud_segments_array[i], all_cluster_indices, _clustering_thresholds[i]);
+			}
 #else
-		std::vector<ClusterPtr> local_clusters = clusterAndColor(cloud_segments_array[i], out_cloud_ptr, in_out_boundingbox_array, in_out_centroids, _clustering_thresholds[i]);
+			clusterAndColor(cloud_segments_array[i], all_cluster_indices, _clustering_thresholds[i]);
 #endif
-		all_clusters.insert(all_clusters.end(), local_clusters.begin(), local_clusters.end());
+		}
 	}
+	addStageTime(in_out_clusters, "clustering", elapsedMs(stage_start));
+
+	stage_start = std::chrono::system_clock::now();
+	std::vector <ClusterPtr> all_clusters = setClusterClouds(all_cluster_indices);
+	addStageTime(in_out_clusters, "cluster_features", elapsedMs(stage_start));
 
 	//Clusters can be merged or checked in here
 	//....
 	//check for mergable clusters
+	stage_start = std::chrono::system_clock::now();
 	std::vector<ClusterPtr> mid_clusters;
 	std::vector<ClusterPtr> final_clusters;
 
@@ -563,10 +767,12 @@ void segmentByDistance(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr,
 			checkAllForMerge(mid_clusters, final_clusters, _cluster_merge_threshold);
 	else
 		final_clusters = mid_clusters;
+	addStageTime(in_out_clusters, "merge", elapsedMs(stage_start));
 
 	tf::StampedTransform vectormap_transform;
 	if (_use_vector_map)
 	{
+		stage_start = std::chrono::system_clock::now();
 		cv::TickMeter timer;
 
 		try
@@ -618,13 +824,15 @@ void segmentByDistance(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr,
 		{
 			ROS_INFO("vectormap_filtering: %s", ex.what());
 		}
+		addStageTime(in_out_clusters, "vector_map", elapsedMs(stage_start));
 	}
 	//Get final PointCloud to be published
+	stage_start = std::chrono::system_clock::now();
 	in_out_polygon_array.header = _velodyne_header;
 	in_out_pictogram_array.header = _velodyne_header;
 	for(unsigned int i=0; i<final_clusters.size(); i++)
 	{
-		*out_cloud_ptr = *out_cloud_ptr + *(final_clusters[i]->GetCloud());
+		*out_cloud_ptr += *(final_clusters[i]->GetCloud());
 
 		jsk_recognition_msgs::BoundingBox bounding_box = final_clusters[i]->GetBoundingBox();
 		geometry_msgs::PolygonStamped polygon = final_clusters[i]->GetPolygon();
@@ -675,6 +883,7 @@ void segmentByDistance(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr,
 	{
 		in_out_polygon_array.labels.push_back(i);
 	}
+	addStageTime(in_out_clusters, "output", elapsedMs(stage_start));
 
 }
 
@@ -859,6 +1068,7 @@ void velodyne_callback(const sensor_msgs::PointCloud2ConstPtr& in_sensor_cloud)
 
 		_velodyne_header = in_sensor_cloud->header;
 
+		std::chrono::system_clock::time_point stage_start = std::chrono::system_clock::now();
 		if (_remove_points_upto > 0.0)
 		{
 			removePointsUpTo(current_sensor_cloud_ptr, removed_points_cloud_ptr, _remove_points_upto);
@@ -877,10 +1087,13 @@ void velodyne_callback(const sensor_msgs::PointCloud2ConstPtr& in_sensor_cloud)
 			keepLanePoints(clipped_cloud_ptr, inlanes_cloud_ptr, _keep_lane_left_distance, _keep_lane_right_distance);
 		else
 			inlanes_cloud_ptr = clipped_cloud_ptr;
+		addStageTime(cloud_clusters, "preprocessing", elapsedMs(stage_start));
 
 		if(_remove_ground)
 		{
+			stage_start = std::chrono::system_clock::now();
 			removeFloor(inlanes_cloud_ptr, nofloor_cloud_ptr, onlyfloor_cloud_ptr);
+			addStageTime(cloud_clusters, "ground_removal", elapsedMs(stage_start));
 			publishCloud(&_pub_ground_cloud, onlyfloor_cloud_ptr);
 		}
 		else
@@ -889,7 +1102,11 @@ void velodyne_callback(const sensor_msgs::PointCloud2ConstPtr& in_sensor_cloud)
 		publishCloud(&_pub_points_lanes_cloud, nofloor_cloud_ptr);
 
 		if (_use_diffnormals)
+		{
+			stage_start = std::chrono::system_clock::now();
 			differenceNormalsSegmentation(nofloor_cloud_ptr, diffnormals_cloud_ptr);
+			addStageTime(cloud_clusters, "diffnormals", elapsedMs(stage_start));
+		}
 		else
 			diffnormals_cloud_ptr = nofloor_cloud_ptr;
 
@@ -1074,6 +1291,15 @@ int main (int argc, char** argv)
 	private_nh.param("remove_points_upto", _remove_points_upto, 0.0);		ROS_INFO("remove_points_upto: %f", _remove_points_upto);
 
 	private_nh.param("use_gpu", _use_gpu, false);				ROS_INFO("use_gpu: %d", _use_gpu);
+	private_nh.param("use_grid_clustering", _use_grid_clustering, false);	ROS_INFO("use_grid_clustering: %d", _use_grid_clustering);
+	if (_use_grid_clustering && _use_gpu)
+		ROS_WARN("use_grid_clustering and use_gpu are both set, the grid clustering runs on the CPU and use_gpu is ignored");
+
+	int cluster_threads;
+	private_nh.param("cluster_threads", cluster_threads, 0);
+	WorkerPool worker_pool(cluster_threads);
+	_worker_pool = &worker_pool;
+	ROS_INFO("cluster_threads: %d", _worker_pool->GetThreads());
 
 	_velodyne_transform_available = false;
 
@@ -1086,6 +1312,10 @@ int main (int argc, char** argv)
 		_clustering_thresholds = {0.5, 1.1, 1.6, 2.1, 2.6};//Nearest neighbor distance threshold for each segment
 	}
 
+	_grid_clustering.SetBands(_clustering_distances, _clustering_thresholds);
+	_grid_clustering.SetMinClusterSize(_cluster_size_min);
+	_grid_clustering.SetMaxClusterSize(_cluster_size_max);
+
 	std::cout << "_clustering_thresholds: "; for (auto i = _clustering_thresholds.begin(); i != _clustering_thresholds.end(); ++i)  std::cout << *i << ' '; std::cout << std::endl;
 	std::cout << "_clustering_distances: ";for (auto i = _clustering_distances.begin(); i != _clustering_distances.end(); ++i)  std::cout << *i << ' '; std::cout <<std::endl;
 
@@ -85,8 +85,10 @@ public:
 	 * \param[in] in_b 					Amount of Blue [0-255]
 	 * \param[in] in_label 				Label to identify this cluster (optional)
 	 * \param[in] in_estimate_pose		Flag to enable Pose Estimation of the Bounding Box
+	 * \param[in] in_storage_ptr		PointCloud to hold the points of the Cluster, reusing its memory (optional)
 	 * */
-	void SetCloud(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_origin_cloud_ptr, const std::vector<int>& in_cluster_indices, std_msgs::Header in_ros_header, int in_id, int in_r, int in_g, int in_b, std::string in_label, bool in_estimate_pose);
+	void SetCloud(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_origin_cloud_ptr, const std::vector<int>& in_cluster_indices, std_msgs::Header in_ros_header, int in_id, int in_r, int in_g, int in_b, std::string in_label, bool in_estimate_pose,
+			pcl::PointCloud<pcl::PointXYZRGB>::Ptr in_storage_ptr = pcl::PointCloud<pcl::PointXYZRGB>::Ptr());
 
 	/* \brief Returns the autoware_msgs::CloudCluster message associated to this Cluster */
 	void ToRosMessage(std_msgs::Header in_ros_header, autoware_msgs::CloudCluster& out_cluster_message);
@@ -0,0 +1,78 @@
+/*
+ * GridClustering.h
+ *
+ * Euclidean clustering of a flattened cloud on a hashed occupancy grid.
+ */
+#ifndef GRID_CLUSTERING_H_
+#define GRID_CLUSTERING_H_
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/PointIndices.h>
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+/* \brief Clusters the whole cloud in one pass with the distance band thresholds of euclidean_cluster.
+ *
+ * Each point falls in the band of its distance to the sensor origin on the XY plane, and two points of a band are
+ * connected when they are closer than the threshold of the band on the XY plane. The clusters are the connected
+ * components, the same as pcl::EuclideanClusterExtraction gives on the flattened points of each band.
+ *
+ * The points are hashed into square cells of side threshold/sqrt(2) per band, so the points of a cell are always
+ * connected. The cells are joined with union-find, checking point pairs only between cells of the 5x5 neighbourhood
+ * that are not already in the same component. No search tree is built.
+ */
+class GridClustering {
+	struct Cell
+	{
+		int band;
+		int x, y;
+		int parent;
+		int start;	//first point of the cell in cell_points_
+		int size;
+	};
+
+	std::vector<double>					distances_;
+	std::vector<double>					thresholds_;
+	std::vector<float>					cell_sizes_;
+	int									min_cluster_size_;
+	int									max_cluster_size_;
+
+	/* buffers kept between frames */
+	std::unordered_map<uint64_t, int>	cell_map_;
+	std::vector<Cell>					cells_;
+	std::vector<int>					point_cells_;
+	std::vector<int>					cell_points_;
+	std::vector<int>					component_clusters_;
+
+	static uint64_t						CellKey(int in_band, int in_x, int in_y);
+	int									FindCell(int in_band, int in_x, int in_y) const;
+	int									FindRoot(int in_cell);
+	bool								CellsConnected(const pcl::PointCloud<pcl::PointXYZ>& in_cloud, const Cell& in_a, const Cell& in_b, float in_squared_threshold) const;
+
+public:
+	GridClustering();
+
+	/* \brief Sets the distance bands
+	 * \param[in] in_distances 		Upper distance of every band but the last one, increasing
+	 * \param[in] in_thresholds 	Cluster tolerance of each band, one more than in_distances
+	 * */
+	void SetBands(const std::vector<double>& in_distances, const std::vector<double>& in_thresholds);
+	/* \brief Sets the minimum number of points of a cluster */
+	void SetMinClusterSize(int in_min_cluster_size);
+	/* \brief Sets the maximum number of points of a cluster. Larger components are dropped, not split */
+	void SetMaxClusterSize(int in_max_cluster_size);
+
+	/* \brief Returns the band of a point */
+	int GetBand(const pcl::PointXYZ& in_point) const;
+
+	/* \brief Clusters the cloud. Points that are not finite are ignored.
+	 * \param[in] in_cloud 				Cloud to cluster, z is not used
+	 * \param[out] out_band_clusters 	Clusters of each band, as indices of in_cloud, largest first like pcl
+	 * */
+	void Extract(const pcl::PointCloud<pcl::PointXYZ>& in_cloud, std::vector< std::vector<pcl::PointIndices> >& out_band_clusters);
+};
+
+#endif /* GRID_CLUSTERING_H_ */
@@ -0,0 +1,48 @@
+/*
+ * WorkerPool.h
+ *
+ * Threads kept between frames to run independent jobs in parallel.
+ */
+#ifndef WORKER_POOL_H_
+#define WORKER_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool {
+	std::vector<std::thread>				workers_;
+	std::mutex								mutex_;
+	std::condition_variable					start_;
+	std::condition_variable					done_;
+
+	const std::function<void(size_t)>*		job_;
+	size_t									count_;
+	std::atomic<size_t>						next_;
+	int										running_;		//workers still in the current run
+	unsigned long							generation_;	//runs started, wakes the workers
+	bool									stop_;
+
+	void									WorkerLoop();
+	void									RunJobs();
+
+public:
+	/* \brief Starts the workers
+	 * \param[in] in_threads 	Threads running the jobs, the calling one included. 0 for all the cores
+	 * */
+	explicit WorkerPool(int in_threads = 0);
+	virtual ~WorkerPool();
+
+	/* \brief Returns the number of threads running the jobs, the calling one included */
+	int GetThreads() const;
+
+	/* \brief Runs in_job(i) for every i in [0, in_count) and returns when all are done. The calling thread takes jobs too.
+	 * Jobs are handed out one at a time, so their order of execution is not defined.
+	 * */
+	void Run(size_t in_count, const std::function<void(size_t)>& in_job);
+};
+
+#endif /* WORKER_POOL_H_ */
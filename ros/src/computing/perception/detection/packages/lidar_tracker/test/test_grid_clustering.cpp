@@ -0,0 +1,180 @@
+/*
+ * test_grid_clustering.cpp
+ *
+ *  Checks GridClustering against a brute force euclidean clustering of each
+ *  distance band, the clusters pcl::EuclideanClusterExtraction gives on the
+ *  flattened points of the band, with the euclidean_cluster thresholds.
+ */
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "GridClustering.h"
+
+//clusters as sorted point indices of the cloud, in a canonical order
+typedef std::vector< std::vector<int> > ClusterSet;
+
+static void Canonicalize(ClusterSet& in_out_clusters)
+{
+	for (size_t k = 0; k < in_out_clusters.size(); k++)
+		std::sort(in_out_clusters[k].begin(), in_out_clusters[k].end());
+	std::sort(in_out_clusters.begin(), in_out_clusters.end());
+}
+
+//deterministic pseudo random numbers in [-1, 1]
+static float Noise(unsigned int& in_out_state)
+{
+	in_out_state = in_out_state * 1664525u + 1013904223u;
+	return (in_out_state >> 8) / static_cast<float>(1u << 23) - 1.f;
+}
+
+class GridClusteringTest : public ::testing::Test
+{
+protected:
+	std::vector<double> distances_;
+	std::vector<double> thresholds_;
+	int min_cluster_size_;
+	int max_cluster_size_;
+	GridClustering grid_clustering_;
+
+	virtual void SetUp()
+	{
+		// euclidean_cluster defaults, smaller minimum so that the sparse far bands have clusters
+		distances_ = {15, 30, 45, 60};
+		thresholds_ = {0.5, 1.1, 1.6, 2.1, 2.6};
+		min_cluster_size_ = 3;
+		max_cluster_size_ = 400;
+		grid_clustering_.SetBands(distances_, thresholds_);
+		grid_clustering_.SetMinClusterSize(min_cluster_size_);
+		grid_clustering_.SetMaxClusterSize(max_cluster_size_);
+	}
+
+	//blobs of every size, some across band limits, and scattered points
+	static void MakeScan(unsigned int in_seed, pcl::PointCloud<pcl::PointXYZ>& out_scan)
+	{
+		unsigned int state = in_seed;
+		out_scan.points.clear();
+		for (int b = 0; b < 60; b++)
+		{
+			float cx = 80 * Noise(state), cy = 80 * Noise(state);
+			int size = static_cast<int>(30 * (Noise(state) + 1));
+			for (int k = 0; k < size; k++)
+			{
+				pcl::PointXYZ point;
+				point.x = cx + 1.5f * Noise(state);
+				point.y = cy + 1.5f * Noise(state);
+				point.z = Noise(state);
+				out_scan.points.push_back(point);
+			}
+		}
+		for (int k = 0; k < 2000; k++)
+		{
+			pcl::PointXYZ point;
+			point.x = 80 * Noise(state);
+			point.y = 80 * Noise(state);
+			point.z = Noise(state);
+			out_scan.points.push_back(point);
+		}
+		out_scan.width = out_scan.points.size();
+		out_scan.height = 1;
+	}
+
+	//connected components of each band by breadth first search over all the points
+	ClusterSet BruteForce(const pcl::PointCloud<pcl::PointXYZ>& in_scan) const
+	{
+		const std::vector<pcl::PointXYZ>& points = in_scan.points;
+		std::vector<bool> visited(points.size(), false);
+		ClusterSet clusters;
+		for (size_t i = 0; i < points.size(); i++)
+		{
+			if (visited[i] || !std::isfinite(points[i].x) || !std::isfinite(points[i].y))
+				continue;
+			int band = grid_clustering_.GetBand(points[i]);
+			float squared_threshold = static_cast<float>(thresholds_[band] * thresholds_[band]);
+			std::vector<int> cluster(1, i);
+			visited[i] = true;
+			for (size_t q = 0; q < cluster.size(); q++)
+			{
+				const pcl::PointXYZ& a = points[cluster[q]];
+				for (size_t j = 0; j < points.size(); j++)
+				{
+					if (visited[j] || !std::isfinite(points[j].x) || !std::isfinite(points[j].y) ||
+						grid_clustering_.GetBand(points[j]) != band)
+						continue;
+					float dx = a.x - points[j].x, dy = a.y - points[j].y;
+					if (dx * dx + dy * dy < squared_threshold)
+					{
+						visited[j] = true;
+						cluster.push_back(j);
+					}
+				}
+			}
+			if ((int)cluster.size() >= min_cluster_size_ && (int)cluster.size() <= max_cluster_size_)
+				clusters.push_back(cluster);
+		}
+		Canonicalize(clusters);
+		return clusters;
+	}
+};
+
+TEST_F(GridClusteringTest, SameClustersAsBruteForce)
+{
+	pcl::PointCloud<pcl::PointXYZ> scan;
+	for (unsigned int seed = 1; seed <= 10; seed++)
+	{
+		MakeScan(seed, scan);
+		ClusterSet expected = BruteForce(scan);
+		ASSERT_FALSE(expected.empty());
+
+		// the buffers of the previous scan are reused
+		std::vector< std::vector<pcl::PointIndices> > band_clusters;
+		grid_clustering_.Extract(scan, band_clusters);
+		ASSERT_EQ(thresholds_.size(), band_clusters.size());
+
+		ClusterSet clusters;
+		for (size_t s = 0; s < band_clusters.size(); s++)
+		{
+			for (size_t k = 0; k < band_clusters[s].size(); k++)
+			{
+				// largest first like pcl
+				if (k > 0)
+					EXPECT_GE(band_clusters[s][k - 1].indices.size(), band_clusters[s][k].indices.size());
+				clusters.push_back(band_clusters[s][k].indices);
+			}
+		}
+		Canonicalize(clusters);
+		EXPECT_TRUE(clusters == expected) << "seed " << seed << ": " << clusters.size() << " clusters, expected " << expected.size();
+	}
+}
+
+TEST_F(GridClusteringTest, InvalidPoints)
+{
+	pcl::PointCloud<pcl::PointXYZ> scan;
+	for (int k = 0; k < 5; k++)
+	{
+		pcl::PointXYZ point;
+		point.x = 5 + 0.1f * k;
+		point.y = 0;
+		point.z = 0;
+		scan.points.push_back(point);
+		point.x = std::numeric_limits<float>::quiet_NaN();
+		scan.points.push_back(point);
+	}
+	scan.width = scan.points.size();
+	scan.height = 1;
+
+	std::vector< std::vector<pcl::PointIndices> > band_clusters;
+	grid_clustering_.Extract(scan, band_clusters);
+	ASSERT_EQ(1u, band_clusters[0].size());
+	std::vector<int> expected = {0, 2, 4, 6, 8};
+	EXPECT_TRUE(band_clusters[0][0].indices == expected);
+}
+
+int main(int argc, char **argv)
+{
+	testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
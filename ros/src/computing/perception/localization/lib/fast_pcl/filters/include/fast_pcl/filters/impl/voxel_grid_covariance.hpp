@@ -46,6 +46,15 @@
 #include <Eigen/Dense>
 #include <Eigen/Cholesky>
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 //////////////////////////////////////////////////////////////////////////////////////////
 template<typename PointT> void
 pcl::VoxelGridCovariance<PointT>::applyFilter (PointCloud &output)
@@ -99,6 +108,12 @@ pcl::VoxelGridCovariance<PointT>::applyFilter (PointCloud &output)
 
   // Clear the leaves
   leaves_.clear ();
+  leaf_array_.clear ();
+  leaf_array_indices_.clear ();
+  leaf_table_.clear ();
+  leaf_table_bits_ = 0;
+  if (leaf_storage_ == LEAF_STORAGE_HASH)
+    rehashLeaves (10);
 
   // Set up the division multiplier
   divb_mul_ = Eigen::Vector4i (1, div_b_[0], div_b_[0] * div_b_[1], 0);
@@ -164,43 +179,7 @@ pcl::VoxelGridCovariance<PointT>::applyFilter (PointCloud &output)
       // Compute the centroid leaf index
       int idx = ijk0 * divb_mul_[0] + ijk1 * divb_mul_[1] + ijk2 * divb_mul_[2];
 
-      Leaf& leaf = leaves_[idx];
-      if (leaf.nr_points == 0)
-      {
-        leaf.centroid.resize (centroid_size);
-        leaf.centroid.setZero ();
-      }
-
-      Eigen::Vector3d pt3d (input_->points[cp].x, input_->points[cp].y, input_->points[cp].z);
-      // Accumulate point sum for centroid calculation
-      leaf.mean_ += pt3d;
-      // Accumulate x*xT for single pass covariance calculation
-      leaf.cov_ += pt3d * pt3d.transpose ();
-
-      // Do we need to process all the fields?
-      if (!downsample_all_data_)
-      {
-        Eigen::Vector4f pt (input_->points[cp].x, input_->points[cp].y, input_->points[cp].z, 0);
-        leaf.centroid.template head<4> () += pt;
-      }
-      else
-      {
-        // Copy all the fields
-        Eigen::VectorXf centroid = Eigen::VectorXf::Zero (centroid_size);
-        // ---[ RGB special case
-        if (rgba_index >= 0)
-        {
-          // fill r/g/b data
-          int rgb;
-          memcpy (&rgb, reinterpret_cast<const char*> (&input_->points[cp]) + rgba_index, sizeof (int));
-          centroid[centroid_size - 3] = static_cast<float> ((rgb >> 16) & 0x0000ff);
-          centroid[centroid_size - 2] = static_cast<float> ((rgb >> 8) & 0x0000ff);
-          centroid[centroid_size - 1] = static_cast<float> ((rgb) & 0x0000ff);
-        }
-        pcl::for_each_type<FieldList> (NdCopyPointEigenFunctor<PointT> (input_->points[cp], centroid));
-        leaf.centroid += centroid;
-      }
-      ++leaf.nr_points;
+      accumulatePoint (input_->points[cp], getOrCreateLeaf (idx), centroid_size, rgba_index);
     }
   }
   // No distance filtering, process all data
@@ -224,150 +203,397 @@ pcl::VoxelGridCovariance<PointT>::applyFilter (PointCloud &output)
       int idx = ijk0 * divb_mul_[0] + ijk1 * divb_mul_[1] + ijk2 * divb_mul_[2];
 
       //int idx = (((input_->points[cp].getArray4fmap () * inverse_leaf_size_).template cast<int> ()).matrix () - min_b_).dot (divb_mul_);
-      Leaf& leaf = leaves_[idx];
-      if (leaf.nr_points == 0)
-      {
-        leaf.centroid.resize (centroid_size);
-        leaf.centroid.setZero ();
-      }
-
-      Eigen::Vector3d pt3d (input_->points[cp].x, input_->points[cp].y, input_->points[cp].z);
-      // Accumulate point sum for centroid calculation
-      leaf.mean_ += pt3d;
-      // Accumulate x*xT for single pass covariance calculation
-      leaf.cov_ += pt3d * pt3d.transpose ();
-
-      // Do we need to process all the fields?
-      if (!downsample_all_data_)
-      {
-        Eigen::Vector4f pt (input_->points[cp].x, input_->points[cp].y, input_->points[cp].z, 0);
-        leaf.centroid.template head<4> () += pt;
-      }
-      else
-      {
-        // Copy all the fields
-        Eigen::VectorXf centroid = Eigen::VectorXf::Zero (centroid_size);
-        // ---[ RGB special case
-        if (rgba_index >= 0)
-        {
-          // Fill r/g/b data, assuming that the order is BGRA
-          int rgb;
-          memcpy (&rgb, reinterpret_cast<const char*> (&input_->points[cp]) + rgba_index, sizeof (int));
-          centroid[centroid_size - 3] = static_cast<float> ((rgb >> 16) & 0x0000ff);
-          centroid[centroid_size - 2] = static_cast<float> ((rgb >> 8) & 0x0000ff);
-          centroid[centroid_size - 1] = static_cast<float> ((rgb) & 0x0000ff);
-        }
-        pcl::for_each_type<FieldList> (NdCopyPointEigenFunctor<PointT> (input_->points[cp], centroid));
-        leaf.centroid += centroid;
-      }
-      ++leaf.nr_points;
+      accumulatePoint (input_->points[cp], getOrCreateLeaf (idx), centroid_size, rgba_index);
     }
   }
 
   // Second pass: go over all leaves and compute centroids and covariance matrices
-  output.points.reserve (leaves_.size ());
-  if (searchable_)
-    voxel_centroids_leaf_indices_.reserve (leaves_.size ());
-  int cp = 0;
+  output.points.reserve (getLeafCount ());
+  voxel_centroids_leaf_indices_.reserve (getLeafCount ());
   if (save_leaf_layout_)
     leaf_layout_.resize (div_b_[0] * div_b_[1] * div_b_[2], -1);
 
+  if (leaf_storage_ == LEAF_STORAGE_HASH)
+  {
+    for (size_t li = 0; li < leaf_array_.size (); ++li)
+      computeLeafDistribution (leaf_array_indices_[li], static_cast<int> (li), leaf_array_[li], output, centroid_size, rgba_index);
+  }
+  else
+  {
+    for (typename std::map<size_t, Leaf>::iterator it = leaves_.begin (); it != leaves_.end (); ++it)
+      computeLeafDistribution (it->first, static_cast<int> (it->first), it->second, output, centroid_size, rgba_index);
+  }
+
+  output.width = static_cast<uint32_t> (output.points.size ());
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+template<typename PointT> void
+pcl::VoxelGridCovariance<PointT>::accumulatePoint (const PointT &point, Leaf &leaf, int centroid_size, int rgba_index)
+{
+  if (leaf.nr_summed_points_ == 0)
+  {
+    leaf.centroid.resize (centroid_size);
+    leaf.centroid.setZero ();
+  }
+
+  Eigen::Vector3d pt3d (point.x, point.y, point.z);
+  // Accumulate point sum for centroid calculation
+  leaf.point_sum_ += pt3d;
+  // Accumulate x*xT for single pass covariance calculation
+  leaf.point_outer_sum_ += pt3d * pt3d.transpose ();
+
+  // Do we need to process all the fields?
+  if (!downsample_all_data_)
+  {
+    Eigen::Vector4f pt (point.x, point.y, point.z, 0);
+    leaf.centroid.template head<4> () += pt;
+  }
+  else
+  {
+    // Copy all the fields
+    Eigen::VectorXf centroid = Eigen::VectorXf::Zero (centroid_size);
+    // ---[ RGB special case
+    if (rgba_index >= 0)
+    {
+      // Fill r/g/b data, assuming that the order is BGRA
+      int rgb;
+      memcpy (&rgb, reinterpret_cast<const char*> (&point) + rgba_index, sizeof (int));
+      centroid[centroid_size - 3] = static_cast<float> ((rgb >> 16) & 0x0000ff);
+      centroid[centroid_size - 2] = static_cast<float> ((rgb >> 8) & 0x0000ff);
+      centroid[centroid_size - 1] = static_cast<float> ((rgb) & 0x0000ff);
+    }
+    pcl::for_each_type<FieldList> (NdCopyPointEigenFunctor<PointT> (point, centroid));
+    leaf.centroid += centroid;
+  }
+  ++leaf.nr_summed_points_;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+template<typename PointT> void
+pcl::VoxelGridCovariance<PointT>::computeLeafDistribution (size_t index, int search_index, Leaf &leaf, PointCloud &output,
+                                                           int centroid_size, int rgba_index)
+{
   // Eigen values and vectors calculated to prevent near singluar matrices
   Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> eigensolver;
   Eigen::Matrix3d eigen_val;
-  Eigen::Vector3d pt_sum;
 
   // Eigen values less than a threshold of max eigen value are inflated to a set fraction of the max eigen value.
   double min_covar_eigvalue;
 
-  for (typename std::map<size_t, Leaf>::iterator it = leaves_.begin (); it != leaves_.end (); ++it)
+  leaf.nr_points = leaf.nr_summed_points_;
+  // Normalize the centroid
+  leaf.centroid /= static_cast<float> (leaf.nr_points);
+  // Normalize mean
+  leaf.mean_ = leaf.point_sum_ / leaf.nr_points;
+
+  // If the voxel contains sufficient points, its covariance is calculated and is added to the voxel centroids and output clouds.
+  // Points with less than the minimum points will have a can not be accuratly approximated using a normal distribution.
+  if (leaf.nr_points >= min_points_per_voxel_)
   {
+    if (leaf.centroid_index_ < 0)
+    {
+      leaf.centroid_index_ = static_cast<int> (output.points.size ());
+      output.push_back (PointT ());
 
-    // Normalize the centroid
-    Leaf& leaf = it->second;
+      // Stores the voxel indice for fast access searching
+      voxel_centroids_leaf_indices_.push_back (search_index);
+    }
 
-    // Normalize the centroid
-    leaf.centroid /= static_cast<float> (leaf.nr_points);
-    // Point sum used for single pass covariance calculation
-    pt_sum = leaf.mean_;
-    // Normalize mean
-    leaf.mean_ /= leaf.nr_points;
+    if (save_leaf_layout_ && index < leaf_layout_.size ())
+      leaf_layout_[index] = leaf.centroid_index_;
 
-    // If the voxel contains sufficient points, its covariance is calculated and is added to the voxel centroids and output clouds.
-    // Points with less than the minimum points will have a can not be accuratly approximated using a normal distribution.
-    if (leaf.nr_points >= min_points_per_voxel_)
-    {
-      if (save_leaf_layout_)
-        leaf_layout_[it->first] = cp++;
+    PointT &centroid_point = output.points[leaf.centroid_index_];
 
-      output.push_back (PointT ());
-
-      // Do we need to process all the fields?
-      if (!downsample_all_data_)
-      {
-        output.points.back ().x = leaf.centroid[0];
-        output.points.back ().y = leaf.centroid[1];
-        output.points.back ().z = leaf.centroid[2];
-      }
-      else
+    // Do we need to process all the fields?
+    if (!downsample_all_data_)
+    {
+      centroid_point.x = leaf.centroid[0];
+      centroid_point.y = leaf.centroid[1];
+      centroid_point.z = leaf.centroid[2];
+    }
+    else
+    {
+      pcl::for_each_type<FieldList> (pcl::NdCopyEigenPointFunctor<PointT> (leaf.centroid, centroid_point));
+      // ---[ RGB special case
+      if (rgba_index >= 0)
       {
-        pcl::for_each_type<FieldList> (pcl::NdCopyEigenPointFunctor<PointT> (leaf.centroid, output.back ()));
-        // ---[ RGB special case
-        if (rgba_index >= 0)
-        {
-          // pack r/g/b into rgb
-          float r = leaf.centroid[centroid_size - 3], g = leaf.centroid[centroid_size - 2], b = leaf.centroid[centroid_size - 1];
-          int rgb = (static_cast<int> (r)) << 16 | (static_cast<int> (g)) << 8 | (static_cast<int> (b));
-          memcpy (reinterpret_cast<char*> (&output.points.back ()) + rgba_index, &rgb, sizeof (float));
-        }
+        // pack r/g/b into rgb
+        float r = leaf.centroid[centroid_size - 3], g = leaf.centroid[centroid_size - 2], b = leaf.centroid[centroid_size - 1];
+        int rgb = (static_cast<int> (r)) << 16 | (static_cast<int> (g)) << 8 | (static_cast<int> (b));
+        memcpy (reinterpret_cast<char*> (&centroid_point) + rgba_index, &rgb, sizeof (float));
       }
+    }
 
-      // Stores the voxel indice for fast access searching
-      if (searchable_)
-        voxel_centroids_leaf_indices_.push_back (static_cast<int> (it->first));
+    // Single pass covariance calculation
+    leaf.cov_ = (leaf.point_outer_sum_ - 2 * (leaf.point_sum_ * leaf.mean_.transpose ())) / leaf.nr_points + leaf.mean_ * leaf.mean_.transpose ();
+    leaf.cov_ *= (leaf.nr_points - 1.0) / leaf.nr_points;
+
+    //Normalize Eigen Val such that max no more than 100x min.
+    eigensolver.compute (leaf.cov_);
+    eigen_val = eigensolver.eigenvalues ().asDiagonal ();
+    leaf.evecs_ = eigensolver.eigenvectors ();
+
+    if (eigen_val (0, 0) < 0 || eigen_val (1, 1) < 0 || eigen_val (2, 2) <= 0)
+    {
+      leaf.nr_points = -1;
+      return;
+    }
 
-      // Single pass covariance calculation
-      leaf.cov_ = (leaf.cov_ - 2 * (pt_sum * leaf.mean_.transpose ())) / leaf.nr_points + leaf.mean_ * leaf.mean_.transpose ();
-      leaf.cov_ *= (leaf.nr_points - 1.0) / leaf.nr_points;
+    // Avoids matrices near singularities (eq 6.11)[Magnusson 2009]
 
-      //Normalize Eigen Val such that max no more than 100x min.
-      eigensolver.compute (leaf.cov_);
-      eigen_val = eigensolver.eigenvalues ().asDiagonal ();
-      leaf.evecs_ = eigensolver.eigenvectors ();
+    min_covar_eigvalue = min_covar_eigvalue_mult_ * eigen_val (2, 2);
+    if (eigen_val (0, 0) < min_covar_eigvalue)
+    {
+      eigen_val (0, 0) = min_covar_eigvalue;
 
-      if (eigen_val (0, 0) < 0 || eigen_val (1, 1) < 0 || eigen_val (2, 2) <= 0)
+      if (eigen_val (1, 1) < min_covar_eigvalue)
       {
-        leaf.nr_points = -1;
-        continue;
+        eigen_val (1, 1) = min_covar_eigvalue;
       }
 
-      // Avoids matrices near singularities (eq 6.11)[Magnusson 2009]
+      leaf.cov_ = leaf.evecs_ * eigen_val * leaf.evecs_.inverse ();
+    }
+    leaf.evals_ = eigen_val.diagonal ();
 
-      min_covar_eigvalue = min_covar_eigvalue_mult_ * eigen_val (2, 2);
-      if (eigen_val (0, 0) < min_covar_eigvalue)
-      {
-        eigen_val (0, 0) = min_covar_eigvalue;
+    leaf.icov_ = leaf.cov_.inverse ();
+    if (leaf.icov_.maxCoeff () == std::numeric_limits<float>::infinity ( )
+        || leaf.icov_.minCoeff () == -std::numeric_limits<float>::infinity ( ) )
+    {
+      leaf.nr_points = -1;
+    }
 
-        if (eigen_val (1, 1) < min_covar_eigvalue)
-        {
-          eigen_val (1, 1) = min_covar_eigvalue;
-        }
+  }
+}
 
-        leaf.cov_ = leaf.evecs_ * eigen_val * leaf.evecs_.inverse ();
-      }
-      leaf.evals_ = eigen_val.diagonal ();
+//////////////////////////////////////////////////////////////////////////////////////////
+template<typename PointT> typename pcl::VoxelGridCovariance<PointT>::Leaf&
+pcl::VoxelGridCovariance<PointT>::getOrCreateLeaf (size_t index)
+{
+  if (leaf_storage_ != LEAF_STORAGE_HASH)
+    return (leaves_[index]);
 
-      leaf.icov_ = leaf.cov_.inverse ();
-      if (leaf.icov_.maxCoeff () == std::numeric_limits<float>::infinity ( )
-          || leaf.icov_.minCoeff () == -std::numeric_limits<float>::infinity ( ) )
-      {
-        leaf.nr_points = -1;
-      }
+  // Linear probing until the index or an empty slot is found
+  size_t mask = leaf_table_.size () - 1;
+  size_t slot = hashLeafIndex (index);
+  for (; leaf_table_[slot] != -1; slot = (slot + 1) & mask)
+  {
+    if (leaf_array_indices_[leaf_table_[slot]] == index)
+      return (leaf_array_[leaf_table_[slot]]);
+  }
+
+  // Keep the load factor below 1/2 so probe sequences stay short
+  if (2 * (leaf_array_.size () + 1) > leaf_table_.size ())
+  {
+    rehashLeaves (leaf_table_bits_ + 1);
+    mask = leaf_table_.size () - 1;
+    for (slot = hashLeafIndex (index); leaf_table_[slot] != -1; slot = (slot + 1) & mask);
+  }
+
+  leaf_table_[slot] = static_cast<int> (leaf_array_.size ());
+  leaf_array_indices_.push_back (index);
+  leaf_array_.push_back (Leaf ());
+  return (leaf_array_.back ());
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+template<typename PointT> void
+pcl::VoxelGridCovariance<PointT>::rehashLeaves (int bits)
+{
+  leaf_table_bits_ = bits;
+  leaf_table_.assign (static_cast<size_t> (1) << bits, -1);
+
+  size_t mask = leaf_table_.size () - 1;
+  for (size_t li = 0; li < leaf_array_indices_.size (); ++li)
+  {
+    size_t slot = hashLeafIndex (leaf_array_indices_[li]);
+    while (leaf_table_[slot] != -1)
+      slot = (slot + 1) & mask;
+    leaf_table_[slot] = static_cast<int> (li);
+  }
+}
 
+//////////////////////////////////////////////////////////////////////////////////////////
+template<typename PointT> bool
+pcl::VoxelGridCovariance<PointT>::growBounds (const Eigen::Vector4i &min_b, const Eigen::Vector4i &max_b)
+{
+  if (min_b[0] >= min_b_[0] && min_b[1] >= min_b_[1] && min_b[2] >= min_b_[2] &&
+      max_b[0] <= max_b_[0] && max_b[1] <= max_b_[1] && max_b[2] <= max_b_[2])
+    return (true);
+
+  // Grow by half of the current size as well, so that a map growing along a trajectory is rarely renumbered.
+  // Without the margin if it would make the indices overflow.
+  Eigen::Vector4i new_min_b, new_max_b, new_div_b;
+  bool fits = false;
+  for (int pass = 0; pass < 2 && !fits; ++pass)
+  {
+    for (int i = 0; i < 3; ++i)
+    {
+      int margin = (pass == 0) ? div_b_[i] / 2 : 0;
+      new_min_b[i] = (min_b[i] < min_b_[i]) ? min_b[i] - margin : min_b_[i];
+      new_max_b[i] = (max_b[i] > max_b_[i]) ? max_b[i] + margin : max_b_[i];
     }
+    new_min_b[3] = new_max_b[3] = 0;
+    new_div_b = new_max_b - new_min_b + Eigen::Vector4i::Ones ();
+    new_div_b[3] = 0;
+    fits = static_cast<int64_t> (new_div_b[0]) * new_div_b[1] * new_div_b[2] <= std::numeric_limits<int32_t>::max ();
   }
 
-  output.width = static_cast<uint32_t> (output.points.size ());
+  if (!fits)
+  {
+    PCL_WARN ("[pcl::%s::growBounds] Leaf size is too small for the input dataset. Integer indices would overflow.\n", getClassName ().c_str ());
+    return (false);
+  }
+
+  Eigen::Vector4i new_divb_mul (1, new_div_b[0], new_div_b[0] * new_div_b[1], 0);
+  Eigen::Vector4i offset = min_b_ - new_min_b;
+
+  // Renumber the voxels, the order of the indices does not change
+  if (leaf_storage_ == LEAF_STORAGE_HASH)
+  {
+    for (size_t li = 0; li < leaf_array_indices_.size (); ++li)
+    {
+      size_t index = leaf_array_indices_[li];
+      int i = static_cast<int> (index % div_b_[0]) + offset[0];
+      int j = static_cast<int> ((index / divb_mul_[1]) % div_b_[1]) + offset[1];
+      int k = static_cast<int> (index / divb_mul_[2]) + offset[2];
+      leaf_array_indices_[li] = i * new_divb_mul[0] + j * new_divb_mul[1] + k * new_divb_mul[2];
+    }
+    rehashLeaves (leaf_table_bits_);
+  }
+  else
+  {
+    std::map<size_t, Leaf> leaves;
+    for (typename std::map<size_t, Leaf>::iterator it = leaves_.begin (); it != leaves_.end (); ++it)
+    {
+      int i = static_cast<int> (it->first % div_b_[0]) + offset[0];
+      int j = static_cast<int> ((it->first / divb_mul_[1]) % div_b_[1]) + offset[1];
+      int k = static_cast<int> (it->first / divb_mul_[2]) + offset[2];
+      leaves.insert (leaves.end (), std::make_pair (static_cast<size_t> (i * new_divb_mul[0] + j * new_divb_mul[1] + k * new_divb_mul[2]), it->second));
+    }
+    leaves_.swap (leaves);
+
+    // The search indices are voxel indices with this storage
+    for (size_t ci = 0; ci < voxel_centroids_leaf_indices_.size (); ++ci)
+    {
+      int index = voxel_centroids_leaf_indices_[ci];
+      int i = index % div_b_[0] + offset[0];
+      int j = (index / divb_mul_[1]) % div_b_[1] + offset[1];
+      int k = index / divb_mul_[2] + offset[2];
+      voxel_centroids_leaf_indices_[ci] = i * new_divb_mul[0] + j * new_divb_mul[1] + k * new_divb_mul[2];
+    }
+  }
+
+  min_b_ = new_min_b;
+  max_b_ = new_max_b;
+  div_b_ = new_div_b;
+  divb_mul_ = new_divb_mul;
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+template<typename PointT> void
+pcl::VoxelGridCovariance<PointT>::addPoints (const PointCloudConstPtr &cloud, bool searchable)
+{
+  if (!cloud || cloud->points.empty ())
+    return;
+
+  // Nothing to update yet
+  if (getLeafCount () == 0 || !voxel_centroids_)
+  {
+    this->setInputCloud (cloud);
+    filter (searchable);
+    return;
+  }
+
+  searchable_ = searchable;
+  leaf_layout_.clear ();
+
+  // Make room for the new points
+  Eigen::Vector4f min_p, max_p;
+  getMinMax3D<PointT> (*cloud, min_p, max_p);
+  Eigen::Vector4i min_b (static_cast<int> (floor (min_p[0] * inverse_leaf_size_[0])),
+                         static_cast<int> (floor (min_p[1] * inverse_leaf_size_[1])),
+                         static_cast<int> (floor (min_p[2] * inverse_leaf_size_[2])), 0);
+  Eigen::Vector4i max_b (static_cast<int> (floor (max_p[0] * inverse_leaf_size_[0])),
+                         static_cast<int> (floor (max_p[1] * inverse_leaf_size_[1])),
+                         static_cast<int> (floor (max_p[2] * inverse_leaf_size_[2])), 0);
+  if (!growBounds (min_b, max_b))
+    return;
+
+  int centroid_size = 4;
+
+  if (downsample_all_data_)
+    centroid_size = boost::mpl::size<FieldList>::value;
+
+  // ---[ RGB special case
+  std::vector<pcl::PCLPointField> fields;
+  int rgba_index = -1;
+  rgba_index = pcl::getFieldIndex (*cloud, "rgb", fields);
+  if (rgba_index == -1)
+    rgba_index = pcl::getFieldIndex (*cloud, "rgba", fields);
+  if (rgba_index >= 0)
+  {
+    rgba_index = fields[rgba_index].offset;
+    centroid_size += 3;
+  }
+
+  // First pass: find the voxel of each point
+  const size_t invalid_index = std::numeric_limits<size_t>::max ();
+  std::vector<size_t> point_voxels (cloud->points.size (), invalid_index);
+  std::vector<size_t> voxels;
+  voxels.reserve (cloud->points.size ());
+  for (size_t cp = 0; cp < cloud->points.size (); ++cp)
+  {
+    if (!cloud->is_dense)
+      // Check if the point is invalid
+      if (!pcl_isfinite (cloud->points[cp].x) ||
+          !pcl_isfinite (cloud->points[cp].y) ||
+          !pcl_isfinite (cloud->points[cp].z))
+        continue;
+
+    int ijk0 = static_cast<int> (floor (cloud->points[cp].x * inverse_leaf_size_[0]) - static_cast<float> (min_b_[0]));
+    int ijk1 = static_cast<int> (floor (cloud->points[cp].y * inverse_leaf_size_[1]) - static_cast<float> (min_b_[1]));
+    int ijk2 = static_cast<int> (floor (cloud->points[cp].z * inverse_leaf_size_[2]) - static_cast<float> (min_b_[2]));
+
+    point_voxels[cp] = ijk0 * divb_mul_[0] + ijk1 * divb_mul_[1] + ijk2 * divb_mul_[2];
+    voxels.push_back (point_voxels[cp]);
+  }
+  std::sort (voxels.begin (), voxels.end ());
+  voxels.erase (std::unique (voxels.begin (), voxels.end ()), voxels.end ());
+
+  // Second pass: turn the centroids of the voxels the points fall in back into sums
+  for (size_t vi = 0; vi < voxels.size (); ++vi)
+  {
+    Leaf &leaf = getOrCreateLeaf (voxels[vi]);
+    if (leaf.nr_summed_points_ > 0)
+      leaf.centroid *= static_cast<float> (leaf.nr_summed_points_);
+  }
+
+  // Third pass: accumulate the points
+  for (size_t cp = 0; cp < cloud->points.size (); ++cp)
+  {
+    if (point_voxels[cp] != invalid_index)
+      accumulatePoint (cloud->points[cp], *findLeaf (point_voxels[cp]), centroid_size, rgba_index);
+  }
+
+  // Fourth pass: compute the distributions of these voxels only
+  for (size_t vi = 0; vi < voxels.size (); ++vi)
+  {
+    LeafPtr leaf = findLeaf (voxels[vi]);
+    int search_index = (leaf_storage_ == LEAF_STORAGE_HASH) ? static_cast<int> (leaf - &leaf_array_[0])
+                                                             : static_cast<int> (voxels[vi]);
+    computeLeafDistribution (voxels[vi], search_index, *leaf, *voxel_centroids_, centroid_size, rgba_index);
+  }
+  voxel_centroids_->width = static_cast<uint32_t> (voxel_centroids_->points.size ());
+  voxel_centroids_->height = 1;
+  voxel_centroids_->is_dense = true;
+
+  if (searchable_ && voxel_centroids_->size () > 0)
+  {
+    // Initiates kdtree of the centroids of voxels containing a sufficient number of points
+    kdtree_.setInputCloud (voxel_centroids_);
+  }
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -393,18 +619,62 @@ pcl::VoxelGridCovariance<PointT>::getNeighborhoodAtPoint (const PointT& referenc
     // Checking if the specified cell is in the grid
     if ((diff2min <= displacement.array ()).all () && (diff2max >= displacement.array ()).all ())
     {
-      typename std::map<size_t, Leaf>::iterator leaf_iter = leaves_.find (((ijk + displacement - min_b_).dot (divb_mul_)));
-      if (leaf_iter != leaves_.end () && leaf_iter->second.nr_points >= min_points_per_voxel_)
-      {
-        LeafConstPtr leaf = &(leaf_iter->second);
+      LeafConstPtr leaf = findLeaf ((ijk + displacement - min_b_).dot (divb_mul_));
+      if (leaf != NULL && leaf->nr_points >= min_points_per_voxel_)
         neighbors.push_back (leaf);
-      }
     }
   }
 
   return (static_cast<int> (neighbors.size ()));
 }
 
+//////////////////////////////////////////////////////////////////////////////////////////
+template<typename PointT> int
+pcl::VoxelGridCovariance<PointT>::getNeighborhoodAtPoint (const PointT& reference_point, Neighborhood neighborhood,
+                                                          std::vector<LeafConstPtr> &neighbors)
+{
+  // Displacements ordered so that the first 1, 7 and 27 entries form each neighborhood
+  static const int relative_coordinates[27][3] = {
+    { 0,  0,  0},
+    {-1,  0,  0}, { 1,  0,  0}, { 0, -1,  0}, { 0,  1,  0}, { 0,  0, -1}, { 0,  0,  1},
+    {-1, -1,  0}, {-1,  1,  0}, { 1, -1,  0}, { 1,  1,  0},
+    {-1,  0, -1}, {-1,  0,  1}, { 1,  0, -1}, { 1,  0,  1},
+    { 0, -1, -1}, { 0, -1,  1}, { 0,  1, -1}, { 0,  1,  1},
+    {-1, -1, -1}, {-1, -1,  1}, {-1,  1, -1}, {-1,  1,  1},
+    { 1, -1, -1}, { 1, -1,  1}, { 1,  1, -1}, { 1,  1,  1}
+  };
+
+  neighbors.clear ();
+
+  int nr_cells = 1;
+  if (neighborhood == NEIGHBORHOOD_7)
+    nr_cells = 7;
+  else if (neighborhood == NEIGHBORHOOD_27)
+    nr_cells = 27;
+
+  // Grid coordinates of the voxel containing the point, computed as in applyFilter
+  int ijk0 = static_cast<int> (floor (reference_point.x * inverse_leaf_size_[0]) - static_cast<float> (min_b_[0]));
+  int ijk1 = static_cast<int> (floor (reference_point.y * inverse_leaf_size_[1]) - static_cast<float> (min_b_[1]));
+  int ijk2 = static_cast<int> (floor (reference_point.z * inverse_leaf_size_[2]) - static_cast<float> (min_b_[2]));
+
+  for (int ni = 0; ni < nr_cells; ni++)
+  {
+    int i = ijk0 + relative_coordinates[ni][0];
+    int j = ijk1 + relative_coordinates[ni][1];
+    int k = ijk2 + relative_coordinates[ni][2];
+
+    // Checking if the specified cell is in the grid
+    if (i < 0 || j < 0 || k < 0 || i >= div_b_[0] || j >= div_b_[1] || k >= div_b_[2])
+      continue;
+
+    LeafConstPtr leaf = findLeaf (i * divb_mul_[0] + j * divb_mul_[1] + k * divb_mul_[2]);
+    if (leaf != NULL && leaf->nr_points >= min_points_per_voxel_)
+      neighbors.push_back (leaf);
+  }
+
+  return (static_cast<int> (neighbors.size ()));
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////
 template<typename PointT> void
 pcl::VoxelGridCovariance<PointT>::getDisplayCloud (pcl::PointCloud<PointXYZ>& cell_cloud)
@@ -422,10 +692,24 @@ pcl::VoxelGridCovariance<PointT>::getDisplayCloud (pcl::PointCloud<PointXYZ>& ce
   Eigen::Vector3d rand_point;
   Eigen::Vector3d dist_point;
 
+  // Collect the leaves regardless of the storage used
+  std::vector<Leaf*> leaves;
+  leaves.reserve (getLeafCount ());
+  if (leaf_storage_ == LEAF_STORAGE_HASH)
+  {
+    for (size_t li = 0; li < leaf_array_.size (); ++li)
+      leaves.push_back (&leaf_array_[li]);
+  }
+  else
+  {
+    for (typename std::map<size_t, Leaf>::iterator it = leaves_.begin (); it != leaves_.end (); ++it)
+      leaves.push_back (&(it->second));
+  }
+
   // Generate points for each occupied voxel with sufficient points.
-  for (typename std::map<size_t, Leaf>::iterator it = leaves_.begin (); it != leaves_.end (); ++it)
+  for (size_t li = 0; li < leaves.size (); ++li)
   {
-    Leaf& leaf = it->second;
+    Leaf& leaf = *leaves[li];
 
     if (leaf.nr_points >= min_points_per_voxel_)
     {
@@ -444,6 +728,205 @@ pcl::VoxelGridCovariance<PointT>::getDisplayCloud (pcl::PointCloud<PointXYZ>& ce
   }
 }
 
+//////////////////////////////////////////////////////////////////////////////////////////
+template<typename PointT> bool
+pcl::VoxelGridCovariance<PointT>::saveLeaves (const std::string &file_name) const
+{
+  // Collect voxels containing a sufficient number of points
+  std::vector<std::pair<size_t, const Leaf*> > leaves;
+  if (leaf_storage_ == LEAF_STORAGE_HASH)
+  {
+    for (size_t li = 0; li < leaf_array_.size (); ++li)
+      if (leaf_array_[li].nr_points >= min_points_per_voxel_)
+        leaves.push_back (std::make_pair (leaf_array_indices_[li], &leaf_array_[li]));
+  }
+  else
+  {
+    for (typename std::map<size_t, Leaf>::const_iterator it = leaves_.begin (); it != leaves_.end (); ++it)
+      if (it->second.nr_points >= min_points_per_voxel_)
+        leaves.push_back (std::make_pair (it->first, &(it->second)));
+  }
+
+  LeafFileHeader header;
+  memset (&header, 0, sizeof (header));
+  strncpy (header.magic, "NDTLEAF", sizeof (header.magic));
+  header.version = LEAF_FILE_VERSION;
+  header.record_size = sizeof (LeafFileRecord);
+  for (int i = 0; i < 4; ++i)
+  {
+    header.leaf_size[i] = leaf_size_[i];
+    header.min_b[i] = min_b_[i];
+    header.max_b[i] = max_b_[i];
+    header.div_b[i] = div_b_[i];
+    header.divb_mul[i] = divb_mul_[i];
+  }
+  header.min_points_per_voxel = min_points_per_voxel_;
+  header.min_covar_eigvalue_mult = min_covar_eigvalue_mult_;
+  header.nr_leaves = leaves.size ();
+
+  FILE *file = fopen (file_name.c_str (), "wb");
+  if (!file)
+  {
+    PCL_ERROR ("[pcl::%s::saveLeaves] Could not open %s for writing.\n", getClassName ().c_str (), file_name.c_str ());
+    return (false);
+  }
+
+  bool ok = fwrite (&header, sizeof (header), 1, file) == 1;
+  LeafFileRecord record;
+  for (size_t li = 0; ok && li < leaves.size (); ++li)
+  {
+    const Leaf &leaf = *leaves[li].second;
+    record.index = leaves[li].first;
+    record.nr_points = leaf.nr_points;
+    Eigen::Map<Eigen::Vector3d> (record.mean) = leaf.mean_;
+    Eigen::Map<Eigen::Matrix3d> (record.cov) = leaf.cov_;
+    Eigen::Map<Eigen::Matrix3d> (record.icov) = leaf.icov_;
+    Eigen::Map<Eigen::Matrix3d> (record.evecs) = leaf.evecs_;
+    Eigen::Map<Eigen::Vector3d> (record.evals) = leaf.evals_;
+    ok = fwrite (&record, sizeof (record), 1, file) == 1;
+  }
+
+  if (fclose (file) != 0)
+    ok = false;
+  if (!ok)
+    PCL_ERROR ("[pcl::%s::saveLeaves] Could not write %s.\n", getClassName ().c_str (), file_name.c_str ());
+  return (ok);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+template<typename PointT> bool
+pcl::VoxelGridCovariance<PointT>::loadLeaves (const std::string &file_name, bool searchable)
+{
+  int fd = open (file_name.c_str (), O_RDONLY);
+  if (fd == -1)
+  {
+    PCL_ERROR ("[pcl::%s::loadLeaves] Could not open %s.\n", getClassName ().c_str (), file_name.c_str ());
+    return (false);
+  }
+
+  struct stat file_stat;
+  void *data = MAP_FAILED;
+  if (fstat (fd, &file_stat) == 0 && static_cast<size_t> (file_stat.st_size) >= sizeof (LeafFileHeader))
+    data = mmap (NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (data == MAP_FAILED)
+  {
+    PCL_ERROR ("[pcl::%s::loadLeaves] Could not map %s.\n", getClassName ().c_str (), file_name.c_str ());
+    return (false);
+  }
+  madvise (data, file_stat.st_size, MADV_SEQUENTIAL);
+
+  const LeafFileHeader &header = *static_cast<const LeafFileHeader*> (data);
+  const LeafFileRecord *records = reinterpret_cast<const LeafFileRecord*> (static_cast<const char*> (data) + sizeof (LeafFileHeader));
+  if (strncmp (header.magic, "NDTLEAF", sizeof (header.magic)) != 0 || header.version != LEAF_FILE_VERSION ||
+      header.record_size != sizeof (LeafFileRecord) ||
+      static_cast<uint64_t> (file_stat.st_size) != sizeof (LeafFileHeader) + header.nr_leaves * sizeof (LeafFileRecord))
+  {
+    PCL_ERROR ("[pcl::%s::loadLeaves] %s is not a version %u voxel file.\n", getClassName ().c_str (), file_name.c_str (), LEAF_FILE_VERSION);
+    munmap (data, file_stat.st_size);
+    return (false);
+  }
+
+  for (int i = 0; i < 4; ++i)
+  {
+    leaf_size_[i] = header.leaf_size[i];
+    min_b_[i] = header.min_b[i];
+    max_b_[i] = header.max_b[i];
+    div_b_[i] = header.div_b[i];
+    divb_mul_[i] = header.divb_mul[i];
+  }
+  // Avoid division errors, as in setLeafSize
+  if (leaf_size_[3] == 0)
+    leaf_size_[3] = 1;
+  inverse_leaf_size_ = Eigen::Array4f::Ones () / leaf_size_.array ();
+  min_points_per_voxel_ = header.min_points_per_voxel;
+  min_covar_eigvalue_mult_ = header.min_covar_eigvalue_mult;
+
+  // Clear the leaves
+  size_t nr_leaves = static_cast<size_t> (header.nr_leaves);
+  leaves_.clear ();
+  leaf_array_.clear ();
+  leaf_array_indices_.clear ();
+  leaf_table_.clear ();
+  leaf_table_bits_ = 0;
+  voxel_centroids_leaf_indices_.clear ();
+  leaf_layout_.clear ();
+
+  if (leaf_storage_ == LEAF_STORAGE_HASH)
+  {
+    leaf_array_.reserve (nr_leaves);
+    leaf_array_indices_.reserve (nr_leaves);
+  }
+  voxel_centroids_leaf_indices_.reserve (nr_leaves);
+
+  searchable_ = searchable;
+  voxel_centroids_ = PointCloudPtr (new PointCloud);
+  voxel_centroids_->points.reserve (nr_leaves);
+
+  Leaf leaf;
+  for (size_t li = 0; li < nr_leaves; ++li)
+  {
+    const LeafFileRecord &record = records[li];
+    leaf.nr_points = static_cast<int> (record.nr_points);
+    leaf.mean_ = Eigen::Map<const Eigen::Vector3d> (record.mean);
+    leaf.cov_ = Eigen::Map<const Eigen::Matrix3d> (record.cov);
+    leaf.icov_ = Eigen::Map<const Eigen::Matrix3d> (record.icov);
+    leaf.evecs_ = Eigen::Map<const Eigen::Matrix3d> (record.evecs);
+    leaf.evals_ = Eigen::Map<const Eigen::Vector3d> (record.evals);
+
+    // Sums giving back the stored distribution for addPoints, approximate where the covariance was inflated
+    double n = static_cast<double> (leaf.nr_points);
+    leaf.nr_summed_points_ = leaf.nr_points;
+    leaf.point_sum_ = n * leaf.mean_;
+    leaf.point_outer_sum_ = (n * n / (n - 1.0)) * leaf.cov_ + n * leaf.mean_ * leaf.mean_.transpose ();
+    leaf.centroid = Eigen::Vector4f (static_cast<float> (leaf.mean_ (0)), static_cast<float> (leaf.mean_ (1)),
+                                     static_cast<float> (leaf.mean_ (2)), 0);
+    leaf.centroid_index_ = static_cast<int> (voxel_centroids_->points.size ());
+
+    int search_index;
+    if (leaf_storage_ == LEAF_STORAGE_HASH)
+    {
+      search_index = static_cast<int> (leaf_array_.size ());
+      leaf_array_indices_.push_back (record.index);
+      leaf_array_.push_back (leaf);
+    }
+    else
+    {
+      // Records of a map are written in key order, so the hint is always right
+      search_index = static_cast<int> (record.index);
+      leaves_.insert (leaves_.end (), std::make_pair (static_cast<size_t> (record.index), leaf));
+    }
+
+    PointT centroid;
+    centroid.x = static_cast<float> (leaf.mean_ (0));
+    centroid.y = static_cast<float> (leaf.mean_ (1));
+    centroid.z = static_cast<float> (leaf.mean_ (2));
+    voxel_centroids_->points.push_back (centroid);
+    voxel_centroids_leaf_indices_.push_back (search_index);
+  }
+  voxel_centroids_->width = static_cast<uint32_t> (voxel_centroids_->points.size ());
+  voxel_centroids_->height = 1;
+  voxel_centroids_->is_dense = true;
+
+  munmap (data, file_stat.st_size);
+
+  if (leaf_storage_ == LEAF_STORAGE_HASH)
+  {
+    // Same load factor bound as getOrCreateLeaf
+    int bits = 10;
+    while ((static_cast<size_t> (1) << bits) < 2 * nr_leaves)
+      ++bits;
+    rehashLeaves (bits);
+  }
+
+  if (searchable_ && voxel_centroids_->size () > 0)
+  {
+    // Initiates kdtree of the centroids of voxels containing a sufficient number of points
+    kdtree_.setInputCloud (voxel_centroids_);
+  }
+  return (true);
+}
+
 #define PCL_INSTANTIATE_VoxelGridCovariance(T) template class PCL_EXPORTS pcl::VoxelGridCovariance<T>;
 
 #endif    // FAST_PCL_VOXEL_GRID_COVARIANCE_IMPL_H_
@@ -44,6 +44,8 @@
 #include "fast_pcl/filters/voxel_grid.h"
 
 #include <map>
+#include <string>
+#include <vector>
 #include <pcl/point_types.h>
 #include <pcl/kdtree/kdtree_flann.h>
 
@@ -105,7 +107,11 @@ namespace pcl
           cov_ (Eigen::Matrix3d::Identity ()),
           icov_ (Eigen::Matrix3d::Zero ()),
           evecs_ (Eigen::Matrix3d::Identity ()),
-          evals_ (Eigen::Vector3d::Zero ())
+          evals_ (Eigen::Vector3d::Zero ()),
+          nr_summed_points_ (0),
+          point_sum_ (Eigen::Vector3d::Zero ()),
+          point_outer_sum_ (Eigen::Matrix3d::Identity ()),
+          centroid_index_ (-1)
         {
         }
 
@@ -188,6 +194,18 @@ namespace pcl
         /** \brief Eigen values of voxel covariance matrix */
         Eigen::Vector3d evals_;
 
+        /** \brief Number of points accumulated in \ref point_sum_, unlike \ref nr_points never set to -1 */
+        int nr_summed_points_;
+
+        /** \brief Sum of the points of the voxel */
+        Eigen::Vector3d point_sum_;
+
+        /** \brief Sum of x*xT of the points of the voxel (starts from the identity matrix, as \ref cov_ always did) */
+        Eigen::Matrix3d point_outer_sum_;
+
+        /** \brief Position of the voxel in the centroid cloud, -1 if it has never had a sufficient number of points */
+        int centroid_index_;
+
       };
 
       /** \brief Pointer to VoxelGridCovariance leaf structure */
@@ -196,16 +214,42 @@ namespace pcl
       /** \brief Const pointer to VoxelGridCovariance leaf structure */
       typedef const Leaf* LeafConstPtr;
 
+      /** \brief Container used to store the leaf structures. */
+      enum LeafStorage
+      {
+        /** \brief Leaves are nodes of a std::map keyed by voxel index. */
+        LEAF_STORAGE_MAP,
+        /** \brief Leaves are stored contiguously and located through an open addressing hash of the voxel index. */
+        LEAF_STORAGE_HASH
+      };
+
+      /** \brief Voxels returned by a direct neighborhood lookup. */
+      enum Neighborhood
+      {
+        /** \brief The voxel containing the point. */
+        NEIGHBORHOOD_1,
+        /** \brief The voxel containing the point and its 6 face neighbors. */
+        NEIGHBORHOOD_7,
+        /** \brief The voxel containing the point and its 26 neighbors. */
+        NEIGHBORHOOD_27
+      };
+
     public:
 
       /** \brief Constructor.
        * Sets \ref leaf_size_ to 0 and \ref searchable_ to false.
+       * \param[in] leaf_storage container used to store the leaf structures
        */
-      VoxelGridCovariance () :
+      VoxelGridCovariance (LeafStorage leaf_storage = LEAF_STORAGE_MAP) :
         searchable_ (true),
         min_points_per_voxel_ (6),
         min_covar_eigvalue_mult_ (0.01),
+        leaf_storage_ (leaf_storage),
         leaves_ (),
+        leaf_array_ (),
+        leaf_array_indices_ (),
+        leaf_table_ (),
+        leaf_table_bits_ (0),
         voxel_centroids_ (),
         voxel_centroids_leaf_indices_ (),
         kdtree_ ()
@@ -262,6 +306,33 @@ namespace pcl
         return min_covar_eigvalue_mult_;
       }
 
+      /** \brief Set the container used to store the leaf structures, takes effect on the next call to filter.
+        * \param[in] leaf_storage container used to store the leaf structures
+        */
+      inline void
+      setLeafStorage (LeafStorage leaf_storage)
+      {
+        leaf_storage_ = leaf_storage;
+      }
+
+      /** \brief Get the container used to store the leaf structures.
+        * \return container used to store the leaf structures
+        */
+      inline LeafStorage
+      getLeafStorage () const
+      {
+        return leaf_storage_;
+      }
+
+      /** \brief Get the number of leaves (including voxels with less than a sufficient number of points).
+        * \return number of leaves
+        */
+      inline size_t
+      getLeafCount () const
+      {
+        return (leaf_storage_ == LEAF_STORAGE_HASH ? leaf_array_.size () : leaves_.size ());
+      }
+
       /** \brief Filter cloud and initializes voxel structure.
        * \param[out] output cloud containing centroids of voxels containing a sufficient number of points
        * \param[in] searchable flag if voxel structure is searchable, if true then kdtree is built
@@ -298,6 +369,36 @@ namespace pcl
         }
       }
 
+      /** \brief Add points to the voxel structure, updating only the voxels they fall in.
+       * The per voxel sums are kept, so the result is the one \ref filter would give on all the points so far.
+       * The grid grows with margin when points fall outside of it, which only renumbers the voxels.
+       * Voxels reaching a sufficient number of points are appended to \ref getCentroids.
+       * \note The filter field limits are not applied and the leaf layout is dropped.
+       * \note With a searchable structure the kdtree is rebuilt over all the centroids.
+       * \param[in] cloud the points to add, with an empty voxel structure the same as setInputCloud and filter
+       * \param[in] searchable flag if voxel structure is searchable, if true then kdtree is built
+       */
+      void
+      addPoints (const PointCloudConstPtr &cloud, bool searchable = false);
+
+      /** \brief Write the voxel structure to a binary file which \ref loadLeaves can map back.
+       * \note Only voxels containing a sufficient number of points are written.
+       * \param[in] file_name the file to write
+       * \return true on success
+       */
+      bool
+      saveLeaves (const std::string &file_name) const;
+
+      /** \brief Replace the voxel structure by the one stored in a file written by \ref saveLeaves.
+       * The leaf size, grid bounds and voxel distributions are taken from the file, so no input cloud is needed.
+       * \note The Nd centroids of the leaves are not stored, \ref getCentroids holds the voxel means.
+       * \param[in] file_name the file to read
+       * \param[in] searchable flag if voxel structure is searchable, if true then kdtree is built
+       * \return true on success
+       */
+      bool
+      loadLeaves (const std::string &file_name, bool searchable = false);
+
       /** \brief Get the voxel containing point p.
        * \param[in] index the index of the leaf structure node
        * \return const pointer to leaf structure
@@ -305,14 +406,7 @@ namespace pcl
       inline LeafConstPtr
       getLeaf (int index)
       {
-        typename std::map<size_t, Leaf>::iterator leaf_iter = leaves_.find (index);
-        if (leaf_iter != leaves_.end ())
-        {
-          LeafConstPtr ret (&(leaf_iter->second));
-          return ret;
-        }
-        else
-          return NULL;
+        return (findLeaf (index));
       }
 
       /** \brief Get the voxel containing point p.
@@ -331,15 +425,7 @@ namespace pcl
         int idx = ijk0 * divb_mul_[0] + ijk1 * divb_mul_[1] + ijk2 * divb_mul_[2];
 
         // Find leaf associated with index
-        typename std::map<size_t, Leaf>::iterator leaf_iter = leaves_.find (idx);
-        if (leaf_iter != leaves_.end ())
-        {
-          // If such a leaf exists return the pointer to the leaf structure
-          LeafConstPtr ret (&(leaf_iter->second));
-          return ret;
-        }
-        else
-          return NULL;
+        return (findLeaf (idx));
       }
 
       /** \brief Get the voxel containing point p.
@@ -358,16 +444,7 @@ namespace pcl
         int idx = ijk0 * divb_mul_[0] + ijk1 * divb_mul_[1] + ijk2 * divb_mul_[2];
 
         // Find leaf associated with index
-        typename std::map<size_t, Leaf>::iterator leaf_iter = leaves_.find (idx);
-        if (leaf_iter != leaves_.end ())
-        {
-          // If such a leaf exists return the pointer to the leaf structure
-          LeafConstPtr ret (&(leaf_iter->second));
-          return ret;
-        }
-        else
-          return NULL;
-
+        return (findLeaf (idx));
       }
 
       /** \brief Get the voxels surrounding point p, not including the voxel contating point p.
@@ -379,7 +456,19 @@ namespace pcl
       int
       getNeighborhoodAtPoint (const PointT& reference_point, std::vector<LeafConstPtr> &neighbors);
 
+      /** \brief Get the voxel containing point p and, depending on the neighborhood, its adjacent voxels.
+       * \note Voxel indices are computed directly from the grid, no kdtree is needed. Lookups are O(1) with \ref LEAF_STORAGE_HASH.
+       * \note Only voxels containing a sufficient number of points are used.
+       * \param[in] reference_point the point to get the leaf structures at
+       * \param[in] neighborhood the voxels to check
+       * \param[out] neighbors
+       * \return number of neighbors found
+       */
+      int
+      getNeighborhoodAtPoint (const PointT& reference_point, Neighborhood neighborhood, std::vector<LeafConstPtr> &neighbors);
+
       /** \brief Get the leaf structure map
+       * \note Empty unless leaves are stored with \ref LEAF_STORAGE_MAP.
        * \return a map contataining all leaves
        */
       inline const std::map<size_t, Leaf>&
@@ -434,7 +523,7 @@ namespace pcl
         k_leaves.reserve (k);
         for (std::vector<int>::iterator iter = k_indices.begin (); iter != k_indices.end (); iter++)
         {
-          k_leaves.push_back (&leaves_[voxel_centroids_leaf_indices_[*iter]]);
+          k_leaves.push_back (getSearchLeaf (voxel_centroids_leaf_indices_[*iter]));
         }
         return k;
       }
@@ -470,6 +559,25 @@ namespace pcl
       int
       radiusSearch (const PointT &point, double radius, std::vector<LeafConstPtr> &k_leaves,
                     std::vector<float> &k_sqr_distances, unsigned int max_nn = 0)
+      {
+        std::vector<int> k_indices;
+        return (radiusSearch (point, radius, k_leaves, k_indices, k_sqr_distances, max_nn));
+      }
+
+      /** \brief Search for all the nearest occupied voxels of the query point in a given radius,
+       * using caller provided buffers so that repeated searches do not allocate.
+       * \note Only voxels containing a sufficient number of points are used.
+       * \param[in] point the given query point
+       * \param[in] radius the radius of the sphere bounding all of p_q's neighbors
+       * \param[out] k_leaves the resultant leaves of the neighboring points
+       * \param[out] k_indices scratch for the indices of the neighboring voxel centroids
+       * \param[out] k_sqr_distances the resultant squared distances to the neighboring points
+       * \param[in] max_nn
+       * \return number of neighbors found
+       */
+      int
+      radiusSearch (const PointT &point, double radius, std::vector<LeafConstPtr> &k_leaves,
+                    std::vector<int> &k_indices, std::vector<float> &k_sqr_distances, unsigned int max_nn = 0)
       {
         k_leaves.clear ();
 
@@ -481,14 +589,13 @@ namespace pcl
         }
 
         // Find neighbors within radius in the occupied voxel centroid cloud
-        std::vector<int> k_indices;
         int k = kdtree_.radiusSearch (point, radius, k_indices, k_sqr_distances, max_nn);
 
         // Find leaves corresponding to neighbors
         k_leaves.reserve (k);
         for (std::vector<int>::iterator iter = k_indices.begin (); iter != k_indices.end (); iter++)
         {
-          k_leaves.push_back (&leaves_[voxel_centroids_leaf_indices_[*iter]]);
+          k_leaves.push_back (getSearchLeaf (voxel_centroids_leaf_indices_[*iter]));
         }
         return k;
       }
@@ -520,6 +627,131 @@ namespace pcl
        */
       void applyFilter (PointCloud &output);
 
+      /** \brief Add a point to the sums of a leaf.
+       * \param[in] point the point
+       * \param[in,out] leaf the leaf structure, its Nd centroid not normalized
+       * \param[in] centroid_size the size of the Nd centroid
+       * \param[in] rgba_index offset of the rgb(a) field, -1 if not present
+       */
+      void
+      accumulatePoint (const PointT &point, Leaf &leaf, int centroid_size, int rgba_index);
+
+      /** \brief Normalize the accumulated sums of a leaf and compute its covariance, inverse covariance and eigen decomposition.
+       * A leaf already in the output has its centroid updated in place.
+       * \param[in] index the index of the leaf structure node
+       * \param[in] search_index the value stored in \ref voxel_centroids_leaf_indices_ for this leaf
+       * \param[in,out] leaf the leaf structure
+       * \param[out] output cloud containing centroids of voxels containing a sufficient number of points
+       * \param[in] centroid_size the size of the Nd centroid
+       * \param[in] rgba_index offset of the rgb(a) field, -1 if not present
+       */
+      void
+      computeLeafDistribution (size_t index, int search_index, Leaf &leaf, PointCloud &output,
+                               int centroid_size, int rgba_index);
+
+      /** \brief Grow the grid bounds so that they contain [min_b, max_b] and renumber the existing voxels.
+       * \param[in] min_b the minimum voxel coordinates to cover
+       * \param[in] max_b the maximum voxel coordinates to cover
+       * \return false if voxel indices would overflow, the grid is then left unchanged
+       */
+      bool
+      growBounds (const Eigen::Vector4i &min_b, const Eigen::Vector4i &max_b);
+
+      /** \brief Get the leaf associated with a voxel index, creating it if it does not exist yet.
+       * \param[in] index the index of the leaf structure node
+       * \return reference to the leaf structure, valid until the next leaf is created
+       */
+      Leaf&
+      getOrCreateLeaf (size_t index);
+
+      /** \brief Rebuild \ref leaf_table_ with 2^bits slots from \ref leaf_array_indices_.
+       * \param[in] bits the base 2 logarithm of the table size
+       */
+      void
+      rehashLeaves (int bits);
+
+      /** \brief Compute the slot of \ref leaf_table_ where the probe for a voxel index starts (Fibonacci hashing).
+       * \param[in] index the index of the leaf structure node
+       * \return slot in \ref leaf_table_
+       */
+      inline size_t
+      hashLeafIndex (size_t index) const
+      {
+        return (static_cast<size_t> ((static_cast<uint64_t> (index) * 11400714819323198485ull) >> (64 - leaf_table_bits_)));
+      }
+
+      /** \brief Find the leaf associated with a voxel index.
+       * \param[in] index the index of the leaf structure node
+       * \return pointer to leaf structure, NULL if the voxel is empty
+       */
+      inline LeafPtr
+      findLeaf (size_t index)
+      {
+        if (leaf_storage_ == LEAF_STORAGE_HASH)
+        {
+          if (leaf_table_.empty ())
+            return (NULL);
+
+          // Linear probing until the index or an empty slot is found
+          size_t mask = leaf_table_.size () - 1;
+          for (size_t slot = hashLeafIndex (index); leaf_table_[slot] != -1; slot = (slot + 1) & mask)
+          {
+            if (leaf_array_indices_[leaf_table_[slot]] == index)
+              return (&leaf_array_[leaf_table_[slot]]);
+          }
+          return (NULL);
+        }
+
+        typename std::map<size_t, Leaf>::iterator leaf_iter = leaves_.find (index);
+        if (leaf_iter != leaves_.end ())
+          return (&(leaf_iter->second));
+        return (NULL);
+      }
+
+      /** \brief Get the leaf referenced by an entry of \ref voxel_centroids_leaf_indices_.
+       * \param[in] search_index voxel index for \ref LEAF_STORAGE_MAP, position in \ref leaf_array_ for \ref LEAF_STORAGE_HASH
+       * \return const pointer to leaf structure
+       */
+      inline LeafConstPtr
+      getSearchLeaf (int search_index)
+      {
+        if (leaf_storage_ == LEAF_STORAGE_HASH)
+          return (&leaf_array_[search_index]);
+        return (&leaves_[search_index]);
+      }
+
+      /** \brief Version of the file format written by \ref saveLeaves. */
+      static const uint32_t LEAF_FILE_VERSION = 1;
+
+      /** \brief Header of the file written by \ref saveLeaves, followed by \ref LeafFileHeader::nr_leaves records. */
+      struct LeafFileHeader
+      {
+        /** \brief "NDTLEAF" followed by a terminating zero. */
+        char magic[8];
+        /** \brief \ref LEAF_FILE_VERSION of the writer. */
+        uint32_t version;
+        /** \brief sizeof (\ref LeafFileRecord) of the writer, guards against layout changes. */
+        uint32_t record_size;
+        float leaf_size[4];
+        int32_t min_b[4], max_b[4], div_b[4], divb_mul[4];
+        int32_t min_points_per_voxel;
+        int32_t reserved;
+        double min_covar_eigvalue_mult;
+        uint64_t nr_leaves;
+      };
+
+      /** \brief Voxel stored in the file written by \ref saveLeaves, matrices in column major order. */
+      struct LeafFileRecord
+      {
+        uint64_t index;
+        int64_t nr_points;
+        double mean[3];
+        double cov[9];
+        double icov[9];
+        double evecs[9];
+        double evals[3];
+      };
+
       /** \brief Flag to determine if voxel structure is searchable. */
       bool searchable_;
 
@@ -529,13 +761,30 @@ namespace pcl
       /** \brief Minimum allowable ratio between eigenvalues to prevent singular covariance matrices. */
       double min_covar_eigvalue_mult_;
 
+      /** \brief Container used to store the leaf structures. */
+      LeafStorage leaf_storage_;
+
       /** \brief Voxel structure containing all leaf nodes (includes voxels with less than a sufficient number of points). */
       std::map<size_t, Leaf> leaves_;
 
+      /** \brief Contiguous leaf structures used with \ref LEAF_STORAGE_HASH (includes voxels with less than a sufficient number of points). */
+      std::vector<Leaf> leaf_array_;
+
+      /** \brief Voxel index of each leaf in \ref leaf_array_. */
+      std::vector<size_t> leaf_array_indices_;
+
+      /** \brief Open addressing hash table of positions in \ref leaf_array_, -1 marks an empty slot. */
+      std::vector<int> leaf_table_;
+
+      /** \brief Base 2 logarithm of the size of \ref leaf_table_. */
+      int leaf_table_bits_;
+
       /** \brief Point cloud containing centroids of voxels containing atleast minimum number of points. */
       PointCloudPtr voxel_centroids_;
 
-      /** \brief Indices of leaf structurs associated with each point in \ref voxel_centroids_ (used for searching). */
+      /** \brief Indices of leaf structurs associated with each point in \ref voxel_centroids_ (used for searching).
+       * \note Voxel indices for \ref LEAF_STORAGE_MAP, positions in \ref leaf_array_ for \ref LEAF_STORAGE_HASH.
+       */
       std::vector<int> voxel_centroids_leaf_indices_;
 
       /** \brief KdTree generated using \ref voxel_centroids_ (used for searching). */
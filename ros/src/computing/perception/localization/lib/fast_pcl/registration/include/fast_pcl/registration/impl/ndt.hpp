@@ -46,6 +46,11 @@ template<typename PointSource, typename PointTarget>
 pcl::NormalDistributionsTransform<PointSource, PointTarget>::NormalDistributionsTransform ()
   : target_cells_ ()
   , resolution_ (1.0f)
+  , target_cells_file_ ()
+  , search_method_ (KDTREE)
+  , use_batched_derivatives_ (false)
+  , num_threads_ (1)
+  , derivatives_slots_ ()
   , step_size_ (0.1)
   , outlier_ratio_ (0.55)
   , gauss_d1_ ()
@@ -70,6 +75,11 @@ pcl::NormalDistributionsTransform<PointSource, PointTarget>::NormalDistributions
 
   transformation_epsilon_ = 0.1;
   max_iterations_ = 35;
+
+  // align does not need the kdtree over the input target, getFitnessScore builds it when it is called.
+  force_no_recompute_ = true;
+
+  setNumberOfThreads (0);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -278,6 +288,9 @@ pcl::NormalDistributionsTransform<PointSource, PointTarget>::computeDerivatives
                                                                                  Eigen::Matrix<double, 6, 1> &p,
                                                                                  bool compute_hessian)
 {
+  if (use_batched_derivatives_)
+    return (computeDerivativesBatched (score_gradient, hessian, trans_cloud, p, compute_hessian, false));
+
   // Original Point and Transformed Point
   PointSource x_pt, x_trans_pt;
   // Original Point and Transformed Point (for math)
@@ -299,10 +312,9 @@ pcl::NormalDistributionsTransform<PointSource, PointTarget>::computeDerivatives
   {
     x_trans_pt = trans_cloud.points[idx];
 
-    // Find nieghbors (Radius search has been experimentally faster than direct neighbor checking.
+    // Find nieghbors, by radius search or directly on the voxel grid depending on search_method_
     std::vector<TargetGridLeafConstPtr> neighborhood;
-    std::vector<float> distances;
-    target_cells_.radiusSearch (x_trans_pt, resolution_, neighborhood, distances);
+    findNeighborhood (x_trans_pt, neighborhood);
 
     for (typename std::vector<TargetGridLeafConstPtr>::iterator neighborhood_it = neighborhood.begin (); neighborhood_it != neighborhood.end (); neighborhood_it++)
     {
@@ -336,121 +348,93 @@ pcl::NormalDistributionsTransform<PointSource, PointTarget>::omp_computeDerivati
                                                                                  Eigen::Matrix<double, 6, 1> &p,
                                                                                  bool compute_hessian)
 {
-  // Original Point and Transformed Point
-  PointSource x_pt, x_trans_pt;
-  // Original Point and Transformed Point (for math)
-  Eigen::Vector3d x, x_trans;
-  // Occupied Voxel
-  TargetGridLeafConstPtr cell;
-  // Inverse Covariance of Occupied Voxel
-  Eigen::Matrix3d c_inv;
-
-  score_gradient.setZero ();
-  hessian.setZero ();
-  double score = 0;
+  if (use_batched_derivatives_)
+    return (computeDerivativesBatched (score_gradient, hessian, trans_cloud, p, compute_hessian, true));
 
   // Precompute Angular Derivatives (eq. 6.19 and 6.21)[Magnusson 2009]
   computeAngleDerivatives (p);
 
-#ifdef _OPENMP
-  int num_threads = omp_get_max_threads() * 2;
-  Eigen::Matrix<double, 6, 1> score_gradient_i[num_threads];
-  Eigen::Matrix<double, 6, 6> hessian_i[num_threads];
-  for (int i = 0; i < num_threads; ++i) {
-      score_gradient_i[i].setZero ();
-      hessian_i[i].setZero ();
-  }
+  initDerivativesSlots ();
 
-  omp_set_nested(1);
-  omp_set_dynamic(1);
-#pragma omp parallel for num_threads(num_threads) reduction(+:score) private(x_pt, x_trans_pt, x, x_trans, cell, c_inv)
-#endif
+  int nr_points = static_cast<int> (input_->points.size ());
+  int nr_slots = static_cast<int> (derivatives_slots_.size ());
+  int slot_size = (nr_points + nr_slots - 1) / nr_slots;
 
-  // Update gradient and hessian for each point, line 17 in Algorithm 2 [Magnusson 2009]
-  for (size_t idx = 0; idx < input_->points.size (); idx++)
+  // Each slot owns a contiguous range of points and its own accumulators, so the threads share no state.
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads_) schedule(static, 1)
+#endif
+  for (int s = 0; s < nr_slots; s++)
   {
-    x_trans_pt = trans_cloud.points[idx];
-
-    // Find nieghbors (Radius search has been experimentally faster than direct neighbor checking.
-    std::vector<TargetGridLeafConstPtr> neighborhood;
-    std::vector<float> distances;
-    target_cells_.radiusSearch (x_trans_pt, resolution_, neighborhood, distances);
+    DerivativesSlot &slot = derivatives_slots_[s];
+    int begin = std::min (s * slot_size, nr_points);
+    int end = std::min (begin + slot_size, nr_points);
 
-    for (typename std::vector<TargetGridLeafConstPtr>::iterator neighborhood_it = neighborhood.begin (); neighborhood_it != neighborhood.end (); neighborhood_it++)
+    // Update gradient and hessian for each point, line 17 in Algorithm 2 [Magnusson 2009]
+    for (int idx = begin; idx < end; idx++)
     {
-      cell = *neighborhood_it;
-      x_pt = input_->points[idx];
-      x = Eigen::Vector3d (x_pt.x, x_pt.y, x_pt.z);
+      const PointSource &x_pt = input_->points[idx];
+      const PointSource &x_trans_pt = trans_cloud.points[idx];
 
-      x_trans = Eigen::Vector3d (x_trans_pt.x, x_trans_pt.y, x_trans_pt.z);
+      // Find nieghbors, by radius search or directly on the voxel grid depending on search_method_
+      findNeighborhood (x_trans_pt, slot.neighborhood, slot.neighbor_indices, slot.neighbor_distances);
 
-      // Denorm point, x_k' in Equations 6.12 and 6.13 [Magnusson 2009]
-      x_trans -= cell->getMean ();
-      // Uses precomputed covariance for speed.
-      c_inv = cell->getInverseCov ();
+      if (slot.neighborhood.empty ())
+        continue;
 
       // Compute derivative of transform function w.r.t. transform vector, J_E and H_E in Equations 6.18 and 6.20 [Magnusson 2009]
-      computePointDerivatives (x);
-      // Update score, gradient and hessian, lines 19-21 in Algorithm 2, according to Equations 6.10, 6.12 and 6.13, respectively [Magnusson 2009]
-      //score += updateDerivatives (score_gradient, hessian, x_trans, c_inv, compute_hessian);
-      {
-          Eigen::Vector3d cov_dxd_pi;
-          // e^(-d_2/2 * (x_k - mu_k)^T Sigma_k^-1 (x_k - mu_k)) Equation 6.9 [Magnusson 2009]
-          double e_x_cov_x = exp (-gauss_d2_ * x_trans.dot (c_inv * x_trans) / 2);
-          // Calculate probability of transtormed points existance, Equation 6.9 [Magnusson 2009]
-          double score_inc = -gauss_d1_ * e_x_cov_x;
+      Eigen::Vector3d x (x_pt.x, x_pt.y, x_pt.z);
+      computePointDerivatives (x, slot.point_gradient, slot.point_hessian, compute_hessian);
 
-          e_x_cov_x = gauss_d2_ * e_x_cov_x;
-
-          // Error checking for invalid values.
-          if (e_x_cov_x > 1 || e_x_cov_x < 0 || e_x_cov_x != e_x_cov_x) {
-              score_inc = 0;
-          } else {
-              // Reusable portion of Equation 6.12 and 6.13 [Magnusson 2009]
-              e_x_cov_x *= gauss_d1_;
-
-
-              for (int i = 0; i < 6; i++)
-              {
-                  // Sigma_k^-1 d(T(x,p))/dpi, Reusable portion of Equation 6.12 and 6.13 [Magnusson 2009o
-                  cov_dxd_pi = c_inv * point_gradient_.col (i);
+      for (typename std::vector<TargetGridLeafConstPtr>::iterator neighborhood_it = slot.neighborhood.begin (); neighborhood_it != slot.neighborhood.end (); neighborhood_it++)
+      {
+        TargetGridLeafConstPtr cell = *neighborhood_it;
 
-                  // Update gradient, Equation 6.12 [Magnusson 2009]
-#ifdef _OPENMP
-                  score_gradient_i[omp_get_thread_num()] (i) += x_trans.dot (cov_dxd_pi) * e_x_cov_x;
-#else
-                  score_gradient (i) += x_trans.dot (cov_dxd_pi) * e_x_cov_x;
-#endif
-                  if (compute_hessian)
-                  {
-                      for (int j = 0; j < hessian.cols (); j++)
-                      {
-                          // Update hessian, Equation 6.13 [Magnusson 2009]
-#ifdef _OPENMP
-                          hessian_i[omp_get_thread_num()] (i, j) += e_x_cov_x * (-gauss_d2_ * x_trans.dot (cov_dxd_pi) * x_trans.dot (c_inv * point_gradient_.col (j)) +
-                                                         x_trans.dot (c_inv * point_hessian_.block<3, 1>(3 * i, j)) +
-                                                         point_gradient_.col (j).dot (cov_dxd_pi) );
-#else
-                          hessian (i, j) += e_x_cov_x * (-gauss_d2_ * x_trans.dot (cov_dxd_pi) * x_trans.dot (c_inv * point_gradient_.col (j)) +
-                                                         x_trans.dot (c_inv * point_hessian_.block<3, 1>(3 * i, j)) +
-                                                         point_gradient_.col (j).dot (cov_dxd_pi) );
-#endif
-                      }
-                  }
-              }
+        // Denorm point, x_k' in Equations 6.12 and 6.13 [Magnusson 2009]
+        Eigen::Vector3d x_trans = Eigen::Vector3d (x_trans_pt.x, x_trans_pt.y, x_trans_pt.z) - cell->getMean ();
+        // Uses precomputed covariance for speed.
+        Eigen::Matrix3d c_inv = cell->getInverseCov ();
+
+        // e^(-d_2/2 * (x_k - mu_k)^T Sigma_k^-1 (x_k - mu_k)) Equation 6.9 [Magnusson 2009]
+        double e_x_cov_x = exp (-gauss_d2_ * x_trans.dot (c_inv * x_trans) / 2);
+        // Calculate probability of transtormed points existance, Equation 6.9 [Magnusson 2009]
+        double score_inc = -gauss_d1_ * e_x_cov_x;
+
+        e_x_cov_x = gauss_d2_ * e_x_cov_x;
+
+        // Error checking for invalid values.
+        if (e_x_cov_x > 1 || e_x_cov_x < 0 || e_x_cov_x != e_x_cov_x)
+          continue;
+
+        // Reusable portion of Equation 6.12 and 6.13 [Magnusson 2009]
+        e_x_cov_x *= gauss_d1_;
+
+        for (int i = 0; i < 6; i++)
+        {
+          // Sigma_k^-1 d(T(x,p))/dpi, Reusable portion of Equation 6.12 and 6.13 [Magnusson 2009]
+          Eigen::Vector3d cov_dxd_pi = c_inv * slot.point_gradient.col (i);
+
+          // Update gradient, Equation 6.12 [Magnusson 2009]
+          slot.score_gradient (i) += x_trans.dot (cov_dxd_pi) * e_x_cov_x;
+
+          if (compute_hessian)
+          {
+            for (int j = 0; j < 6; j++)
+            {
+              // Update hessian, Equation 6.13 [Magnusson 2009]
+              slot.hessian (i, j) += e_x_cov_x * (-gauss_d2_ * x_trans.dot (cov_dxd_pi) * x_trans.dot (c_inv * slot.point_gradient.col (j)) +
+                                                  x_trans.dot (c_inv * slot.point_hessian.template block<3, 1>(3 * i, j)) +
+                                                  slot.point_gradient.col (j).dot (cov_dxd_pi) );
+            }
           }
-          score += score_inc;
+        }
+
+        slot.score += score_inc;
       }
     }
   }
-#ifdef _OPENMP
-  for (int i = 0; i < num_threads; ++i) {
-    score_gradient += score_gradient_i[i];
-    hessian += hessian_i[i];
-  }
-#endif
 
-  return (score);
+  return (reduceDerivativesSlots (score_gradient, hessian));
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -533,17 +517,27 @@ pcl::NormalDistributionsTransform<PointSource, PointTarget>::computeAngleDerivat
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 template<typename PointSource, typename PointTarget> void
 pcl::NormalDistributionsTransform<PointSource, PointTarget>::computePointDerivatives (Eigen::Vector3d &x, bool compute_hessian)
+{
+  computePointDerivatives (x, point_gradient_, point_hessian_, compute_hessian);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template<typename PointSource, typename PointTarget> void
+pcl::NormalDistributionsTransform<PointSource, PointTarget>::computePointDerivatives (Eigen::Vector3d &x,
+                                                                                  Eigen::Matrix<double, 3, 6> &point_gradient,
+                                                                                  Eigen::Matrix<double, 18, 6> &point_hessian,
+                                                                                  bool compute_hessian)
 {
   // Calculate first derivative of Transformation Equation 6.17 w.r.t. transform vector p.
   // Derivative w.r.t. ith element of transform vector corresponds to column i, Equation 6.18 and 6.19 [Magnusson 2009]
-  point_gradient_ (1, 3) = x.dot (j_ang_a_);
-  point_gradient_ (2, 3) = x.dot (j_ang_b_);
-  point_gradient_ (0, 4) = x.dot (j_ang_c_);
-  point_gradient_ (1, 4) = x.dot (j_ang_d_);
-  point_gradient_ (2, 4) = x.dot (j_ang_e_);
-  point_gradient_ (0, 5) = x.dot (j_ang_f_);
-  point_gradient_ (1, 5) = x.dot (j_ang_g_);
-  point_gradient_ (2, 5) = x.dot (j_ang_h_);
+  point_gradient (1, 3) = x.dot (j_ang_a_);
+  point_gradient (2, 3) = x.dot (j_ang_b_);
+  point_gradient (0, 4) = x.dot (j_ang_c_);
+  point_gradient (1, 4) = x.dot (j_ang_d_);
+  point_gradient (2, 4) = x.dot (j_ang_e_);
+  point_gradient (0, 5) = x.dot (j_ang_f_);
+  point_gradient (1, 5) = x.dot (j_ang_g_);
+  point_gradient (2, 5) = x.dot (j_ang_h_);
 
   if (compute_hessian)
   {
@@ -559,15 +553,15 @@ pcl::NormalDistributionsTransform<PointSource, PointTarget>::computePointDerivat
 
     // Calculate second derivative of Transformation Equation 6.17 w.r.t. transform vector p.
     // Derivative w.r.t. ith and jth elements of transform vector corresponds to the 3x1 block matrix starting at (3i,j), Equation 6.20 and 6.21 [Magnusson 2009]
-    point_hessian_.block<3, 1>(9, 3) = a;
-    point_hessian_.block<3, 1>(12, 3) = b;
-    point_hessian_.block<3, 1>(15, 3) = c;
-    point_hessian_.block<3, 1>(9, 4) = b;
-    point_hessian_.block<3, 1>(12, 4) = d;
-    point_hessian_.block<3, 1>(15, 4) = e;
-    point_hessian_.block<3, 1>(9, 5) = c;
-    point_hessian_.block<3, 1>(12, 5) = e;
-    point_hessian_.block<3, 1>(15, 5) = f;
+    point_hessian.block<3, 1>(9, 3) = a;
+    point_hessian.block<3, 1>(12, 3) = b;
+    point_hessian.block<3, 1>(15, 3) = c;
+    point_hessian.block<3, 1>(9, 4) = b;
+    point_hessian.block<3, 1>(12, 4) = d;
+    point_hessian.block<3, 1>(15, 4) = e;
+    point_hessian.block<3, 1>(9, 5) = c;
+    point_hessian.block<3, 1>(12, 5) = e;
+    point_hessian.block<3, 1>(15, 5) = f;
   }
 }
 
@@ -620,8 +614,15 @@ pcl::NormalDistributionsTransform<PointSource, PointTarget>::updateDerivatives (
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 template<typename PointSource, typename PointTarget> void
 pcl::NormalDistributionsTransform<PointSource, PointTarget>::computeHessian (Eigen::Matrix<double, 6, 6> &hessian,
-                                                                             PointCloudSource &trans_cloud, Eigen::Matrix<double, 6, 1> &)
+                                                                             PointCloudSource &trans_cloud, Eigen::Matrix<double, 6, 1> &p)
 {
+  if (use_batched_derivatives_)
+  {
+    Eigen::Matrix<double, 6, 1> score_gradient;
+    computeDerivativesBatched (score_gradient, hessian, trans_cloud, p, true, false);
+    return;
+  }
+
   // Original Point and Transformed Point
   PointSource x_pt, x_trans_pt;
   // Original Point and Transformed Point (for math)
@@ -640,10 +641,9 @@ pcl::NormalDistributionsTransform<PointSource, PointTarget>::computeHessian (Eig
   {
     x_trans_pt = trans_cloud.points[idx];
 
-    // Find nieghbors (Radius search has been experimentally faster than direct neighbor checking.
+    // Find nieghbors, by radius search or directly on the voxel grid depending on search_method_
     std::vector<TargetGridLeafConstPtr> neighborhood;
-    std::vector<float> distances;
-    target_cells_.radiusSearch (x_trans_pt, resolution_, neighborhood, distances);
+    findNeighborhood (x_trans_pt, neighborhood);
 
     for (typename std::vector<TargetGridLeafConstPtr>::iterator neighborhood_it = neighborhood.begin (); neighborhood_it != neighborhood.end (); neighborhood_it++)
     {
@@ -700,6 +700,309 @@ pcl::NormalDistributionsTransform<PointSource, PointTarget>::updateHessian (Eige
 
 }
 
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template<typename PointSource, typename PointTarget> double
+pcl::NormalDistributionsTransform<PointSource, PointTarget>::computeDerivativesBatched (Eigen::Matrix<double, 6, 1> &score_gradient,
+                                                                                        Eigen::Matrix<double, 6, 6> &hessian,
+                                                                                        PointCloudSource &trans_cloud,
+                                                                                        Eigen::Matrix<double, 6, 1> &p,
+                                                                                        bool compute_hessian, bool parallel)
+{
+  // Precompute Angular Derivatives (eq. 6.19 and 6.21)[Magnusson 2009]
+  computeAngleDerivatives (p);
+
+  initDerivativesSlots ();
+
+  int nr_points = static_cast<int> (input_->points.size ());
+  int nr_slots = static_cast<int> (derivatives_slots_.size ());
+  int slot_size = (nr_points + nr_slots - 1) / nr_slots;
+
+  // The same slots are used with or without threads, so both give identical results.
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads_) schedule(static, 1) if (parallel)
+#endif
+  for (int s = 0; s < nr_slots; s++)
+  {
+    DerivativesSlot &slot = derivatives_slots_[s];
+    DerivativesBlock &block = slot.block;
+    int begin = std::min (s * slot_size, nr_points);
+    int end = std::min (begin + slot_size, nr_points);
+
+    // Gather point/voxel pairs into blocks, line 17 in Algorithm 2 [Magnusson 2009]
+    for (int idx = begin; idx < end; idx++)
+    {
+      const PointSource &x_pt = input_->points[idx];
+      const PointSource &x_trans_pt = trans_cloud.points[idx];
+
+      findNeighborhood (x_trans_pt, slot.neighborhood, slot.neighbor_indices, slot.neighbor_distances);
+
+      for (typename std::vector<TargetGridLeafConstPtr>::iterator neighborhood_it = slot.neighborhood.begin (); neighborhood_it != slot.neighborhood.end (); neighborhood_it++)
+      {
+        if (block.size == DERIVATIVES_BLOCK_SIZE)
+        {
+          slot.score += computeBlockDerivatives (block, slot.score_gradient, slot.hessian, compute_hessian);
+          block.size = 0;
+        }
+
+        const Eigen::Vector3d &mean = (*neighborhood_it)->mean_;
+        const Eigen::Matrix3d &c_inv = (*neighborhood_it)->icov_;
+        int k = block.size++;
+
+        block.x[k] = x_pt.x;
+        block.y[k] = x_pt.y;
+        block.z[k] = x_pt.z;
+        block.dx[k] = x_trans_pt.x - mean (0);
+        block.dy[k] = x_trans_pt.y - mean (1);
+        block.dz[k] = x_trans_pt.z - mean (2);
+        block.c00[k] = c_inv (0, 0);
+        block.c01[k] = c_inv (0, 1);
+        block.c02[k] = c_inv (0, 2);
+        block.c11[k] = c_inv (1, 1);
+        block.c12[k] = c_inv (1, 2);
+        block.c22[k] = c_inv (2, 2);
+      }
+    }
+
+    if (block.size > 0)
+      slot.score += computeBlockDerivatives (block, slot.score_gradient, slot.hessian, compute_hessian);
+  }
+
+  return (reduceDerivativesSlots (score_gradient, hessian));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template<typename PointSource, typename PointTarget> void
+pcl::NormalDistributionsTransform<PointSource, PointTarget>::initDerivativesSlots ()
+{
+  if (derivatives_slots_.size () != static_cast<size_t> (num_threads_))
+  {
+    derivatives_slots_.resize (num_threads_);
+    for (size_t s = 0; s < derivatives_slots_.size (); s++)
+    {
+      // Constant entries of the point derivatives, the angular ones are set by computePointDerivatives
+      derivatives_slots_[s].point_gradient.setZero ();
+      derivatives_slots_[s].point_gradient.template block<3, 3>(0, 0).setIdentity ();
+      derivatives_slots_[s].point_hessian.setZero ();
+    }
+  }
+
+  for (size_t s = 0; s < derivatives_slots_.size (); s++)
+  {
+    derivatives_slots_[s].score = 0;
+    derivatives_slots_[s].score_gradient.setZero ();
+    derivatives_slots_[s].hessian.setZero ();
+    derivatives_slots_[s].block.size = 0;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template<typename PointSource, typename PointTarget> double
+pcl::NormalDistributionsTransform<PointSource, PointTarget>::reduceDerivativesSlots (Eigen::Matrix<double, 6, 1> &score_gradient,
+                                                                                     Eigen::Matrix<double, 6, 6> &hessian)
+{
+  // Fixed summation order keeps the result reproducible run to run.
+  double score = 0;
+  score_gradient.setZero ();
+  hessian.setZero ();
+  for (size_t s = 0; s < derivatives_slots_.size (); s++)
+  {
+    score += derivatives_slots_[s].score;
+    score_gradient += derivatives_slots_[s].score_gradient;
+    hessian += derivatives_slots_[s].hessian;
+  }
+  return (score);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template<typename PointSource, typename PointTarget> double
+pcl::NormalDistributionsTransform<PointSource, PointTarget>::computeBlockDerivatives (DerivativesBlock &block,
+                                                                                      Eigen::Matrix<double, 6, 1> &score_gradient,
+                                                                                      Eigen::Matrix<double, 6, 6> &hessian,
+                                                                                      bool compute_hessian)
+{
+  const int n = block.size;
+  const double d1 = gauss_d1_, d2 = gauss_d2_;
+
+  // Precomputed angular gradient and hessian components as scalars, Equation 6.19 and 6.21 [Magnusson 2009]
+  const double ja0 = j_ang_a_ (0), ja1 = j_ang_a_ (1), ja2 = j_ang_a_ (2);
+  const double jb0 = j_ang_b_ (0), jb1 = j_ang_b_ (1), jb2 = j_ang_b_ (2);
+  const double jc0 = j_ang_c_ (0), jc1 = j_ang_c_ (1), jc2 = j_ang_c_ (2);
+  const double jd0 = j_ang_d_ (0), jd1 = j_ang_d_ (1), jd2 = j_ang_d_ (2);
+  const double je0 = j_ang_e_ (0), je1 = j_ang_e_ (1), je2 = j_ang_e_ (2);
+  const double jf0 = j_ang_f_ (0), jf1 = j_ang_f_ (1), jf2 = j_ang_f_ (2);
+  const double jg0 = j_ang_g_ (0), jg1 = j_ang_g_ (1), jg2 = j_ang_g_ (2);
+  const double jh0 = j_ang_h_ (0), jh1 = j_ang_h_ (1), jh2 = j_ang_h_ (2);
+
+  // e^(-d_2/2 * (x_k - mu_k)^T Sigma_k^-1 (x_k - mu_k)) Equation 6.9 [Magnusson 2009], kept apart so the other loops have no calls
+  for (int k = 0; k < n; k++)
+  {
+    double dx = block.dx[k], dy = block.dy[k], dz = block.dz[k];
+    double x_cov_x = block.c00[k] * dx * dx + block.c11[k] * dy * dy + block.c22[k] * dz * dz +
+                     2 * (block.c01[k] * dx * dy + block.c02[k] * dx * dz + block.c12[k] * dy * dz);
+    block.e[k] = exp (-d2 * x_cov_x / 2);
+  }
+
+  // Score and gradient accumulators, Equation 6.10 and 6.12 [Magnusson 2009]
+  double s = 0, g0 = 0, g1 = 0, g2 = 0, g3 = 0, g4 = 0, g5 = 0;
+
+  if (!compute_hessian)
+  {
+#if defined (_OPENMP) && _OPENMP >= 201307
+#pragma omp simd reduction(+:s, g0, g1, g2, g3, g4, g5)
+#endif
+    for (int k = 0; k < n; k++)
+    {
+      double x = block.x[k], y = block.y[k], z = block.z[k];
+      double dx = block.dx[k], dy = block.dy[k], dz = block.dz[k];
+
+      // Sigma_k^-1 x_k'
+      double q0 = block.c00[k] * dx + block.c01[k] * dy + block.c02[k] * dz;
+      double q1 = block.c01[k] * dx + block.c11[k] * dy + block.c12[k] * dz;
+      double q2 = block.c02[k] * dx + block.c12[k] * dy + block.c22[k] * dz;
+
+      // Non constant entries of the point gradient, Equation 6.18 and 6.19 [Magnusson 2009]
+      double j13 = x * ja0 + y * ja1 + z * ja2, j23 = x * jb0 + y * jb1 + z * jb2;
+      double j04 = x * jc0 + y * jc1 + z * jc2, j14 = x * jd0 + y * jd1 + z * jd2, j24 = x * je0 + y * je1 + z * je2;
+      double j05 = x * jf0 + y * jf1 + z * jf2, j15 = x * jg0 + y * jg1 + z * jg2, j25 = x * jh0 + y * jh1 + z * jh2;
+
+      // Error checking for invalid values, the pair is skipped as in updateDerivatives
+      double e_x_cov_x = d2 * block.e[k];
+      bool valid = (e_x_cov_x <= 1 && e_x_cov_x >= 0);
+      double w = valid ? d1 * e_x_cov_x : 0.0;
+
+      s += valid ? -d1 * block.e[k] : 0.0;
+      g0 += w * q0;
+      g1 += w * q1;
+      g2 += w * q2;
+      g3 += w * (q1 * j13 + q2 * j23);
+      g4 += w * (q0 * j04 + q1 * j14 + q2 * j24);
+      g5 += w * (q0 * j05 + q1 * j15 + q2 * j25);
+    }
+  }
+  else
+  {
+    const double ha21 = h_ang_a2_ (0), ha22 = h_ang_a2_ (1), ha23 = h_ang_a2_ (2);
+    const double ha31 = h_ang_a3_ (0), ha32 = h_ang_a3_ (1), ha33 = h_ang_a3_ (2);
+    const double hb21 = h_ang_b2_ (0), hb22 = h_ang_b2_ (1), hb23 = h_ang_b2_ (2);
+    const double hb31 = h_ang_b3_ (0), hb32 = h_ang_b3_ (1), hb33 = h_ang_b3_ (2);
+    const double hc21 = h_ang_c2_ (0), hc22 = h_ang_c2_ (1), hc23 = h_ang_c2_ (2);
+    const double hc31 = h_ang_c3_ (0), hc32 = h_ang_c3_ (1), hc33 = h_ang_c3_ (2);
+    const double hd11 = h_ang_d1_ (0), hd12 = h_ang_d1_ (1), hd13 = h_ang_d1_ (2);
+    const double hd21 = h_ang_d2_ (0), hd22 = h_ang_d2_ (1), hd23 = h_ang_d2_ (2);
+    const double hd31 = h_ang_d3_ (0), hd32 = h_ang_d3_ (1), hd33 = h_ang_d3_ (2);
+    const double he11 = h_ang_e1_ (0), he12 = h_ang_e1_ (1), he13 = h_ang_e1_ (2);
+    const double he21 = h_ang_e2_ (0), he22 = h_ang_e2_ (1), he23 = h_ang_e2_ (2);
+    const double he31 = h_ang_e3_ (0), he32 = h_ang_e3_ (1), he33 = h_ang_e3_ (2);
+    const double hf11 = h_ang_f1_ (0), hf12 = h_ang_f1_ (1), hf13 = h_ang_f1_ (2);
+    const double hf21 = h_ang_f2_ (0), hf22 = h_ang_f2_ (1), hf23 = h_ang_f2_ (2);
+    const double hf31 = h_ang_f3_ (0), hf32 = h_ang_f3_ (1), hf33 = h_ang_f3_ (2);
+
+    // Upper triangle of the hessian, Equation 6.13 [Magnusson 2009]
+    double h00 = 0, h01 = 0, h02 = 0, h03 = 0, h04 = 0, h05 = 0;
+    double h11 = 0, h12 = 0, h13 = 0, h14 = 0, h15 = 0;
+    double h22 = 0, h23 = 0, h24 = 0, h25 = 0;
+    double h33 = 0, h34 = 0, h35 = 0;
+    double h44 = 0, h45 = 0;
+    double h55 = 0;
+
+#if defined (_OPENMP) && _OPENMP >= 201307
+#pragma omp simd reduction(+:s, g0, g1, g2, g3, g4, g5, h00, h01, h02, h03, h04, h05, h11, h12, h13, h14, h15, h22, h23, h24, h25, h33, h34, h35, h44, h45, h55)
+#endif
+    for (int k = 0; k < n; k++)
+    {
+      double x = block.x[k], y = block.y[k], z = block.z[k];
+      double dx = block.dx[k], dy = block.dy[k], dz = block.dz[k];
+      double c00 = block.c00[k], c01 = block.c01[k], c02 = block.c02[k];
+      double c11 = block.c11[k], c12 = block.c12[k], c22 = block.c22[k];
+
+      // Sigma_k^-1 x_k'
+      double q0 = c00 * dx + c01 * dy + c02 * dz;
+      double q1 = c01 * dx + c11 * dy + c12 * dz;
+      double q2 = c02 * dx + c12 * dy + c22 * dz;
+
+      // Non constant entries of the point gradient, Equation 6.18 and 6.19 [Magnusson 2009]
+      double j13 = x * ja0 + y * ja1 + z * ja2, j23 = x * jb0 + y * jb1 + z * jb2;
+      double j04 = x * jc0 + y * jc1 + z * jc2, j14 = x * jd0 + y * jd1 + z * jd2, j24 = x * je0 + y * je1 + z * je2;
+      double j05 = x * jf0 + y * jf1 + z * jf2, j15 = x * jg0 + y * jg1 + z * jg2, j25 = x * jh0 + y * jh1 + z * jh2;
+
+      // x_k'^T Sigma_k^-1 d(T(x,p))/dpi
+      double gi3 = q1 * j13 + q2 * j23;
+      double gi4 = q0 * j04 + q1 * j14 + q2 * j24;
+      double gi5 = q0 * j05 + q1 * j15 + q2 * j25;
+
+      // Sigma_k^-1 d(T(x,p))/dpi for the angular columns
+      double cj30 = c01 * j13 + c02 * j23, cj31 = c11 * j13 + c12 * j23, cj32 = c12 * j13 + c22 * j23;
+      double cj40 = c00 * j04 + c01 * j14 + c02 * j24, cj41 = c01 * j04 + c11 * j14 + c12 * j24, cj42 = c02 * j04 + c12 * j14 + c22 * j24;
+      double cj50 = c00 * j05 + c01 * j15 + c02 * j25, cj51 = c01 * j05 + c11 * j15 + c12 * j25, cj52 = c02 * j05 + c12 * j15 + c22 * j25;
+
+      // x_k'^T Sigma_k^-1 d2(T(x,p))/dpidpj using the vectors of Equation 6.21 [Magnusson 2009]
+      double qa = q1 * (x * ha21 + y * ha22 + z * ha23) + q2 * (x * ha31 + y * ha32 + z * ha33);
+      double qb = q1 * (x * hb21 + y * hb22 + z * hb23) + q2 * (x * hb31 + y * hb32 + z * hb33);
+      double qc = q1 * (x * hc21 + y * hc22 + z * hc23) + q2 * (x * hc31 + y * hc32 + z * hc33);
+      double qd = q0 * (x * hd11 + y * hd12 + z * hd13) + q1 * (x * hd21 + y * hd22 + z * hd23) + q2 * (x * hd31 + y * hd32 + z * hd33);
+      double qe = q0 * (x * he11 + y * he12 + z * he13) + q1 * (x * he21 + y * he22 + z * he23) + q2 * (x * he31 + y * he32 + z * he33);
+      double qf = q0 * (x * hf11 + y * hf12 + z * hf13) + q1 * (x * hf21 + y * hf22 + z * hf23) + q2 * (x * hf31 + y * hf32 + z * hf33);
+
+      // Error checking for invalid values, the pair is skipped as in updateDerivatives
+      double e_x_cov_x = d2 * block.e[k];
+      bool valid = (e_x_cov_x <= 1 && e_x_cov_x >= 0);
+      double w = valid ? d1 * e_x_cov_x : 0.0;
+      double wd2 = w * d2;
+
+      s += valid ? -d1 * block.e[k] : 0.0;
+      g0 += w * q0;
+      g1 += w * q1;
+      g2 += w * q2;
+      g3 += w * gi3;
+      g4 += w * gi4;
+      g5 += w * gi5;
+
+      h00 += w * c00 - wd2 * q0 * q0;
+      h01 += w * c01 - wd2 * q0 * q1;
+      h02 += w * c02 - wd2 * q0 * q2;
+      h03 += w * cj30 - wd2 * q0 * gi3;
+      h04 += w * cj40 - wd2 * q0 * gi4;
+      h05 += w * cj50 - wd2 * q0 * gi5;
+      h11 += w * c11 - wd2 * q1 * q1;
+      h12 += w * c12 - wd2 * q1 * q2;
+      h13 += w * cj31 - wd2 * q1 * gi3;
+      h14 += w * cj41 - wd2 * q1 * gi4;
+      h15 += w * cj51 - wd2 * q1 * gi5;
+      h22 += w * c22 - wd2 * q2 * q2;
+      h23 += w * cj32 - wd2 * q2 * gi3;
+      h24 += w * cj42 - wd2 * q2 * gi4;
+      h25 += w * cj52 - wd2 * q2 * gi5;
+      h33 += w * (j13 * cj31 + j23 * cj32 + qa) - wd2 * gi3 * gi3;
+      h34 += w * (j13 * cj41 + j23 * cj42 + qb) - wd2 * gi3 * gi4;
+      h35 += w * (j13 * cj51 + j23 * cj52 + qc) - wd2 * gi3 * gi5;
+      h44 += w * (j04 * cj40 + j14 * cj41 + j24 * cj42 + qd) - wd2 * gi4 * gi4;
+      h45 += w * (j04 * cj50 + j14 * cj51 + j24 * cj52 + qe) - wd2 * gi4 * gi5;
+      h55 += w * (j05 * cj50 + j15 * cj51 + j25 * cj52 + qf) - wd2 * gi5 * gi5;
+    }
+
+    hessian (0, 0) += h00; hessian (0, 1) += h01; hessian (0, 2) += h02; hessian (0, 3) += h03; hessian (0, 4) += h04; hessian (0, 5) += h05;
+    hessian (1, 1) += h11; hessian (1, 2) += h12; hessian (1, 3) += h13; hessian (1, 4) += h14; hessian (1, 5) += h15;
+    hessian (2, 2) += h22; hessian (2, 3) += h23; hessian (2, 4) += h24; hessian (2, 5) += h25;
+    hessian (3, 3) += h33; hessian (3, 4) += h34; hessian (3, 5) += h35;
+    hessian (4, 4) += h44; hessian (4, 5) += h45;
+    hessian (5, 5) += h55;
+
+    // Mirror the upper triangle
+    for (int i = 1; i < 6; i++)
+      for (int j = 0; j < i; j++)
+        hessian (i, j) = hessian (j, i);
+  }
+
+  score_gradient (0) += g0;
+  score_gradient (1) += g1;
+  score_gradient (2) += g2;
+  score_gradient (3) += g3;
+  score_gradient (4) += g4;
+  score_gradient (5) += g5;
+
+  return (s);
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 template<typename PointSource, typename PointTarget> bool
 pcl::NormalDistributionsTransform<PointSource, PointTarget>::updateIntervalMT (double &a_l, double &f_l, double &g_l,
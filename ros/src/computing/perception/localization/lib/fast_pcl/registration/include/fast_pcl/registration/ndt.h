@@ -48,6 +48,10 @@
 
 #include <unsupported/Eigen/NonLinearOptimization>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace pcl
 {
   /** \brief A 3D Normal Distribution Transform registration implementation for point cloud data.
@@ -92,6 +96,19 @@ namespace pcl
       typedef boost::shared_ptr< NormalDistributionsTransform<PointSource, PointTarget> > Ptr;
       typedef boost::shared_ptr< const NormalDistributionsTransform<PointSource, PointTarget> > ConstPtr;
 
+      /** \brief Method used to find the target voxels around a transformed source point. */
+      enum NeighborSearchMethod
+      {
+        /** \brief Radius search of the voxel centroids using a kdtree. */
+        KDTREE,
+        /** \brief The voxel containing the point, computed directly on the voxel grid. */
+        DIRECT1,
+        /** \brief The voxel containing the point and its 6 face neighbors, computed directly on the voxel grid. */
+        DIRECT7,
+        /** \brief The voxel containing the point and its 26 neighbors, computed directly on the voxel grid. */
+        DIRECT27
+      };
+
 
       /** \brief Constructor.
         * Sets \ref outlier_ratio_ to 0.35, \ref step_size_ to 0.05 and \ref resolution_ to 1.0
@@ -107,10 +124,85 @@ namespace pcl
       inline void
       setInputTarget (const PointCloudTargetConstPtr &cloud)
       {
+        target_cells_file_.clear ();
         Registration<PointSource, PointTarget>::setInputTarget (cloud);
         init ();
       }
 
+      /** \brief Add points to the input target, only the voxels they fall in are updated.
+        * \note The voxel means become the input target, as with \ref loadTargetCells. Changing the resolution,
+        * leaf storage or neighbor search method afterwards rebuilds the voxels from these means, so set the
+        * whole target again after such a change.
+        * \param[in] cloud the points to add to the target
+        */
+      inline void
+      addInputTarget (const PointCloudTargetConstPtr &cloud)
+      {
+        target_cells_file_.clear ();
+        if (target_cells_.getLeafCount () == 0 || target_cells_.getLeafSize () (0) != resolution_)
+        {
+          target_cells_.setLeafSize (resolution_, resolution_, resolution_);
+          target_cells_.setInputCloud (cloud);
+          target_cells_.filter (search_method_ == KDTREE);
+        }
+        else
+        {
+          target_cells_.addPoints (cloud, search_method_ == KDTREE);
+        }
+        Registration<PointSource, PointTarget>::setInputTarget (target_cells_.getCentroids ());
+      }
+
+      /** \brief Use a voxel grid precomputed by \ref saveTargetCells instead of an input target.
+        * \note The resolution is the one stored in the file. The voxel means become the input target,
+        * which is only used by getFitnessScore.
+        * \param[in] file_name the file written by \ref saveTargetCells
+        * \return true on success
+        */
+      inline bool
+      loadTargetCells (const std::string &file_name)
+      {
+        target_cells_file_ = file_name;
+        if (!loadTargetCellsFile ())
+        {
+          target_cells_file_.clear ();
+          return (false);
+        }
+        Registration<PointSource, PointTarget>::setInputTarget (target_cells_.getCentroids ());
+        return (true);
+      }
+
+      /** \brief Write the voxel grid built from the input target to a file for \ref loadTargetCells.
+        * \param[in] file_name the file to write
+        * \return true on success
+        */
+      inline bool
+      saveTargetCells (const std::string &file_name) const
+      {
+        return (target_cells_.saveLeaves (file_name));
+      }
+
+      /** \brief Obtain the Euclidean fitness score (e.g., sum of squared distances from the source to the target)
+        * \note The kdtree over the input target is only used here, so it is built on the first call after the
+        * target changed rather than by align.
+        * \param[in] max_range maximum allowable distance between a point and its correspondence in the target
+        * (default: double::max)
+        */
+      inline double
+      getFitnessScore (double max_range = std::numeric_limits<double>::max ())
+      {
+        updateFitnessTree ();
+        return (Registration<PointSource, PointTarget>::getFitnessScore (max_range));
+      }
+
+      inline double
+      omp_getFitnessScore (double max_range = std::numeric_limits<double>::max ())
+      {
+        updateFitnessTree ();
+        return (Registration<PointSource, PointTarget>::omp_getFitnessScore (max_range));
+      }
+
+      using Registration<PointSource, PointTarget>::getFitnessScore;
+
       /** \brief Set/change the voxel grid resolution.
         * \param[in] resolution side length of voxels
         */
@@ -126,6 +218,44 @@ namespace pcl
         }
       }
 
+      /** \brief Set/change the container used to store the target voxel leaves.
+        * \param[in] leaf_storage container used to store the leaf structures
+        */
+      inline void
+      setLeafStorage (typename TargetGrid::LeafStorage leaf_storage)
+      {
+        // Prevents unnessary voxel initiations
+        if (target_cells_.getLeafStorage () != leaf_storage)
+        {
+          target_cells_.setLeafStorage (leaf_storage);
+          if (target_)
+            init ();
+        }
+      }
+
+      /** \brief Set/change the method used to find the target voxels around each transformed source point.
+        * \note The direct methods skip the kdtree entirely and are best combined with hashed leaf storage.
+        * \param[in] method neighbor search method
+        */
+      inline void
+      setNeighborSearchMethod (NeighborSearchMethod method)
+      {
+        // The kdtree is only built when it is needed
+        bool reinit = (method == KDTREE) != (search_method_ == KDTREE);
+        search_method_ = method;
+        if (reinit && target_)
+          init ();
+      }
+
+      /** \brief Get the method used to find the target voxels around each transformed source point.
+        * \return neighbor search method
+        */
+      inline NeighborSearchMethod
+      getNeighborSearchMethod () const
+      {
+        return (search_method_);
+      }
+
       /** \brief Get voxel grid resolution.
         * \return side length of voxels
         */
@@ -135,6 +265,48 @@ namespace pcl
         return (resolution_);
       }
 
+      /** \brief Set whether derivatives are computed by the batched kernel or point by point.
+        * \param[in] batched true to use \ref computeBlockDerivatives, false for the per point path
+        */
+      inline void
+      setBatchedDerivatives (bool batched)
+      {
+        use_batched_derivatives_ = batched;
+      }
+
+      /** \brief Get whether derivatives are computed by the batched kernel or point by point.
+        * \return true if \ref computeBlockDerivatives is used
+        */
+      inline bool
+      getBatchedDerivatives () const
+      {
+        return (use_batched_derivatives_);
+      }
+
+      /** \brief Set the number of threads used by \ref omp_align.
+        * \note The source points are always split into this many slots which are summed in order,
+        * so results do not depend on how many threads the OpenMP runtime actually provides.
+        * \param[in] nr_threads number of threads, 0 to use omp_get_max_threads ()
+        */
+      inline void
+      setNumberOfThreads (int nr_threads)
+      {
+#ifdef _OPENMP
+        num_threads_ = (nr_threads > 0) ? nr_threads : omp_get_max_threads ();
+#else
+        num_threads_ = 1;
+#endif
+      }
+
+      /** \brief Get the number of threads used by \ref omp_align.
+        * \return number of threads
+        */
+      inline int
+      getNumberOfThreads () const
+      {
+        return (num_threads_);
+      }
+
       /** \brief Get the newton line search maximum step length.
         * \return maximum step length
         */
@@ -231,6 +403,10 @@ namespace pcl
       using Registration<PointSource, PointTarget>::corr_dist_threshold_;
       using Registration<PointSource, PointTarget>::inlier_threshold_;
 
+      using Registration<PointSource, PointTarget>::tree_;
+      using Registration<PointSource, PointTarget>::target_cloud_updated_;
+      using Registration<PointSource, PointTarget>::force_no_recompute_;
+
       using Registration<PointSource, PointTarget>::update_visualizer_;
 
       /** \brief Estimate the transformation and returns the transformed source (input) as output.
@@ -252,14 +428,79 @@ namespace pcl
       virtual void
       omp_computeTransformation (PointCloudSource &output, const Eigen::Matrix4f &guess);
 
+      /** \brief Build the kdtree over the input target if the target changed since it was last built. */
+      inline void
+      updateFitnessTree ()
+      {
+        if (target_cloud_updated_ && target_)
+        {
+          tree_->setInputCloud (target_);
+          target_cloud_updated_ = false;
+        }
+      }
+
       /** \brief Initiate covariance voxel structure. */
       void inline
       init ()
       {
+        if (!target_cells_file_.empty ())
+        {
+          loadTargetCellsFile ();
+          return;
+        }
         target_cells_.setLeafSize (resolution_, resolution_, resolution_);
         target_cells_.setInputCloud ( target_ );
-        // Initiate voxel structure.
-        target_cells_.filter (true);
+        // Initiate voxel structure, the kdtree is only needed for radius search.
+        target_cells_.filter (search_method_ == KDTREE);
+      }
+
+      /** \brief (Re)load the covariance voxel structure from \ref target_cells_file_.
+        * \return true on success
+        */
+      inline bool
+      loadTargetCellsFile ()
+      {
+        if (!target_cells_.loadLeaves (target_cells_file_, search_method_ == KDTREE))
+          return (false);
+        resolution_ = target_cells_.getLeafSize () (0);
+        return (true);
+      }
+
+      /** \brief Find the target voxels used to score a transformed source point.
+        * \param[in] x_trans_pt transformed source point
+        * \param[out] neighborhood occupied voxels around the point
+        * \return number of voxels found
+        */
+      inline int
+      findNeighborhood (const PointSource &x_trans_pt, std::vector<TargetGridLeafConstPtr> &neighborhood)
+      {
+        std::vector<int> indices;
+        std::vector<float> distances;
+        return (findNeighborhood (x_trans_pt, neighborhood, indices, distances));
+      }
+
+      /** \brief Find the target voxels used to score a transformed source point.
+        * \param[in] x_trans_pt transformed source point
+        * \param[out] neighborhood occupied voxels around the point
+        * \param[out] indices scratch for the radius search
+        * \param[out] distances scratch for the radius search
+        * \return number of voxels found
+        */
+      inline int
+      findNeighborhood (const PointSource &x_trans_pt, std::vector<TargetGridLeafConstPtr> &neighborhood,
+                        std::vector<int> &indices, std::vector<float> &distances)
+      {
+        switch (search_method_)
+        {
+          case DIRECT1:
+            return (target_cells_.getNeighborhoodAtPoint (x_trans_pt, TargetGrid::NEIGHBORHOOD_1, neighborhood));
+          case DIRECT7:
+            return (target_cells_.getNeighborhoodAtPoint (x_trans_pt, TargetGrid::NEIGHBORHOOD_7, neighborhood));
+          case DIRECT27:
+            return (target_cells_.getNeighborhoodAtPoint (x_trans_pt, TargetGrid::NEIGHBORHOOD_27, neighborhood));
+          default:
+            return (target_cells_.radiusSearch (x_trans_pt, resolution_, neighborhood, indices, distances));
+        }
       }
 
       /** \brief Compute derivatives of probability function w.r.t. the transformation vector.
@@ -284,6 +525,91 @@ namespace pcl
                           Eigen::Matrix<double, 6, 1> &p,
                           bool compute_hessian = true);
 
+      /** \brief Number of point/voxel pairs processed together by \ref computeBlockDerivatives. */
+      static const int DERIVATIVES_BLOCK_SIZE = 64;
+
+      /** \brief Point/voxel pairs stored as a structure of arrays for \ref computeBlockDerivatives. */
+      struct DerivativesBlock
+      {
+        /** \brief Number of pairs in the block. */
+        int size;
+        /** \brief Source point, x in Equations 6.18 and 6.20 [Magnusson 2009]. */
+        double x[DERIVATIVES_BLOCK_SIZE], y[DERIVATIVES_BLOCK_SIZE], z[DERIVATIVES_BLOCK_SIZE];
+        /** \brief Transformed point minus mean of the voxel, x_k' in Equations 6.12 and 6.13 [Magnusson 2009]. */
+        double dx[DERIVATIVES_BLOCK_SIZE], dy[DERIVATIVES_BLOCK_SIZE], dz[DERIVATIVES_BLOCK_SIZE];
+        /** \brief Upper triangle of the inverse covariance of the voxel. */
+        double c00[DERIVATIVES_BLOCK_SIZE], c01[DERIVATIVES_BLOCK_SIZE], c02[DERIVATIVES_BLOCK_SIZE],
+               c11[DERIVATIVES_BLOCK_SIZE], c12[DERIVATIVES_BLOCK_SIZE], c22[DERIVATIVES_BLOCK_SIZE];
+        /** \brief Scratch for the exponential of Equation 6.9 [Magnusson 2009]. */
+        double e[DERIVATIVES_BLOCK_SIZE];
+      };
+
+      /** \brief Compute derivatives of probability function w.r.t. the transformation vector with the batched kernel.
+        * \note Equation 6.10, 6.12 and 6.13 [Magnusson 2009].
+        * \param[out] score_gradient the gradient vector of the probability function w.r.t. the transformation vector
+        * \param[out] hessian the hessian matrix of the probability function w.r.t. the transformation vector
+        * \param[in] trans_cloud transformed point cloud
+        * \param[in] p the current transform vector
+        * \param[in] compute_hessian flag to calculate hessian, unnessissary for step calculation.
+        * \param[in] parallel flag to split the source points across OpenMP threads
+        */
+      double
+      computeDerivativesBatched (Eigen::Matrix<double, 6, 1> &score_gradient,
+                                 Eigen::Matrix<double, 6, 6> &hessian,
+                                 PointCloudSource &trans_cloud,
+                                 Eigen::Matrix<double, 6, 1> &p,
+                                 bool compute_hessian, bool parallel);
+
+      /** \brief Accumulate the contributions of a block of point/voxel pairs to the derivatives of probability function.
+        * \note Equation 6.10, 6.12, 6.13, 6.18 and 6.20 [Magnusson 2009], evaluated in closed form on scalars
+        * so that the loops over the block can be vectorized. \ref computeAngleDerivatives must have been called.
+        * \param[in,out] block point/voxel pairs, the exponential scratch is overwritten
+        * \param[in,out] score_gradient the gradient vector of the probability function w.r.t. the transformation vector
+        * \param[in,out] hessian the hessian matrix of the probability function w.r.t. the transformation vector
+        * \param[in] compute_hessian flag to calculate hessian, unnessissary for step calculation.
+        * \return score of the block
+        */
+      double
+      computeBlockDerivatives (DerivativesBlock &block,
+                               Eigen::Matrix<double, 6, 1> &score_gradient,
+                               Eigen::Matrix<double, 6, 6> &hessian,
+                               bool compute_hessian);
+
+      /** \brief Accumulators and scratch of one slot of the parallel derivative computation.
+        * Slots are kept between calls so that no allocation happens during alignment.
+        */
+      struct DerivativesSlot
+      {
+        /** \brief Partial score, gradient and hessian of the points of the slot. */
+        double score;
+        Eigen::Matrix<double, 6, 1> score_gradient;
+        Eigen::Matrix<double, 6, 6> hessian;
+        /** \brief Per slot copies of \ref point_gradient_ and \ref point_hessian_. */
+        Eigen::Matrix<double, 3, 6> point_gradient;
+        Eigen::Matrix<double, 18, 6> point_hessian;
+        /** \brief Neighboring voxels of the current point and radius search scratch. */
+        std::vector<TargetGridLeafConstPtr> neighborhood;
+        std::vector<int> neighbor_indices;
+        std::vector<float> neighbor_distances;
+        /** \brief Pending point/voxel pairs of the batched kernel. */
+        DerivativesBlock block;
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+      };
+
+      /** \brief Make sure there is one slot per thread and reset their accumulators. */
+      void
+      initDerivativesSlots ();
+
+      /** \brief Sum the slot accumulators in slot order.
+        * \param[out] score_gradient the gradient vector of the probability function w.r.t. the transformation vector
+        * \param[out] hessian the hessian matrix of the probability function w.r.t. the transformation vector
+        * \return score
+        */
+      double
+      reduceDerivativesSlots (Eigen::Matrix<double, 6, 1> &score_gradient,
+                              Eigen::Matrix<double, 6, 6> &hessian);
+
       /** \brief Compute individual point contirbutions to derivatives of probability function w.r.t. the transformation vector.
         * \note Equation 6.10, 6.12 and 6.13 [Magnusson 2009].
         * \param[in,out] score_gradient the gradient vector of the probability function w.r.t. the transformation vector
@@ -314,6 +640,19 @@ namespace pcl
       void
       computePointDerivatives (Eigen::Vector3d &x, bool compute_hessian = true);
 
+      /** \brief Compute point derivatives into the given matrices instead of \ref point_gradient_ and \ref point_hessian_.
+        * \note Equation 6.18-21 [Magnusson 2009].
+        * \param[in] x point from the input cloud
+        * \param[in,out] point_gradient first order derivative, only the angular entries are written
+        * \param[in,out] point_hessian second order derivative, only the angular entries are written
+        * \param[in] compute_hessian flag to calculate hessian, unnessissary for step calculation.
+        */
+      void
+      computePointDerivatives (Eigen::Vector3d &x,
+                               Eigen::Matrix<double, 3, 6> &point_gradient,
+                               Eigen::Matrix<double, 18, 6> &point_hessian,
+                               bool compute_hessian = true);
+
       /** \brief Compute hessian of probability function w.r.t. the transformation vector.
         * \note Equation 6.13 [Magnusson 2009].
         * \param[out] hessian the hessian matrix of the probability function w.r.t. the transformation vector
@@ -434,6 +773,21 @@ namespace pcl
       /** \brief The side length of voxels. */
       float resolution_;
 
+      /** \brief File the voxel grid was loaded from by \ref loadTargetCells, empty if built from the input target. */
+      std::string target_cells_file_;
+
+      /** \brief The method used to find the target voxels around each transformed source point. */
+      NeighborSearchMethod search_method_;
+
+      /** \brief Flag to compute derivatives with the batched kernel instead of point by point. */
+      bool use_batched_derivatives_;
+
+      /** \brief Number of threads, and of slots the source points are split into, in \ref omp_align. */
+      int num_threads_;
+
+      /** \brief Slots of the derivative computation, reused across iterations and alignments. */
+      std::vector<DerivativesSlot, Eigen::aligned_allocator<DerivativesSlot> > derivatives_slots_;
+
       /** \brief The maximum step length. */
       double step_size_;
 
@@ -18,165 +18,14 @@
  ***************************************************************************/
 
 #include<GL/glut.h>
-/*root cell size*/
 /*
-  #define MAP_CELLSIZE 0.2 //m
-  
-  #define MAP_X 128
-  #define MAP_Y 80
-  #define MAP_Z 48
+  The ND map is sparse: each layer is a hash table of the occupied voxels, so it
+  has no fixed extent and its origin is stored in the map file (NDMapHeader).
 */
-
-//#define MAP_CELLSIZE 1.0 //m
-#define MAX_ND_NUM (20000000)
-
-
-//map origin//
-//meidai_map
-#if 0
-#define MAP_CENTER_X (-18407.4+215)
-#define MAP_CENTER_Y (-93444.9-400)
-#define MAP_CENTER_Z 33
-#define MAP_ROTATION 0.0
-//map size
-#define MAP_X 1600
-#define MAP_Y 1600
-#define MAP_Z 200
-#endif
-
-//meidai_map_all
-#if 0
-#define MAP_CENTER_X (-18500)
-#define MAP_CENTER_Y (-93800)
-#define MAP_CENTER_Z 33
-#define MAP_ROTATION 0.0
-//map size
-#define MAP_X 2200
-#define MAP_Y 2600
-#define MAP_Z 200
-
-#endif
-
-//moriyama_map
-#if 0
-#define MAP_CENTER_X -15741 
-#define MAP_CENTER_Y -85697
-#define MAP_CENTER_Z 70
-#define MAP_ROTATION 0.7
-//map size
-#define MAP_X 1600
-#define MAP_Y 1600
-#define MAP_Z 200
-#endif
-
-//tctslc map
-#if 0
-#define MAP_CENTER_X 3702
-#define MAP_CENTER_Y -99430
-#define MAP_CENTER_Z 85
-#define MAP_ROTATION 0
-//map size
-#define MAP_X 1600
-#define MAP_Y 1600
-#define MAP_Z 200
-#endif
-
-#if 0
-//map offset
-#define MAP_CENTER_X 0
-#define MAP_CENTER_Y 0
-#define MAP_CENTER_Z 0
-#define MAP_ROTATION 0
-//map size
-#define MAP_X 1600
-#define MAP_Y 1600
-#define MAP_Z 200
-#endif
-
-//initial position
-//meidai IB (141117_run01,run02)
-#if 0
-#define INITIAL_X -18354.1
-#define INITIAL_Y -93693.4
-#define INITIAL_Z 43
-#define INITIAL_ROLL  0
-#define INITIAL_PITCH 0
-#define INITIAL_YAW -0.5
-#endif
-//meidai  (141205_outdoor1)
-#if 0
-#define INITIAL_X -18526.5
-#define INITIAL_Y -93646.0
-#define INITIAL_Z 39
-#define INITIAL_ROLL  0
-#define INITIAL_PITCH 0.03
-#define INITIAL_YAW -0.45
-#endif
-//incubation(0826)
-#if 0
-#define INITIAL_X (-18407.4+215-215+0.6)
-#define INITIAL_Y (-93444.9 -400+400+0.65)
-#define INITIAL_Z 33
-#define INITIAL_ROLL  0
-#define INITIAL_PITCH -0.063
-#define INITIAL_YAW -1.976
-#endif
-//incubation parking(1224)
-#if 0
-#define INITIAL_X (-18389.8)
-#define INITIAL_Y (-93499.1)
-#define INITIAL_Z 33
-#define INITIAL_ROLL  0
-#define INITIAL_PITCH 0
-#define INITIAL_YAW 1.107
-#endif
-
-
-//moriyama
-#if 0
-#define INITIAL_X -14771
-#define INITIAL_Y -84757
-#define INITIAL_Z (39.8)
-#define INITIAL_ROLL  0
-#define INITIAL_PITCH 0
-//#define INITIAL_YAW 0
-#define INITIAL_YAW 2.324
-#endif
-
-//tctslc
-#if 0
-#define INITIAL_X 3702
-#define INITIAL_Y -99430  //matsu
-//#define INITIAL_Y -99426   //zmp
-#define INITIAL_Z 87
-#define INITIAL_ROLL  0
-#define INITIAL_PITCH 0
-#define INITIAL_YAW 0      //matsu
-//#define INITIAL_YAW 3.14   //zmp
-#endif
-
-//no map
-#if 0
-#define INITIAL_X 0
-#define INITIAL_Y 0
-#define INITIAL_Z 0
-#define INITIAL_ROLL  0
-#define INITIAL_PITCH 0
-#define INITIAL_YAW 0
-#endif
-
-
-//x=-14763
-//y=-84780
-//q=-2.34
 #define LAYER_NUM 2 //0.2 0.4 0.8 1.6 3.2(128*80*48)
 
 #define ND_MIN  40
 
-//#define CELL_X (MAP_X*(1<<LAYER_NUM))
-//#define CELL_Y (MAP_Y*(1<<LAYER_NUM))
-//#define CELL_Z (MAP_Z*(1<<LAYER_NUM))
-
 /*point*/
 typedef struct point_type *PointPtr;
 
@@ -235,16 +84,21 @@ typedef struct Normaldistribution{
   //  NDPtr child[8]; /*upper level layer*/
 }NormalDistribution;
 
+/*voxel of a layer, empty when nd is 0*/
+typedef struct nd_cell{
+  int x;
+  int y;
+  int z;
+  NDPtr nd;
+}NDCell;
+
 typedef struct nd_map *NDMapPtr;
 
 typedef struct nd_map{
-  NDPtr *nd;
+  NDCell *cell; /*open addressing table*/
+  int cell_size;/*table size, power of 2*/
+  int cell_num; /*occupied cells*/
   int layer;
-  int x;
-  int y;
-  int z;
-  int to_x;
-  int to_y;
   double size;
   char name[30];
 
@@ -261,6 +115,19 @@ typedef struct nd_data{
   int layer;
 }NDData;
 
+/*head of the nd map file, followed by NDData*/
+#define ND_MAP_MAGIC "NDMAP01"
+
+typedef struct nd_map_header{
+  char magic[8];
+  double center_x;/*map origin*/
+  double center_y;
+  double center_z;
+  double rotation;
+  double cellsize;/*voxel size of layer 0*/
+  int layer_num;
+}NDMapHeader;
+
 int add_point_covariance(NDPtr nd,PointPtr p);
 int update_covariance(NDPtr nd);
 int add_point_map(NDMapPtr ndmap,PointPtr point);
@@ -268,6 +135,12 @@ int get_ND(NDMapPtr ndmap, PointPtr point,NDPtr *nd,int mode);
 
 NDMapPtr initialize_NDmap(void);
 NDMapPtr initialize_NDmap_layer(int layer, NDMapPtr parent);
+NDMapPtr create_NDmap_layer(int layer, double size, NDMapPtr child);
+NDPtr *find_ND_cell(NDMapPtr ndmap, int x, int y, int z, int create);
+int ND_cell_index(double v, double size, double shift, int *index);
+NDPtr alloc_ND(void);
+void mark_ND_dirty(NDPtr nd);
+void update_dirty_NDs(void);
 int round_covariance(NDPtr nd);
 int  print_ellipse(FILE* output_file, double mat[3][3],double cx,double cy);
 int  print_ellipse_nd(FILE* output_file,NDPtr nd);
@@ -292,5 +165,7 @@ int adjust2d(PointPtr scan, int num, PosturePtr initial);
 
 double calc_summand3d(PointPtr p,NDPtr nd,PosturePtr pose,double *g,double H[6][6],double qd3[6][3],double dist);
 double adjust3d(PointPtr scan, int num, PosturePtr initial,int target);
+void set_adjust3d_threads(int num);
+int get_adjust3d_threads(void);
 void set_sincos2(double a,double b,double g,double sc[3][3]);
 void scan_transrate(PointPtr src, PointPtr dst ,PosturePtr pose, int num);
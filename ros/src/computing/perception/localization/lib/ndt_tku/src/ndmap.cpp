@@ -0,0 +1,173 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ndt.h"
+
+#define ND_CELL_INITIAL_SIZE (1 << 12)
+#define ND_BLOCK_NUM (1 << 16)
+
+/*voxel indices beyond this are out of the int range*/
+#define ND_INDEX_MAX 1.0e9
+
+static unsigned int hash_cell(int x, int y, int z)
+{
+  return ((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u) ^ ((unsigned int)z * 83492791u);
+}
+
+/*allocate empty cells*/
+static NDCell *alloc_cells(int size)
+{
+  return (NDCell *)calloc(size, sizeof(NDCell));
+}
+
+/*double the table of the layer*/
+static int grow_cells(NDMapPtr ndmap)
+{
+  NDCell *old_cell = ndmap->cell;
+  int old_size = ndmap->cell_size;
+  NDCell *cell;
+  unsigned int mask;
+  int i;
+
+  cell = alloc_cells(old_size * 2);
+  if (!cell)
+    return 0;
+
+  ndmap->cell = cell;
+  ndmap->cell_size = old_size * 2;
+  mask = ndmap->cell_size - 1;
+
+  for (i = 0; i < old_size; i++)
+  {
+    unsigned int h;
+    if (!old_cell[i].nd)
+      continue;
+    h = hash_cell(old_cell[i].x, old_cell[i].y, old_cell[i].z) & mask;
+    while (cell[h].nd)
+      h = (h + 1) & mask;
+    cell[h] = old_cell[i];
+  }
+  free(old_cell);
+
+  return 1;
+}
+
+/*layer of the sparse map, voxel size is size*/
+NDMapPtr create_NDmap_layer(int layer, double size, NDMapPtr child)
+{
+  NDMapPtr ndmap;
+
+  ndmap = (NDMapPtr)malloc(sizeof(NDMap));
+  ndmap->cell = alloc_cells(ND_CELL_INITIAL_SIZE);
+  ndmap->cell_size = ND_CELL_INITIAL_SIZE;
+  ndmap->cell_num = 0;
+  ndmap->layer = layer;
+  ndmap->size = size;
+  ndmap->name[0] = '\0';
+  ndmap->next = child;
+
+  return ndmap;
+}
+
+/*
+  slot of the voxel (x,y,z), 0 if it is not in the map.
+  with create, a missing voxel is added with a new ND from add_ND,
+  nothing is added and 0 is returned if add_ND fails.
+  the slot is valid until the next voxel is created.
+*/
+NDPtr *find_ND_cell(NDMapPtr ndmap, int x, int y, int z, int create)
+{
+  unsigned int mask, h;
+  NDCell *cell;
+
+  /*keep the load under 1/2*/
+  if (create && (ndmap->cell_num + 1) * 2 > ndmap->cell_size)
+  {
+    if (!grow_cells(ndmap))
+      return 0;
+  }
+
+  mask = ndmap->cell_size - 1;
+  h = hash_cell(x, y, z) & mask;
+  cell = ndmap->cell;
+  while (cell[h].nd)
+  {
+    if (cell[h].x == x && cell[h].y == y && cell[h].z == z)
+      return &cell[h].nd;
+    h = (h + 1) & mask;
+  }
+
+  if (!create)
+    return 0;
+
+  /*claim the slot only once it holds an ND*/
+  NDPtr nd = add_ND();
+  if (!nd)
+    return 0;
+  cell[h].nd = nd;
+  cell[h].x = x;
+  cell[h].y = y;
+  cell[h].z = z;
+  ndmap->cell_num++;
+  return &cell[h].nd;
+}
+
+/*voxel index of the coordinate v, 0 if it is not finite or too far*/
+int ND_cell_index(double v, double size, double shift, int *index)
+{
+  double f = floor(v / size + shift);
+
+  if (!(fabs(f) < ND_INDEX_MAX))
+    return 0;
+  *index = (int)f;
+  return 1;
+}
+
+/*ND from blocks allocated on demand, never released*/
+NDPtr alloc_ND(void)
+{
+  static NDPtr block = 0;
+  static int block_used = ND_BLOCK_NUM;
+
+  if (block_used >= ND_BLOCK_NUM)
+  {
+    block = (NDPtr)malloc(sizeof(NormalDistribution) * ND_BLOCK_NUM);
+    if (!block)
+      return 0;
+    block_used = 0;
+  }
+
+  return block + block_used++;
+}
+
+/*NDs whose covariance is out of date*/
+static NDPtr *dirty_nd = 0;
+static int dirty_nd_num = 0;
+static int dirty_nd_size = 0;
+
+/*called when an up to date ND gets points*/
+void mark_ND_dirty(NDPtr nd)
+{
+  if (dirty_nd_num >= dirty_nd_size)
+  {
+    int size = dirty_nd_size ? dirty_nd_size * 2 : ND_BLOCK_NUM;
+    NDPtr *list = (NDPtr *)realloc(dirty_nd, sizeof(NDPtr) * size);
+    if (!list)
+      return;
+    dirty_nd = list;
+    dirty_nd_size = size;
+  }
+  dirty_nd[dirty_nd_num++] = nd;
+}
+
+/*update the covariances of the dirty NDs, so that get_ND does not write the map*/
+void update_dirty_NDs(void)
+{
+  int i;
+
+  for (i = 0; i < dirty_nd_num; i++)
+    update_covariance(dirty_nd[i]);
+  dirty_nd_num = 0;
+}
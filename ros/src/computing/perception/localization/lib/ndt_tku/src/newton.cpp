@@ -1,11 +1,16 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <string>
 
 #include "ndt.h"
 #include "algebra.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #define E_THETA 0.0001
 
 //#define WEIGHTED_SELECT 1
@@ -25,6 +30,22 @@ double qd[3][2];
 double qd3[6][3];
 double qdd3[6][6][3];
 
+/*gradient and hessian of a slot of scan points*/
+typedef struct adjust_slot
+{
+  double gsum[6];
+  double Hsumh[6][6];
+  double esum;
+  double gnum;
+  double qd3[6][3];
+  double qdd3[6][6][3];
+} AdjustSlot;
+
+/*scan points per slot, fixed so that the partition does not depend on the number of threads*/
+#define ADJUST_SLOT_POINTS 256
+
+static int adjust_thread_num = 1;
+
 void set_sincos(double a, double b, double g, double sc_d[3][3][3]);
 void set_sincos2(double a, double b, double g, double sc[3][3]);
 int check_Hessian(double H[3][3]);
@@ -35,7 +56,8 @@ void depth(PointPtr scan, int num, PosturePtr pose);
 �����̤���뤿��η׻��ʰ���ʬ��
 �إå�����η׻��⤦�����ڤǤ��뤫�⡣
 �켡��ʬ�����ο������׻����ơ��إå�����Ϥ���κ�ʬ������롣*/
-double calc_summand3d(PointPtr p, NDPtr nd, PosturePtr pose, double *g, double H[6][6], double qd3_d[6][3], double dist)
+static double calc_summand3d_r(PointPtr p, NDPtr nd, double *g, double H[6][6], double qd3_d[6][3],
+                               double qdd3_d[6][6][3], double dist)
 {
   double a[3];
   double e;
@@ -78,14 +100,14 @@ double calc_summand3d(PointPtr p, NDPtr nd, PosturePtr pose, double *g, double H
 
   for (j = 0; j < 6; j++)
   {
-    qda[j][0] = qd3[j][0] * nd->inv_covariance[0][0] + qd3[j][1] * nd->inv_covariance[1][0] +
-                qd3[j][2] * nd->inv_covariance[2][0];
+    qda[j][0] = qd3_d[j][0] * nd->inv_covariance[0][0] + qd3_d[j][1] * nd->inv_covariance[1][0] +
+                qd3_d[j][2] * nd->inv_covariance[2][0];
     qda_p++;
-    qda[j][1] = qd3[j][0] * nd->inv_covariance[0][1] + qd3[j][1] * nd->inv_covariance[1][1] +
-                qd3[j][2] * nd->inv_covariance[2][1];
+    qda[j][1] = qd3_d[j][0] * nd->inv_covariance[0][1] + qd3_d[j][1] * nd->inv_covariance[1][1] +
+                qd3_d[j][2] * nd->inv_covariance[2][1];
     qda_p++;
-    qda[j][2] = qd3[j][0] * nd->inv_covariance[0][2] + qd3[j][1] * nd->inv_covariance[1][2] +
-                qd3[j][2] * nd->inv_covariance[2][2];
+    qda[j][2] = qd3_d[j][0] * nd->inv_covariance[0][2] + qd3_d[j][1] * nd->inv_covariance[1][2] +
+                qd3_d[j][2] * nd->inv_covariance[2][2];
     qda_p++;
   }
 
@@ -93,8 +115,8 @@ double calc_summand3d(PointPtr p, NDPtr nd, PosturePtr pose, double *g, double H
   {
     for (j = 0; j < 6; j++)
     {
-      H[i][j] = -e * ((-g[i]) * (g[j]) - (a[0] * qdd3[i][j][0] + a[1] * qdd3[i][j][1] + a[2] * qdd3[i][j][2]) -
-                      (qda[j][0] * qd3[i][0] + qda[j][1] * qd3[i][1] + qda[j][2] * qd3[i][2]));
+      H[i][j] = -e * ((-g[i]) * (g[j]) - (a[0] * qdd3_d[i][j][0] + a[1] * qdd3_d[i][j][1] + a[2] * qdd3_d[i][j][2]) -
+                      (qda[j][0] * qd3_d[i][0] + qda[j][1] * qd3_d[i][1] + qda[j][2] * qd3_d[i][2]));
     }
   }
 
@@ -104,6 +126,11 @@ double calc_summand3d(PointPtr p, NDPtr nd, PosturePtr pose, double *g, double H
   return e;
 }
 
+double calc_summand3d(PointPtr p, NDPtr nd, PosturePtr pose, double *g, double H[6][6], double qd3_d[6][3], double dist)
+{
+  return calc_summand3d_r(p, nd, g, H, qd3_d, qdd3, dist);
+}
+
 /*�ȤäƤʤ���*/
 int check_Hessian(double H[3][3])
 {
@@ -191,28 +218,114 @@ void depth(PointPtr scan, int num, PosturePtr pose)
   }
 }
 
+/*add the summand of a scan point to the slot*/
+static void add_summand3d(PointPtr scanptr, NDMapPtr nd_map, PosturePtr pose, int target, double sc[3][3],
+                          double sc_d[3][3][3], double sc_dd[3][3][3][3], AdjustSlot *slot)
+{
+  double g[6], hH[6][6];
+  double *work;
+  double x, y, z, dist;
+  NDPtr nd[8];
+  Point p;
+  int n, m, k;
+
+  /*���κ�ɸ�Ѵ��׻�*/
+  x = scanptr->x;
+  y = scanptr->y;
+  z = scanptr->z;
+  dist = 1;
+
+  p.x = x * sc[0][0] + y * sc[0][1] + z * sc[0][2] + pose->x;
+  p.y = x * sc[1][0] + y * sc[1][1] + z * sc[1][2] + pose->y;
+  p.z = x * sc[2][0] + y * sc[2][1] + z * sc[2][2] + pose->z;
+
+  /*�����б�����ND�ܥ�����������Ʊ���˼�������ND�ܥ�����򹹿���
+    �٤����Τ�Ĥ������Ӥ���Ĥ�Ĥ�����*/
+  if (!get_ND(nd_map, &p, nd, target))
+    return;
+
+  /*q�ΰ켡��ʬ(�Ѳ�������Τ�)*/
+  work = (double *)sc_d;
+  for (m = 0; m < 3; m++)
+  {
+    for (k = 0; k < 3; k++)
+    {
+      // qd3[txtytzabg][xyz]
+      slot->qd3[m + 3][k] = x * (*work) + y * (*(work + 1)) + z * (*(work + 2));
+      work += 3;
+    }
+  }
+
+  /*q������ʬ���Ѳ�������Τߡ�*/
+  work = (double *)sc_dd;
+  for (n = 0; n < 3; n++)
+  {
+    for (m = 0; m < 3; m++)
+    {
+      for (k = 0; k < 3; k++)
+      {
+        slot->qdd3[n + 3][m + 3][k] = (*work * x + *(work + 1) * y + *(work + 2) * z - slot->qd3[m + 3][k]) / E_THETA;
+        work += 3;
+      }
+    }
+  }
+
+  /*�����̷׻�*/
+  if (nd[0])
+  {
+    if (nd[0]->num > 10 && nd[0]->sign == 1)
+    {
+      slot->esum += calc_summand3d_r(&p, nd[0], g, hH, slot->qd3, slot->qdd3, dist);
+      add_matrix6d(slot->Hsumh, hH, slot->Hsumh);
+
+      slot->gsum[0] += g[0];
+      slot->gsum[1] += g[1];
+      slot->gsum[2] += g[2];
+      slot->gsum[3] += g[3];
+      slot->gsum[4] += g[4];
+      slot->gsum[5] += g[5];
+      slot->gnum += 1;
+    }
+  }
+}
+
+/*number of threads of adjust3d, 0 for all cores*/
+void set_adjust3d_threads(int num)
+{
+#ifdef _OPENMP
+  if (num <= 0)
+    num = omp_get_max_threads();
+#endif
+  adjust_thread_num = num > 0 ? num : 1;
+}
+
+int get_adjust3d_threads(void)
+{
+  return adjust_thread_num;
+}
+
 /*���ʬ�ν���*/
 double adjust3d(PointPtr scan, int num, PosturePtr initial, int target)
 {
   // double gsum[6], Hsum[6][6],Hsumh[6][6],Hinv[6][6],g[6],gd[6],ge[6][6],H[6][6],hH[6][6];
-  double gsum[6], Hsum[6][6], Hsumh[6][6], Hinv[6][6], g[6], H[6][6], hH[6][6];
+  double gsum[6], Hsum[6][6], Hsumh[6][6], Hinv[6][6], H[6][6];
   // double sc[3][3],sc_d[3][3][3],sc_dd[3][3][3][3],sce[3][3][3];
   double sc[3][3], sc_d[3][3][3], sc_dd[3][3][3][3];
   // double *work,*work2,*work3;
-  double *work;
   double esum = 0, gnum = 0;
-  NDPtr nd[8];
   NDMapPtr nd_map;
-  int i, j, n, m, k, layer;
-  double x, y, z;  //,sa,ca,sb,cb,sg,cg;
+  int i, n, m, k, layer = 0;
   PosturePtr pose;
-  // Point p,pe[6],pd;
-  Point p;
-  PointPtr scanptr;
   // int inc,count;
   int inc;
-  int ndmode;
-  double dist, weight_total, weight_sum, weight_next;
+  int ndmode = 0;
+  double weight_total, weight_sum, weight_next;
+  static int *selected = 0;
+  static int selected_size = 0;
+  int selected_num;
+  static AdjustSlot *slots = 0;
+  static int slots_size = 0;
+  int slot_num, slot_points;
 
   /*initialize*/
   gsum[0] = 0;
@@ -221,7 +334,6 @@ double adjust3d(PointPtr scan, int num, PosturePtr initial, int target)
   gsum[3] = 0;
   gsum[4] = 0;
   gsum[5] = 0;
-  j = 0;
   zero_matrix6d(Hsum);
   zero_matrix6d(Hsumh);
   pose = initial;
@@ -308,109 +420,29 @@ double adjust3d(PointPtr scan, int num, PosturePtr initial, int target)
   }
   //#endif
 
-  scanptr = scan;
-
-  /*����ˤĤ��Ʒ����֤��׻�*/
+  /*select the scan points, the weighted selection depends on the preceding points*/
+  if (selected_size < num)
+  {
+    free(selected);
+    selected = (int *)malloc(sizeof(int) * num);
+    selected_size = num;
+  }
+  selected_num = 0;
 
   //#if WEIGHTED_SELECT
   if (_downsampler_num == 0)
   {
     weight_total = scan_points_totalweight;
-    ;
     weight_next = 0;
     weight_sum = 0;
 
-    //  FILE *point_fp;
-    // point_fp=fopen("/tmp/range","w");
     for (i = 0; i < num; i++)
     {
       weight_sum += scan_points_weight[i];
       if (weight_sum < weight_next)
-      {
-        scanptr++;
         continue;
-      }
-
-      /*���κ�ɸ�Ѵ��׻�*/
-      x = scanptr->x;
-      y = scanptr->y;
-      z = scanptr->z;
-      //    fprintf(point_fp,"%f %f %f \n",x,y,z);
-
-      scanptr++;
+      selected[selected_num++] = i;
       weight_next += weight_total / (double)inc;  // 1000;
-      dist = 1;
-
-      p.x = x * sc[0][0] + y * sc[0][1] + z * sc[0][2] + pose->x;
-      p.y = x * sc[1][0] + y * sc[1][1] + z * sc[1][2] + pose->y;
-      p.z = x * sc[2][0] + y * sc[2][1] + z * sc[2][2] + pose->z;
-
-      /*���ϥ������ˤ�����������*/
-      if (ndmode == 1)
-        layer = 1;  // layer_select;
-      if (ndmode == 0)
-        layer = 0;  // layer_select;
-      nd_map = NDmap;
-
-      while (layer > 0)
-      {
-        if (nd_map->next)
-          nd_map = nd_map->next;
-        layer--;
-      }
-
-      /*�����б�����ND�ܥ�����������Ʊ���˼�������ND�ܥ�����򹹿���
-        �٤����Τ�Ĥ������Ӥ���Ĥ�Ĥ�����*/
-
-      if (!get_ND(nd_map, &p, nd, target))
-        continue;
-
-      /*q�ΰ켡��ʬ(�Ѳ�������Τ�)*/
-      work = (double *)sc_d;
-      for (m = 0; m < 3; m++)
-      {
-        for (k = 0; k < 3; k++)
-        {
-          // qd3[txtytzabg][xyz]
-          qd3[m + 3][k] = x * (*work) + y * (*(work + 1)) + z * (*(work + 2));
-          // x*sc_d[m][k][0] + y*sc_d[m][k][1] + z*sc_d[m][k][2];
-          work += 3;
-        }
-      }
-
-      /*q������ʬ���Ѳ�������Τߡ�*/
-      work = (double *)sc_dd;
-      for (n = 0; n < 3; n++)
-      {
-        for (m = 0; m < 3; m++)
-        {
-          for (k = 0; k < 3; k++)
-          {
-            qdd3[n + 3][m + 3][k] = (*work * x + *(work + 1) * y + *(work + 2) * z - qd3[m + 3][k]) / E_THETA;
-            work += 3;
-          }
-        }
-      }
-
-      /*�����̷׻�*/
-      if (nd[j])
-      {
-        if (nd[j]->num > 10 && nd[j]->sign == 1)
-        {
-          //	double e;
-          esum += calc_summand3d(&p, nd[j], pose, g, hH, qd3, dist);
-          add_matrix6d(Hsumh, hH, Hsumh);
-
-          //	  dist =1;
-          gsum[0] += g[0];                //*nd[j]->w;
-          gsum[1] += g[1];                //*nd[j]->w;
-          gsum[2] += g[2] + pose->z * 0;  //*nd[j]->w;
-          gsum[3] += g[3];                //*nd[j]->w;
-          gsum[4] += g[4];                //+(pose->theta2-(0.0))*1;//*nd[j]->w;
-          gsum[5] += g[5];                //*nd[j]->w;
-          gnum += 1;  // nd[j]->w;
-        }
-      }
     }
   }
 
@@ -418,90 +450,73 @@ double adjust3d(PointPtr scan, int num, PosturePtr initial, int target)
   if (_downsampler_num == 1)
   {
     for (i = 0; i < num; i += inc)
-    {
-      //    dist = (x*x+y*y+z*z);
-      // dist *= (1.2-exp(-1*(-1 - z)*(-1 - z)/4.0));
-      //    if(dist>2500)dist=2500;
-      /*���κ�ɸ�Ѵ��׻�*/
-      x = scanptr->x;
-      y = scanptr->y;
-      z = scanptr->z;
-      dist = 1;
-      scanptr += inc;
-
-      p.x = x * sc[0][0] + y * sc[0][1] + z * sc[0][2] + pose->x;
-      p.y = x * sc[1][0] + y * sc[1][1] + z * sc[1][2] + pose->y;
-      p.z = x * sc[2][0] + y * sc[2][1] + z * sc[2][2] + pose->z;
-
-      /*���ϥ������ˤ�����������*/
-      if (ndmode == 1)
-        layer = 1;  // layer_select;
-      if (ndmode == 0)
-        layer = 0;  // layer_select;
-      nd_map = NDmap;
-
-      while (layer > 0)
-      {
-        if (nd_map->next)
-          nd_map = nd_map->next;
-        layer--;
-      }
+      selected[selected_num++] = i;
+  }
+  //#endif
 
-      /*�����б�����ND�ܥ�����������Ʊ���˼�������ND�ܥ�����򹹿���
-        �٤����Τ�Ĥ������Ӥ���Ĥ�Ĥ�����*/
+  /*���ϥ������ˤ�����������*/
+  if (ndmode == 1)
+    layer = 1;  // layer_select;
+  if (ndmode == 0)
+    layer = 0;  // layer_select;
+  nd_map = NDmap;
 
-      if (!get_ND(nd_map, &p, nd, target))
-        continue;
+  while (layer > 0)
+  {
+    if (nd_map->next)
+      nd_map = nd_map->next;
+    layer--;
+  }
 
-      /*q�ΰ켡��ʬ(�Ѳ�������Τ�)*/
-      work = (double *)sc_d;
-      for (m = 0; m < 3; m++)
-      {
-        for (k = 0; k < 3; k++)
-        {
-          // qd3[txtytzabg][xyz]
-          qd3[m + 3][k] = x * (*work) + y * (*(work + 1)) + z * (*(work + 2));
-          // x*sc_d[m][k][0] + y*sc_d[m][k][1] + z*sc_d[m][k][2];
-          work += 3;
-        }
-      }
+  /*the threads only read the map*/
+  update_dirty_NDs();
 
-      /*q������ʬ���Ѳ�������Τߡ�*/
-      work = (double *)sc_dd;
-      for (n = 0; n < 3; n++)
-      {
-        for (m = 0; m < 3; m++)
-        {
-          for (k = 0; k < 3; k++)
-          {
-            qdd3[n + 3][m + 3][k] = (*work * x + *(work + 1) * y + *(work + 2) * z - qd3[m + 3][k]) / E_THETA;
-            work += 3;
-          }
-        }
-      }
+  slot_num = (selected_num + ADJUST_SLOT_POINTS - 1) / ADJUST_SLOT_POINTS;
+  if (slot_num < 1)
+    slot_num = 1;
+  if (slots_size < slot_num)
+  {
+    free(slots);
+    slots = (AdjustSlot *)malloc(sizeof(AdjustSlot) * slot_num);
+    slots_size = slot_num;
+  }
+  slot_points = ADJUST_SLOT_POINTS;
 
-      /*�����̷׻�*/
-      if (nd[j])
-      {
-        if (nd[j]->num > 10 && nd[j]->sign == 1)
-        {
-          //	double e;
-          esum += calc_summand3d(&p, nd[j], pose, g, hH, qd3, dist);
-          add_matrix6d(Hsumh, hH, Hsumh);
-
-          //	  dist =1;
-          gsum[0] += g[0];                //*nd[j]->w;
-          gsum[1] += g[1];                //*nd[j]->w;
-          gsum[2] += g[2] + pose->z * 0;  //*nd[j]->w;
-          gsum[3] += g[3];                //*nd[j]->w;
-          gsum[4] += g[4];                //+(pose->theta2-(0.0))*1;//*nd[j]->w;
-          gsum[5] += g[5];                //*nd[j]->w;
-          gnum += 1;  // nd[j]->w;
-        }
-      }
-    }
+  /*each slot owns a contiguous range of the selected points and its own accumulators*/
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(adjust_thread_num) schedule(static)
+#endif
+  for (int s = 0; s < slot_num; s++)
+  {
+    AdjustSlot *slot = &slots[s];
+    int begin = s * slot_points;
+    int end = begin + slot_points;
+
+    if (begin > selected_num)
+      begin = selected_num;
+    if (end > selected_num)
+      end = selected_num;
+
+    memset(slot->gsum, 0, sizeof(slot->gsum));
+    zero_matrix6d(slot->Hsumh);
+    slot->esum = 0;
+    slot->gnum = 0;
+    memcpy(slot->qd3, qd3, sizeof(qd3));
+    memcpy(slot->qdd3, qdd3, sizeof(qdd3));
+
+    for (int idx = begin; idx < end; idx++)
+      add_summand3d(scan + selected[idx], nd_map, pose, target, sc, sc_d, sc_dd, slot);
+  }
+
+  /*sum up in slot order, the result does not depend on the scheduling*/
+  for (i = 0; i < slot_num; i++)
+  {
+    for (k = 0; k < 6; k++)
+      gsum[k] += slots[i].gsum[k];
+    add_matrix6d(Hsumh, slots[i].Hsumh, Hsumh);
+    esum += slots[i].esum;
+    gnum += slots[i].gnum;
   }
-  //#endif
 
   if (gnum > 1)
   {
@@ -41,6 +41,7 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <memory>
 
 #include <ros/ros.h>
 #include <std_msgs/Bool.h>
@@ -68,6 +69,8 @@
 #include "autoware_msgs/ConfigNdtMapping.h"
 #include "autoware_msgs/ConfigNdtMappingOutput.h"
 
+#include "map_tile_writer.h"
+
 struct pose {
     double x;
     double y;
@@ -123,6 +126,12 @@ static std::vector<pcl::PointCloud<pcl::PointXYZI>> previous_scans;
 
 static bool _use_openmp = false;
 
+// Tiles of the map written while mapping, map then only holds the tiles around the vehicle.
+static std::string _map_tile_directory = "";
+static double _map_tile_size = 100.0;
+static double _map_tile_radius = 200.0;
+static std::unique_ptr<MapTileWriter> map_tile_writer;
+
 static double fitness_score;
 
 static void param_callback(const autoware_msgs::ConfigNdtMapping::ConstPtr& input)
@@ -175,6 +184,13 @@ static void output_callback(const autoware_msgs::ConfigNdtMappingOutput::ConstPt
 
   ndt_map_pub.publish(*map_msg_ptr);
 
+  // The tiles already hold the whole map, unfiltered.
+  if(map_tile_writer){
+    map_tile_writer->flush();
+    std::cout << "Saved " << map_tile_writer->getTileCount() << " tiles listed in " << map_tile_writer->getArealistPath() << "." << std::endl;
+    return;
+  }
+
   // Writing Point Cloud data to PCD file
   if(filter_res == 0.0){
     pcl::io::savePCDFileASCII(filename, *map_ptr);
@@ -221,6 +237,8 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
     if(initial_scan_loaded == 0){
       map += *scan_ptr;
       reference_map += *scan_ptr;
+      if(map_tile_writer)
+        map_tile_writer->add(*scan_ptr);
       initial_scan_loaded = 1;
     }
     
@@ -337,6 +355,12 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
     double shift = sqrt(pow(current_pose.x-added_pose.x, 2.0) + pow(current_pose.y-added_pose.y, 2.0));
     if(shift >= min_add_scan_shift){
       map += *transformed_scan_ptr;
+      if(map_tile_writer){
+        // Tiles left behind are written in the background and dropped from map
+        map_tile_writer->add(*transformed_scan_ptr);
+        if(map_tile_writer->spill(current_pose.x, current_pose.y))
+          map_tile_writer->getActiveMap(map);
+      }
 
       if(previous_scans.size() >= (unsigned int)REFERENCE_MAP_SIZE){
     	  previous_scans.erase(previous_scans.begin());
@@ -451,6 +475,15 @@ int main(int argc, char **argv)
     std::cout << "REFERENCE_MAP_SIZE: " << REFERENCE_MAP_SIZE << std::endl;
     private_nh.getParam("use_openmp", _use_openmp);
     std::cout << "use_openmp: " << _use_openmp << std::endl;
+    private_nh.getParam("map_tile_directory", _map_tile_directory);
+    std::cout << "map_tile_directory: " << _map_tile_directory << std::endl;
+    private_nh.getParam("map_tile_size", _map_tile_size);
+    std::cout << "map_tile_size: " << _map_tile_size << std::endl;
+    private_nh.getParam("map_tile_radius", _map_tile_radius);
+    std::cout << "map_tile_radius: " << _map_tile_radius << std::endl;
+
+    if(!_map_tile_directory.empty())
+      map_tile_writer.reset(new MapTileWriter(_map_tile_directory, _map_tile_size, _map_tile_radius));
 
     if (nh.getParam("tf_x", _tf_x) == false)
     {
@@ -511,5 +544,8 @@ int main(int argc, char **argv)
 
     ros::spin();
 
+    // Writes the remaining tiles
+    map_tile_writer.reset();
+
     return 0;
 }
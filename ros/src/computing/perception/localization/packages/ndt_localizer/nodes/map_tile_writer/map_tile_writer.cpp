@@ -0,0 +1,271 @@
+/*
+ *  Copyright (c) 2015, Nagoya University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of Autoware nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "map_tile_writer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+#include <pcl/io/pcd_io.h>
+
+MapTileWriter::MapTileWriter(const std::string& directory, double tile_size, double active_radius)
+  : directory_(directory)
+  , tile_size_(tile_size)
+  , active_radius_(active_radius)
+  , active_points_(0)
+  , busy_(false)
+  , stop_(false)
+{
+  if (!directory_.empty() && directory_[directory_.size() - 1] != '/')
+    directory_ += '/';
+  writer_ = std::thread(&MapTileWriter::writerLoop, this);
+}
+
+MapTileWriter::~MapTileWriter()
+{
+  flush();
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  queued_.notify_one();
+  writer_.join();
+}
+
+void MapTileWriter::add(const pcl::PointCloud<pcl::PointXYZI>& points)
+{
+  // Consecutive points mostly fall in the same tile
+  Tile* tile = NULL;
+  for (pcl::PointCloud<pcl::PointXYZI>::const_iterator item = points.begin(); item != points.end(); item++)
+  {
+    if (!std::isfinite(item->x) || !std::isfinite(item->y) || !std::isfinite(item->z))
+      continue;
+
+    int ix = static_cast<int>(std::floor(item->x / tile_size_));
+    int iy = static_cast<int>(std::floor(item->y / tile_size_));
+    if (tile == NULL || tile->ix != ix || tile->iy != iy)
+    {
+      std::map<std::pair<int, int>, Tile>::iterator it = tiles_.find(std::make_pair(ix, iy));
+      if (it == tiles_.end())
+      {
+        Tile new_tile;
+        new_tile.ix = ix;
+        new_tile.iy = iy;
+        new_tile.nr_written = 0;
+        new_tile.has_file = false;
+        new_tile.z_min = std::numeric_limits<float>::max();
+        new_tile.z_max = -std::numeric_limits<float>::max();
+        it = tiles_.insert(std::make_pair(std::make_pair(ix, iy), new_tile)).first;
+      }
+      tile = &it->second;
+      if (!tile->points)
+      {
+        tile->points.reset(new pcl::PointCloud<pcl::PointXYZI>);
+        tile->nr_written = 0;
+      }
+    }
+
+    tile->points->push_back(*item);
+    tile->z_min = std::min(tile->z_min, item->z);
+    tile->z_max = std::max(tile->z_max, item->z);
+    active_points_++;
+  }
+}
+
+bool MapTileWriter::spill(double x, double y)
+{
+  bool spilled = false;
+  for (std::map<std::pair<int, int>, Tile>::iterator it = tiles_.begin(); it != tiles_.end(); ++it)
+  {
+    Tile& tile = it->second;
+    if (!tile.points)
+      continue;
+
+    // Distance from (x, y) to the square of the tile
+    double x_min = tile.ix * tile_size_;
+    double y_min = tile.iy * tile_size_;
+    double dx = std::max(0.0, std::max(x_min - x, x - (x_min + tile_size_)));
+    double dy = std::max(0.0, std::max(y_min - y, y - (y_min + tile_size_)));
+    if (std::sqrt(dx * dx + dy * dy) <= active_radius_)
+      continue;
+
+    queueUnwritten(tile, true);
+    active_points_ -= tile.points->size();
+    tile.points.reset();
+    spilled = true;
+  }
+  return spilled;
+}
+
+void MapTileWriter::getActiveMap(pcl::PointCloud<pcl::PointXYZI>& map) const
+{
+  map.clear();
+  map.reserve(active_points_);
+  for (std::map<std::pair<int, int>, Tile>::const_iterator it = tiles_.begin(); it != tiles_.end(); ++it)
+  {
+    if (it->second.points)
+      map += *it->second.points;
+  }
+}
+
+void MapTileWriter::flush()
+{
+  for (std::map<std::pair<int, int>, Tile>::iterator it = tiles_.begin(); it != tiles_.end(); ++it)
+  {
+    if (it->second.points)
+      queueUnwritten(it->second, false);
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this] { return jobs_.empty() && !busy_; });
+  lock.unlock();
+
+  writeArealist();
+}
+
+size_t MapTileWriter::getActivePoints() const
+{
+  return active_points_;
+}
+
+size_t MapTileWriter::getTileCount() const
+{
+  return tiles_.size();
+}
+
+std::string MapTileWriter::getArealistPath() const
+{
+  return directory_ + "arealist.txt";
+}
+
+std::string MapTileWriter::tilePath(const Tile& tile) const
+{
+  // Named after the grid indices, the corners in meters are in arealist.txt
+  char name[64];
+  snprintf(name, sizeof(name), "%d_%d.pcd", tile.ix, tile.iy);
+  return directory_ + name;
+}
+
+// Queues the points of the tile that are not in its file yet. The writer thread gets its own cloud,
+// the one of the tile itself if it is dropped and nothing of it was written.
+void MapTileWriter::queueUnwritten(Tile& tile, bool drop)
+{
+  if (tile.nr_written == tile.points->size())
+    return;
+
+  WriteJob job;
+  job.path = tilePath(tile);
+  if (drop && tile.nr_written == 0)
+  {
+    job.points = tile.points;
+  }
+  else
+  {
+    job.points.reset(new pcl::PointCloud<pcl::PointXYZI>);
+    job.points->points.assign(tile.points->points.begin() + tile.nr_written, tile.points->points.end());
+    job.points->width = job.points->points.size();
+    job.points->height = 1;
+  }
+  job.append = tile.has_file;
+  tile.nr_written = tile.points->size();
+  tile.has_file = true;
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    jobs_.push_back(job);
+  }
+  queued_.notify_one();
+}
+
+// Same layout as points_map_loader: path,x_min,y_min,z_min,x_max,y_max,z_max per line.
+void MapTileWriter::writeArealist() const
+{
+  std::ofstream ofs(getArealistPath().c_str());
+  if (!ofs)
+  {
+    std::cout << "Couldn't write " << getArealistPath() << "." << std::endl;
+    return;
+  }
+  ofs << std::fixed;
+  ofs.precision(3);
+  for (std::map<std::pair<int, int>, Tile>::const_iterator it = tiles_.begin(); it != tiles_.end(); ++it)
+  {
+    const Tile& tile = it->second;
+    if (!tile.has_file)
+      continue;
+    // Rounded outwards so that the bounds printed in millimeters still contain every point
+    double z_min = std::floor(tile.z_min * 1000.0) / 1000.0;
+    double z_max = std::ceil(tile.z_max * 1000.0) / 1000.0;
+    ofs << tilePath(tile) << "," << tile.ix * tile_size_ << "," << tile.iy * tile_size_ << "," << z_min << ","
+        << (tile.ix + 1) * tile_size_ << "," << (tile.iy + 1) * tile_size_ << "," << z_max << std::endl;
+  }
+}
+
+void MapTileWriter::writerLoop()
+{
+  while (true)
+  {
+    WriteJob job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      queued_.wait(lock, [this] { return !jobs_.empty() || stop_; });
+      if (jobs_.empty())
+        return;
+      job = jobs_.front();
+      jobs_.pop_front();
+      busy_ = true;
+    }
+
+    // Binary compressed PCD files can't be appended to, a tile entered again is read back and rewritten
+    // whole, which costs O(tile) for each visit
+    if (job.append)
+    {
+      pcl::PointCloud<pcl::PointXYZI> written;
+      if (pcl::io::loadPCDFile<pcl::PointXYZI>(job.path, written) == -1)
+        std::cout << "Couldn't read " << job.path << ", its previous points are lost." << std::endl;
+      else
+        *job.points = written + *job.points;
+    }
+
+    if (pcl::io::savePCDFileBinaryCompressed(job.path, *job.points) != 0)
+      std::cout << "Couldn't write " << job.path << "." << std::endl;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      busy_ = false;
+      if (jobs_.empty())
+        idle_.notify_all();
+    }
+  }
+}
@@ -0,0 +1,115 @@
+/*
+ *  Copyright (c) 2015, Nagoya University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of Autoware nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MAP_TILE_WRITER_H
+#define MAP_TILE_WRITER_H
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+/*
+ Map sink of the mapping nodes writing square tiles to binary compressed PCD files.
+
+ Points are binned into the tiles of the points_map_loader grid (100 m by default). Tiles farther than the
+ active radius from the vehicle are handed to a writer thread and dropped from memory, so only the active
+ neighbourhood stays in RAM. A tile entered again gets its new points added to its file, which is read and
+ rewritten whole, so each visit costs O(points of the tile). The tiles are named ix_iy.pcd after their grid
+ indices and listed in arealist.txt of the output directory, which points_map_loader and ndt_matching
+ local_map_arealist read.
+ */
+class MapTileWriter
+{
+public:
+  MapTileWriter(const std::string& directory, double tile_size = 100.0, double active_radius = 200.0);
+  ~MapTileWriter();
+
+  // Adds points in map coordinates.
+  void add(const pcl::PointCloud<pcl::PointXYZI>& points);
+
+  // Writes and drops the tiles farther than the active radius from (x, y). Returns true if any tile was dropped.
+  bool spill(double x, double y);
+
+  // Gets the points of the tiles in memory.
+  void getActiveMap(pcl::PointCloud<pcl::PointXYZI>& map) const;
+
+  // Writes the points not written yet of every tile and arealist.txt, and waits for the writer thread.
+  void flush();
+
+  size_t getActivePoints() const;
+  size_t getTileCount() const;
+  std::string getArealistPath() const;
+
+private:
+  struct Tile
+  {
+    int ix, iy;
+    pcl::PointCloud<pcl::PointXYZI>::Ptr points;  // NULL when not in memory
+    size_t nr_written;                            // leading points of points already in the file
+    bool has_file;
+    float z_min, z_max;
+  };
+
+  struct WriteJob
+  {
+    std::string path;
+    pcl::PointCloud<pcl::PointXYZI>::Ptr points;
+    bool append;
+  };
+
+  std::string tilePath(const Tile& tile) const;
+  void queueUnwritten(Tile& tile, bool drop);
+  void writeArealist() const;
+  void writerLoop();
+
+  std::string directory_;
+  double tile_size_;
+  double active_radius_;
+
+  std::map<std::pair<int, int>, Tile> tiles_;
+  size_t active_points_;
+
+  std::thread writer_;
+  std::mutex mutex_;
+  std::condition_variable queued_;
+  std::condition_variable idle_;
+  std::deque<WriteJob> jobs_;
+  bool busy_;
+  bool stop_;
+};
+
+#endif  // MAP_TILE_WRITER_H
@@ -0,0 +1,110 @@
+/*
+ *  Copyright (c) 2015, Nagoya University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of Autoware nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+/*
+ Offline builder of the NDT voxel grid of a PCD map.
+
+ The grid is written in the binary format of VoxelGridCovariance::saveLeaves and is
+ loaded by ndt_matching through its voxel_grid_file param. The map must be in the
+ frame ndt_matching matches in (use_local_transform is not applied to the file).
+
+ Usage: rosrun ndt_localizer ndt_grid_writer OUTPUT resolution MAP.pcd [MAP.pcd ...]
+ */
+
+#include <iostream>
+#include <string>
+#include <chrono>
+
+#include <pcl/io/pcd_io.h>
+#include <pcl/point_types.h>
+
+#include <fast_pcl/registration/ndt.h>
+
+typedef pcl::NormalDistributionsTransform<pcl::PointXYZ, pcl::PointXYZ> NDT;
+
+static double elapsed_ms(const std::chrono::time_point<std::chrono::system_clock>& start)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start).count() /
+         1000.0;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 4)
+  {
+    std::cout << "Usage: rosrun ndt_localizer ndt_grid_writer OUTPUT resolution MAP.pcd [MAP.pcd ...]" << std::endl;
+    return 1;
+  }
+
+  std::string output = argv[1];
+  float resolution = std::stof(argv[2]);
+
+  // Concatenate the map files, as points_map_loader does
+  pcl::PointCloud<pcl::PointXYZ>::Ptr map_ptr(new pcl::PointCloud<pcl::PointXYZ>);
+  for (int i = 3; i < argc; i++)
+  {
+    pcl::PointCloud<pcl::PointXYZ> part;
+    if (pcl::io::loadPCDFile<pcl::PointXYZ>(argv[i], part) == -1)
+    {
+      std::cout << "Couldn't read " << argv[i] << "." << std::endl;
+      return 1;
+    }
+    *map_ptr += part;
+  }
+  std::cout << "Map: " << map_ptr->size() << " points, resolution: " << resolution << std::endl;
+
+  std::chrono::time_point<std::chrono::system_clock> start = std::chrono::system_clock::now();
+  NDT ndt;
+  ndt.setNeighborSearchMethod(NDT::DIRECT7);
+  ndt.setResolution(resolution);
+  ndt.setInputTarget(map_ptr);
+  std::cout << "Built voxel grid in " << elapsed_ms(start) << " ms." << std::endl;
+
+  if (!ndt.saveTargetCells(output))
+  {
+    std::cout << "Couldn't write " << output << "." << std::endl;
+    return 1;
+  }
+
+  // Load it back as ndt_matching would
+  start = std::chrono::system_clock::now();
+  NDT loaded;
+  loaded.setNeighborSearchMethod(NDT::DIRECT7);
+  loaded.setLeafStorage(pcl::VoxelGridCovariance<pcl::PointXYZ>::LEAF_STORAGE_HASH);
+  if (!loaded.loadTargetCells(output))
+  {
+    std::cout << "Couldn't load " << output << " back." << std::endl;
+    return 1;
+  }
+  std::cout << "Wrote " << output << ", loads in " << elapsed_ms(start) << " ms." << std::endl;
+
+  return 0;
+}
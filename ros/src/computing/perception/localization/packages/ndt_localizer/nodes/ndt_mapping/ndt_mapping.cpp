@@ -40,6 +40,7 @@
 #include <sstream>
 #include <fstream>
 #include <string>
+#include <memory>
 
 #include <ros/ros.h>
 #include <std_msgs/Bool.h>
@@ -69,6 +70,8 @@
 #include <autoware_msgs/ConfigNdtMapping.h>
 #include <autoware_msgs/ConfigNdtMappingOutput.h>
 
+#include "map_tile_writer.h"
+
 struct pose
 {
   double x;
@@ -142,6 +145,24 @@ static bool _imu_upside_down = false;
 
 static std::string _imu_topic = "/imu_raw";
 
+// Tiles of the map written while mapping, map then only holds the tiles around the vehicle.
+static std::string _map_tile_directory = "";
+static double _map_tile_size = 100.0;
+static double _map_tile_radius = 200.0;
+static std::unique_ptr<MapTileWriter> map_tile_writer;
+
+#ifdef USE_FAST_PCL
+// Options of fast_pcl. The incremental update folds each added scan into the voxels it falls in
+// instead of rebuilding the target from the whole map.
+static bool _incremental_voxel_update = false;
+static bool _use_voxel_hash = false;
+static std::string _neighbor_search = "kdtree";  // kdtree, direct1, direct7, direct27
+// With the incremental update, the whole map is only published when it changed, at most every interval.
+static double _map_publish_interval = 10.0;  // [s]
+static bool map_publish_pending = true;
+static ros::Time map_publish_time;
+#endif
+
 
 static double fitness_score;
 
@@ -202,6 +223,15 @@ static void output_callback(const autoware_msgs::ConfigNdtMappingOutput::ConstPt
 
   ndt_map_pub.publish(*map_msg_ptr);
 
+  // The tiles already hold the whole map, unfiltered.
+  if (map_tile_writer)
+  {
+    map_tile_writer->flush();
+    std::cout << "Saved " << map_tile_writer->getTileCount() << " tiles listed in "
+              << map_tile_writer->getArealistPath() << "." << std::endl;
+    return;
+  }
+
   // Writing Point Cloud data to PCD file
   if (filter_res == 0.0)
   {
@@ -482,6 +512,8 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
   {
     pcl::transformPointCloud(*scan_ptr, *transformed_scan_ptr, tf_btol);
     map += *transformed_scan_ptr;
+    if (map_tile_writer)
+      map_tile_writer->add(*transformed_scan_ptr);
     initial_scan_loaded = 1;
   }
 
@@ -491,16 +523,20 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
   voxel_grid_filter.setInputCloud(scan_ptr);
   voxel_grid_filter.filter(*filtered_scan_ptr);
 
-  pcl::PointCloud<pcl::PointXYZI>::Ptr map_ptr(new pcl::PointCloud<pcl::PointXYZI>(map));
-  
   ndt.setTransformationEpsilon(trans_eps);
   ndt.setStepSize(step_size);
+#ifdef USE_FAST_PCL
+  // The voxels updated incrementally are only valid at their resolution, a new one needs the whole map.
+  if (_incremental_voxel_update == true && ndt.getResolution() != ndt_res)
+    isMapUpdate = true;
+#endif
   ndt.setResolution(ndt_res);
   ndt.setMaximumIterations(max_iter);
   ndt.setInputSource(filtered_scan_ptr);
 
   if (isMapUpdate == true)
   {
+    pcl::PointCloud<pcl::PointXYZI>::Ptr map_ptr(new pcl::PointCloud<pcl::PointXYZI>(map));
     ndt.setInputTarget(map_ptr);
     isMapUpdate = false;
   }
@@ -547,18 +583,22 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
 
   pcl::PointCloud<pcl::PointXYZI>::Ptr output_cloud(new pcl::PointCloud<pcl::PointXYZI>);
 #ifdef USE_FAST_PCL
+  // The fitness score needs a kdtree over the whole target, which every incremental update would invalidate.
   if (_use_openmp == true)
   {
     ndt.omp_align(*output_cloud, init_guess);
-    fitness_score = ndt.omp_getFitnessScore();
+    if (_incremental_voxel_update == false)
+      fitness_score = ndt.omp_getFitnessScore();
   }
   else
   {
-#endif
     ndt.align(*output_cloud, init_guess);
-    fitness_score = ndt.getFitnessScore();
-#ifdef USE_FAST_PCL
+    if (_incremental_voxel_update == false)
+      fitness_score = ndt.getFitnessScore();
   }
+#else
+  ndt.align(*output_cloud, init_guess);
+  fitness_score = ndt.getFitnessScore();
 #endif
 
   t_localizer = ndt.getFinalTransformation();
@@ -682,18 +722,47 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
   if (shift >= min_add_scan_shift)
   {
     map += *transformed_scan_ptr;
+    if (map_tile_writer)
+    {
+      // Tiles left behind are written in the background and dropped from map
+      map_tile_writer->add(*transformed_scan_ptr);
+      if (map_tile_writer->spill(current_pose.x, current_pose.y))
+        map_tile_writer->getActiveMap(map);
+    }
     added_pose.x = current_pose.x;
     added_pose.y = current_pose.y;
     added_pose.z = current_pose.z;
     added_pose.roll = current_pose.roll;
     added_pose.pitch = current_pose.pitch;
     added_pose.yaw = current_pose.yaw;
-    isMapUpdate = true;
+#ifdef USE_FAST_PCL
+    if (_incremental_voxel_update == true)
+    {
+      // Only the voxels the scan falls in are updated.
+      ndt.addInputTarget(transformed_scan_ptr);
+      map_publish_pending = true;
+    }
+    else
+#endif
+      isMapUpdate = true;
   }
 
-  sensor_msgs::PointCloud2::Ptr map_msg_ptr(new sensor_msgs::PointCloud2);
-  pcl::toROSMsg(*map_ptr, *map_msg_ptr);
-  ndt_map_pub.publish(*map_msg_ptr);
+  bool publish_map = true;
+#ifdef USE_FAST_PCL
+  if (_incremental_voxel_update == true)
+    publish_map = map_publish_pending == true &&
+                  (map_publish_time.isZero() || (current_scan_time - map_publish_time).toSec() >= _map_publish_interval);
+#endif
+  if (publish_map == true)
+  {
+    sensor_msgs::PointCloud2::Ptr map_msg_ptr(new sensor_msgs::PointCloud2);
+    pcl::toROSMsg(map, *map_msg_ptr);
+    ndt_map_pub.publish(*map_msg_ptr);
+#ifdef USE_FAST_PCL
+    map_publish_pending = false;
+    map_publish_time = current_scan_time;
+#endif
+  }
 
   q.setRPY(current_pose.roll, current_pose.pitch, current_pose.yaw);
   current_pose_msg.header.frame_id = "map";
@@ -716,7 +785,12 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
   std::cout << "transformed_scan_ptr: " << transformed_scan_ptr->points.size() << " points." << std::endl;
   std::cout << "map: " << map.points.size() << " points." << std::endl;
   std::cout << "NDT has converged: " << ndt.hasConverged() << std::endl;
-  std::cout << "Fitness score: " << fitness_score << std::endl;
+#ifdef USE_FAST_PCL
+  if (_incremental_voxel_update == true)
+    std::cout << "Transformation probability: " << ndt.getTransformationProbability() << std::endl;
+  else
+#endif
+    std::cout << "Fitness score: " << fitness_score << std::endl;
   std::cout << "Number of iteration: " << ndt.getFinalNumIteration() << std::endl;
   std::cout << "(x,y,z,roll,pitch,yaw):" << std::endl;
   std::cout << "(" << current_pose.x << ", " << current_pose.y << ", " << current_pose.z << ", " << current_pose.roll
@@ -816,6 +890,50 @@ int main(int argc, char** argv)
 
   std::cout << "imu_topic: " << _imu_topic << std::endl;
 
+  private_nh.getParam("map_tile_directory", _map_tile_directory);
+  private_nh.getParam("map_tile_size", _map_tile_size);
+  private_nh.getParam("map_tile_radius", _map_tile_radius);
+
+  std::cout << "map_tile_directory: " << _map_tile_directory << std::endl;
+  std::cout << "map_tile_size: " << _map_tile_size << std::endl;
+  std::cout << "map_tile_radius: " << _map_tile_radius << std::endl;
+
+  if (!_map_tile_directory.empty())
+    map_tile_writer.reset(new MapTileWriter(_map_tile_directory, _map_tile_size, _map_tile_radius));
+
+#ifdef USE_FAST_PCL
+  private_nh.getParam("incremental_voxel_update", _incremental_voxel_update);
+  private_nh.getParam("use_voxel_hash", _use_voxel_hash);
+  private_nh.getParam("neighbor_search", _neighbor_search);
+  private_nh.getParam("map_publish_interval", _map_publish_interval);
+
+  std::cout << "incremental_voxel_update: " << _incremental_voxel_update << std::endl;
+  std::cout << "use_voxel_hash: " << _use_voxel_hash << std::endl;
+  std::cout << "neighbor_search: " << _neighbor_search << std::endl;
+  std::cout << "map_publish_interval: " << _map_publish_interval << std::endl;
+
+  // Hashed voxels and direct lookups keep the cost of an incremental update independent of the map size.
+  if (_use_voxel_hash == true)
+    ndt.setLeafStorage(pcl::VoxelGridCovariance<pcl::PointXYZI>::LEAF_STORAGE_HASH);
+
+  if (_neighbor_search == "direct1")
+  {
+    ndt.setNeighborSearchMethod(pcl::NormalDistributionsTransform<pcl::PointXYZI, pcl::PointXYZI>::DIRECT1);
+  }
+  else if (_neighbor_search == "direct7")
+  {
+    ndt.setNeighborSearchMethod(pcl::NormalDistributionsTransform<pcl::PointXYZI, pcl::PointXYZI>::DIRECT7);
+  }
+  else if (_neighbor_search == "direct27")
+  {
+    ndt.setNeighborSearchMethod(pcl::NormalDistributionsTransform<pcl::PointXYZI, pcl::PointXYZI>::DIRECT27);
+  }
+  else if (_neighbor_search != "kdtree")
+  {
+    std::cout << "Unknown neighbor_search " << _neighbor_search << ", using kdtree." << std::endl;
+  }
+#endif
+
   if (nh.getParam("tf_x", _tf_x) == false)
   {
     std::cout << "tf_x is not set." << std::endl;
@@ -875,5 +993,8 @@ int main(int argc, char** argv)
 
   ros::spin();
 
+  // Writes the remaining tiles
+  map_tile_writer.reset();
+
   return 0;
 }
@@ -4,7 +4,7 @@
   2005/4/24 tku
 */
 
-// number of cells
+// number of cells of the dense grid nd map files without header were written with
 #define G_MAP_X 2000
 #define G_MAP_Y 2000
 #define G_MAP_Z 200
@@ -16,6 +16,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <string>
 #include <unistd.h>
 #include <math.h>
@@ -555,6 +556,8 @@ br.sendTransform(tf::StampedTransform(transform, ros::Time::now(),  "world", "nd
 int add_point_covariance(NDPtr nd, PointPtr p)
 {
   /*add data num*/
+  if (nd->flag || nd->num == 0)
+    mark_ND_dirty(nd); /*updated before matching*/
   nd->num++;
   nd->flag = 0; /*need to update*/
   // printf("%d \n",nd->num);
@@ -625,11 +628,15 @@ int update_covariance(NDPtr nd)
   return 1;
 }
 
+/*voxels sharing the point, (x,y,z) first*/
+static const int nd_offset[8][3] = { { 0, 0, 0 },   { -1, 0, 0 },  { 0, -1, 0 },  { -1, -1, 0 },
+                                     { 0, 0, -1 },  { -1, 0, -1 }, { 0, -1, -1 }, { -1, -1, -1 } };
+
 /*add point to ndmap*/
 int add_point_map(NDMapPtr ndmap, PointPtr point)
 {
   int x, y, z, i;
-  NDPtr *ndp[8];
+  NDPtr *ndp;
 
   /*
 
@@ -642,35 +649,16 @@ int add_point_map(NDMapPtr ndmap, PointPtr point)
   */
 
   /*mapping*/
-  x = (point->x / ndmap->size) + ndmap->x / 2;
-  y = (point->y / ndmap->size) + ndmap->y / 2;
-  z = (point->z / ndmap->size) + ndmap->z / 2;
-
-  /*clipping*/
-  if (x < 1 || x >= ndmap->x)
-    return 0;
-  if (y < 1 || y >= ndmap->y)
+  if (!ND_cell_index(point->x, ndmap->size, 0, &x) || !ND_cell_index(point->y, ndmap->size, 0, &y) ||
+      !ND_cell_index(point->z, ndmap->size, 0, &z))
     return 0;
-  if (z < 1 || z >= ndmap->z)
-    return 0;
-
-  /*select root ND*/
-  ndp[0] = ndmap->nd + x * ndmap->to_x + y * ndmap->to_y + z;
-  ndp[1] = ndp[0] - ndmap->to_x;
-  ndp[2] = ndp[0] - ndmap->to_y;
-  ndp[4] = ndp[0] - 1;
-  ndp[3] = ndp[2] - ndmap->to_x;
-  ndp[5] = ndp[4] - ndmap->to_x;
-  ndp[6] = ndp[4] - ndmap->to_y;
-  ndp[7] = ndp[3] - 1;
 
   /*add  point to map */
   for (i = 0; i < 8; i++)
   {
-    if ((*ndp[i]) == 0)
-      *ndp[i] = add_ND();
-    if ((*ndp[i]) != 0)
-      add_point_covariance(*ndp[i], point);
+    ndp = find_ND_cell(ndmap, x + nd_offset[i][0], y + nd_offset[i][1], z + nd_offset[i][2], 1);
+    if (ndp)
+      add_point_covariance(*ndp, point);
   }
 
   if (ndmap->next)
@@ -686,7 +674,8 @@ int get_ND(NDMapPtr ndmap, PointPtr point, NDPtr *nd, int ndmode)
 {
   int x, y, z;
   int i;
-  NDPtr *ndp[8];
+  double shift;
+  NDPtr *ndp;
 
   /*
     
@@ -705,43 +694,22 @@ int get_ND(NDMapPtr ndmap, PointPtr point, NDPtr *nd, int ndmode)
      */
   /*mapping*/
   if (ndmode < 3)
-  {
-    x = (double)((point->x / ndmap->size) + ndmap->x / 2 - 0.5);
-    y = (double)((point->y / ndmap->size) + ndmap->y / 2 - 0.5);
-    z = (double)((point->z / ndmap->size) + ndmap->z / 2 - 0.5);
-  }
+    shift = -0.5;
   else
-  {
-    x = (point->x / ndmap->size) + ndmap->x / 2;
-    y = (point->y / ndmap->size) + ndmap->y / 2;
-    z = (point->z / ndmap->size) + ndmap->z / 2;
-  }
+    shift = 0;
 
-  /*clipping*/
-  if (x < 1 || x >= ndmap->x)
-    return 0;
-  if (y < 1 || y >= ndmap->y)
+  if (!ND_cell_index(point->x, ndmap->size, shift, &x) || !ND_cell_index(point->y, ndmap->size, shift, &y) ||
+      !ND_cell_index(point->z, ndmap->size, shift, &z))
     return 0;
-  if (z < 1 || z >= ndmap->z)
-    return 0;
-
-  /*select root ND*/
-  ndp[0] = ndmap->nd + x * ndmap->to_x + y * ndmap->to_y + z;
-  ndp[1] = ndp[0] - ndmap->to_x;
-  ndp[2] = ndp[0] - ndmap->to_y;
-  ndp[4] = ndp[0] - 1;
-  ndp[3] = ndp[2] - ndmap->to_x;
-  ndp[5] = ndp[4] - ndmap->to_x;
-  ndp[6] = ndp[4] - ndmap->to_y;
-  ndp[7] = ndp[3] - 1;
 
   for (i = 0; i < 8; i++)
   {
-    if (*ndp[i] != 0)
+    ndp = find_ND_cell(ndmap, x + nd_offset[i][0], y + nd_offset[i][1], z + nd_offset[i][2], 0);
+    if (ndp && *ndp != 0)
     {
-      if (!(*ndp[i])->flag)
-        update_covariance(*ndp[i]);
-      nd[i] = *ndp[i];
+      if (!(*ndp)->flag)
+        update_covariance(*ndp);
+      nd[i] = *ndp;
     }
     else
     {
@@ -758,13 +726,12 @@ NDPtr add_ND(void)
   NDPtr ndp;
   // int m;
 
-  if (NDs_num >= MAX_ND_NUM)
+  ndp = alloc_ND();
+  if (!ndp)
   {
     printf("over flow\n");
     return 0;
   }
-
-  ndp = NDs + NDs_num;
   NDs_num++;
 
   ndp->flag = 0;
@@ -787,51 +754,8 @@ NDPtr add_ND(void)
 
 NDMapPtr initialize_NDmap_layer(int layer, NDMapPtr child)
 {
-  // int i,j,k,i2,i3,m;
-  int i, j, k;
-  int x, y, z;
-  NDPtr *nd, *ndp;
-  NDMapPtr ndmap;
-
-  //  i2 = i3 = 0;
-  //  printf("Initializing...layer %d\n",layer);
-
-  x = (g_map_x >> layer) + 1;
-  y = (g_map_y >> layer) + 1;
-  z = (g_map_z >> layer) + 1;
-
-  /*����γ��ݡ�*/
-  nd = (NDPtr *)malloc(x * y * z * sizeof(NDPtr));
-  ndmap = (NDMapPtr)malloc(sizeof(NDMap));
-
-  ndmap->x = x;
-  ndmap->y = y;
-  ndmap->z = z;
-  ndmap->to_x = y * z;
-  ndmap->to_y = z;
-  ndmap->layer = layer;
-  ndmap->nd = nd;
-  ndmap->next = child;
-  ndmap->size = g_map_cellsize * ((int)1 << layer);
-  //  printf("size %f\n",ndmap->size);
-
-  ndp = nd;
-
-  /*�쥤�䡼�ν��*/
-  for (i = 0; i < x; i++)
-  {
-    for (j = 0; j < y; j++)
-    {
-      for (k = 0; k < z; k++)
-      {
-        *ndp = 0;
-        ndp++;
-      }
-    }
-  }
-
-  /*�쥤�䡼�֤�Ϣ�롩*/
-  return ndmap;
+  /*voxels are allocated as points come, no extent needed*/
+  return create_NDmap_layer(layer, g_map_cellsize * ((int)1 << layer), child);
 }
 
 /*ND�ܥ�����ν��*/
@@ -839,16 +763,13 @@ NDMapPtr initialize_NDmap(void)
 {
   int i;
   NDMapPtr ndmap;
-  NDPtr null_nd;
 
   printf("Initialize NDmap\n");
   ndmap = 0;
 
-  // init NDs
-  NDs = (NDPtr)malloc(sizeof(NormalDistribution) * MAX_ND_NUM);
+  // init NDs, the first one stands for empty voxels
   NDs_num = 0;
-
-  null_nd = add_ND();
+  NDs = add_ND();
 
   for (i = LAYER_NUM - 1; i >= 0; i--)
   {
@@ -949,10 +870,11 @@ void load(char *name)
 
 void save_nd_map(char *name)
 {
-  int i, j, k, layer;
+  int i, layer;
   NDData nddat;
+  NDMapHeader header;
   NDMapPtr ndmap;
-  NDPtr *ndp;
+  NDPtr ndp;
   FILE *ofp;
 
   // for pcd
@@ -967,38 +889,45 @@ void save_nd_map(char *name)
 
   ndmap = NDmap;
   ofp = fopen(name, "w");
+  if (!ofp)
+  {
+    printf("Couldn't write %s\n", name);
+    return;
+  }
 
-  for (layer = 0; layer < 2; layer++)
+  // origin and voxel size of the map
+  memset(&header, 0, sizeof(NDMapHeader));
+  strcpy(header.magic, ND_MAP_MAGIC);
+  header.center_x = g_map_center_x;
+  header.center_y = g_map_center_y;
+  header.center_z = g_map_center_z;
+  header.rotation = g_map_rotation;
+  header.cellsize = g_map_cellsize;
+  header.layer_num = LAYER_NUM;
+  fwrite(&header, sizeof(NDMapHeader), 1, ofp);
+
+  for (layer = 0; layer < LAYER_NUM; layer++)
   {
-    ndp = ndmap->nd;
-    /*�쥤�䡼�ν��*/
-    for (i = 0; i < ndmap->x; i++)
+    for (i = 0; i < ndmap->cell_size; i++)
     {
-      for (j = 0; j < ndmap->y; j++)
+      ndp = ndmap->cell[i].nd;
+      if (ndp)
       {
-        for (k = 0; k < ndmap->z; k++)
-        {
-          if (*ndp)
-          {
-            update_covariance(*ndp);
-            nddat.nd = **ndp;
-            nddat.x = i;
-            nddat.y = j;
-            nddat.z = k;
-            nddat.layer = layer;
-
-            fwrite(&nddat, sizeof(NDData), 1, ofp);
-
-            // regist the point to pcd data;
-            p.x = (*ndp)->mean.x;
-            p.y = (*ndp)->mean.y;
-            p.z = (*ndp)->mean.z;
-            cloud.points.push_back(p);
-          }
-          ndp++;
-        }
+        update_covariance(ndp);
+        nddat.nd = *ndp;
+        nddat.x = ndmap->cell[i].x;
+        nddat.y = ndmap->cell[i].y;
+        nddat.z = ndmap->cell[i].z;
+        nddat.layer = layer;
+
+        fwrite(&nddat, sizeof(NDData), 1, ofp);
+
+        // regist the point to pcd data;
+        p.x = ndp->mean.x;
+        p.y = ndp->mean.y;
+        p.z = ndp->mean.z;
+        cloud.points.push_back(p);
       }
-      //      printf("a\n");
     }
     ndmap = ndmap->next;
   }
@@ -1055,23 +984,70 @@ int load_nd_map(char *name)
 {
   //  int i,j,k,layer;
   NDData nddat;
-  NDMapPtr ndmap[2];
-  NDPtr ndp;
+  NDMapHeader header;
+  NDMapPtr ndmap[LAYER_NUM];
+  NDPtr ndp, *cell;
+  int layer, offset[LAYER_NUM][3];
   FILE *ifp;
   //  FILE *logfp;
 
-  ndmap[0] = NDmap;
-  ndmap[1] = NDmap->next;
-
   ifp = fopen(name, "r");
   if (!ifp)
     return 0;
 
+  ndmap[0] = NDmap;
+  for (layer = 1; layer < LAYER_NUM; layer++)
+    ndmap[layer] = ndmap[layer - 1]->next;
+
+  if (fread(&header, sizeof(NDMapHeader), 1, ifp) == 1 &&
+      strncmp(header.magic, ND_MAP_MAGIC, sizeof(header.magic)) == 0)
+  {
+    if (header.layer_num != LAYER_NUM)
+    {
+      printf("%s has %d layers, %d expected\n", name, header.layer_num, LAYER_NUM);
+      fclose(ifp);
+      return 0;
+    }
+
+    // the map sets the origin and the voxel size
+    g_map_center_x = header.center_x;
+    g_map_center_y = header.center_y;
+    g_map_center_z = header.center_z;
+    g_map_rotation = header.rotation;
+    g_map_cellsize = header.cellsize;
+    for (layer = 0; layer < LAYER_NUM; layer++)
+    {
+      ndmap[layer]->size = g_map_cellsize * ((int)1 << layer);
+      offset[layer][0] = offset[layer][1] = offset[layer][2] = 0;
+    }
+  }
+  else
+  {
+    // no header, indices of the dense grid centered at the current origin
+    rewind(ifp);
+    for (layer = 0; layer < LAYER_NUM; layer++)
+    {
+      offset[layer][0] = ((g_map_x >> layer) + 1) / 2;
+      offset[layer][1] = ((g_map_y >> layer) + 1) / 2;
+      offset[layer][2] = ((g_map_z >> layer) + 1) / 2;
+    }
+  }
+
   while (fread(&nddat, sizeof(NDData), 1, ifp) > 0)
   {
-    ndp = add_ND();
+    if (nddat.layer < 0 || nddat.layer >= LAYER_NUM)
+      continue;
+    layer = nddat.layer;
+    /*the first ND of a voxel wins*/
+    if (find_ND_cell(ndmap[layer], nddat.x - offset[layer][0], nddat.y - offset[layer][1],
+                     nddat.z - offset[layer][2], 0))
+      continue;
+    cell = find_ND_cell(ndmap[layer], nddat.x - offset[layer][0], nddat.y - offset[layer][1],
+                        nddat.z - offset[layer][2], 1);
+    if (!cell)
+      break;
+    ndp = *cell;
     *ndp = nddat.nd;
-    *(ndmap[nddat.layer]->nd + nddat.x * ndmap[nddat.layer]->to_x + nddat.y * ndmap[nddat.layer]->to_y + nddat.z) = ndp;
     ndp->flag = 0;
     update_covariance(ndp);
     // fprintf(logfp,"%f %f %f \n",ndp->mean.x, ndp->mean.y, ndp->mean.z);
@@ -39,6 +39,14 @@
 #include <fstream>
 #include <string>
 #include <chrono>
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+#include <boost/shared_ptr.hpp>
 
 #include <ros/ros.h>
 #include <std_msgs/Float32.h>
@@ -114,6 +122,36 @@ static float ndt_res = 1.0;      // Resolution
 static double step_size = 0.1;   // Step size
 static double trans_eps = 0.01;  // Transformation epsilon
 
+// Sliding-window local map, built by local_map_thread and swapped in by points_callback
+struct local_map_tile
+{
+  std::string path;
+  double x_min;
+  double y_min;
+  double x_max;
+  double y_max;
+};
+
+struct local_map_request
+{
+  double x;
+  double y;
+  int max_iter;
+  float ndt_res;
+  double step_size;
+  double trans_eps;
+};
+
+static std::vector<local_map_tile> local_map_tiles;
+static std::mutex local_map_mutex;
+static std::condition_variable local_map_cv;
+static bool local_map_requested = false;  // A request is waiting for or being processed by local_map_thread
+static bool local_map_rebuild = false;    // NDT parameters changed since the active local map was built
+static bool local_map_shutdown = false;   // Makes local_map_thread return, set when the node exits
+static local_map_request local_map_next_request;
+static double local_map_center_x, local_map_center_y;
+static boost::shared_ptr<pcl::NormalDistributionsTransform<pcl::PointXYZ, pcl::PointXYZ> > local_ndt, local_ndt_ready;
+
 static ros::Publisher predict_pose_pub;
 static geometry_msgs::PoseStamped predict_pose_msg;
 
@@ -199,6 +237,13 @@ static ros::Publisher ndt_reliability_pub;
 static std_msgs::Float32 ndt_reliability;
 
 static bool _use_openmp = false;
+static bool _use_voxel_hash = false;
+static std::string _neighbor_search = "kdtree";  // kdtree, direct1, direct7, direct27
+static bool _use_batched_derivatives = false;
+static std::string _voxel_grid_file = "";  // Written by ndt_grid_writer, replaces points_map if set
+static std::string _local_map_arealist = "";  // arealist.txt of points_map_loader, replaces points_map if set
+static double _local_map_radius = 200.0;       // Tiles closer than this to the vehicle form the local map
+static double _local_map_update_distance = 20.0;  // Rebuild the local map after moving this far
 static bool _get_height = false;
 static bool _use_local_transform = false;
 static bool _use_imu = false;
@@ -217,6 +262,15 @@ static nav_msgs::Odometry odom;
 // static tf::TransformListener local_transform_listener;
 static tf::StampedTransform local_transform;
 
+// Makes update_local_map request a local map around current_pose, after it was set or jumped.
+static void request_local_map_rebuild()
+{
+  if (_local_map_arealist.empty())
+    return;
+  std::unique_lock<std::mutex> lock(local_map_mutex);
+  local_map_rebuild = true;
+}
+
 static void param_callback(const autoware_msgs::ConfigNdt::ConstPtr& input)
 {
   if (_use_gnss != input->init_pos_gnss)
@@ -233,7 +287,13 @@ static void param_callback(const autoware_msgs::ConfigNdt::ConstPtr& input)
   _use_gnss = input->init_pos_gnss;
 
   // Setting parameters
-  if (input->resolution != ndt_res)
+  // The resolution of a precomputed voxel grid is fixed by the file, ndt_res stays the one in use.
+  if (input->resolution != ndt_res && !_voxel_grid_file.empty())
+  {
+    std::cout << "resolution " << input->resolution << " ignored, " << _voxel_grid_file << " has resolution "
+              << ndt_res << "." << std::endl;
+  }
+  else if (input->resolution != ndt_res)
   {
     ndt_res = input->resolution;
     ndt.setResolution(ndt_res);
@@ -254,6 +314,9 @@ static void param_callback(const autoware_msgs::ConfigNdt::ConstPtr& input)
     ndt.setMaximumIterations(max_iter);
   }
 
+  // The local map is rebuilt with the new parameters, and around the initial pose if it is set below
+  request_local_map_rebuild();
+
   if (_use_gnss == 0 && init_pos_set == 0)
   {
     initial_pose.x = input->x;
@@ -326,9 +389,36 @@ static void param_callback(const autoware_msgs::ConfigNdt::ConstPtr& input)
   }
 }
 
+#ifdef USE_FAST_PCL
+// Options of fast_pcl given as params, to be set before the target.
+static void set_fast_pcl_options(pcl::NormalDistributionsTransform<pcl::PointXYZ, pcl::PointXYZ>& target_ndt)
+{
+  // Hashed voxels give O(1) cell lookup on large maps.
+  if (_use_voxel_hash == true)
+    target_ndt.setLeafStorage(pcl::VoxelGridCovariance<pcl::PointXYZ>::LEAF_STORAGE_HASH);
+
+  // Direct lookups on the voxel grid skip the kdtree over the voxel centroids.
+  if (_neighbor_search == "direct1")
+  {
+    target_ndt.setNeighborSearchMethod(pcl::NormalDistributionsTransform<pcl::PointXYZ, pcl::PointXYZ>::DIRECT1);
+  }
+  else if (_neighbor_search == "direct7")
+  {
+    target_ndt.setNeighborSearchMethod(pcl::NormalDistributionsTransform<pcl::PointXYZ, pcl::PointXYZ>::DIRECT7);
+  }
+  else if (_neighbor_search == "direct27")
+  {
+    target_ndt.setNeighborSearchMethod(pcl::NormalDistributionsTransform<pcl::PointXYZ, pcl::PointXYZ>::DIRECT27);
+  }
+
+  target_ndt.setBatchedDerivatives(_use_batched_derivatives);
+}
+#endif
+
 static void map_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
 {
-  if (map_loaded == 0)
+  // The local map mode builds its own target from the map tiles.
+  if (map_loaded == 0 && _local_map_arealist.empty())
   {
     // Convert the data type(from sensor_msgs to pcl).
     pcl::fromROSMsg(*input, map);
@@ -364,6 +454,159 @@ static void map_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
   }
 }
 
+// Reads the tile layout of points_map_loader: path,x_min,y_min,z_min,x_max,y_max,z_max per line.
+static bool read_local_map_arealist(const std::string& arealist)
+{
+  std::ifstream ifs(arealist.c_str());
+  if (!ifs)
+    return false;
+
+  // Relative tile paths are relative to the directory of arealist.txt
+  std::string dir = arealist.substr(0, arealist.find_last_of('/') + 1);
+
+  std::string line;
+  while (std::getline(ifs, line))
+  {
+    std::istringstream iss(line);
+    std::string col;
+    std::vector<std::string> cols;
+    while (std::getline(iss, col, ','))
+      cols.push_back(col);
+    if (cols.size() < 7)
+      continue;
+
+    local_map_tile tile;
+    tile.path = (cols[0].empty() || cols[0][0] == '/') ? cols[0] : dir + cols[0];
+    tile.x_min = std::stod(cols[1]);
+    tile.y_min = std::stod(cols[2]);
+    tile.x_max = std::stod(cols[4]);
+    tile.y_max = std::stod(cols[5]);
+    local_map_tiles.push_back(tile);
+  }
+  return !local_map_tiles.empty();
+}
+
+// Builds the NDT target of the tiles around each requested position. Tiles stay cached while they are in
+// the window, so moving the window only loads the tiles it enters and drops the ones it leaves. The NDT
+// target itself is rebuilt from all the points of the window.
+static void local_map_thread()
+{
+  std::map<std::string, pcl::PointCloud<pcl::PointXYZ>::Ptr> tile_cache;
+
+  while (ros::ok())
+  {
+    local_map_request request;
+    {
+      std::unique_lock<std::mutex> lock(local_map_mutex);
+      while (!local_map_requested && !local_map_shutdown)
+        local_map_cv.wait(lock);
+      if (local_map_shutdown)
+        return;
+      request = local_map_next_request;
+    }
+
+    std::chrono::time_point<std::chrono::system_clock> build_start = std::chrono::system_clock::now();
+
+    // Select the tiles whose bounding box is within _local_map_radius of the position
+    std::map<std::string, pcl::PointCloud<pcl::PointXYZ>::Ptr> window;
+    for (size_t i = 0; i < local_map_tiles.size(); i++)
+    {
+      const local_map_tile& tile = local_map_tiles[i];
+      double dx = std::max(0.0, std::max(tile.x_min - request.x, request.x - tile.x_max));
+      double dy = std::max(0.0, std::max(tile.y_min - request.y, request.y - tile.y_max));
+      if (dx * dx + dy * dy > _local_map_radius * _local_map_radius)
+        continue;
+
+      std::map<std::string, pcl::PointCloud<pcl::PointXYZ>::Ptr>::iterator cached = tile_cache.find(tile.path);
+      if (cached != tile_cache.end())
+      {
+        window[tile.path] = cached->second;
+        continue;
+      }
+
+      pcl::PointCloud<pcl::PointXYZ>::Ptr tile_ptr(new pcl::PointCloud<pcl::PointXYZ>);
+      if (pcl::io::loadPCDFile<pcl::PointXYZ>(tile.path, *tile_ptr) == -1)
+      {
+        std::cout << "Couldn't read " << tile.path << "." << std::endl;
+        continue;
+      }
+      window[tile.path] = tile_ptr;
+    }
+    tile_cache.swap(window);
+
+    pcl::PointCloud<pcl::PointXYZ>::Ptr local_map_ptr(new pcl::PointCloud<pcl::PointXYZ>);
+    for (std::map<std::string, pcl::PointCloud<pcl::PointXYZ>::Ptr>::iterator it = tile_cache.begin();
+         it != tile_cache.end(); ++it)
+      *local_map_ptr += *(it->second);
+
+    // Build the next target while points_callback keeps matching against the active one
+    boost::shared_ptr<pcl::NormalDistributionsTransform<pcl::PointXYZ, pcl::PointXYZ> > next_ndt(
+        new pcl::NormalDistributionsTransform<pcl::PointXYZ, pcl::PointXYZ>);
+#ifdef USE_FAST_PCL
+    set_fast_pcl_options(*next_ndt);
+#endif
+    next_ndt->setResolution(request.ndt_res);
+    next_ndt->setStepSize(request.step_size);
+    next_ndt->setTransformationEpsilon(request.trans_eps);
+    next_ndt->setMaximumIterations(request.max_iter);
+    if (!local_map_ptr->empty())
+      next_ndt->setInputTarget(local_map_ptr);
+
+    std::cout << "Local map at (" << request.x << ", " << request.y << "): " << tile_cache.size() << " tiles, "
+              << local_map_ptr->size() << " points, built in "
+              << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - build_start)
+                         .count() / 1000.0
+              << " ms." << std::endl;
+
+    std::unique_lock<std::mutex> lock(local_map_mutex);
+    if (!local_map_ptr->empty())
+    {
+      local_ndt_ready = next_ndt;
+      local_map_center_x = request.x;
+      local_map_center_y = request.y;
+    }
+    local_map_requested = false;
+  }
+}
+
+// Swaps in the local map finished by local_map_thread and requests a new one once the vehicle has moved away.
+// Returns whether the active local map covers current_pose.
+static bool update_local_map()
+{
+  std::unique_lock<std::mutex> lock(local_map_mutex);
+
+  if (local_ndt_ready)
+  {
+    // The previous target is released here, after the thread is done with the new one
+    local_ndt.swap(local_ndt_ready);
+    local_ndt_ready.reset();
+    map_loaded = 1;
+  }
+
+  // local_map_center_x/y are those of local_ndt once the ready map is swapped in
+  double dx = current_pose.x - local_map_center_x;
+  double dy = current_pose.y - local_map_center_y;
+  bool covered = local_ndt && dx * dx + dy * dy <= _local_map_radius * _local_map_radius;
+
+  if (local_map_requested)
+    return covered;
+
+  if (!local_ndt || local_map_rebuild ||
+      dx * dx + dy * dy > _local_map_update_distance * _local_map_update_distance)
+  {
+    local_map_next_request.x = current_pose.x;
+    local_map_next_request.y = current_pose.y;
+    local_map_next_request.max_iter = max_iter;
+    local_map_next_request.ndt_res = ndt_res;
+    local_map_next_request.step_size = step_size;
+    local_map_next_request.trans_eps = trans_eps;
+    local_map_requested = true;
+    local_map_rebuild = false;
+    local_map_cv.notify_one();
+  }
+  return covered;
+}
+
 static void gnss_callback(const geometry_msgs::PoseStamped::ConstPtr& input)
 {
   tf::Quaternion gnss_q(input->pose.orientation.x, input->pose.orientation.y, input->pose.orientation.z,
@@ -398,6 +641,7 @@ static void gnss_callback(const geometry_msgs::PoseStamped::ConstPtr& input)
     offset_yaw = current_pose.yaw - previous_pose.yaw;
 
     init_pos_set = 1;
+    request_local_map_rebuild();
   }
 
   previous_gnss_pose.x = current_gnss_pose.x;
@@ -443,9 +687,31 @@ static void initialpose_callback(const geometry_msgs::PoseWithCovarianceStamped:
 
   if (_get_height == true && map_loaded == 1)
   {
+    // Without points_map, the height comes from the voxel means of voxel_grid_file or the points of the local map.
+    const pcl::PointCloud<pcl::PointXYZ>* height_map = &map;
+    pcl::PointCloud<pcl::PointXYZ>::ConstPtr target;
+    if (map.empty() && !_local_map_arealist.empty())
+    {
+      // local_map_center_x/y are those of the ready local map until it is swapped in
+      std::unique_lock<std::mutex> lock(local_map_mutex);
+      auto latest_ndt = local_ndt_ready ? local_ndt_ready : local_ndt;
+      double dx = current_pose.x - local_map_center_x;
+      double dy = current_pose.y - local_map_center_y;
+      if (latest_ndt && dx * dx + dy * dy <= _local_map_radius * _local_map_radius)
+        target = latest_ndt->getInputTarget();
+    }
+    else if (map.empty())
+    {
+      target = ndt.getInputTarget();
+    }
+    if (target)
+      height_map = target.get();
+    if (height_map->empty())
+      std::cout << "get_height: no map around the initial pose, z is kept." << std::endl;
+
     double min_distance = DBL_MAX;
     double nearest_z = current_pose.z;
-    for (const auto& p : map)
+    for (const auto& p : *height_map)
     {
       double distance = hypot(current_pose.x - p.x, current_pose.y - p.y);
       if (distance < min_distance)
@@ -491,6 +757,7 @@ static void initialpose_callback(const geometry_msgs::PoseWithCovarianceStamped:
   offset_imu_odom_pitch = 0.0;
   offset_imu_odom_yaw = 0.0;
 
+  request_local_map_rebuild();
 }
 
 static void imu_odom_calc(ros::Time current_time)
@@ -721,8 +988,18 @@ static void imu_callback(const sensor_msgs::Imu::Ptr& input)
 
 static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
 {
+  // The local map is only requested around a set pose, and scans wait for one that covers it.
+  if (!_local_map_arealist.empty() && init_pos_set == 1 && !update_local_map())
+  {
+    ROS_WARN_THROTTLE(1.0, "No local map around (%f, %f) yet, scan skipped.", current_pose.x, current_pose.y);
+    return;
+  }
+
   if (map_loaded == 1 && init_pos_set == 1)
   {
+    // In the local map mode the target is the latest local map
+    pcl::NormalDistributionsTransform<pcl::PointXYZ, pcl::PointXYZ>& matcher = local_ndt ? *local_ndt : ndt;
+
     matching_start = std::chrono::system_clock::now();
 
     static tf::TransformBroadcaster br;
@@ -746,7 +1023,7 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
     static double align_time, getFitnessScore_time = 0.0;
 
     // Setting point cloud to be aligned.
-    ndt.setInputSource(filtered_scan_ptr);
+    matcher.setInputSource(filtered_scan_ptr);
 
     // Guess the initial gross estimation of the transformation
     predict_pose.x = previous_pose.x + offset_x;
@@ -788,14 +1065,14 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
     if (_use_openmp == true)
     {
       align_start = std::chrono::system_clock::now();
-      ndt.omp_align(*output_cloud, init_guess);
+      matcher.omp_align(*output_cloud, init_guess);
       align_end = std::chrono::system_clock::now();
     }
     else
     {
 #endif
       align_start = std::chrono::system_clock::now();
-      ndt.align(*output_cloud, init_guess);
+      matcher.align(*output_cloud, init_guess);
       align_end = std::chrono::system_clock::now();
 #ifdef USE_FAST_PCL
     }
@@ -804,22 +1081,22 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
     align_time = std::chrono::duration_cast<std::chrono::microseconds>(align_end - align_start).count() / 1000.0;
 
 
-    t = ndt.getFinalTransformation();  // localizer
+    t = matcher.getFinalTransformation();  // localizer
     t2 = t * tf_ltob;                  // base_link
 
-    iteration = ndt.getFinalNumIteration();
+    iteration = matcher.getFinalNumIteration();
 #ifdef USE_FAST_PCL
     if (_use_openmp == true)
     {
       getFitnessScore_start = std::chrono::system_clock::now();
-      fitness_score = ndt.omp_getFitnessScore();
+      fitness_score = matcher.omp_getFitnessScore();
       getFitnessScore_end = std::chrono::system_clock::now();
     }
     else
     {
 #endif
       getFitnessScore_start = std::chrono::system_clock::now();
-      fitness_score = ndt.getFitnessScore();
+      fitness_score = matcher.getFitnessScore();
       getFitnessScore_end = std::chrono::system_clock::now();
 #ifdef USE_FAST_PCL
     }
@@ -829,7 +1106,7 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
         1000.0;
 
 
-    trans_probability = ndt.getTransformationProbability();
+    trans_probability = matcher.getTransformationProbability();
 
     tf::Matrix3x3 mat_l;  // localizer
     mat_l.setValue(static_cast<double>(t(0, 0)), static_cast<double>(t(0, 1)), static_cast<double>(t(0, 2)),
@@ -1171,11 +1448,11 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
     std::cout << "Frame ID: " << input->header.frame_id << std::endl;
     //		std::cout << "Number of Scan Points: " << scan_ptr->size() << " points." << std::endl;
     std::cout << "Number of Filtered Scan Points: " << scan_points_num << " points." << std::endl;
-    std::cout << "NDT has converged: " << ndt.hasConverged() << std::endl;
+    std::cout << "NDT has converged: " << matcher.hasConverged() << std::endl;
     std::cout << "Fitness Score: " << fitness_score << std::endl;
-    std::cout << "Transformation Probability: " << ndt.getTransformationProbability() << std::endl;
+    std::cout << "Transformation Probability: " << matcher.getTransformationProbability() << std::endl;
     std::cout << "Execution Time: " << exe_time << " ms." << std::endl;
-    std::cout << "Number of Iterations: " << ndt.getFinalNumIteration() << std::endl;
+    std::cout << "Number of Iterations: " << matcher.getFinalNumIteration() << std::endl;
     std::cout << "NDT Reliability: " << ndt_reliability.data << std::endl;
     std::cout << "(x,y,z,roll,pitch,yaw): " << std::endl;
     std::cout << "(" << current_pose.x << ", " << current_pose.y << ", " << current_pose.z << ", " << current_pose.roll
@@ -1270,6 +1547,13 @@ int main(int argc, char** argv)
   private_nh.getParam("queue_size", _queue_size);
   private_nh.getParam("offset", _offset);
   private_nh.getParam("use_openmp", _use_openmp);
+  private_nh.getParam("use_voxel_hash", _use_voxel_hash);
+  private_nh.getParam("neighbor_search", _neighbor_search);
+  private_nh.getParam("use_batched_derivatives", _use_batched_derivatives);
+  private_nh.getParam("voxel_grid_file", _voxel_grid_file);
+  private_nh.getParam("local_map_arealist", _local_map_arealist);
+  private_nh.getParam("local_map_radius", _local_map_radius);
+  private_nh.getParam("local_map_update_distance", _local_map_update_distance);
   private_nh.getParam("get_height", _get_height);
   private_nh.getParam("use_local_transform", _use_local_transform);
   private_nh.getParam("use_imu", _use_imu);
@@ -1319,6 +1603,13 @@ int main(int argc, char** argv)
   std::cout << "queue_size: " << _queue_size << std::endl;
   std::cout << "offset: " << _offset << std::endl;
   std::cout << "use_openmp: " << _use_openmp << std::endl;
+  std::cout << "use_voxel_hash: " << _use_voxel_hash << std::endl;
+  std::cout << "neighbor_search: " << _neighbor_search << std::endl;
+  std::cout << "use_batched_derivatives: " << _use_batched_derivatives << std::endl;
+  std::cout << "voxel_grid_file: " << _voxel_grid_file << std::endl;
+  std::cout << "local_map_arealist: " << _local_map_arealist << std::endl;
+  std::cout << "local_map_radius: " << _local_map_radius << std::endl;
+  std::cout << "local_map_update_distance: " << _local_map_update_distance << std::endl;
   std::cout << "get_height: " << _get_height << std::endl;
   std::cout << "use_local_transform: " << _use_local_transform << std::endl;
   std::cout << "use_imu: " << _use_imu << std::endl;
@@ -1342,6 +1633,69 @@ int main(int argc, char** argv)
   Eigen::AngleAxisf rot_z_ltob((-1.0) * _tf_yaw, Eigen::Vector3f::UnitZ());
   tf_ltob = (tl_ltob * rot_z_ltob * rot_y_ltob * rot_x_ltob).matrix();
 
+  // The local map takes over from the voxel grid, _voxel_grid_file stays set only if it is loaded.
+  if (!_voxel_grid_file.empty() && !_local_map_arealist.empty())
+  {
+    std::cout << "local_map_arealist is set, voxel_grid_file " << _voxel_grid_file << " is not used." << std::endl;
+    _voxel_grid_file = "";
+  }
+
+#ifdef USE_FAST_PCL
+  if (_neighbor_search != "kdtree" && _neighbor_search != "direct1" && _neighbor_search != "direct7" &&
+      _neighbor_search != "direct27")
+  {
+    std::cout << "Unknown neighbor_search " << _neighbor_search << ", using kdtree." << std::endl;
+  }
+
+  set_fast_pcl_options(ndt);
+
+  // A precomputed voxel grid makes the node ready without waiting for points_map.
+  if (!_voxel_grid_file.empty())
+  {
+    std::chrono::time_point<std::chrono::system_clock> load_start = std::chrono::system_clock::now();
+    if (ndt.loadTargetCells(_voxel_grid_file))
+    {
+      ndt.setMaximumIterations(max_iter);
+      ndt.setStepSize(step_size);
+      ndt.setTransformationEpsilon(trans_eps);
+      ndt_res = ndt.getResolution();
+      map_loaded = 1;
+      std::cout << "Loaded " << _voxel_grid_file << " (resolution: " << ndt_res << ") in "
+                << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - load_start)
+                           .count() / 1000.0
+                << " ms." << std::endl;
+    }
+    else
+    {
+      std::cout << "Couldn't load " << _voxel_grid_file << ", waiting for points_map." << std::endl;
+      _voxel_grid_file = "";
+    }
+  }
+#else
+  if (!_voxel_grid_file.empty())
+  {
+    std::cout << "voxel_grid_file needs fast_pcl, " << _voxel_grid_file << " is not used." << std::endl;
+    _voxel_grid_file = "";
+  }
+#endif
+
+  // The local map replaces points_map, the tiles are loaded around current_pose by local_map_thread.
+  std::thread local_map_builder;
+  if (!_local_map_arealist.empty())
+  {
+    if (read_local_map_arealist(_local_map_arealist))
+    {
+      if (_use_local_transform == true)
+        std::cout << "use_local_transform is not applied to the local map tiles." << std::endl;
+      local_map_builder = std::thread(local_map_thread);
+    }
+    else
+    {
+      std::cout << "Couldn't read " << _local_map_arealist << ", waiting for points_map." << std::endl;
+      _local_map_arealist = "";
+    }
+  }
+
   // Updated in initialpose_callback or gnss_callback
   initial_pose.x = 0.0;
   initial_pose.y = 0.0;
@@ -1377,5 +1731,15 @@ int main(int argc, char** argv)
 
   ros::spin();
 
+  if (local_map_builder.joinable())
+  {
+    {
+      std::unique_lock<std::mutex> lock(local_map_mutex);
+      local_map_shutdown = true;
+    }
+    local_map_cv.notify_one();
+    local_map_builder.join();
+  }
+
   return 0;
 }
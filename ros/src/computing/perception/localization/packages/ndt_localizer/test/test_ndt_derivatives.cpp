@@ -0,0 +1,294 @@
+/*
+ *  Copyright (c) 2015, Nagoya University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of Autoware nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ Compares the per point and the batched NDT derivatives on the same scan and target.
+
+ The per point path of computeDerivatives is the reference. The batched kernel is run
+ serially and split across threads, for every neighbor search method, with and without
+ the hessian. Full alignments with align and omp_align are compared the same way, and
+ omp_align must give the same result when run twice. The same file is also built
+ without OpenMP, which checks the plain loop version of the batched kernel against the
+ reference.
+ */
+
+#include <cmath>
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+#include <pcl/point_types.h>
+#include <pcl/common/transforms.h>
+
+#include <fast_pcl/registration/ndt.h>
+
+typedef pcl::PointXYZ PointT;
+typedef pcl::PointCloud<PointT> CloudT;
+
+class NDTDerivatives : public pcl::NormalDistributionsTransform<PointT, PointT>
+{
+public:
+  struct Result
+  {
+    double score;
+    Eigen::Matrix<double, 6, 1> gradient;
+    Eigen::Matrix<double, 6, 6> hessian;
+  };
+
+  // Derivatives of the input source at transform p, as computed at the start of computeTransformation
+  Result compute(const Eigen::Matrix<double, 6, 1>& p, bool batched, bool parallel, bool compute_hessian)
+  {
+    // Same initialization as computeTransformation
+    point_gradient_.setZero();
+    point_gradient_.block<3, 3>(0, 0).setIdentity();
+    point_hessian_.setZero();
+
+    Eigen::Matrix4f trans;
+    convertTransform(p, trans);
+    CloudT trans_cloud;
+    pcl::transformPointCloud(*input_, trans_cloud, trans);
+
+    Eigen::Matrix<double, 6, 1> x = p;
+    Result result;
+    result.hessian.setZero();
+    setBatchedDerivatives(batched);
+    if (parallel)
+      result.score = omp_computeDerivatives(result.gradient, result.hessian, trans_cloud, x, compute_hessian);
+    else
+      result.score = computeDerivatives(result.gradient, result.hessian, trans_cloud, x, compute_hessian);
+    return result;
+  }
+
+  // Hessian alone, as computed after the line search
+  Eigen::Matrix<double, 6, 6> hessianOnly(const Eigen::Matrix<double, 6, 1>& p, bool batched)
+  {
+    Eigen::Matrix4f trans;
+    convertTransform(p, trans);
+    CloudT trans_cloud;
+    pcl::transformPointCloud(*input_, trans_cloud, trans);
+
+    // computeHessian relies on the angular derivatives of the preceding computeDerivatives call
+    compute(p, batched, false, true);
+
+    Eigen::Matrix<double, 6, 1> x = p;
+    Eigen::Matrix<double, 6, 6> hessian;
+    setBatchedDerivatives(batched);
+    computeHessian(hessian, trans_cloud, x);
+    return hessian;
+  }
+};
+
+// Deterministic pseudo random numbers in [-1, 1], independent of the C library
+static double noise(unsigned int& state)
+{
+  state = state * 1664525u + 1013904223u;
+  return (state >> 8) / static_cast<double>(1u << 23) - 1.0;
+}
+
+// A floor, two walls and a pole, sampled with some noise so every voxel has a full rank covariance
+static CloudT::Ptr makeTarget()
+{
+  CloudT::Ptr cloud(new CloudT);
+  unsigned int state = 1;
+  for (double u = -8.0; u < 8.0; u += 0.2)
+  {
+    for (double v = -8.0; v < 8.0; v += 0.2)
+    {
+      cloud->push_back(PointT(u + 0.05 * noise(state), v + 0.05 * noise(state), 0.05 * noise(state)));
+      if (v < 3.0 && v >= 0.0)
+      {
+        cloud->push_back(PointT(u + 0.05 * noise(state), 6.0 + 0.05 * noise(state), v + 0.05 * noise(state)));
+        cloud->push_back(PointT(-6.0 + 0.05 * noise(state), u + 0.05 * noise(state), v + 0.05 * noise(state)));
+      }
+    }
+  }
+  for (double h = 0.0; h < 4.0; h += 0.05)
+  {
+    for (int k = 0; k < 8; k++)
+      cloud->push_back(PointT(2.0 + 0.2 * std::cos(k * M_PI / 4), -3.0 + 0.2 * std::sin(k * M_PI / 4),
+                              h + 0.02 * noise(state)));
+  }
+  return cloud;
+}
+
+// Every third target point with extra noise, so the scan does not sit on the voxel means
+static CloudT::Ptr makeSource(const CloudT& target)
+{
+  CloudT::Ptr cloud(new CloudT);
+  unsigned int state = 7;
+  for (size_t i = 0; i < target.size(); i += 3)
+  {
+    const PointT& pt = target.points[i];
+    cloud->push_back(PointT(pt.x + 0.1 * noise(state), pt.y + 0.1 * noise(state), pt.z + 0.1 * noise(state)));
+  }
+  return cloud;
+}
+
+static void expectNear(const NDTDerivatives::Result& expected, const NDTDerivatives::Result& actual,
+                       bool compute_hessian)
+{
+  // Both paths sum the same terms in a different order and with differently grouped products
+  const double tolerance = 1e-9;
+  double score_scale = std::max(1.0, std::fabs(expected.score));
+  double gradient_scale = std::max(1.0, expected.gradient.cwiseAbs().maxCoeff());
+  double hessian_scale = std::max(1.0, expected.hessian.cwiseAbs().maxCoeff());
+
+  EXPECT_NEAR(expected.score, actual.score, tolerance * score_scale);
+  for (int i = 0; i < 6; i++)
+    EXPECT_NEAR(expected.gradient(i), actual.gradient(i), tolerance * gradient_scale) << "gradient " << i;
+  if (!compute_hessian)
+    return;
+  for (int i = 0; i < 6; i++)
+  {
+    for (int j = 0; j < 6; j++)
+      EXPECT_NEAR(expected.hessian(i, j), actual.hessian(i, j), tolerance * hessian_scale)
+          << "hessian " << i << ", " << j;
+  }
+}
+
+class NDTDerivativesTest
+  : public ::testing::TestWithParam<NDTDerivatives::NeighborSearchMethod>
+{
+protected:
+  virtual void SetUp()
+  {
+    target_ = makeTarget();
+    source_ = makeSource(*target_);
+    ndt_.setNeighborSearchMethod(GetParam());
+    ndt_.setInputTarget(target_);
+    ndt_.setInputSource(source_);
+
+    // Small offset from the true pose, within the basin of the match
+    p_ << 0.3, -0.2, 0.05, 0.01, -0.02, 0.05;
+  }
+
+  CloudT::Ptr target_;
+  CloudT::Ptr source_;
+  NDTDerivatives ndt_;
+  Eigen::Matrix<double, 6, 1> p_;
+
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+TEST_P(NDTDerivativesTest, SerialBatchedMatchesPerPoint)
+{
+  for (int compute_hessian = 0; compute_hessian < 2; compute_hessian++)
+  {
+    NDTDerivatives::Result expected = ndt_.compute(p_, false, false, compute_hessian);
+    ASSERT_GT(expected.score, 0.0) << "scan does not overlap the target";
+    expectNear(expected, ndt_.compute(p_, true, false, compute_hessian), compute_hessian);
+  }
+}
+
+TEST_P(NDTDerivativesTest, ParallelMatchesPerPoint)
+{
+  for (int nr_threads = 1; nr_threads <= 4; nr_threads += 3)
+  {
+    ndt_.setNumberOfThreads(nr_threads);
+    for (int compute_hessian = 0; compute_hessian < 2; compute_hessian++)
+    {
+      NDTDerivatives::Result expected = ndt_.compute(p_, false, false, compute_hessian);
+      expectNear(expected, ndt_.compute(p_, false, true, compute_hessian), compute_hessian);
+      expectNear(expected, ndt_.compute(p_, true, true, compute_hessian), compute_hessian);
+    }
+  }
+}
+
+TEST_P(NDTDerivativesTest, HessianMatchesPerPoint)
+{
+  NDTDerivatives::Result expected, actual;
+  expected.score = actual.score = 0.0;
+  expected.gradient.setZero();
+  actual.gradient.setZero();
+  expected.hessian = ndt_.hessianOnly(p_, false);
+  actual.hessian = ndt_.hessianOnly(p_, true);
+  expectNear(expected, actual, true);
+}
+
+static void expectNearTransformation(const Eigen::Matrix4f& expected, const Eigen::Matrix4f& actual)
+{
+  // The derivatives differ in the last digits, so the Newton steps may stop at slightly different poses
+  const float tolerance = 1e-4;
+  for (int i = 0; i < 3; i++)
+  {
+    for (int j = 0; j < 4; j++)
+      EXPECT_NEAR(expected(i, j), actual(i, j), tolerance) << "transformation " << i << ", " << j;
+  }
+}
+
+TEST_P(NDTDerivativesTest, AlignMatchesPerPoint)
+{
+  // ndt_matching settings, the source is the target with noise so the true pose is the identity
+  ndt_.setResolution(1.0);
+  ndt_.setStepSize(0.1);
+  ndt_.setTransformationEpsilon(0.01);
+  ndt_.setMaximumIterations(30);
+  Eigen::Matrix4f guess =
+      (Eigen::Translation3f(0.3, -0.2, 0.05) * Eigen::AngleAxisf(0.05, Eigen::Vector3f::UnitZ())).matrix();
+  CloudT output;
+
+  ndt_.setBatchedDerivatives(false);
+  ndt_.align(output, guess);
+  Eigen::Matrix4f expected = ndt_.getFinalTransformation();
+  // The guess is 0.36 m off, a single voxel (direct1) does not get as close as the others
+  Eigen::Vector3f translation = expected.block<3, 1>(0, 3);
+  EXPECT_LT(translation.norm(), 0.15);
+
+  ndt_.setBatchedDerivatives(true);
+  ndt_.align(output, guess);
+  expectNearTransformation(expected, ndt_.getFinalTransformation());
+
+  for (int nr_threads = 1; nr_threads <= 4; nr_threads += 3)
+  {
+    ndt_.setNumberOfThreads(nr_threads);
+    for (int batched = 0; batched < 2; batched++)
+    {
+      ndt_.setBatchedDerivatives(batched);
+      ndt_.omp_align(output, guess);
+      Eigen::Matrix4f first = ndt_.getFinalTransformation();
+      expectNearTransformation(expected, first);
+
+      // The slots are summed in a fixed order, so a second run gives the same bits
+      ndt_.omp_align(output, guess);
+      EXPECT_TRUE(first == ndt_.getFinalTransformation()) << nr_threads << " threads, batched " << batched;
+    }
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(NeighborSearch, NDTDerivativesTest,
+                        ::testing::Values(NDTDerivatives::KDTREE, NDTDerivatives::DIRECT1,
+                                          NDTDerivatives::DIRECT7, NDTDerivatives::DIRECT27));
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,199 @@
+/*
+ *  Copyright (c) 2015, Nagoya University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of Autoware nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ Compares the hashed and the std::map leaf storages of VoxelGridCovariance on the same cloud.
+
+ The std::map storage is the reference. Both are built from the same points at several
+ resolutions and must hold the same voxels, return the same voxel for every query point
+ and find the same neighbors with radiusSearch and getNeighborhoodAtPoint.
+ */
+
+#include <cmath>
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <pcl/point_types.h>
+
+#include <fast_pcl/filters/voxel_grid_covariance.h>
+
+typedef pcl::PointXYZ PointT;
+typedef pcl::PointCloud<PointT> CloudT;
+typedef pcl::VoxelGridCovariance<PointT> VoxelGrid;
+
+// Deterministic pseudo random numbers in [-1, 1], independent of the C library
+static double noise(unsigned int& state)
+{
+  state = state * 1664525u + 1013904223u;
+  return (state >> 8) / static_cast<double>(1u << 23) - 1.0;
+}
+
+// A floor, a wall and a sparse cloud around them, so some voxels have too few points to be usable
+static CloudT::Ptr makeCloud()
+{
+  CloudT::Ptr cloud(new CloudT);
+  unsigned int state = 3;
+  for (double u = -6.0; u < 6.0; u += 0.15)
+  {
+    for (double v = -6.0; v < 6.0; v += 0.15)
+    {
+      cloud->push_back(PointT(u + 0.05 * noise(state), v + 0.05 * noise(state), 0.05 * noise(state)));
+      if (v >= 0.0 && v < 3.0)
+        cloud->push_back(PointT(u + 0.05 * noise(state), 4.0 + 0.05 * noise(state), v + 0.05 * noise(state)));
+    }
+  }
+  for (int i = 0; i < 500; i++)
+    cloud->push_back(PointT(7.0 * noise(state), 7.0 * noise(state), 3.0 + 3.0 * noise(state)));
+  return cloud;
+}
+
+// Cloud points jittered by up to one voxel
+static CloudT makeQueries(const CloudT& cloud, float resolution)
+{
+  CloudT queries;
+  unsigned int state = 11;
+  for (size_t i = 0; i < cloud.size(); i += 7)
+  {
+    const PointT& pt = cloud.points[i];
+    queries.push_back(PointT(pt.x + resolution * noise(state), pt.y + resolution * noise(state),
+                             pt.z + resolution * noise(state)));
+  }
+  return queries;
+}
+
+static void expectSameLeaf(VoxelGrid::LeafConstPtr expected, VoxelGrid::LeafConstPtr actual)
+{
+  ASSERT_EQ(expected == NULL, actual == NULL);
+  if (expected == NULL)
+    return;
+  EXPECT_EQ(expected->nr_points, actual->nr_points);
+  EXPECT_TRUE(expected->getMean() == actual->getMean());
+  EXPECT_TRUE(expected->getCov() == actual->getCov());
+  EXPECT_TRUE(expected->getInverseCov() == actual->getInverseCov());
+}
+
+// Neighbors are compared by their means, the storages may return them in a different order
+static std::set<std::vector<double> > means(const std::vector<VoxelGrid::LeafConstPtr>& leaves)
+{
+  std::set<std::vector<double> > result;
+  for (size_t i = 0; i < leaves.size(); i++)
+  {
+    Eigen::Vector3d mean = leaves[i]->getMean();
+    result.insert(std::vector<double>(mean.data(), mean.data() + 3));
+  }
+  return result;
+}
+
+class VoxelGridCovarianceTest : public ::testing::TestWithParam<float>
+{
+protected:
+  virtual void SetUp()
+  {
+    cloud_ = makeCloud();
+    const float resolution = GetParam();
+    map_grid_.setLeafStorage(VoxelGrid::LEAF_STORAGE_MAP);
+    hash_grid_.setLeafStorage(VoxelGrid::LEAF_STORAGE_HASH);
+    map_grid_.setLeafSize(resolution, resolution, resolution);
+    hash_grid_.setLeafSize(resolution, resolution, resolution);
+    map_grid_.setInputCloud(cloud_);
+    hash_grid_.setInputCloud(cloud_);
+    map_grid_.filter(true);
+    hash_grid_.filter(true);
+  }
+
+  CloudT::Ptr cloud_;
+  VoxelGrid map_grid_;
+  VoxelGrid hash_grid_;
+};
+
+TEST_P(VoxelGridCovarianceTest, SameVoxels)
+{
+  EXPECT_EQ(map_grid_.getLeafCount(), hash_grid_.getLeafCount());
+
+  const CloudT& map_centroids = *map_grid_.getCentroids();
+  const CloudT& hash_centroids = *hash_grid_.getCentroids();
+  ASSERT_GT(map_centroids.size(), 0u);
+  ASSERT_EQ(map_centroids.size(), hash_centroids.size());
+
+  std::set<std::vector<float> > map_set, hash_set;
+  for (size_t i = 0; i < map_centroids.size(); i++)
+  {
+    const PointT& m = map_centroids.points[i];
+    const PointT& h = hash_centroids.points[i];
+    map_set.insert(std::vector<float>{ m.x, m.y, m.z });
+    hash_set.insert(std::vector<float>{ h.x, h.y, h.z });
+  }
+  EXPECT_TRUE(map_set == hash_set);
+}
+
+TEST_P(VoxelGridCovarianceTest, SameLeafPerPoint)
+{
+  CloudT queries = makeQueries(*cloud_, GetParam());
+  for (size_t i = 0; i < queries.size(); i++)
+  {
+    PointT p = queries.points[i];
+    expectSameLeaf(map_grid_.getLeaf(p), hash_grid_.getLeaf(p));
+  }
+}
+
+TEST_P(VoxelGridCovarianceTest, SameNeighbors)
+{
+  const float resolution = GetParam();
+  CloudT queries = makeQueries(*cloud_, resolution);
+  std::vector<VoxelGrid::LeafConstPtr> map_leaves, hash_leaves;
+  std::vector<float> distances;
+  VoxelGrid::Neighborhood neighborhoods[] = { VoxelGrid::NEIGHBORHOOD_1, VoxelGrid::NEIGHBORHOOD_7,
+                                              VoxelGrid::NEIGHBORHOOD_27 };
+
+  for (size_t i = 0; i < queries.size(); i++)
+  {
+    // Radius search as done by NormalDistributionsTransform::computeDerivatives
+    map_grid_.radiusSearch(queries.points[i], resolution, map_leaves, distances);
+    hash_grid_.radiusSearch(queries.points[i], resolution, hash_leaves, distances);
+    EXPECT_TRUE(means(map_leaves) == means(hash_leaves)) << "radiusSearch, query " << i;
+
+    for (int n = 0; n < 3; n++)
+    {
+      map_grid_.getNeighborhoodAtPoint(queries.points[i], neighborhoods[n], map_leaves);
+      hash_grid_.getNeighborhoodAtPoint(queries.points[i], neighborhoods[n], hash_leaves);
+      EXPECT_TRUE(means(map_leaves) == means(hash_leaves)) << "neighborhood " << n << ", query " << i;
+    }
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(Resolution, VoxelGridCovarianceTest, ::testing::Values(0.5f, 1.0f, 2.0f));
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -33,6 +33,7 @@
 #include <nav_msgs/OccupancyGrid.h>
 #include <pcl_conversions/pcl_conversions.h>
 
+#include <algorithm>
 #include <utility>
 
 namespace
@@ -42,16 +43,35 @@ constexpr double CAR_LENGTH = 4.5;
 constexpr double CAR_WIDTH = 1.75;
 
 ros::Publisher g_costmap_pub;
+ros::Publisher g_costmap_update_pub;
 double g_resolution;
 int g_cell_width;
 int g_cell_height;
 double g_offset_x;
 double g_offset_y;
 double g_offset_z;
-
-std::vector<int> createCostMap(const pcl::PointCloud<pcl::PointXYZ> &scan)
+bool g_use_filter;
+double g_decay;
+bool g_publish_updates;
+
+// grid buffers reused for every scan
+std::vector<int> g_cost_map;
+std::vector<int> g_touched_cells;  // cells of g_cost_map set by the last scan
+std::vector<int> g_cleared_cells;  // cells of g_cost_map set by the scan before, cleared for the last one
+std::vector<int> g_filtered_cost_map;
+std::vector<int> g_row_sums;
+std::vector<float> g_accumulated_cost_map;
+
+void createCostMap(const pcl::PointCloud<pcl::PointXYZ> &scan, std::vector<int> *cost_map)
 {
-  std::vector<int> cost_map(g_cell_width * g_cell_height, 0);
+  cost_map->resize(g_cell_width * g_cell_height, 0);
+
+  // only the cells of the last scan have to be cleared
+  g_cleared_cells.swap(g_touched_cells);
+  for (int index : g_cleared_cells)
+    (*cost_map)[index] = 0;
+  g_touched_cells.clear();
+
   double map_center_x = (g_cell_width / 2.0) * g_resolution - g_offset_x;
   double map_center_y = (g_cell_height / 2.0) * g_resolution - g_offset_y;
 
@@ -70,14 +90,15 @@ std::vector<int> createCostMap(const pcl::PointCloud<pcl::PointXYZ> &scan)
       continue;
 
     int index = g_cell_width * grid_y + grid_x;
-    cost_map[index] += 15;
+    int &cost = (*cost_map)[index];
+    if (cost == 0)
+      g_touched_cells.push_back(index);
+    cost += 15;
 
     // Max cost value is 100
-    if (cost_map[index] > 100)
-      cost_map[index] = 100;
+    if (cost > 100)
+      cost = 100;
   }
-
-  return cost_map;
 }
 
 void setOccupancyGrid(nav_msgs::OccupancyGrid *og)
@@ -94,51 +115,82 @@ void setOccupancyGrid(nav_msgs::OccupancyGrid *og)
   og->info.origin.orientation.w = 1.0;
 }
 
-std::vector<int> filterCostMap(std::vector<int>& cost_map)
+// Add the cost of each cell to its 8 neighbors, as a 3x3 box sum done
+// along the rows and then along the columns
+void filterCostMap(const std::vector<int> &cost_map, std::vector<int> *filtered_cost_map)
 {
-  std::vector<int> filtered_cost_map(cost_map.size(), 0);
+  filtered_cost_map->resize(cost_map.size());
+  g_row_sums.resize(cost_map.size());
 
-  // cells around reference (x, y)
-  std::vector<std::pair<int, int>> neighborhood
+  for (int y = 0; y < g_cell_height; y++)
   {
-    std::make_pair(-1, -1), std::make_pair( 0, -1), std::make_pair( 1, -1),
-    std::make_pair(-1,  0), std::make_pair( 1,  0),
-    std::make_pair(-1,  1), std::make_pair( 0,  1), std::make_pair( 1,  1),
-  };
-
-  for (size_t size = cost_map.size(), i = 0; i < size; i++) {
-    int ref_cost = cost_map[i];
-
-    int ref_x = i % g_cell_width;
-    int ref_y = (i - ref_x) / g_cell_width;
-
-    // we don't have to filter if the cost is 0
-    if (ref_cost <= 0)
-      continue;
-
-    filtered_cost_map[i] += ref_cost;
-
-    // increase the cost for each neighborhood cell
-    for (const auto& n : neighborhood) {
-      int neighbor_x = ref_x + n.first;
-      int neighbor_y = ref_y + n.second;
-
-      if (neighbor_x < 0 || neighbor_x >= g_cell_width || neighbor_y < 0 || neighbor_y >= g_cell_height)
-        continue;
+    const int *row = &cost_map[y * g_cell_width];
+    int *row_sum = &g_row_sums[y * g_cell_width];
+    for (int x = 0; x < g_cell_width; x++)
+    {
+      // cells without cost don't spread
+      int sum = std::max(row[x], 0);
+      if (x > 0)
+        sum += std::max(row[x - 1], 0);
+      if (x < g_cell_width - 1)
+        sum += std::max(row[x + 1], 0);
+      row_sum[x] = sum;
+    }
+  }
 
-      int neighbor_index = neighbor_x + neighbor_y * g_cell_width;
-      filtered_cost_map[neighbor_index] += ref_cost;
+  for (int y = 0; y < g_cell_height; y++)
+  {
+    const int *row_sum = &g_row_sums[y * g_cell_width];
+    const int *prev_row_sum = y > 0 ? row_sum - g_cell_width : nullptr;
+    const int *next_row_sum = y < g_cell_height - 1 ? row_sum + g_cell_width : nullptr;
+    int *filtered_row = &(*filtered_cost_map)[y * g_cell_width];
+    for (int x = 0; x < g_cell_width; x++)
+    {
+      int cost = row_sum[x];
+      if (prev_row_sum)
+        cost += prev_row_sum[x];
+      if (next_row_sum)
+        cost += next_row_sum[x];
+
+      // handle the cost over 100
+      filtered_row[x] = std::min(cost, 100);
     }
+  }
+}
+
+// Decayed sum of the cost of the past scans, capped at 100
+void accumulateCostMap(const std::vector<int> &cost_map, std::vector<float> *accumulated_cost_map)
+{
+  accumulated_cost_map->resize(cost_map.size(), 0);
 
+  float decay = g_decay;
+  for (size_t size = cost_map.size(), i = 0; i < size; i++)
+  {
+    float &cost = (*accumulated_cost_map)[i];
+    cost = std::min(cost * decay + cost_map[i], 100.0f);
   }
+}
 
-  // handle the cost over 100
-  for (auto &cost : filtered_cost_map) {
-    if (cost > 100)
-      cost = 100;
+// Publish the bounding box of the cells changed since the last scan as a
+// smaller OccupancyGrid placed within the whole one
+void publishCostMapUpdate(const nav_msgs::OccupancyGrid &og, int min_x, int min_y, int max_x, int max_y)
+{
+  nav_msgs::OccupancyGrid update;
+  update.header = og.header;
+  update.info = og.info;
+  update.info.width = max_x - min_x + 1;
+  update.info.height = max_y - min_y + 1;
+  update.info.origin.position.x += min_x * g_resolution;
+  update.info.origin.position.y += min_y * g_resolution;
+
+  update.data.reserve(update.info.width * update.info.height);
+  for (int y = min_y; y <= max_y; y++)
+  {
+    auto row = og.data.begin() + y * g_cell_width;
+    update.data.insert(update.data.end(), row + min_x, row + max_x + 1);
   }
 
-  return filtered_cost_map;
+  g_costmap_update_pub.publish(update);
 }
 
 void createOccupancyGrid(const sensor_msgs::PointCloud2::ConstPtr &input)
@@ -149,22 +201,62 @@ void createOccupancyGrid(const sensor_msgs::PointCloud2::ConstPtr &input)
 
   static nav_msgs::OccupancyGrid og;
   if (!count)
+  {
     setOccupancyGrid(&og);
+    og.data.assign(g_cell_width * g_cell_height, 0);
+  }
 
   og.header = input->header;
 
   // create cost map with pointcloud
-  std::vector<int> cost_map = createCostMap(scan);
+  createCostMap(scan, &g_cost_map);
+  const std::vector<int> *cost_map = &g_cost_map;
+
+  if (g_use_filter)
+  {
+    filterCostMap(*cost_map, &g_filtered_cost_map);
+    cost_map = &g_filtered_cost_map;
+  }
 
-  /*
-  bool filter = false;
-  if (filter)
-    cost_map = filterCostMap(cost_map);
-  */
+  // write the costs into the reused message, keeping the changed region
+  int min_x = g_cell_width, min_y = g_cell_height, max_x = -1, max_y = -1;
+  auto write_cost = [&](int x, int y, int8_t cost) {
+    int index = y * g_cell_width + x;
+    if (og.data[index] == cost)
+      return;
+
+    og.data[index] = cost;
+    min_x = std::min(min_x, x);
+    min_y = std::min(min_y, y);
+    max_x = std::max(max_x, x);
+    max_y = std::max(max_y, y);
+  };
+
+  if (g_decay > 0)
+    accumulateCostMap(*cost_map, &g_accumulated_cost_map);
+  if (!g_use_filter && g_decay <= 0)
+  {
+    // without filter and decay, only the cells of this scan and of the last one can change
+    for (int index : g_cleared_cells)
+      write_cost(index % g_cell_width, index / g_cell_width, (*cost_map)[index]);
+    for (int index : g_touched_cells)
+      write_cost(index % g_cell_width, index / g_cell_width, (*cost_map)[index]);
+  }
+  else
+  {
+    for (int y = 0; y < g_cell_height; y++)
+    {
+      for (int x = 0; x < g_cell_width; x++)
+      {
+        int index = y * g_cell_width + x;
+        write_cost(x, y, g_decay > 0 ? static_cast<int>(g_accumulated_cost_map[index]) : (*cost_map)[index]);
+      }
+    }
+  }
 
-  og.data.insert(og.data.end(), cost_map.begin(), cost_map.end());
   g_costmap_pub.publish(og);
-  og.data.clear();
+  if (g_publish_updates && max_x >= 0)
+    publishCostMapUpdate(og, min_x, min_y, max_x, max_y);
   count++;
 }
 
@@ -186,8 +278,16 @@ int main(int argc, char **argv)
   private_nh.param<double>("offset_x", g_offset_x, 30.0);
   private_nh.param<double>("offset_y", g_offset_y, 0.0);
   private_nh.param<double>("offset_z", g_offset_z, -2.0);
+  private_nh.param<bool>("use_filter", g_use_filter, false);
+  private_nh.param<double>("decay", g_decay, 0.0);
+  private_nh.param<bool>("publish_updates", g_publish_updates, false);
+
+  // a decay of 1 or more would never forget an obstacle
+  g_decay = std::min(std::max(g_decay, 0.0), 0.99);
 
   g_costmap_pub = nh.advertise<nav_msgs::OccupancyGrid>("realtime_cost_map", 10);
+  if (g_publish_updates)
+    g_costmap_update_pub = nh.advertise<nav_msgs::OccupancyGrid>("realtime_cost_map_updates", 10);
   ros::Subscriber points_sub = nh.subscribe(points_topic, 10, createOccupancyGrid);
 
   ros::spin();
@@ -0,0 +1,163 @@
+/*
+ * CompactGridMap.h
+ *
+ *  Grid map with one array per cell property instead of one CELL_Info object per cell.
+ */
+
+#ifndef COMPACTGRIDMAP_H_
+#define COMPACTGRIDMAP_H_
+
+#include "RoadNetwork.h"
+#include "GridMap.h"
+#include <map>
+
+namespace PlannerHNS
+{
+
+/*
+ * Sub cells (SUBCELL_L x SUBCELL_L) of a cell which received obstacle points
+ */
+class CompactSubCells
+{
+public:
+	unsigned char nStaticPoints[SUBCELL_L*SUBCELL_L];
+	unsigned char nMovingPoints[SUBCELL_L*SUBCELL_L];
+	std::vector<POINT2D> innerStaticPointsList; // first point of each sub cell
+	std::vector<POINT2D> innerMovingPointsList;
+
+	CompactSubCells();
+};
+
+/*
+ * Copy of a CompactGridMap cell with the CELL_Info field names, without the sub cells and the path search fields
+ */
+class CompactCellInfo
+{
+public:
+	int r,c,index;
+	GPSPoint center;
+	double heuristic;
+	double localize_val;
+	double localize_prob;
+	POINT2D bottom_left;
+	POINT2D top_right;
+	POINT2D bottom_right;
+	POINT2D top_left;
+	int nStaticPoints;
+	int nMovingPoints;
+
+	CompactCellInfo();
+
+	inline bool PointInRect(const POINT2D& p) const
+	{
+		return p.x >= bottom_left.x && p.x <= top_right.x && p.y >= bottom_left.y && p.y <= top_right.y;
+	}
+};
+
+/*
+ * Same cells, obstacle points and costs as GridMap, cells are addressed by index (get2dIndex(row, col, wCells)), -1 when out of the map.
+ * Sub cells and their points lists only exist for the cells which received points.
+ */
+class CompactGridMap
+{
+public:
+	double w; // world width
+	double h; // world height
+	double cell_l; // cell length in meters
+	double sub_cell_l;
+	double origin_x , origin_y;
+	int wCells; // number of cells per row
+	int hCells; // number of cells per column
+	int nCells;
+	int m_MaxHeuristics;
+
+	// one value per cell
+	std::vector<unsigned char> nStaticPoints;
+	std::vector<unsigned char> nMovingPoints;
+	std::vector<double> heuristic;
+	std::vector<double> localize_val;
+	std::vector<double> localize_prob;
+
+	CompactGridMap(double start_x, double start_y, double map_w, double map_h, double cell_length, bool bDefaultEmpty);
+	virtual ~CompactGridMap();
+
+	int GetCellIndexFromPoint(const POINT2D& p) const;
+
+	/**
+	 * @brief index of the cell at row, col, -1 if it is out of the map
+	 */
+	int GetCellIndex(const int& row, const int& col) const;
+
+	/**
+	 * @brief cell at index, as GridMap::pCells[index]
+	 */
+	CompactCellInfo GetCell(const int& index) const;
+
+	/**
+	 * @brief cell of the absolute point p, as GridMap::GetCellFromPoint
+	 * @return false if p is out of the map
+	 */
+	bool GetCellFromPoint(const POINT2D& p, CompactCellInfo& cell) const;
+
+	POINT2D GetCellBottomLeft(const int& index) const;
+	POINT2D GetCellCenter(const int& index) const;
+
+	/**
+	 * @brief same test as the Reeds Shepp planning on GridMap cells
+	 */
+	inline bool IsObstacleCell(const int& index) const
+	{
+		return nMovingPoints[index] > 0 || nStaticPoints[index] > 0 || heuristic[index] == m_MaxHeuristics;
+	}
+
+	void UpdateMapObstacleValue(const Obstacle& ob);
+	void UpdateMapObstaclesValuePlygon(const std::vector<POINT2D>& poly, std::vector<int>& modifiedCells);
+
+	/**
+	 * @brief update cell to indicate that there is an obstacle @ absolute point p
+	 * @param p absolute x,y point
+	 * @return index of the updated cell, -1 if p is out of the map
+	 */
+	int UpdateMapObstaclePoint(const POINT2D& p);
+
+	/**
+	 * @brief update cell to indicate that there is an moving obstacle @ absolute point p
+	 * @param p absolute x,y point
+	 * @return index of the updated cell, -1 if p is out of the map
+	 */
+	int UpdateMapMovingObstaclePoint(const POINT2D& p);
+
+	int UpdateMapCostValue(const POINT2D& p, const double& localize_val, const double& localize_prob);
+
+	/**
+	 * @brief sub cells of a cell, 0 if the cell never received points
+	 */
+	const CompactSubCells* GetSubCells(const int& index) const;
+
+	/**
+	 * @brief Clear the map contents including obstacle data if bMovingOnly parameter = -1
+	 * @param bMovingOnly , 1 : clear cell data and moving only points, 0 clear all data including moving and static points, -1 clear data only.
+	 */
+	void ClearMap(int bMovingOnly);
+
+	bool IsUpdated()
+	{
+		return m_bUpdatedMap;
+	}
+
+	void ObservedMap()
+	{
+		m_bUpdatedMap = false;
+	}
+
+private:
+	bool m_bUpdatedMap;
+	std::map<int, CompactSubCells> m_SubCells;
+
+	int GetSubCellIndex(const int& index, const POINT2D& p) const;
+	int InsidePolygon(const std::vector<POINT2D>& polygon,const POINT2D& p);
+};
+
+}
+
+#endif /* COMPACTGRIDMAP_H_ */
@@ -58,11 +58,24 @@ public:
 	static TiXmlElement* GetDataFolder(const std::string& folderName, TiXmlElement* pMainElem);
 
 
+	/**
+	 * @brief Indexes the lanes waypoints of the map on a grid, for the closest lane and waypoint searches. Done when the map is
+	 * constructed or loaded, and again by the searches if waypoints were added or removed since. Call it after moving waypoints.
+	 */
+	static void BuildLanesIndex(RoadNetwork& map, const double& cellSize = 5.0);
+
+	/**
+	 * @brief For every lane with waypoints closer than distance to p, in the order of the map, its closest waypoint (the first one
+	 * if several are as close) and the distance to it
+	 */
+	static void GetLanesClosestPoints(const GPSPoint& p, RoadNetwork& map, const double& distance, std::vector<std::pair<double, LanePointRef> >& lanesPoints);
+
 	static Lane* GetClosestLaneFromMap(const WayPoint& pos, RoadNetwork& map, const double& distance = 5.0);
 	static Lane* GetClosestLaneFromMapDirectionBased(const WayPoint& pos, RoadNetwork& map, const double& distance = 5.0);
 	static std::vector<Lane*> GetClosestMultipleLanesFromMap(const WayPoint& pos, RoadNetwork& map, const double& distance = 5.0);
 	static WayPoint* GetClosestWaypointFromMap(const WayPoint& pos, RoadNetwork& map);
 	static WayPoint* GetClosestBackWaypointFromMap(const WayPoint& pos, RoadNetwork& map);
+	static Lane* GetClosestLaneWithinIncreasingDistance(const WayPoint& pos, RoadNetwork& map);
 	static WayPoint GetFirstWaypoint(RoadNetwork& map);
 	static WayPoint* GetLastWaypoint(RoadNetwork& map);
 
@@ -7,6 +7,7 @@
 
 #include "RSPlanner.h"
 #include "GridMap.h"
+#include "CompactGridMap.h"
 
 #define START_POINT_MAX_DISTANCE 8 // meters
 #define GOAL_POINT_MAX_DISTANCE 8 // meters
@@ -35,6 +36,8 @@ public:
 	 */
 	double PlanUsingReedSheppWithObstacleDetection(const WayPoint& start, const WayPoint& goal, GridMap& map, std::vector<WayPoint>& genSmoothedPath,
 			const double pathDensity = 0.25, const double smoothFactor = 12.0);
+	double PlanUsingReedSheppWithObstacleDetection(const WayPoint& start, const WayPoint& goal, const CompactGridMap& map, std::vector<WayPoint>& genSmoothedPath,
+			const double pathDensity = 0.25, const double smoothFactor = 12.0);
 
 	/**
 	 * @brief Generates Trajectory using Reeds Shepp, this method will not try to avoid obstacles , but if there an obstacle on the trajectory function will fail. , also this function does not guaranteed to generate trajectories
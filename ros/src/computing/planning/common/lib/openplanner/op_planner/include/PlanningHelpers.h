@@ -25,6 +25,35 @@ namespace PlannerHNS {
 #define LANE_CHANGE_COST 3.0 // meters
 #define BACKUP_STRAIGHT_PLAN_DISTANCE 75 //meters
 
+/**
+ * @brief Uniform grid over the points of a trajectory, to find the closest point to a position
+ * without going through the whole trajectory
+ */
+class TrajectoryPointsGrid
+{
+public:
+	TrajectoryPointsGrid();
+
+	void SetTrajectory(const std::vector<WayPoint>& trajectory, const double& cellSize = 2.0);
+
+	/**
+	 * @brief Index of the trajectory point closest to p, the first one if several are as close, as the search of GetClosestNextPointIndex from index 0
+	 */
+	int GetClosestPointIndex(const GPSPoint& p) const;
+
+private:
+	std::vector<GPSPoint> m_Points;
+	double m_MinX;
+	double m_MinY;
+	double m_CellSize;
+	int m_Width;
+	int m_Height;
+	std::vector<int> m_CellStart; // first point of each cell in m_PointIndices, one more at the end
+	std::vector<int> m_PointIndices;
+
+	int GetClosestPointIndexLinear(const GPSPoint& p) const;
+};
+
 class PlanningHelpers {
 public:
 	PlanningHelpers();
@@ -40,6 +69,18 @@ public:
 	 */
 	static bool GetRelativeInfo(const std::vector<WayPoint>& trajectory, const WayPoint& p, RelativeInfo& info, const int& prevIndex = 0);
 
+	/**
+	 * @brief Same as GetRelativeInfo from index 0, with the closest point found through the grid of the trajectory points
+	 * @param trajectory list of waypoints
+	 * @param trajectoryGrid grid set with the same trajectory
+	 * @param p query point
+	 * @param info collection of calculated information
+	 * @return true if success without errors, false otherwise
+	 */
+	static bool GetRelativeInfo(const std::vector<WayPoint>& trajectory, const TrajectoryPointsGrid& trajectoryGrid, const WayPoint& p, RelativeInfo& info);
+
+	static bool GetRelativeInfoFromNextPoint(const std::vector<WayPoint>& trajectory, const WayPoint& p, const int& iFront, RelativeInfo& info);
+
 	static bool GetRelativeInfoRange(const std::vector<std::vector<WayPoint> >& trajectories, const WayPoint& p, const double& searchDistance, RelativeInfo& info);
 
 	/**
@@ -68,6 +109,7 @@ public:
 	 * @return index of the closest next point from trajectory
 	 */
 	static int GetClosestNextPointIndex(const std::vector<WayPoint>& trajectory, const WayPoint& p, const int& prevIndex = 0);
+	static int GetNextPointIndexFromClosest(const std::vector<WayPoint>& trajectory, const WayPoint& p, const int& closestIndex);
 
 	static int GetClosestNextPointIndexDirection(const std::vector<WayPoint>& trajectory, const WayPoint& p, const int& prevIndex = 0);
 
@@ -631,12 +631,60 @@ public:
 
 };
 
+class LanePointRef
+{
+public:
+	int iSegment;
+	int iLane;
+	int iPoint;
+
+	LanePointRef()
+	{
+		iSegment = 0;
+		iLane = 0;
+		iPoint = 0;
+	}
+
+	LanePointRef(const int& segment, const int& lane, const int& point)
+	{
+		iSegment = segment;
+		iLane = lane;
+		iPoint = point;
+	}
+};
+
+/*
+ * Uniform grid over the lanes waypoints, built by MappingHelpers::BuildLanesIndex
+ */
+class LanesIndex
+{
+public:
+	double minX;
+	double minY;
+	double cellSize;
+	int width;
+	int height;
+	std::vector<LanePointRef> points; // all the lanes waypoints, in the order of the map
+	std::vector<int> cellStart; // first point of each cell in cellPoints, one more at the end
+	std::vector<int> cellPoints; // indices in points, increasing in each cell
+
+	LanesIndex()
+	{
+		minX = 0;
+		minY = 0;
+		cellSize = 1;
+		width = 0;
+		height = 0;
+	}
+};
+
 class RoadNetwork
 {
 public:
 	std::vector<RoadSegment> roadSegments;
 	std::vector<TrafficLight> trafficLights;
 	std::vector<StopLine> stopLines;
+	LanesIndex lanesIndex;
 
 };
 
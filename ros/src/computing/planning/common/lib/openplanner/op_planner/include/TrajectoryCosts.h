@@ -37,6 +37,12 @@ public:
 
 
 private:
+	// obstacle contour points projected on the lane being evaluated, reused between steps
+	TrajectoryPointsGrid m_TotalPathGrid;
+	vector<double> m_ObstaclePerpDistances;
+	vector<double> m_ObstacleLongitudinalDistances;
+	vector<bool> m_ObstacleInsideBorder;
+
 	bool ValidateRollOutsInput(const vector<vector<vector<WayPoint> > >& rollOuts);
 	vector<TrajectoryCost> CalculatePriorityAndLaneChangeCosts(const vector<vector<WayPoint> >& laneRollOuts, const int& lane_index, const PlanningParams& params);
 	void NormalizeCosts(vector<TrajectoryCost>& trajectoryCosts);
@@ -0,0 +1,362 @@
+/*
+ * CompactGridMap.cpp
+ *
+ *  Grid map with one array per cell property instead of one CELL_Info object per cell.
+ */
+
+#include "CompactGridMap.h"
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+using namespace std;
+
+namespace PlannerHNS
+{
+
+CompactSubCells::CompactSubCells()
+{
+	fill(nStaticPoints, nStaticPoints + SUBCELL_L*SUBCELL_L, 0);
+	fill(nMovingPoints, nMovingPoints + SUBCELL_L*SUBCELL_L, 0);
+}
+
+CompactCellInfo::CompactCellInfo()
+{
+	r = c = index = -1;
+	heuristic = 0;
+	localize_val = 0;
+	localize_prob = 0;
+	nStaticPoints = 0;
+	nMovingPoints = 0;
+}
+
+CompactGridMap::CompactGridMap(double start_x, double start_y, double map_w, double map_h, double cell_length, bool bDefaultEmpty)
+{
+	assert(cell_length > 0);
+	assert(map_w>0);
+	assert(map_h>0);
+
+	m_bUpdatedMap = false;
+	origin_x = start_x ;
+	origin_y = start_y;
+
+	w = map_w;
+	h = map_h;
+
+	cell_l = cell_length;
+	sub_cell_l = cell_l/(double)SUBCELL_L;
+
+	wCells =  w/cell_l;
+	hCells =  h/cell_l;
+
+	nCells = wCells*hCells;
+	m_MaxHeuristics = w*h*cell_l;
+
+	nStaticPoints.assign(nCells, !bDefaultEmpty);
+	nMovingPoints.assign(nCells, !bDefaultEmpty);
+	heuristic.assign(nCells, 0);
+	localize_val.assign(nCells, 0);
+	localize_prob.assign(nCells, 0);
+}
+
+CompactGridMap::~CompactGridMap()
+{
+}
+
+int CompactGridMap::GetCellIndexFromPoint(const POINT2D& p) const
+{
+	double row = floor((p.y-origin_y) /cell_l);
+	double col = floor((p.x-origin_x) /cell_l);
+
+	if(row>=0 && row < hCells && col >=0 && col < wCells)
+		return get2dIndex((int)row,(int)col,wCells);
+
+	return -1;
+}
+
+int CompactGridMap::GetCellIndex(const int& row, const int& col) const
+{
+	if(checkGridLimit(row, col, hCells, wCells))
+		return get2dIndex(row,col,wCells);
+
+	return -1;
+}
+
+CompactCellInfo CompactGridMap::GetCell(const int& index) const
+{
+	CompactCellInfo cell;
+	if(!(checkGridIndex(index, nCells)))
+		return cell;
+
+	cell.r = index / wCells;
+	cell.c = index % wCells;
+	cell.index = index;
+	cell.bottom_left = GetCellBottomLeft(index);
+	cell.top_right = POINT2D(cell.bottom_left.x + cell_l, cell.bottom_left.y + cell_l);
+	cell.bottom_right = POINT2D(cell.top_right.x, cell.bottom_left.y);
+	cell.top_left = POINT2D(cell.bottom_left.x, cell.top_right.y);
+	cell.center.x = cell.bottom_left.x + cell_l / 2.0;
+	cell.center.y = cell.bottom_left.y + cell_l / 2.0;
+	cell.heuristic = heuristic[index];
+	cell.localize_val = localize_val[index];
+	cell.localize_prob = localize_prob[index];
+	cell.nStaticPoints = nStaticPoints[index];
+	cell.nMovingPoints = nMovingPoints[index];
+	return cell;
+}
+
+bool CompactGridMap::GetCellFromPoint(const POINT2D& p, CompactCellInfo& cell) const
+{
+	int index = GetCellIndexFromPoint(p);
+	if(index < 0)
+		return false;
+
+	cell = GetCell(index);
+	return true;
+}
+
+POINT2D CompactGridMap::GetCellBottomLeft(const int& index) const
+{
+	return POINT2D(((double)(index % wCells) * cell_l) + origin_x, ((double)(index / wCells) * cell_l) + origin_y);
+}
+
+POINT2D CompactGridMap::GetCellCenter(const int& index) const
+{
+	POINT2D bl = GetCellBottomLeft(index);
+	return POINT2D(bl.x + cell_l / 2.0, bl.y + cell_l / 2.0);
+}
+
+int CompactGridMap::GetSubCellIndex(const int& index, const POINT2D& p) const
+{
+	POINT2D bl = GetCellBottomLeft(index);
+	int row = floor((p.y - bl.y)/sub_cell_l);
+	int col = floor((p.x - bl.x)/sub_cell_l);
+
+	if(row>=0 && row<SUBCELL_L && col >=0 && col < SUBCELL_L)
+		return get2dIndex(row,col,SUBCELL_L);
+	else
+		return -1;
+}
+
+const CompactSubCells* CompactGridMap::GetSubCells(const int& index) const
+{
+	map<int, CompactSubCells>::const_iterator it = m_SubCells.find(index);
+	if(it == m_SubCells.end())
+		return 0;
+
+	return &it->second;
+}
+
+void CompactGridMap::ClearMap(int bMovingOnly)
+{
+	fill(heuristic.begin(), heuristic.end(), 0);
+
+	if(bMovingOnly == 1)
+	{
+		fill(nMovingPoints.begin(), nMovingPoints.end(), 0);
+		for(map<int, CompactSubCells>::iterator it = m_SubCells.begin(); it != m_SubCells.end(); it++)
+		{
+			fill(it->second.nMovingPoints, it->second.nMovingPoints + SUBCELL_L*SUBCELL_L, 0);
+			it->second.innerMovingPointsList.clear();
+		}
+	}
+	else if(bMovingOnly == 0)
+	{
+		fill(nMovingPoints.begin(), nMovingPoints.end(), 0);
+		fill(nStaticPoints.begin(), nStaticPoints.end(), 0);
+		m_SubCells.clear();
+	}
+
+	m_bUpdatedMap = true;
+}
+
+void CompactGridMap::UpdateMapObstacleValue(const Obstacle& ob)
+{
+	POINT2D p1, p2;
+	p1 = ob.sp;
+	p2 = ob.ep;
+
+	if(ob.polygon.size() == 0)
+	{
+		// only the cells around the obstacle rectangle can overlap it, all of them are tested for non finite coordinates.
+		// The range is clamped to the map before it is converted, an empty range stays empty.
+		double r0 = 0, r1 = hCells-1, c0 = 0, c1 = wCells-1;
+		if(std::isfinite(p1.x) && std::isfinite(p1.y) && std::isfinite(p2.x) && std::isfinite(p2.y))
+		{
+			r0 = min(max(floor((p1.y-origin_y)/cell_l) - 1, 0.0), (double)hCells);
+			r1 = max(min(floor((p2.y-origin_y)/cell_l) + 1, (double)hCells-1), -1.0);
+			c0 = min(max(floor((p1.x-origin_x)/cell_l) - 1, 0.0), (double)wCells);
+			c1 = max(min(floor((p2.x-origin_x)/cell_l) + 1, (double)wCells-1), -1.0);
+		}
+
+		for(int r = (int)r0; r <= (int)r1; r++)
+		{
+			for(int c = (int)c0; c <= (int)c1; c++)
+			{
+				int index = get2dIndex(r,c,wCells);
+				POINT2D p3 = GetCellBottomLeft(index);
+				POINT2D p4(p3.x + cell_l, p3.y + cell_l);
+
+				if(! ( p2.y < p3.y || p1.y > p4.y || p2.x < p3.x || p1.x > p4.x ))
+				{
+					if(nStaticPoints[index] < 255)
+						nStaticPoints[index]++;
+					m_bUpdatedMap = true;
+				}
+			}
+		}
+	}
+	else
+	{
+		vector<int> modList;
+		UpdateMapObstaclesValuePlygon(ob.polygon, modList);
+	}
+}
+
+void CompactGridMap::UpdateMapObstaclesValuePlygon(const vector<POINT2D>& poly, vector<int>& modifiedCells)
+{
+	POINT2D minP, maxP;
+
+	minP = poly[0];
+	maxP = poly[0];
+
+	for(unsigned int j=1; j< poly.size(); j++)
+	{
+		if(poly[j].x < minP.x) minP.x = poly[j].x;
+		if(poly[j].y < minP.y) minP.y = poly[j].y;
+
+		if(poly[j].x > maxP.x) maxP.x = poly[j].x;
+		if(poly[j].y > maxP.y) maxP.y = poly[j].y;
+	}
+
+	int minC = GetCellIndexFromPoint(minP);
+	int maxC = GetCellIndexFromPoint(maxP);
+
+	if(maxC < 0 || minC < 0)
+	{
+		printf("Obstacle Polygon is outside the Map !!");
+		return;
+	}
+
+	for(int r=minC/wCells; r<=maxC/wCells; r++)
+	{
+		for(int c=minC%wCells; c<=maxC%wCells; c++)
+		{
+			int index = get2dIndex(r,c,wCells);
+			POINT2D bl = GetCellBottomLeft(index);
+			POINT2D tr(bl.x + cell_l, bl.y + cell_l);
+			bl.x += 0.01;
+			bl.y += 0.01;
+			tr.x -= 0.01;
+			tr.y -= 0.01;
+			if(InsidePolygon(poly, bl)==1 || InsidePolygon(poly, tr)==1)
+			{
+				nMovingPoints[index] = 1;
+				nStaticPoints[index] = 1;
+				modifiedCells.push_back(index);
+				m_bUpdatedMap = true;
+			}
+		}
+	}
+}
+
+int CompactGridMap::UpdateMapObstaclePoint(const POINT2D& p)
+{
+	int index = GetCellIndexFromPoint(p);
+	if(index >= 0)
+	{
+		if(nStaticPoints[index] < 5)
+			nStaticPoints[index]++;
+		int sub_index = GetSubCellIndex(index, p);
+		if(sub_index >= 0)
+		{
+			CompactSubCells& subCells = m_SubCells[index];
+			if(subCells.nStaticPoints[sub_index]<1)
+			{
+				subCells.innerStaticPointsList.push_back(p);
+				m_bUpdatedMap = true;
+			}
+
+			if(subCells.nStaticPoints[sub_index] < 5)
+				subCells.nStaticPoints[sub_index]++;
+		}
+	}
+	return index;
+}
+
+int CompactGridMap::UpdateMapMovingObstaclePoint(const POINT2D& p)
+{
+	int index = GetCellIndexFromPoint(p);
+	if(index >= 0)
+	{
+		if(nMovingPoints[index] < 5)
+			nMovingPoints[index]++;
+		int sub_index = GetSubCellIndex(index, p);
+		if(sub_index >= 0)
+		{
+			CompactSubCells& subCells = m_SubCells[index];
+			if(subCells.nMovingPoints[sub_index]<1)
+			{
+				subCells.innerMovingPointsList.push_back(p);
+				m_bUpdatedMap = true;
+			}
+
+			if(subCells.nMovingPoints[sub_index] < 5)
+				subCells.nMovingPoints[sub_index]++;
+		}
+	}
+	return index;
+}
+
+int CompactGridMap::UpdateMapCostValue(const POINT2D& p, const double& val, const double& prob)
+{
+	int index = GetCellIndexFromPoint(p);
+	if(index >= 0)
+	{
+		localize_val[index] = val;
+		localize_prob[index] = prob;
+		m_bUpdatedMap = true;
+	}
+
+	return index;
+}
+
+int CompactGridMap::InsidePolygon(const vector<POINT2D>& polygon,const POINT2D& p)
+{
+	int counter = 0;
+	int i;
+	double xinters;
+	POINT2D p1,p2;
+	int N = polygon.size();
+	if(N <=0 ) return -1;
+
+	p1 = polygon.at(0);
+	for (i=1;i<=N;i++)
+	{
+		p2 = polygon.at(i % N);
+
+		if (p.y > MIN(p1.y,p2.y))
+		{
+			if (p.y <= MAX(p1.y,p2.y))
+			{
+				if (p.x <= MAX(p1.x,p2.x))
+				{
+					if (p1.y != p2.y)
+					{
+						xinters = (p.y-p1.y)*(p2.x-p1.x)/(p2.y-p1.y)+p1.x;
+						if (p1.x == p2.x || p.x <= xinters)
+							counter++;
+					}
+				}
+			}
+		}
+		p1 = p2;
+	}
+
+	if (counter % 2 == 0)
+		return 0;
+	else
+		return 1;
+}
+
+}
@@ -14,6 +14,9 @@
 #include "geo_pos_conv.hh"
 #include "math.h"
 #include <fstream>
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
 
 #ifdef ENABLE_GPS_CONVERSIONS
 #include "proj_api.h"
@@ -556,6 +559,8 @@ void MappingHelpers::ConstructRoadNetworkFromRosMessage(const std::vector<Utilit
 		}
 	}
 
+	BuildLanesIndex(map);
+
 	cout << "Map loaded from data with " << roadLanes.size()  << " lanes" << endl;
 }
 
@@ -923,6 +928,8 @@ void MappingHelpers::LoadKML(const std::string& kmlFile, RoadNetwork& map)
 		}
 	}
 
+	BuildLanesIndex(map);
+
 	cout << "Map loaded from kml file with (" << laneLinksList.size()  << ") lanes, First Point ( " << GetFirstWaypoint(map).pos.ToString() << ")"<< endl;
 
 }
@@ -1272,16 +1279,186 @@ void MappingHelpers::SetTrafficSignsList(TiXmlElement* pElem, std::vector<Traffi
 
 }
 
-WayPoint* MappingHelpers::GetClosestWaypointFromMap(const WayPoint& pos, RoadNetwork& map)
+void MappingHelpers::BuildLanesIndex(RoadNetwork& map, const double& cellSize)
+{
+	LanesIndex& index = map.lanesIndex;
+	index.points.clear();
+	index.cellStart.clear();
+	index.cellPoints.clear();
+	index.width = 0;
+	index.height = 0;
+
+	double min_x = DBL_MAX, min_y = DBL_MAX, max_x = -DBL_MAX, max_y = -DBL_MAX;
+	for(unsigned int j=0; j< map.roadSegments.size(); j ++)
+	{
+		for(unsigned int k=0; k< map.roadSegments.at(j).Lanes.size(); k ++)
+		{
+			for(unsigned int pindex=0; pindex< map.roadSegments.at(j).Lanes.at(k).points.size(); pindex ++)
+			{
+				const GPSPoint& p = map.roadSegments.at(j).Lanes.at(k).points.at(pindex).pos;
+				index.points.push_back(LanePointRef(j, k, pindex));
+				if(!std::isfinite(p.x) || !std::isfinite(p.y))
+					continue;
+				min_x = std::min(min_x, p.x);
+				min_y = std::min(min_y, p.y);
+				max_x = std::max(max_x, p.x);
+				max_y = std::max(max_y, p.y);
+			}
+		}
+	}
+
+	if(min_x > max_x)
+		return;
+
+	// at most a million cells
+	index.cellSize = cellSize;
+	while(((max_x - min_x)/index.cellSize + 1) * ((max_y - min_y)/index.cellSize + 1) > 1e6)
+		index.cellSize *= 2;
+
+	index.minX = min_x;
+	index.minY = min_y;
+	index.width = (int)((max_x - min_x)/index.cellSize) + 1;
+	index.height = (int)((max_y - min_y)/index.cellSize) + 1;
+
+	vector<int> point_cells(index.points.size(), -1);
+	index.cellStart.assign(index.width*index.height + 1, 0);
+	for(unsigned int i = 0; i < index.points.size(); i++)
+	{
+		const LanePointRef& r = index.points.at(i);
+		const GPSPoint& p = map.roadSegments.at(r.iSegment).Lanes.at(r.iLane).points.at(r.iPoint).pos;
+		if(!std::isfinite(p.x) || !std::isfinite(p.y))
+			continue;
+		int cx = std::min((int)((p.x - index.minX)/index.cellSize), index.width-1);
+		int cy = std::min((int)((p.y - index.minY)/index.cellSize), index.height-1);
+		point_cells.at(i) = cy*index.width + cx;
+		index.cellStart.at(point_cells.at(i)+1)++;
+	}
+
+	for(unsigned int c = 1; c < index.cellStart.size(); c++)
+		index.cellStart.at(c) += index.cellStart.at(c-1);
+
+	index.cellPoints.resize(index.cellStart.back());
+	vector<int> cell_fill(index.cellStart.begin(), index.cellStart.end()-1);
+	for(unsigned int i = 0; i < index.points.size(); i++)
+	{
+		if(point_cells.at(i) >= 0)
+			index.cellPoints.at(cell_fill.at(point_cells.at(i))++) = i;
+	}
+}
+
+void MappingHelpers::GetLanesClosestPoints(const GPSPoint& p, RoadNetwork& map, const double& distance, std::vector<std::pair<double, LanePointRef> >& lanesPoints)
+{
+	lanesPoints.clear();
+
+	// maps not indexed yet, or which got waypoints added or removed since
+	unsigned int nPoints = 0;
+	for(unsigned int j=0; j< map.roadSegments.size(); j ++)
+		for(unsigned int k=0; k< map.roadSegments.at(j).Lanes.size(); k ++)
+			nPoints += map.roadSegments.at(j).Lanes.at(k).points.size();
+
+	if(nPoints != map.lanesIndex.points.size())
+		BuildLanesIndex(map);
+
+	const LanesIndex& index = map.lanesIndex;
+	if(index.width == 0 || !std::isfinite(p.x) || !std::isfinite(p.y) || !(distance > 0))
+		return;
+
+	// cells of the square around p, a bit larger for the rounding of the distances
+	double r = distance + 1e-6;
+	double x0 = (p.x - r - index.minX)/index.cellSize;
+	double y0 = (p.y - r - index.minY)/index.cellSize;
+	double x1 = (p.x + r - index.minX)/index.cellSize;
+	double y1 = (p.y + r - index.minY)/index.cellSize;
+	if(x1 < 0 || y1 < 0 || x0 >= index.width || y0 >= index.height)
+		return;
+
+	int cx0 = std::max(x0, 0.0);
+	int cy0 = std::max(y0, 0.0);
+	int cx1 = std::min(x1, (double)index.width-1);
+	int cy1 = std::min(y1, (double)index.height-1);
+
+	vector<int> candidates;
+	for(int cy = cy0; cy <= cy1; cy++)
+	{
+		for(int cx = cx0; cx <= cx1; cx++)
+		{
+			int c = cy*index.width + cx;
+			candidates.insert(candidates.end(), index.cellPoints.begin() + index.cellStart.at(c), index.cellPoints.begin() + index.cellStart.at(c+1));
+		}
+	}
+
+	// back in the order of the map
+	std::sort(candidates.begin(), candidates.end());
+
+	double d = 0;
+	for(unsigned int i = 0; i < candidates.size(); i++)
+	{
+		const LanePointRef& ref = index.points.at(candidates.at(i));
+		d = distance2points(map.roadSegments.at(ref.iSegment).Lanes.at(ref.iLane).points.at(ref.iPoint).pos, p);
+		if(!(d < distance))
+			continue;
+
+		if(lanesPoints.size() > 0 && lanesPoints.back().second.iSegment == ref.iSegment && lanesPoints.back().second.iLane == ref.iLane)
+		{
+			if(d < lanesPoints.back().first)
+				lanesPoints.back() = make_pair(d, ref);
+		}
+		else
+			lanesPoints.push_back(make_pair(d, ref));
+	}
+}
+
+Lane* MappingHelpers::GetClosestLaneWithinIncreasingDistance(const WayPoint& pos, RoadNetwork& map)
 {
+	// Same as GetClosestLaneFromMap with the distance going from 1 to 99 meters until a lane is found, with one search of the map
+	vector<pair<double, LanePointRef> > lanesPoints;
+	GetLanesClosestPoints(pos.pos, map, 99, lanesPoints);
+
+	vector<pair<double, Lane*> > laneLinksList;
+	vector<double> perp_distances;
+	for(unsigned int i = 0; i < lanesPoints.size(); i++)
+	{
+		Lane* pLane = &map.roadSegments.at(lanesPoints.at(i).second.iSegment).Lanes.at(lanesPoints.at(i).second.iLane);
+		RelativeInfo info;
+		PlanningHelpers::GetRelativeInfo(pLane->points, pos, info);
+
+		if(info.perp_distance == 0 && lanesPoints.at(i).first != 0)
+			continue;
+
+		if(fabs(info.angle_diff) < 45)
+		{
+			laneLinksList.push_back(make_pair(lanesPoints.at(i).first, pLane));
+			perp_distances.push_back(fabs(info.perp_distance));
+		}
+	}
+
 	double distance_to_nearest_lane = 1;
-	Lane* pLane = 0;
-	while(distance_to_nearest_lane < 100 && pLane == 0)
+	while(distance_to_nearest_lane < 100)
 	{
-		pLane = GetClosestLaneFromMap(pos, map, distance_to_nearest_lane);
+		double min_d = 999999999;
+		Lane* closest_lane = 0;
+		for(unsigned int i = 0; i < laneLinksList.size(); i++)
+		{
+			if(laneLinksList.at(i).first < distance_to_nearest_lane && perp_distances.at(i) < min_d)
+			{
+				min_d = perp_distances.at(i);
+				closest_lane = laneLinksList.at(i).second;
+			}
+		}
+
+		if(closest_lane)
+			return closest_lane;
+
 		distance_to_nearest_lane += 1;
 	}
 
+	return 0;
+}
+
+WayPoint* MappingHelpers::GetClosestWaypointFromMap(const WayPoint& pos, RoadNetwork& map)
+{
+	Lane* pLane = GetClosestLaneWithinIncreasingDistance(pos, map);
+
 	if(!pLane) return 0;
 
 	int closest_index = PlanningHelpers::GetClosestNextPointIndex(pLane->points, pos);
@@ -1291,13 +1468,7 @@ WayPoint* MappingHelpers::GetClosestWaypointFromMap(const WayPoint& pos, RoadNet
 
 WayPoint* MappingHelpers::GetClosestBackWaypointFromMap(const WayPoint& pos, RoadNetwork& map)
 {
-	double distance_to_nearest_lane = 1;
-	Lane* pLane = 0;
-	while(distance_to_nearest_lane < 100 && pLane == 0)
-	{
-		pLane = GetClosestLaneFromMap(pos, map, distance_to_nearest_lane);
-		distance_to_nearest_lane += 1;
-	}
+	Lane* pLane = GetClosestLaneWithinIncreasingDistance(pos, map);
 
 	if(!pLane) return 0;
 
@@ -1315,45 +1486,26 @@ WayPoint* MappingHelpers::GetClosestBackWaypointFromMap(const WayPoint& pos, Roa
 
 Lane* MappingHelpers::GetClosestLaneFromMap(const WayPoint& pos, RoadNetwork& map, const double& distance)
 {
-	vector<pair<double, Lane*> > laneLinksList;
-	double d = 0;
-	double min_d = 9999999999;
-	for(unsigned int j=0; j< map.roadSegments.size(); j ++)
-	{
-		for(unsigned int k=0; k< map.roadSegments.at(j).Lanes.size(); k ++)
-		{
-			//Lane* pLane = &pEdge->lanes.at(k);
-			 d = 0;
-			min_d = 9999999999;
-			for(unsigned int pindex=0; pindex< map.roadSegments.at(j).Lanes.at(k).points.size(); pindex ++)
-			{
-
-				d = distance2points(map.roadSegments.at(j).Lanes.at(k).points.at(pindex).pos, pos.pos);
-				if(d < min_d)
-					min_d = d;
-			}
-
-			if(min_d < distance)
-				laneLinksList.push_back(make_pair(min_d, &map.roadSegments.at(j).Lanes.at(k)));
-		}
-	}
+	vector<pair<double, LanePointRef> > lanesPoints;
+	GetLanesClosestPoints(pos.pos, map, distance, lanesPoints);
 
-	if(laneLinksList.size() == 0) return 0;
+	if(lanesPoints.size() == 0) return 0;
 
-	min_d = 999999999;
+	double min_d = 999999999;
 	Lane* closest_lane = 0;
-	for(unsigned int i = 0; i < laneLinksList.size(); i++)
+	for(unsigned int i = 0; i < lanesPoints.size(); i++)
 	{
+		Lane* pLane = &map.roadSegments.at(lanesPoints.at(i).second.iSegment).Lanes.at(lanesPoints.at(i).second.iLane);
 		RelativeInfo info;
-		PlanningHelpers::GetRelativeInfo(laneLinksList.at(i).second->points, pos, info);
+		PlanningHelpers::GetRelativeInfo(pLane->points, pos, info);
 
-		if(info.perp_distance == 0 && laneLinksList.at(i).first != 0)
+		if(info.perp_distance == 0 && lanesPoints.at(i).first != 0)
 			continue;
 
 		if(fabs(info.perp_distance) < min_d && fabs(info.angle_diff) < 45)
 		{
 			min_d = fabs(info.perp_distance);
-			closest_lane = laneLinksList.at(i).second;
+			closest_lane = pLane;
 		}
 	}
 
@@ -1362,51 +1514,29 @@ Lane* MappingHelpers::GetClosestLaneFromMap(const WayPoint& pos, RoadNetwork& ma
 
 Lane* MappingHelpers::GetClosestLaneFromMapDirectionBased(const WayPoint& pos, RoadNetwork& map, const double& distance)
 {
-	vector<pair<double, WayPoint*> > laneLinksList;
-	double d = 0;
-	double min_d = 9999999999;
-	int min_i = 0;
-	for(unsigned int j=0; j< map.roadSegments.size(); j ++)
-	{
-		for(unsigned int k=0; k< map.roadSegments.at(j).Lanes.size(); k ++)
-		{
-			//Lane* pLane = &pEdge->lanes.at(k);
-			d = 0;
-			min_d = 9999999999;
-			for(unsigned int pindex=0; pindex< map.roadSegments.at(j).Lanes.at(k).points.size(); pindex ++)
-			{
-
-				d = distance2points(map.roadSegments.at(j).Lanes.at(k).points.at(pindex).pos, pos.pos);
-				if(d < min_d)
-				{
-					min_d = d;
-					min_i = pindex;
-				}
-			}
+	vector<pair<double, LanePointRef> > lanesPoints;
+	GetLanesClosestPoints(pos.pos, map, distance, lanesPoints);
 
-			if(min_d < distance)
-				laneLinksList.push_back(make_pair(min_d, &map.roadSegments.at(j).Lanes.at(k).points.at(min_i)));
-		}
-	}
+	if(lanesPoints.size() == 0) return 0;
 
-	if(laneLinksList.size() == 0) return 0;
-
-	min_d = 999999999;
+	double min_d = 999999999;
 	Lane* closest_lane = 0;
 	double a_diff = 0;
-	for(unsigned int i = 0; i < laneLinksList.size(); i++)
+	for(unsigned int i = 0; i < lanesPoints.size(); i++)
 	{
+		const LanePointRef& ref = lanesPoints.at(i).second;
+		WayPoint* pWP = &map.roadSegments.at(ref.iSegment).Lanes.at(ref.iLane).points.at(ref.iPoint);
 		RelativeInfo info;
-		PlanningHelpers::GetRelativeInfo(laneLinksList.at(i).second->pLane->points, pos, info);
-		if(info.perp_distance == 0 && laneLinksList.at(i).first != 0)
+		PlanningHelpers::GetRelativeInfo(pWP->pLane->points, pos, info);
+		if(info.perp_distance == 0 && lanesPoints.at(i).first != 0)
 			continue;
 
-		a_diff = UtilityH::AngleBetweenTwoAnglesPositive(laneLinksList.at(i).second->pos.a, pos.pos.a);
+		a_diff = UtilityH::AngleBetweenTwoAnglesPositive(pWP->pos.a, pos.pos.a);
 
 		if(fabs(info.perp_distance)<min_d && a_diff <= M_PI_4)
 		{
 			min_d = fabs(info.perp_distance);
-			closest_lane = laneLinksList.at(i).second->pLane;
+			closest_lane = pWP->pLane;
 		}
 	}
 
@@ -1417,34 +1547,37 @@ Lane* MappingHelpers::GetClosestLaneFromMapDirectionBased(const WayPoint& pos, R
  std::vector<Lane*> MappingHelpers::GetClosestMultipleLanesFromMap(const WayPoint& pos, RoadNetwork& map, const double& distance)
 {
 	vector<Lane*> lanesList;
+
+	// the lanes with a waypoint at distance or closer, in the order of the map
+	vector<pair<double, LanePointRef> > lanesPoints;
+	GetLanesClosestPoints(pos.pos, map, nextafter(distance, DBL_MAX), lanesPoints);
+
 	double d = 0;
 	double a_diff = 0;
-	for(unsigned int j=0; j< map.roadSegments.size(); j ++)
+	for(unsigned int i = 0; i < lanesPoints.size(); i++)
 	{
-		for(unsigned int k=0; k< map.roadSegments.at(j).Lanes.size(); k ++)
+		Lane* pLane = &map.roadSegments.at(lanesPoints.at(i).second.iSegment).Lanes.at(lanesPoints.at(i).second.iLane);
+		for(unsigned int pindex=0; pindex< pLane->points.size(); pindex ++)
 		{
-			for(unsigned int pindex=0; pindex< map.roadSegments.at(j).Lanes.at(k).points.size(); pindex ++)
-			{
-				d = distance2points(map.roadSegments.at(j).Lanes.at(k).points.at(pindex).pos, pos.pos);
-				a_diff = UtilityH::AngleBetweenTwoAnglesPositive(map.roadSegments.at(j).Lanes.at(k).points.at(pindex).pos.a, pos.pos.a);
+			d = distance2points(pLane->points.at(pindex).pos, pos.pos);
+			a_diff = UtilityH::AngleBetweenTwoAnglesPositive(pLane->points.at(pindex).pos.a, pos.pos.a);
 
-				if(d <= distance && a_diff <= M_PI_4)
+			if(d <= distance && a_diff <= M_PI_4)
+			{
+				bool bLaneExist = false;
+				for(unsigned int il = 0; il < lanesList.size(); il++)
 				{
-					bool bLaneExist = false;
-					for(unsigned int il = 0; il < lanesList.size(); il++)
+					if(lanesList.at(il)->id == pLane->id)
 					{
-						if(lanesList.at(il)->id == map.roadSegments.at(j).Lanes.at(k).id)
-						{
-							bLaneExist = true;
-							break;
-						}
+						bLaneExist = true;
+						break;
 					}
+				}
 
-					if(!bLaneExist)
-						lanesList.push_back(&map.roadSegments.at(j).Lanes.at(k));
+				if(!bLaneExist)
+					lanesList.push_back(pLane);
 
-					break;
-				}
+				break;
 			}
 		}
 	}
@@ -35,7 +35,35 @@ PlannerH::PlannerH()
  	return length;
  }
 
- double PlannerH::PlanUsingReedSheppWithObstacleDetection(const WayPoint& start, const WayPoint& goal,GridMap& map, vector<WayPoint>& genSmoothedPath,
+ /*
+  * Cell test of the Reeds Shepp planning, 1 if the cell of p is free, 0 if it is an obstacle, -1 if p is out of the map
+  */
+ static int CheckReedSheppCell(GridMap& map, const WayPoint& p)
+ {
+	CELL_Info* pCellRet = map.GetCellFromPoint(POINT2D(p.pos.x, p.pos.y));
+	if(!pCellRet)
+		return -1;
+
+	if(pCellRet->nMovingPoints > 0|| pCellRet->nStaticPoints > 0 || pCellRet->heuristic == map.m_MaxHeuristics)
+		return 0;
+
+	return 1;
+ }
+
+ static int CheckReedSheppCell(const CompactGridMap& map, const WayPoint& p)
+ {
+	int index = map.GetCellIndexFromPoint(POINT2D(p.pos.x, p.pos.y));
+	if(index < 0)
+		return -1;
+
+	if(map.IsObstacleCell(index))
+		return 0;
+
+	return 1;
+ }
+
+ template <class MAP_TYPE>
+ static double PlanUsingReedSheppOnMap(const WayPoint& start, const WayPoint& goal, MAP_TYPE& map, vector<WayPoint>& genSmoothedPath,
 		 const double pathDensity , const double smoothFactor )
  {
  	RSPlanner rs_planner(smoothFactor);
@@ -52,8 +80,6 @@ PlannerH::PlannerH()
  	if(genSmoothedPath.size() == 0)
  		return length;
 
- 	CELL_Info* pCellRet = 0;
-
  	WayPoint p = genSmoothedPath.at(0);
  	int nChanges = 0;
  	double nMinChangeDistance = length;
@@ -75,21 +101,14 @@ PlannerH::PlannerH()
 
  		p = genSmoothedPath.at(i);
 
-// 		if(map.)
-// 			pCellRet = map.GetCellFromPointInnerMap(p.p);
-// 		else
- 		pCellRet = map.GetCellFromPoint(POINT2D(p.pos.x, p.pos.y));
-
- 		if(pCellRet)
+ 		int cellState = CheckReedSheppCell(map, p);
+ 		if(cellState == 0)
  		{
- 			if(pCellRet->nMovingPoints > 0|| pCellRet->nStaticPoints > 0 || pCellRet->heuristic == map.m_MaxHeuristics)
- 			{
- 				cout << "\n Obstacle Detected \n";
- 				genSmoothedPath.clear();
- 				return -1;
- 			}
+ 			cout << "\n Obstacle Detected \n";
+ 			genSmoothedPath.clear();
+ 			return -1;
  		}
- 		else
+ 		else if(cellState < 0)
  		{
  			cout << "\n Outside the Main Grid \n";
  			genSmoothedPath.clear();
@@ -116,6 +135,18 @@ PlannerH::PlannerH()
 
  }
 
+ double PlannerH::PlanUsingReedSheppWithObstacleDetection(const WayPoint& start, const WayPoint& goal,GridMap& map, vector<WayPoint>& genSmoothedPath,
+		 const double pathDensity , const double smoothFactor )
+ {
+	 return PlanUsingReedSheppOnMap(start, goal, map, genSmoothedPath, pathDensity, smoothFactor);
+ }
+
+ double PlannerH::PlanUsingReedSheppWithObstacleDetection(const WayPoint& start, const WayPoint& goal, const CompactGridMap& map, vector<WayPoint>& genSmoothedPath,
+		 const double pathDensity , const double smoothFactor )
+ {
+	 return PlanUsingReedSheppOnMap(start, goal, map, genSmoothedPath, pathDensity, smoothFactor);
+ }
+
  void PlannerH::GenerateRunoffTrajectory(const std::vector<std::vector<WayPoint> >& referencePaths,const WayPoint& carPos, const bool& bEnableLaneChange, const double& speed, const double& microPlanDistance,
  				const double& maxSpeed,const double& minSpeed, const double&  carTipMargin, const double& rollInMargin,
  				const double& rollInSpeedFactor, const double& pathDensity, const double& rollOutDensity,
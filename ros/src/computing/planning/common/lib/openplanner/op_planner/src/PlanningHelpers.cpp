@@ -8,6 +8,9 @@
 #include "PlanningHelpers.h"
 #include "MatrixOperations.h"
 #include <string>
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
 //#include "spline.hpp"
 
 
@@ -21,6 +24,145 @@ namespace PlannerHNS {
 
 
 
+TrajectoryPointsGrid::TrajectoryPointsGrid()
+{
+	m_MinX = 0;
+	m_MinY = 0;
+	m_CellSize = 1;
+	m_Width = 0;
+	m_Height = 0;
+}
+
+void TrajectoryPointsGrid::SetTrajectory(const std::vector<WayPoint>& trajectory, const double& cellSize)
+{
+	m_Points.clear();
+	m_CellStart.clear();
+	m_PointIndices.clear();
+	m_Width = 0;
+	m_Height = 0;
+
+	double min_x = DBL_MAX, min_y = DBL_MAX, max_x = -DBL_MAX, max_y = -DBL_MAX;
+	for(unsigned int i = 0; i < trajectory.size(); i++)
+	{
+		const GPSPoint& p = trajectory.at(i).pos;
+		m_Points.push_back(p);
+		if(!std::isfinite(p.x) || !std::isfinite(p.y))
+			continue;
+		min_x = std::min(min_x, p.x);
+		min_y = std::min(min_y, p.y);
+		max_x = std::max(max_x, p.x);
+		max_y = std::max(max_y, p.y);
+	}
+
+	// nothing to grid, GetClosestPointIndex goes through the points
+	if(min_x > max_x)
+		return;
+
+	// at most a million cells
+	m_CellSize = cellSize;
+	while(((max_x - min_x)/m_CellSize + 1) * ((max_y - min_y)/m_CellSize + 1) > 1e6)
+		m_CellSize *= 2;
+
+	m_MinX = min_x;
+	m_MinY = min_y;
+	m_Width = (int)((max_x - min_x)/m_CellSize) + 1;
+	m_Height = (int)((max_y - min_y)/m_CellSize) + 1;
+
+	// points sorted by cell, increasing in each cell
+	vector<int> point_cells(m_Points.size(), -1);
+	m_CellStart.assign(m_Width*m_Height + 1, 0);
+	for(unsigned int i = 0; i < m_Points.size(); i++)
+	{
+		const GPSPoint& p = m_Points.at(i);
+		if(!std::isfinite(p.x) || !std::isfinite(p.y))
+			continue;
+		int cx = std::min((int)((p.x - m_MinX)/m_CellSize), m_Width-1);
+		int cy = std::min((int)((p.y - m_MinY)/m_CellSize), m_Height-1);
+		point_cells.at(i) = cy*m_Width + cx;
+		m_CellStart.at(point_cells.at(i)+1)++;
+	}
+
+	for(unsigned int c = 1; c < m_CellStart.size(); c++)
+		m_CellStart.at(c) += m_CellStart.at(c-1);
+
+	m_PointIndices.resize(m_CellStart.back());
+	vector<int> cell_fill(m_CellStart.begin(), m_CellStart.end()-1);
+	for(unsigned int i = 0; i < m_Points.size(); i++)
+	{
+		if(point_cells.at(i) >= 0)
+			m_PointIndices.at(cell_fill.at(point_cells.at(i))++) = i;
+	}
+}
+
+int TrajectoryPointsGrid::GetClosestPointIndexLinear(const GPSPoint& p) const
+{
+	double d = 0, minD = 9999999999;
+	int min_index  = 0;
+
+	for(unsigned int i=0; i< m_Points.size(); i++)
+	{
+		d  = distance2pointsSqr(m_Points.at(i), p);
+		if(d < minD)
+		{
+			min_index = i;
+			minD = d;
+		}
+	}
+
+	return min_index;
+}
+
+int TrajectoryPointsGrid::GetClosestPointIndex(const GPSPoint& p) const
+{
+	// points out of the grid are only found by going through all of them
+	if(m_Width == 0 || m_PointIndices.size() != m_Points.size() || !std::isfinite(p.x) || !std::isfinite(p.y))
+		return GetClosestPointIndexLinear(p);
+
+	// cell of p, or the closest cell of the grid if p is out of it
+	int qx = std::max(std::min((p.x - m_MinX)/m_CellSize, (double)m_Width-1), 0.0);
+	int qy = std::max(std::min((p.y - m_MinY)/m_CellSize, (double)m_Height-1), 0.0);
+
+	double minD = 9999999999;
+	int min_index = -1;
+	int max_r = std::max(m_Width, m_Height);
+	for(int r = 0; r <= max_r; r++)
+	{
+		// the cells of the next rings are at least this far, a cell less for the rounding of the cell coordinates
+		double ring_distance = std::max(r-1, 0) * m_CellSize;
+		if(min_index >= 0 && ring_distance*ring_distance > minD)
+			break;
+
+		for(int cy = std::max(qy-r, 0); cy <= std::min(qy+r, m_Height-1); cy++)
+		{
+			// whole rows at the top and the bottom of the ring, both ends of the others
+			int step = (cy == qy-r || cy == qy+r) ? 1 : 2*r;
+			for(int cx = qx-r; cx <= qx+r; cx += std::max(step, 1))
+			{
+				if(cx < 0 || cx >= m_Width)
+					continue;
+
+				int c = cy*m_Width + cx;
+				for(int k = m_CellStart.at(c); k < m_CellStart.at(c+1); k++)
+				{
+					int i = m_PointIndices.at(k);
+					double d = distance2pointsSqr(m_Points.at(i), p);
+					if(d < minD || (d == minD && i < min_index))
+					{
+						min_index = i;
+						minD = d;
+					}
+				}
+			}
+		}
+	}
+
+	// the points which are not finite are never the closest
+	if(min_index < 0)
+		return GetClosestPointIndexLinear(p);
+
+	return min_index;
+}
+
 PlanningHelpers::PlanningHelpers()
 {
 }
@@ -87,6 +229,28 @@ bool PlanningHelpers::GetRelativeInfo(const std::vector<WayPoint>& trajectory, c
 {
 	if(trajectory.size() < 2) return false;
 
+	int iFront = 1;
+	if(trajectory.size() > 2)
+		iFront = GetClosestNextPointIndex(trajectory, p, prevIndex);
+
+	return GetRelativeInfoFromNextPoint(trajectory, p, iFront, info);
+}
+
+bool PlanningHelpers::GetRelativeInfo(const std::vector<WayPoint>& trajectory, const TrajectoryPointsGrid& trajectoryGrid, const WayPoint& p, RelativeInfo& info)
+{
+	if(trajectory.size() < 2) return false;
+
+	int iFront = 1;
+	if(trajectory.size() > 2)
+		iFront = GetNextPointIndexFromClosest(trajectory, p, trajectoryGrid.GetClosestPointIndex(p.pos));
+
+	return GetRelativeInfoFromNextPoint(trajectory, p, iFront, info);
+}
+
+bool PlanningHelpers::GetRelativeInfoFromNextPoint(const std::vector<WayPoint>& trajectory, const WayPoint& p, const int& iFront, RelativeInfo& info)
+{
+	if(trajectory.size() < 2) return false;
+
 	WayPoint p0, p1;
 	if(trajectory.size()==2)
 	{
@@ -99,7 +263,7 @@ bool PlanningHelpers::GetRelativeInfo(const std::vector<WayPoint>& trajectory, c
 	}
 	else
 	{
-		info.iFront = GetClosestNextPointIndex(trajectory, p, prevIndex);
+		info.iFront = iFront;
 
 		if(info.iFront > 0)
 			info.iBack = info.iFront -1;
@@ -247,6 +411,13 @@ int PlanningHelpers::GetClosestNextPointIndex(const vector<WayPoint>& trajectory
 		}
 	}
 
+	return GetNextPointIndexFromClosest(trajectory, p, min_index);
+}
+
+int PlanningHelpers::GetNextPointIndexFromClosest(const vector<WayPoint>& trajectory, const WayPoint& p, const int& closestIndex)
+{
+	int min_index = closestIndex;
+
 	if(min_index < (int)trajectory.size()-2)
 	{
 		GPSPoint curr, next;
@@ -177,6 +177,11 @@ void TrajectoryCosts::CalculateLateralAndLongitudinalCosts(vector<TrajectoryCost
 	m_SafetyBorder.points.push_back(top_left) ;
 	m_SafetyBorder.points.push_back(top_left_car) ;
 
+	// The safety border doesn't depend on the lane nor on the roll out
+	m_ObstacleInsideBorder.resize(contourPoints.size());
+	for(unsigned int icon = 0; icon < contourPoints.size(); icon++)
+		m_ObstacleInsideBorder.at(icon) = m_SafetyBorder.PointInsidePolygon(m_SafetyBorder, contourPoints.at(icon).pos) == true;
+
 	for(unsigned int il=0; il < rollOuts.size(); il++)
 	{
 		if(rollOuts.at(il).size() > 0 && rollOuts.at(il).at(0).size()>0)
@@ -184,15 +189,27 @@ void TrajectoryCosts::CalculateLateralAndLongitudinalCosts(vector<TrajectoryCost
 			RelativeInfo car_info;
 			PlanningHelpers::GetRelativeInfo(totalPaths.at(il), currState, car_info);
 
+			// Project the obstacle points on the lane once for all its roll outs
+			m_TotalPathGrid.SetTrajectory(totalPaths.at(il));
+			m_ObstaclePerpDistances.resize(contourPoints.size());
+			m_ObstacleLongitudinalDistances.resize(contourPoints.size());
+			for(unsigned int icon = 0; icon < contourPoints.size(); icon++)
+			{
+				RelativeInfo obj_info;
+				PlanningHelpers::GetRelativeInfo(totalPaths.at(il), m_TotalPathGrid, contourPoints.at(icon), obj_info);
+				double longitudinalDist = PlanningHelpers::GetExactDistanceOnTrajectory(totalPaths.at(il), car_info, obj_info);
+				if(obj_info.iFront == 0 && longitudinalDist > 0)
+					longitudinalDist = -longitudinalDist;
+
+				m_ObstaclePerpDistances.at(icon) = obj_info.perp_distance;
+				m_ObstacleLongitudinalDistances.at(icon) = longitudinalDist;
+			}
+
 			for(unsigned int it=0; it< rollOuts.at(il).size(); it++)
 			{
 				for(unsigned int icon = 0; icon < contourPoints.size(); icon++)
 				{
-					RelativeInfo obj_info;
-					PlanningHelpers::GetRelativeInfo(totalPaths.at(il), contourPoints.at(icon), obj_info);
-					double longitudinalDist = PlanningHelpers::GetExactDistanceOnTrajectory(totalPaths.at(il), car_info, obj_info);
-					if(obj_info.iFront == 0 && longitudinalDist > 0)
-						longitudinalDist = -longitudinalDist;
+					double longitudinalDist = m_ObstacleLongitudinalDistances.at(icon);
 
 					double close_in_percentage = 1;
 //					close_in_percentage = ((longitudinalDist- critical_long_front_distance)/params.rollInMargin)*4.0;
@@ -204,7 +221,7 @@ void TrajectoryCosts::CalculateLateralAndLongitudinalCosts(vector<TrajectoryCost
 					if(close_in_percentage < 1)
 						distance_from_center = distance_from_center - distance_from_center * (1.0-close_in_percentage);
 
-					double lateralDist = fabs(obj_info.perp_distance - distance_from_center);
+					double lateralDist = fabs(m_ObstaclePerpDistances.at(icon) - distance_from_center);
 
 					if(longitudinalDist < -carInfo.length || lateralDist > 6)
 					{
@@ -213,7 +230,7 @@ void TrajectoryCosts::CalculateLateralAndLongitudinalCosts(vector<TrajectoryCost
 
 					longitudinalDist = longitudinalDist - critical_long_front_distance;
 
-					if(m_SafetyBorder.PointInsidePolygon(m_SafetyBorder, contourPoints.at(icon).pos) == true)
+					if(m_ObstacleInsideBorder.at(icon))
 						trajectoryCosts.at(iCostIndex).bBlocked = true;
 
 					if(lateralDist <= critical_lateral_distance
@@ -0,0 +1,227 @@
+/*
+ * test_compact_grid_map.cpp
+ *
+ *  Applies the same updates to GridMap and CompactGridMap and compares them cell by cell.
+ */
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+#include <limits>
+#include "GridMap.h"
+#include "CompactGridMap.h"
+#include "PlannerH.h"
+
+using namespace PlannerHNS;
+
+class CompactGridMapTest : public ::testing::Test
+{
+protected:
+	unsigned int seed;
+
+	virtual void SetUp()
+	{
+		seed = 5;
+	}
+
+	double Rand(const double& min_v, const double& max_v)
+	{
+		return min_v + (max_v - min_v) * (double)rand_r(&seed) / (double)RAND_MAX;
+	}
+
+	int GetIndex(CELL_Info* pCell)
+	{
+		if(pCell)
+			return pCell->index;
+		return -1;
+	}
+
+	void ExpectSameCells(GridMap& grid, const CompactGridMap& compact)
+	{
+		ASSERT_EQ(grid.nCells, compact.nCells);
+		for(int i=0; i < grid.nCells; i++)
+		{
+			const CELL_Info& cell = grid.pCells[i];
+			EXPECT_EQ(std::min(cell.nStaticPoints, 255), compact.nStaticPoints[i]) << "cell " << i;
+			EXPECT_EQ(cell.nMovingPoints, compact.nMovingPoints[i]) << "cell " << i;
+			EXPECT_EQ(cell.heuristic, compact.heuristic[i]) << "cell " << i;
+			EXPECT_EQ(cell.localize_val, compact.localize_val[i]) << "cell " << i;
+			EXPECT_EQ(cell.localize_prob, compact.localize_prob[i]) << "cell " << i;
+
+			bool bObstacle = cell.nMovingPoints > 0 || cell.nStaticPoints > 0 || cell.heuristic == grid.m_MaxHeuristics;
+			EXPECT_EQ(bObstacle, compact.IsObstacleCell(i)) << "cell " << i;
+
+			POINT2D center = compact.GetCellCenter(i);
+			EXPECT_DOUBLE_EQ(cell.center.x, center.x);
+			EXPECT_DOUBLE_EQ(cell.center.y, center.y);
+
+			EXPECT_EQ(i, compact.GetCellIndex(cell.r, cell.c));
+			CompactCellInfo compactCell = compact.GetCell(i);
+			EXPECT_EQ(cell.r, compactCell.r);
+			EXPECT_EQ(cell.c, compactCell.c);
+			EXPECT_EQ(cell.index, compactCell.index);
+			EXPECT_DOUBLE_EQ(cell.center.x, compactCell.center.x);
+			EXPECT_DOUBLE_EQ(cell.center.y, compactCell.center.y);
+			EXPECT_DOUBLE_EQ(cell.bottom_left.x, compactCell.bottom_left.x);
+			EXPECT_DOUBLE_EQ(cell.bottom_left.y, compactCell.bottom_left.y);
+			EXPECT_DOUBLE_EQ(cell.top_right.x, compactCell.top_right.x);
+			EXPECT_DOUBLE_EQ(cell.top_right.y, compactCell.top_right.y);
+			EXPECT_EQ(std::min(cell.nStaticPoints, 255), compactCell.nStaticPoints);
+			EXPECT_EQ(cell.nMovingPoints, compactCell.nMovingPoints);
+			EXPECT_EQ(cell.localize_val, compactCell.localize_val);
+
+			const CompactSubCells* pSubCells = compact.GetSubCells(i);
+			unsigned int nStatic = 0, nMoving = 0;
+			if(cell.pInnerMap)
+			{
+				// GridMap also allocates the sub cells for points on the cell border which fall in none of them
+				for(int j=0; j < cell.nCells; j++)
+				{
+					EXPECT_EQ(cell.pInnerMap[j].nStaticPoints, pSubCells ? pSubCells->nStaticPoints[j] : 0);
+					EXPECT_EQ(cell.pInnerMap[j].nMovingPoints, pSubCells ? pSubCells->nMovingPoints[j] : 0);
+					nStatic += cell.pInnerMap[j].innerStaticPointsList.size();
+					nMoving += cell.pInnerMap[j].innerMovingPointsList.size();
+				}
+			}
+			EXPECT_EQ(nStatic, pSubCells ? pSubCells->innerStaticPointsList.size() : 0) << "cell " << i;
+			EXPECT_EQ(nMoving, pSubCells ? pSubCells->innerMovingPointsList.size() : 0) << "cell " << i;
+		}
+	}
+
+	void CompareMaps(double origin_x, double origin_y, double w, double h, double cell_l, bool bDefaultEmpty)
+	{
+		GridMap grid(origin_x, origin_y, w, h, cell_l, bDefaultEmpty);
+		CompactGridMap compact(origin_x, origin_y, w, h, cell_l, bDefaultEmpty);
+		ASSERT_EQ(grid.m_MaxHeuristics, compact.m_MaxHeuristics);
+		ExpectSameCells(grid, compact);
+
+		// every ClearMap mode, after static points, moving points, costs, rectangles and polygons, some of them outside the map
+		int clear_modes[] = {1, -1, 0, 1, 0, -1};
+		for(unsigned int s=0; s < sizeof(clear_modes)/sizeof(int); s++)
+		{
+			for(int k=0; k < 300; k++)
+			{
+				POINT2D p(Rand(origin_x - 5, origin_x + w + 5), Rand(origin_y - 5, origin_y + h + 5));
+				int op = k % 4;
+				if(op == 0)
+					EXPECT_EQ(GetIndex(grid.UpdateMapObstaclePoint(p)), compact.UpdateMapObstaclePoint(p));
+				else if(op == 1)
+					EXPECT_EQ(GetIndex(grid.UpdateMapMovingObstaclePoint(p)), compact.UpdateMapMovingObstaclePoint(p));
+				else if(op == 2)
+				{
+					double val = Rand(0, 100);
+					EXPECT_EQ(GetIndex(grid.UpdateMapCostValue(p, val, val/100.0)), compact.UpdateMapCostValue(p, val, val/100.0));
+				}
+				else if(k % 20 == 3)
+				{
+					Obstacle ob;
+					ob.sp = p;
+					ob.ep = POINT2D(p.x + Rand(0, 5), p.y + Rand(0, 5));
+					if(k % 40 == 3)
+					{
+						ob.polygon.push_back(ob.sp);
+						ob.polygon.push_back(POINT2D(ob.ep.x, ob.sp.y));
+						ob.polygon.push_back(ob.ep);
+						ob.polygon.push_back(POINT2D(ob.sp.x, ob.ep.y));
+					}
+					grid.UpdateMapObstacleValue(ob);
+					compact.UpdateMapObstacleValue(ob);
+				}
+			}
+
+			ExpectSameCells(grid, compact);
+
+			for(int k=0; k < 500; k++)
+			{
+				POINT2D p(Rand(origin_x - 5, origin_x + w + 5), Rand(origin_y - 5, origin_y + h + 5));
+				CompactCellInfo compactCell;
+				EXPECT_EQ(GetIndex(grid.GetCellFromPoint(p)), compact.GetCellIndexFromPoint(p));
+				EXPECT_EQ(grid.GetCellFromPoint(p) != 0, compact.GetCellFromPoint(p, compactCell));
+				EXPECT_EQ(GetIndex(grid.GetCellFromPoint(p)), compactCell.index);
+			}
+
+			grid.ClearMap(clear_modes[s]);
+			compact.ClearMap(clear_modes[s]);
+			ExpectSameCells(grid, compact);
+		}
+	}
+};
+
+TEST_F(CompactGridMapTest, ExtremeRectangles)
+{
+	GridMap grid(-20, -10, 40, 30, 0.5, true);
+	CompactGridMap compact(-20, -10, 40, 30, 0.5, true);
+
+	// far outside on each side, larger than the map, non finite
+	double inf = std::numeric_limits<double>::infinity();
+	double rects[][4] = {{-1e300, -1e300, -1e299, -1e299}, {1e299, 1e299, 1e300, 1e300}, {-1e300, 0, 1e300, 1},
+			{0, -1e300, 1, 1e300}, {-inf, -inf, inf, inf}, {std::nan(""), 0, 1, 1}, {0, 0, std::nan(""), std::nan("")}};
+	for(unsigned int i=0; i < sizeof(rects)/sizeof(rects[0]); i++)
+	{
+		Obstacle ob;
+		ob.sp = POINT2D(rects[i][0], rects[i][1]);
+		ob.ep = POINT2D(rects[i][2], rects[i][3]);
+		grid.UpdateMapObstacleValue(ob);
+		compact.UpdateMapObstacleValue(ob);
+		ExpectSameCells(grid, compact);
+	}
+
+	CompactCellInfo compactCell;
+	EXPECT_EQ(-1, compact.GetCellIndex(-1, 0));
+	EXPECT_EQ(-1, compact.GetCellIndex(0, compact.wCells));
+	EXPECT_EQ(-1, compact.GetCell(compact.nCells).index);
+	EXPECT_FALSE(compact.GetCellFromPoint(POINT2D(std::nan(""), 0), compactCell));
+}
+
+TEST_F(CompactGridMapTest, ReedSheppObstacleDetection)
+{
+	GridMap grid(-20, -20, 40, 40, 1.0, true);
+	CompactGridMap compact(-20, -20, 40, 40, 1.0, true);
+	for(int k=0; k < 30; k++)
+	{
+		POINT2D p(Rand(-20, 20), Rand(-20, 20));
+		grid.UpdateMapObstaclePoint(p);
+		compact.UpdateMapObstaclePoint(p);
+	}
+
+	PlannerH planner;
+	int nPlanned = 0, nBlocked = 0;
+	for(int k=0; k < 200; k++)
+	{
+		WayPoint start(Rand(-15, 15), Rand(-15, 15), 0, Rand(-M_PI, M_PI));
+		WayPoint goal(Rand(-15, 15), Rand(-15, 15), 0, Rand(-M_PI, M_PI));
+		std::vector<WayPoint> gridPath, compactPath;
+		double gridLength = planner.PlanUsingReedSheppWithObstacleDetection(start, goal, grid, gridPath);
+		double compactLength = planner.PlanUsingReedSheppWithObstacleDetection(start, goal, compact, compactPath);
+		EXPECT_EQ(gridLength, compactLength) << "plan " << k;
+		ASSERT_EQ(gridPath.size(), compactPath.size()) << "plan " << k;
+		if(gridPath.size() > 0)
+			nPlanned++;
+		else
+			nBlocked++;
+	}
+	EXPECT_GT(nPlanned, 0);
+	EXPECT_GT(nBlocked, 0);
+}
+
+TEST_F(CompactGridMapTest, EmptyMap)
+{
+	CompareMaps(-20, -10, 40, 30, 0.5, true);
+}
+
+TEST_F(CompactGridMapTest, OccupiedMap)
+{
+	CompareMaps(3, -7, 25, 40, 1.0, false);
+}
+
+TEST_F(CompactGridMapTest, RoundedMapSize)
+{
+	CompareMaps(-5.5, 2.25, 17.3, 11.9, 0.75, true);
+}
+
+int main(int argc, char **argv)
+{
+	testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,263 @@
+/*
+ * test_trajectory_costs.cpp
+ *
+ *  Projects obstacle contours on the lanes of a vector map, loaded with ConstructRoadNetworkFromDataFiles like op_simu
+ *  does, once through all the lane points and once through TrajectoryPointsGrid as TrajectoryCosts does, and compares
+ *  the results.
+ *
+ *  The map is written to a temporary folder: an S curve, a lane next to it and a hairpin. Set OP_PLANNER_TEST_VECTOR_MAP
+ *  to the vector_map folder of a real map (point.csv, dtlane.csv, lane.csv, ...) to run on its lanes instead.
+ */
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include "MappingHelpers.h"
+#include "PlanningHelpers.h"
+#include "TrajectoryCosts.h"
+
+using namespace PlannerHNS;
+
+#define PATH_DENSITY 0.5 //meters
+#define CONTOUR_DENSITY 0.2 //meters
+#define CARS_DISTANCE 8.0 //meters
+#define STEP_DISTANCE 5.0 //meters
+
+class TrajectoryCostsTest : public ::testing::Test
+{
+protected:
+	std::string m_MapFolder;
+	std::string m_TempFolder;
+	RoadNetwork m_Map;
+	CAR_BASIC_INFO m_CarInfo;
+
+	virtual void SetUp()
+	{
+		const char* vectorMap = getenv("OP_PLANNER_TEST_VECTOR_MAP");
+		if(vectorMap && vectorMap[0] != 0)
+		{
+			m_MapFolder = vectorMap;
+			if(m_MapFolder.at(m_MapFolder.size()-1) != '/')
+				m_MapFolder += "/";
+		}
+		else
+		{
+			char folder[] = "/tmp/op_planner_test_XXXXXX";
+			ASSERT_TRUE(mkdtemp(folder) != 0);
+			m_TempFolder = folder;
+			m_MapFolder = m_TempFolder + "/";
+			WriteVectorMap();
+		}
+
+		MappingHelpers::ConstructRoadNetworkFromDataFiles(m_MapFolder, m_Map, true);
+	}
+
+	virtual void TearDown()
+	{
+		if(m_TempFolder.size() > 0)
+		{
+			remove((m_MapFolder + "point.csv").c_str());
+			remove((m_MapFolder + "dtlane.csv").c_str());
+			remove((m_MapFolder + "lane.csv").c_str());
+			rmdir(m_TempFolder.c_str());
+		}
+	}
+
+	// One lane.csv row per point, the rows of a lane linked by BLID and FLID
+	void WriteVectorMap()
+	{
+		std::vector<std::vector<GPSPoint> > lanes(3);
+		for(double d = 0; d <= 120; d += 1.0)
+		{
+			double y = 8.0 * sin(d / 20.0);
+			double a = atan2(8.0 / 20.0 * cos(d / 20.0), 1.0);
+			lanes.at(0).push_back(GPSPoint(d, y, 0, a));
+			lanes.at(1).push_back(GPSPoint(d - 3.5 * sin(a), y + 3.5 * cos(a), 0, a));
+		}
+		for(double d = 0; d <= 60; d += 1.0)
+		{
+			// 20 m out, half a turn of 6 m radius, 20 m back
+			GPSPoint p(40 + d, -20, 0, 0);
+			if(d > 20 && d < 20 + M_PI * 6)
+			{
+				double t = (d - 20) / 6.0;
+				p = GPSPoint(60 + 6 * sin(t), -14 - 6 * cos(t), 0, t);
+			}
+			else if(d >= 20 + M_PI * 6)
+				p = GPSPoint(60 - (d - 20 - M_PI * 6), -8, 0, M_PI);
+			lanes.at(2).push_back(p);
+		}
+
+		std::ofstream points((m_MapFolder + "point.csv").c_str());
+		std::ofstream dtlanes((m_MapFolder + "dtlane.csv").c_str());
+		std::ofstream lane_rows((m_MapFolder + "lane.csv").c_str());
+		points << "PID,B,L,H,Bx,Ly,ReF,MCODE1,MCODE2,MCODE3" << std::endl;
+		dtlanes << "DID,Dist,PID,Dir,Apara,r,slope,cant,LW,RW" << std::endl;
+		lane_rows << "LnID,DID,BLID,FLID,BNID,FNID,JCT,BLID2,BLID3,BLID4,FLID2,FLID3,FLID4,ClossID,Span,LCnt,Lno,LaneType,LimitVel,RefVel,RoadSecID,LaneChgFG,LinkWAID" << std::endl;
+		points.precision(12);
+		dtlanes.precision(12);
+
+		int id = 1;
+		for(unsigned int l = 0; l < lanes.size(); l++)
+		{
+			for(unsigned int i = 0; i < lanes.at(l).size(); i++, id++)
+			{
+				const GPSPoint& p = lanes.at(l).at(i);
+				int blid = i > 0 ? id - 1 : 0;
+				int flid = i + 1 < lanes.at(l).size() ? id + 1 : 0;
+				points << id << ",0,0," << p.z << "," << p.y << "," << p.x << ",7,0,0,0" << std::endl;
+				dtlanes << id << "," << i << "," << id << "," << p.a << ",0,90000000000,0,0,1.5,1.5" << std::endl;
+				lane_rows << id << "," << id << "," << blid << "," << flid << ",0,0,0,0,0,0,0,0,0,0,1,1,1,0,40,40,1,0,0" << std::endl;
+			}
+		}
+	}
+
+	// Contour of a car on the lane point, shifted sideways
+	void AddCarContour(const WayPoint& center, double shift, std::vector<WayPoint>& contourPoints)
+	{
+		double x = center.pos.x - shift * sin(center.pos.a);
+		double y = center.pos.y + shift * cos(center.pos.a);
+		double corners[5][2] = {{-m_CarInfo.length/2.0, -m_CarInfo.width/2.0}, {m_CarInfo.length/2.0, -m_CarInfo.width/2.0},
+				{m_CarInfo.length/2.0, m_CarInfo.width/2.0}, {-m_CarInfo.length/2.0, m_CarInfo.width/2.0}, {-m_CarInfo.length/2.0, -m_CarInfo.width/2.0}};
+
+		for(unsigned int i = 0; i < 4; i++)
+		{
+			double side = hypot(corners[i+1][0] - corners[i][0], corners[i+1][1] - corners[i][1]);
+			for(double d = 0; d < side; d += CONTOUR_DENSITY)
+			{
+				double lx = corners[i][0] + (corners[i+1][0] - corners[i][0])*d/side;
+				double ly = corners[i][1] + (corners[i+1][1] - corners[i][1])*d/side;
+				WayPoint p;
+				p.pos.x = x + lx*cos(center.pos.a) - ly*sin(center.pos.a);
+				p.pos.y = y + lx*sin(center.pos.a) + ly*cos(center.pos.a);
+				contourPoints.push_back(p);
+			}
+		}
+	}
+};
+
+TEST_F(TrajectoryCostsTest, GridProjectionSameAsLinear)
+{
+	ASSERT_EQ(1u, m_Map.roadSegments.size());
+	const std::vector<Lane>& lanes = m_Map.roadSegments.at(0).Lanes;
+	if(m_TempFolder.size() > 0)
+		ASSERT_EQ(3u, lanes.size());
+
+	// Cars along every lane, on it and beside it, so each lane also sees the cars of the others
+	std::vector<WayPoint> contourPoints;
+	for(unsigned int l = 0; l < lanes.size(); l++)
+	{
+		const std::vector<WayPoint>& points = lanes.at(l).points;
+		double d = 0;
+		for(unsigned int i = 1; i < points.size(); i++)
+		{
+			d += distance2points(points.at(i-1).pos, points.at(i).pos);
+			if(d < CARS_DISTANCE)
+				continue;
+			d = 0;
+			AddCarContour(points.at(i), (i % 3) * 1.5 - 1.5, contourPoints);
+		}
+	}
+	ASSERT_GT(contourPoints.size(), 0u);
+
+	TrajectoryPointsGrid pathGrid;
+	int nLanes = 0, nProjections = 0;
+	for(unsigned int l = 0; l < lanes.size(); l++)
+	{
+		// Global path as the planner makes it from the lane
+		std::vector<WayPoint> path = lanes.at(l).points;
+		PlanningHelpers::FixPathDensity(path, PATH_DENSITY);
+		if(path.size() < 3)
+			continue;
+		PlanningHelpers::CalcAngleAndCost(path);
+		pathGrid.SetTrajectory(path);
+		nLanes++;
+
+		int step = STEP_DISTANCE / PATH_DENSITY;
+		for(unsigned int iCar = 0; iCar < path.size(); iCar += step)
+		{
+			RelativeInfo car_info;
+			PlanningHelpers::GetRelativeInfo(path, path.at(iCar), car_info);
+
+			for(unsigned int icon = 0; icon < contourPoints.size(); icon++)
+			{
+				RelativeInfo linear_info, grid_info;
+				PlanningHelpers::GetRelativeInfo(path, contourPoints.at(icon), linear_info);
+				PlanningHelpers::GetRelativeInfo(path, pathGrid, contourPoints.at(icon), grid_info);
+
+				EXPECT_EQ(linear_info.iFront, grid_info.iFront) << "lane " << l << ", point " << icon;
+				EXPECT_EQ(linear_info.iBack, grid_info.iBack) << "lane " << l << ", point " << icon;
+				EXPECT_EQ(linear_info.perp_distance, grid_info.perp_distance) << "lane " << l << ", point " << icon;
+				EXPECT_EQ(PlanningHelpers::GetExactDistanceOnTrajectory(path, car_info, linear_info),
+						PlanningHelpers::GetExactDistanceOnTrajectory(path, car_info, grid_info)) << "lane " << l << ", point " << icon;
+				nProjections++;
+			}
+		}
+	}
+	EXPECT_GT(nLanes, 0);
+	EXPECT_GT(nProjections, 0);
+}
+
+TEST_F(TrajectoryCostsTest, CarOnLaneBlocksCenterRollOut)
+{
+	const std::vector<Lane>& lanes = m_Map.roadSegments.at(0).Lanes;
+	ASSERT_GT(lanes.size(), 0u);
+
+	std::vector<std::vector<WayPoint> > totalPaths(1, lanes.at(0).points);
+	PlanningHelpers::FixPathDensity(totalPaths.at(0), PATH_DENSITY);
+	PlanningHelpers::CalcAngleAndCost(totalPaths.at(0));
+	ASSERT_GT(totalPaths.at(0).size(), 40u);
+
+	// Roll outs shifted sideways from the lane
+	PlanningParams params;
+	std::vector<std::vector<std::vector<WayPoint> > > rollOuts(1);
+	for(int it = 0; it <= params.rollOutNumber; it++)
+	{
+		double shift = (it - params.rollOutNumber/2) * params.rollOutDensity;
+		std::vector<WayPoint> rollOut = totalPaths.at(0);
+		for(unsigned int i = 0; i < rollOut.size(); i++)
+		{
+			rollOut.at(i).pos.x -= shift*sin(rollOut.at(i).pos.a);
+			rollOut.at(i).pos.y += shift*cos(rollOut.at(i).pos.a);
+		}
+		rollOuts.at(0).push_back(rollOut);
+	}
+
+	// A stopped car a few meters ahead on the lane
+	WayPoint currState = totalPaths.at(0).at(0);
+	DetectedObject obj;
+	obj.l = m_CarInfo.length;
+	obj.w = m_CarInfo.width;
+	obj.center = totalPaths.at(0).at(16);
+	std::vector<WayPoint> contourPoints;
+	AddCarContour(obj.center, 0, contourPoints);
+	for(unsigned int icon = 0; icon < contourPoints.size(); icon++)
+		obj.contour.push_back(contourPoints.at(icon).pos);
+	std::vector<DetectedObject> obj_list(1, obj);
+
+	TrajectoryCosts costsCalculator;
+	VehicleState vehicleState;
+	costsCalculator.DoOneStep(rollOuts, totalPaths, currState, params.rollOutNumber/2, 0, params, m_CarInfo, vehicleState, obj_list);
+	ASSERT_EQ(rollOuts.at(0).size(), costsCalculator.m_TrajectoryCosts.size());
+	EXPECT_TRUE(costsCalculator.m_TrajectoryCosts.at(params.rollOutNumber/2).bBlocked);
+
+	// Same costs when the buffers of the previous step are reused
+	std::vector<TrajectoryCost> first = costsCalculator.m_TrajectoryCosts;
+	costsCalculator.DoOneStep(rollOuts, totalPaths, currState, params.rollOutNumber/2, 0, params, m_CarInfo, vehicleState, obj_list);
+	for(unsigned int i = 0; i < first.size(); i++)
+	{
+		EXPECT_EQ(first.at(i).bBlocked, costsCalculator.m_TrajectoryCosts.at(i).bBlocked);
+		EXPECT_EQ(first.at(i).lateral_cost, costsCalculator.m_TrajectoryCosts.at(i).lateral_cost);
+		EXPECT_EQ(first.at(i).longitudinal_cost, costsCalculator.m_TrajectoryCosts.at(i).longitudinal_cost);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -9,7 +9,7 @@
 #define PLANNERTESTDRAW_H_
 #include <iostream>
 #include "DrawObjBase.h"
-#include "GridMap.h"
+#include "CompactGridMap.h"
 #include "RoadNetwork.h"
 #include "CarState.h"
 #include "DrawingHelpers.h"
@@ -48,7 +48,7 @@ public:
 
 public:
 	 PlannerHNS::RoadNetwork m_RoadMap;
-	PlannerHNS::GridMap* m_pMap;
+	PlannerHNS::CompactGridMap* m_pMap;
 	std::vector<PlannerHNS::WayPoint> m_goals;
 	int m_iCurrentGoal;
 	PlannerHNS::WayPoint m_start;
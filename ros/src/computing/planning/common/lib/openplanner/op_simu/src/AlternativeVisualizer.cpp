@@ -27,6 +27,8 @@ namespace Graphics
 
 AlternativeVisualizer::AlternativeVisualizer()
 {
+	m_pMap = 0;
+
 	/**
 	 * Writing the kml file for the RoadNetwork Map
 	 */
@@ -242,7 +242,7 @@ PlannerTestDraw::PlannerTestDraw()
 //	PlannerHNS::MappingHelpers::WriteKML(kml_fileToSave, kml_templateFilePath, m_RoadMap);
 
 
-	m_pMap = new PlannerHNS::GridMap(0,0,60,60,5.0, true);
+	m_pMap = new PlannerHNS::CompactGridMap(0,0,60,60,5.0, true);
 
 	m_CarInfo.width = 2.0;
 	m_CarInfo.length = 4.2;
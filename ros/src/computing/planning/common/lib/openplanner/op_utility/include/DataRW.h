@@ -13,6 +13,7 @@
 #include <sstream>
 #include <vector>
 #include <iostream>
+#include <utility>
 
 namespace UtilityHNS {
 
@@ -38,7 +39,13 @@ public:
 class SimpleReaderBase
 {
 private:
-	std::ifstream* m_pFile;
+	void* m_pMappedFile;
+	std::vector<char> m_FileBuffer; // used when the file can't be mapped
+	const char* m_pData;
+	size_t m_DataSize;
+	size_t m_iPos;
+	bool m_bEOF;
+	std::vector<std::pair<const char*, const char*> > m_Fields; // [begin, end) of each field of the current line
 	std::vector<std::string> m_RawHeaders;
 	std::vector<std::string> m_DataTitlesHeader;
 	std::vector<std::vector<std::vector<std::string> > > m_AllData;
@@ -49,13 +56,19 @@ private:
 	std::string m_HeaderRepeatKey;
 	char m_Separator;
 
+	SimpleReaderBase(const SimpleReaderBase&);
+	SimpleReaderBase& operator=(const SimpleReaderBase&);
+
 	void ReadHeaders();
 	void ParseDataTitles(const std::string& header);
+	bool ReadLine(const char*& pBegin, const char*& pEnd);
+	void SplitLine(const char* pBegin, const char* pEnd);
+	const char* FieldCString(const unsigned int& i, char* buff, const unsigned int& buffSize, std::string& longField) const;
 
 public:
 	/**
 	 *
-	 * @param fileName log file name
+	 * @param fileName log file name, the file is memory mapped and parsed in place
 	 * @param nHeaders number of data headers
 	 * @param iDataTitles which row contains the data titles
 	 * @param nVariablesForOneObject 0 means each row represents one object
@@ -69,6 +82,15 @@ protected:
 	int ReadAllData();
 	bool ReadSingleLine(std::vector<std::vector<std::string> >& line);
 
+	/**
+	 * @brief split the next line into fields without copying it, same lines and fields as ReadSingleLine when each row represents one object
+	 * @return false at the end of the file
+	 */
+	bool ReadNextFields();
+	unsigned int FieldsCount() const { return m_Fields.size(); }
+	double FieldDouble(const unsigned int& i) const;
+	long FieldLong(const unsigned int& i) const;
+	std::string FieldString(const unsigned int& i) const;
 };
 
 //class GPSLocalizerReader : public SimpleReaderBase
@@ -7,6 +7,11 @@
 
 #include "DataRW.h"
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <tinyxml.h>
 #include "UtilityH.h"
 
@@ -167,67 +172,179 @@ SimpleReaderBase::SimpleReaderBase(const string& fileName, const int& nHeaders,c
 		  const int& iDataTitles, const int& nVariablesForOneObject ,
 		  const int& nLineHeaders, const string& headerRepeatKey)
 {
-	  m_pFile = new ifstream(fileName.c_str(), ios::in);
-	  if(!m_pFile->is_open())
-	  {
-		  printf("\n Can't Open Map File !, %s", fileName.c_str());
-		  return;
-	  }
-
+	m_pMappedFile = 0;
+	m_pData = 0;
+	m_DataSize = 0;
+	m_iPos = 0;
+	m_bEOF = true;
 	m_nHeders = nHeaders;
 	m_iDataTitles = iDataTitles;
 	m_nVarPerObj = nVariablesForOneObject;
 	m_HeaderRepeatKey = headerRepeatKey;
 	m_nLineHeaders = nLineHeaders;
 	m_Separator = separator;
-	m_pFile->precision(16);
+
+	int fd = open(fileName.c_str(), O_RDONLY);
+	if(fd < 0)
+	{
+		printf("\n Can't Open Map File !, %s", fileName.c_str());
+		return;
+	}
+
+	struct stat fileStat;
+	if(fstat(fd, &fileStat) == 0 && S_ISREG(fileStat.st_mode) && fileStat.st_size > 0)
+	{
+		void* pMap = mmap(0, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(pMap != MAP_FAILED)
+		{
+			madvise(pMap, fileStat.st_size, MADV_SEQUENTIAL);
+			m_pMappedFile = pMap;
+			m_pData = (const char*)pMap;
+			m_DataSize = fileStat.st_size;
+		}
+	}
+
+	if(m_pMappedFile == 0)
+	{
+		char buff[4096];
+		ssize_t nRead = 0;
+		while((nRead = read(fd, buff, sizeof(buff))) > 0)
+			m_FileBuffer.insert(m_FileBuffer.end(), buff, buff + nRead);
+
+		if(m_FileBuffer.size() > 0)
+			m_pData = &m_FileBuffer[0];
+		m_DataSize = m_FileBuffer.size();
+	}
+
+	close(fd);
+	m_bEOF = false;
 
 	ReadHeaders();
 }
 
 SimpleReaderBase::~SimpleReaderBase()
 {
-	if(m_pFile->is_open())
-		m_pFile->close();
+	if(m_pMappedFile != 0)
+		munmap(m_pMappedFile, m_DataSize);
 }
 
-bool SimpleReaderBase::ReadSingleLine(vector<vector<string> >& line)
+bool SimpleReaderBase::ReadLine(const char*& pBegin, const char*& pEnd)
 {
-	if(!m_pFile->is_open() || m_pFile->eof()) return false;
+	if(m_bEOF) return false;
+
+	// same lines as getline, the last one is empty when the file ends with a new line
+	pBegin = m_pData + m_iPos;
+	pEnd = 0;
+	if(m_iPos < m_DataSize)
+		pEnd = (const char*)memchr(pBegin, '\n', m_DataSize - m_iPos);
 
-	string strLine, innerToken;
+	if(pEnd == 0)
+	{
+		pEnd = m_pData + m_DataSize;
+		m_iPos = m_DataSize;
+		m_bEOF = true;
+	}
+	else
+		m_iPos = pEnd - m_pData + 1;
+
+	return true;
+}
+
+void SimpleReaderBase::SplitLine(const char* pBegin, const char* pEnd)
+{
+	// same fields as getline with the separator, no empty field after a trailing separator
+	m_Fields.clear();
+	const char* p = pBegin;
+	while(p < pEnd)
+	{
+		const char* pSep = (const char*)memchr(p, m_Separator, pEnd - p);
+		if(pSep == 0)
+		{
+			m_Fields.push_back(make_pair(p, pEnd));
+			break;
+		}
+
+		m_Fields.push_back(make_pair(p, pSep));
+		p = pSep + 1;
+	}
+}
+
+bool SimpleReaderBase::ReadNextFields()
+{
+	const char* pBegin = 0;
+	const char* pEnd = 0;
+	if(!ReadLine(pBegin, pEnd)) return false;
+
+	SplitLine(pBegin, pEnd);
+	return true;
+}
+
+const char* SimpleReaderBase::FieldCString(const unsigned int& i, char* buff, const unsigned int& buffSize, string& longField) const
+{
+	const pair<const char*, const char*>& field = m_Fields.at(i);
+	size_t len = field.second - field.first;
+	if(len >= buffSize)
+	{
+		longField.assign(field.first, field.second);
+		return longField.c_str();
+	}
+
+	memcpy(buff, field.first, len);
+	buff[len] = 0;
+	return buff;
+}
+
+double SimpleReaderBase::FieldDouble(const unsigned int& i) const
+{
+	char buff[64];
+	string longField;
+	return strtod(FieldCString(i, buff, sizeof(buff), longField), NULL);
+}
+
+long SimpleReaderBase::FieldLong(const unsigned int& i) const
+{
+	char buff[64];
+	string longField;
+	return strtol(FieldCString(i, buff, sizeof(buff), longField), NULL, 10);
+}
+
+string SimpleReaderBase::FieldString(const unsigned int& i) const
+{
+	const pair<const char*, const char*>& field = m_Fields.at(i);
+	return string(field.first, field.second);
+}
+
+bool SimpleReaderBase::ReadSingleLine(vector<vector<string> >& line)
+{
 	line.clear();
-	getline(*m_pFile, strLine);
-	istringstream str_stream(strLine);
+	if(!ReadNextFields()) return false;
 
 	vector<string> header;
 	vector<string> obj_part;
 
 	if(m_nVarPerObj == 0)
 	{
-		while(getline(str_stream, innerToken, m_Separator))
-		{
-			obj_part.push_back(innerToken);
-		}
+		for(unsigned int i = 0; i < m_Fields.size(); i++)
+			obj_part.push_back(FieldString(i));
 
 		line.push_back(obj_part);
 		return true;
 	}
 	else
 	{
-		int iCounter = 0;
-		while(iCounter < m_nLineHeaders && getline(str_stream, innerToken, m_Separator))
+		unsigned int iField = 0;
+		while((int)iField < m_nLineHeaders && iField < m_Fields.size())
 		{
-			header.push_back(innerToken);
-			iCounter++;
+			header.push_back(FieldString(iField));
+			iField++;
 		}
 		obj_part.insert(obj_part.begin(), header.begin(), header.end());
 
-		iCounter = 1;
+		int iCounter = 1;
 
-		while(getline(str_stream, innerToken, m_Separator))
+		for(; iField < m_Fields.size(); iField++)
 		{
-			obj_part.push_back(innerToken);
+			obj_part.push_back(FieldString(iField));
 			if(iCounter == m_nVarPerObj)
 			{
 				line.push_back(obj_part);
@@ -246,11 +363,11 @@ bool SimpleReaderBase::ReadSingleLine(vector<vector<string> >& line)
 
 int SimpleReaderBase::ReadAllData()
 {
-	if(!m_pFile->is_open()) return 0;
+	if(m_bEOF) return 0;
 
 	m_AllData.clear();
 	vector<vector<string> > singleLine;
-	while(!m_pFile->eof())
+	while(!m_bEOF)
 	{
 		ReadSingleLine(singleLine);
 		m_AllData.push_back(singleLine);
@@ -261,14 +378,13 @@ int SimpleReaderBase::ReadAllData()
 
 void SimpleReaderBase::ReadHeaders()
 {
-	if(!m_pFile->is_open()) return;
-
-	string strLine;
+	const char* pBegin = 0;
+	const char* pEnd = 0;
 	int iCounter = 0;
 	m_RawHeaders.clear();
-	while(!m_pFile->eof() && iCounter < m_nHeders)
+	while(iCounter < m_nHeders && ReadLine(pBegin, pEnd))
 	{
-		getline(*m_pFile, strLine);
+		string strLine(pBegin, pEnd);
 		m_RawHeaders.push_back(strLine);
 		if(iCounter == m_iDataTitles)
 			ParseDataTitles(strLine);
@@ -280,28 +396,27 @@ void SimpleReaderBase::ParseDataTitles(const string& header)
 {
 	if(header.size()==0) return;
 
-	string innerToken;
-	istringstream str_stream(header);
+	SplitLine(header.c_str(), header.c_str() + header.size());
 	m_DataTitlesHeader.clear();
-	while(getline(str_stream, innerToken, m_Separator))
+	for(unsigned int i = 0; i < m_Fields.size(); i++)
 	{
+		string innerToken = FieldString(i);
 		if(innerToken.compare(m_HeaderRepeatKey)!=0)
 			m_DataTitlesHeader.push_back(innerToken);
 	}
+	m_Fields.clear();
 }
 
 bool GPSDataReader::ReadNextLine(GPSBasicData& data)
 {
-	vector<vector<string> > lineData;
-	if(ReadSingleLine(lineData))
+	if(ReadNextFields())
 	{
-		if(lineData.size()==0) return false;
-		if(lineData.at(0).size() < 5) return false;
+		if(FieldsCount() < 6) return false;
 
-		data.lat = strtod(lineData.at(0).at(2).c_str(), NULL);
-		data.lon = strtod(lineData.at(0).at(3).c_str(), NULL);
-		data.alt = strtod(lineData.at(0).at(4).c_str(), NULL);
-		data.distance = strtod(lineData.at(0).at(5).c_str(), NULL);
+		data.lat = FieldDouble(2);
+		data.lon = FieldDouble(3);
+		data.alt = FieldDouble(4);
+		data.distance = FieldDouble(5);
 
 		return true;
 
@@ -325,18 +440,16 @@ int GPSDataReader::ReadAllData(vector<GPSBasicData>& data_list)
 
 bool SimulationFileReader::ReadNextLine(SimulationPoint& data)
 {
-	vector<vector<string> > lineData;
-	if(ReadSingleLine(lineData))
+	if(ReadNextFields())
 	{
-		if(lineData.size()==0) return false;
-		if(lineData.at(0).size() < 5) return false;
+		if(FieldsCount() < 6) return false;
 
-		data.x = strtod(lineData.at(0).at(0).c_str(), NULL);
-		data.y = strtod(lineData.at(0).at(1).c_str(), NULL);
-		data.z = strtod(lineData.at(0).at(2).c_str(), NULL);
-		data.a = strtod(lineData.at(0).at(3).c_str(), NULL);
-		data.c = strtod(lineData.at(0).at(4).c_str(), NULL);
-		data.v = strtod(lineData.at(0).at(5).c_str(), NULL);
+		data.x = FieldDouble(0);
+		data.y = FieldDouble(1);
+		data.z = FieldDouble(2);
+		data.a = FieldDouble(3);
+		data.c = FieldDouble(4);
+		data.v = FieldDouble(5);
 
 		return true;
 
@@ -368,18 +481,16 @@ int SimulationFileReader::ReadAllData(SimulationData& data_list)
 
 bool LocalizationPathReader::ReadNextLine(LocalizationWayPoint& data)
 {
-	vector<vector<string> > lineData;
-	if(ReadSingleLine(lineData))
+	if(ReadNextFields())
 	{
-		if(lineData.size()==0) return false;
-		if(lineData.at(0).size() < 5) return false;
+		if(FieldsCount() < 5) return false;
 
-		//data.t = strtod(lineData.at(0).at(0).c_str(), NULL);
-		data.x = strtod(lineData.at(0).at(0).c_str(), NULL);
-		data.y = strtod(lineData.at(0).at(1).c_str(), NULL);
-		data.z = strtod(lineData.at(0).at(2).c_str(), NULL);
-		data.a = strtod(lineData.at(0).at(3).c_str(), NULL);
-		data.v = strtod(lineData.at(0).at(4).c_str(), NULL);
+		//data.t = FieldDouble(0);
+		data.x = FieldDouble(0);
+		data.y = FieldDouble(1);
+		data.z = FieldDouble(2);
+		data.a = FieldDouble(3);
+		data.v = FieldDouble(4);
 
 		return true;
 
@@ -404,14 +515,12 @@ int LocalizationPathReader::ReadAllData(vector<LocalizationWayPoint>& data_list)
 
 bool AisanNodesFileReader::ReadNextLine(AisanNode& data)
 {
-	vector<vector<string> > lineData;
-	if(ReadSingleLine(lineData))
+	if(ReadNextFields())
 	{
-		if(lineData.size()==0) return false;
-		if(lineData.at(0).size() < 10) return false;
+		if(FieldsCount() < 10) return false;
 
-		data.NID = strtol(lineData.at(0).at(0).c_str(), NULL, 10);
-		data.PID = strtol(lineData.at(0).at(1).c_str(), NULL, 10);
+		data.NID = FieldLong(0);
+		data.PID = FieldLong(1);
 
 		return true;
 
@@ -436,23 +545,21 @@ int AisanNodesFileReader::ReadAllData(vector<AisanNode>& data_list)
 
 bool AisanPointsFileReader::ReadNextLine(AisanPoints& data)
 {
-	vector<vector<string> > lineData;
-	if(ReadSingleLine(lineData))
+	if(ReadNextFields())
 	{
-		if(lineData.size()==0) return false;
-		if(lineData.at(0).size() < 10) return false;
+		if(FieldsCount() < 10) return false;
 
-		data.PID = strtol(lineData.at(0).at(0).c_str(), NULL, 10);
-		data.B = strtod(lineData.at(0)[1].c_str(), NULL);
-		data.L = strtod(lineData.at(0)[2].c_str(), NULL);
-		data.H = strtod(lineData.at(0)[3].c_str(), NULL);
+		data.PID = FieldLong(0);
+		data.B = FieldDouble(1);
+		data.L = FieldDouble(2);
+		data.H = FieldDouble(3);
 
-		data.Bx = strtod(lineData.at(0)[4].c_str(), NULL);
-		data.Ly = strtod(lineData.at(0)[5].c_str(), NULL);
-		data.Ref = strtol(lineData.at(0).at(6).c_str(), NULL, 10);
-		data.MCODE1 = strtol(lineData.at(0).at(7).c_str(), NULL, 10);
-		data.MCODE2 = strtol(lineData.at(0).at(8).c_str(), NULL, 10);
-		data.MCODE3 = strtol(lineData.at(0).at(9).c_str(), NULL, 10);
+		data.Bx = FieldDouble(4);
+		data.Ly = FieldDouble(5);
+		data.Ref = FieldLong(6);
+		data.MCODE1 = FieldLong(7);
+		data.MCODE2 = FieldLong(8);
+		data.MCODE3 = FieldLong(9);
 
 		return true;
 
@@ -477,17 +584,15 @@ int AisanPointsFileReader::ReadAllData(vector<AisanPoints>& data_list)
 
 bool AisanLinesFileReader::ReadNextLine(AisanLine& data)
 {
-	vector<vector<string> > lineData;
-	if(ReadSingleLine(lineData))
+	if(ReadNextFields())
 	{
-		if(lineData.size()==0) return false;
-		if(lineData.at(0).size() < 5) return false;
+		if(FieldsCount() < 5) return false;
 
-		data.LID = strtol(lineData.at(0).at(0).c_str(), NULL, 10);
-		data.BPID = strtol(lineData.at(0).at(1).c_str(), NULL, 10);
-		data.FPID = strtol(lineData.at(0).at(2).c_str(), NULL, 10);
-		data.BLID = strtol(lineData.at(0).at(3).c_str(), NULL, 10);
-		data.FLID = strtol(lineData.at(0).at(4).c_str(), NULL, 10);
+		data.LID = FieldLong(0);
+		data.BPID = FieldLong(1);
+		data.FPID = FieldLong(2);
+		data.BLID = FieldLong(3);
+		data.FLID = FieldLong(4);
 
 		return true;
 	}
@@ -511,23 +616,21 @@ int AisanLinesFileReader::ReadAllData(vector<AisanLine>& data_list)
 
 bool AisanCenterLinesFileReader::ReadNextLine(AisanCenterLine& data)
 {
-	vector<vector<string> > lineData;
-	if(ReadSingleLine(lineData))
+	if(ReadNextFields())
 	{
-		if(lineData.size()==0) return false;
-		if(lineData.at(0).size() < 5) return false;
+		if(FieldsCount() < 10) return false;
 
-		data.DID 	= strtol(lineData.at(0).at(0).c_str(), NULL, 10);
-		data.Dist 	= strtol(lineData.at(0).at(1).c_str(), NULL, 10);
-		data.PID 	= strtol(lineData.at(0).at(2).c_str(), NULL, 10);
+		data.DID 	= FieldLong(0);
+		data.Dist 	= FieldLong(1);
+		data.PID 	= FieldLong(2);
 
-		data.Dir 	= strtod(lineData.at(0)[3].c_str(), NULL);
-		data.Apara 	= strtod(lineData.at(0)[4].c_str(), NULL);
-		data.r 		= strtod(lineData.at(0)[5].c_str(), NULL);
-		data.slope 	= strtod(lineData.at(0)[6].c_str(), NULL);
-		data.cant 	= strtod(lineData.at(0)[7].c_str(), NULL);
-		data.LW 	= strtod(lineData.at(0)[8].c_str(), NULL);
-		data.RW 	= strtod(lineData.at(0)[9].c_str(), NULL);
+		data.Dir 	= FieldDouble(3);
+		data.Apara 	= FieldDouble(4);
+		data.r 		= FieldDouble(5);
+		data.slope 	= FieldDouble(6);
+		data.cant 	= FieldDouble(7);
+		data.LW 	= FieldDouble(8);
+		data.RW 	= FieldDouble(9);
 
 		return true;
 	}
@@ -551,44 +654,42 @@ int AisanCenterLinesFileReader::ReadAllData(vector<AisanCenterLine>& data_list)
 
 bool AisanLanesFileReader::ReadNextLine(AisanLane& data)
 {
-	vector<vector<string> > lineData;
-	if(ReadSingleLine(lineData))
-	{
-		if(lineData.size() == 0) return false;
-		if(lineData.at(0).size() < 17) return false;
-
-		data.LnID		= strtol(lineData.at(0).at(0).c_str(), NULL, 10);
-		data.DID		= strtol(lineData.at(0).at(1).c_str(), NULL, 10);
-		data.BLID		= strtol(lineData.at(0).at(2).c_str(), NULL, 10);
-		data.FLID		= strtol(lineData.at(0).at(3).c_str(), NULL, 10);
-		data.BNID	 	= strtol(lineData.at(0).at(4).c_str(), NULL, 10);
-		data.FNID		= strtol(lineData.at(0).at(5).c_str(), NULL, 10);
-		data.JCT		= strtol(lineData.at(0).at(6).c_str(), NULL, 10);
-		data.BLID2	 	= strtol(lineData.at(0).at(7).c_str(), NULL, 10);
-		data.BLID3		= strtol(lineData.at(0).at(8).c_str(), NULL, 10);
-		data.BLID4		= strtol(lineData.at(0).at(9).c_str(), NULL, 10);
-		data.FLID2	 	= strtol(lineData.at(0).at(10).c_str(), NULL, 10);
-		data.FLID3		= strtol(lineData.at(0).at(11).c_str(), NULL, 10);
-		data.FLID4		= strtol(lineData.at(0).at(12).c_str(), NULL, 10);
-		data.ClossID 	= strtol(lineData.at(0).at(13).c_str(), NULL, 10);
-		data.Span 		= strtod(lineData.at(0).at(14).c_str(), NULL);
-		data.LCnt	 	= strtol(lineData.at(0).at(15).c_str(), NULL, 10);
-		data.Lno	  	= strtol(lineData.at(0).at(16).c_str(), NULL, 10);
-
-
-		if(lineData.at(0).size() < 23) return true;
-
-		data.LaneType	= strtol(lineData.at(0).at(17).c_str(), NULL, 10);
-		data.LimitVel	= strtol(lineData.at(0).at(18).c_str(), NULL, 10);
-		data.RefVel	 	= strtol(lineData.at(0).at(19).c_str(), NULL, 10);
-		data.RoadSecID	= strtol(lineData.at(0).at(20).c_str(), NULL, 10);
-		data.LaneChgFG 	= strtol(lineData.at(0).at(21).c_str(), NULL, 10);
-		data.LinkWAID	= strtol(lineData.at(0).at(22).c_str(), NULL, 10);
-
-
-		if(lineData.at(0).size() > 23)
+	if(ReadNextFields())
+	{
+		if(FieldsCount() < 17) return false;
+
+		data.LnID		= FieldLong(0);
+		data.DID		= FieldLong(1);
+		data.BLID		= FieldLong(2);
+		data.FLID		= FieldLong(3);
+		data.BNID	 	= FieldLong(4);
+		data.FNID		= FieldLong(5);
+		data.JCT		= FieldLong(6);
+		data.BLID2	 	= FieldLong(7);
+		data.BLID3		= FieldLong(8);
+		data.BLID4		= FieldLong(9);
+		data.FLID2	 	= FieldLong(10);
+		data.FLID3		= FieldLong(11);
+		data.FLID4		= FieldLong(12);
+		data.ClossID 	= FieldLong(13);
+		data.Span 		= FieldDouble(14);
+		data.LCnt	 	= FieldLong(15);
+		data.Lno	  	= FieldLong(16);
+
+
+		if(FieldsCount() < 23) return true;
+
+		data.LaneType	= FieldLong(17);
+		data.LimitVel	= FieldLong(18);
+		data.RefVel	 	= FieldLong(19);
+		data.RoadSecID	= FieldLong(20);
+		data.LaneChgFG 	= FieldLong(21);
+		data.LinkWAID	= FieldLong(22);
+
+
+		if(FieldsCount() > 23)
 		{
-			string str_dir = lineData.at(0).at(23);
+			string str_dir = FieldString(23);
 			if(str_dir.size() > 0)
 				data.LaneDir 	= str_dir.at(0);
 			else
@@ -597,8 +698,8 @@ bool AisanLanesFileReader::ReadNextLine(AisanLane& data)
 
 //		data.LeftLaneId  = 0;
 //		data.RightLaneId = 0;
-//		data.LeftLaneId 	= strtol(lineData.at(0).at(24).c_str(), NULL, 10);
-//		data.RightLaneId 	= strtol(lineData.at(0).at(25).c_str(), NULL, 10);
+//		data.LeftLaneId 	= FieldLong(24);
+//		data.RightLaneId 	= FieldLong(25);
 
 
 		return true;
@@ -623,15 +724,13 @@ int AisanLanesFileReader::ReadAllData(vector<AisanLane>& data_list)
 
 bool AisanAreasFileReader::ReadNextLine(AisanArea& data)
 {
-	vector<vector<string> > lineData;
-	if(ReadSingleLine(lineData))
+	if(ReadNextFields())
 	{
-		if(lineData.size()==0) return false;
-		if(lineData.at(0).size() < 3) return false;
+		if(FieldsCount() < 3) return false;
 
-		data.AID = strtol(lineData.at(0).at(0).c_str(), NULL, 10);
-		data.SLID = strtol(lineData.at(0).at(1).c_str(), NULL, 10);
-		data.ELID = strtol(lineData.at(0).at(2).c_str(), NULL, 10);
+		data.AID = FieldLong(0);
+		data.SLID = FieldLong(1);
+		data.ELID = FieldLong(2);
 
 		return true;
 
@@ -656,15 +755,13 @@ int AisanAreasFileReader::ReadAllData(vector<AisanArea>& data_list)
 
 bool AisanIntersectionFileReader::ReadNextLine(AisanIntersection& data)
 {
-	vector<vector<string> > lineData;
-	if(ReadSingleLine(lineData))
+	if(ReadNextFields())
 	{
-		if(lineData.size()==0) return false;
-		if(lineData.at(0).size() < 3) return false;
+		if(FieldsCount() < 3) return false;
 
-		data.ID = strtol(lineData.at(0).at(0).c_str(), NULL, 10);
-		data.AID = strtol(lineData.at(0).at(1).c_str(), NULL, 10);
-		data.LinkID = strtol(lineData.at(0).at(2).c_str(), NULL, 10);
+		data.ID = FieldLong(0);
+		data.AID = FieldLong(1);
+		data.LinkID = FieldLong(2);
 
 		return true;
 
@@ -689,17 +786,15 @@ int AisanIntersectionFileReader::ReadAllData(vector<AisanIntersection>& data_lis
 
 bool AisanStopLineFileReader::ReadNextLine(AisanStopLine& data)
 {
-	vector<vector<string> > lineData;
-	if(ReadSingleLine(lineData))
+	if(ReadNextFields())
 	{
-		if(lineData.size()==0) return false;
-		if(lineData.at(0).size() < 5) return false;
+		if(FieldsCount() < 5) return false;
 
-		data.ID 	= strtol(lineData.at(0).at(0).c_str(), NULL, 10);
-		data.LID 	= strtol(lineData.at(0).at(1).c_str(), NULL, 10);
-		data.TLID 	= strtol(lineData.at(0).at(2).c_str(), NULL, 10);
-		data.SignID = strtol(lineData.at(0).at(3).c_str(), NULL, 10);
-		data.LinkID = strtol(lineData.at(0).at(4).c_str(), NULL, 10);
+		data.ID 	= FieldLong(0);
+		data.LID 	= FieldLong(1);
+		data.TLID 	= FieldLong(2);
+		data.SignID = FieldLong(3);
+		data.LinkID = FieldLong(4);
 
 		return true;
 
@@ -724,17 +819,15 @@ int AisanStopLineFileReader::ReadAllData(vector<AisanStopLine>& data_list)
 
 bool AisanRoadSignFileReader::ReadNextLine(AisanRoadSign& data)
 {
-	vector<vector<string> > lineData;
-	if(ReadSingleLine(lineData))
+	if(ReadNextFields())
 	{
-		if(lineData.size()==0) return false;
-		if(lineData.at(0).size() < 5) return false;
+		if(FieldsCount() < 5) return false;
 
-		data.ID 	= strtol(lineData.at(0).at(0).c_str(), NULL, 10);
-		data.VID 	= strtol(lineData.at(0).at(1).c_str(), NULL, 10);
-		data.PLID 	= strtol(lineData.at(0).at(2).c_str(), NULL, 10);
-		data.Type 	= strtol(lineData.at(0).at(3).c_str(), NULL, 10);
-		data.LinkID = strtol(lineData.at(0).at(4).c_str(), NULL, 10);
+		data.ID 	= FieldLong(0);
+		data.VID 	= FieldLong(1);
+		data.PLID 	= FieldLong(2);
+		data.Type 	= FieldLong(3);
+		data.LinkID = FieldLong(4);
 
 		return true;
 
@@ -759,17 +852,15 @@ int AisanRoadSignFileReader::ReadAllData(vector<AisanRoadSign>& data_list)
 
 bool AisanSignalFileReader::ReadNextLine(AisanSignal& data)
 {
-	vector<vector<string> > lineData;
-	if(ReadSingleLine(lineData))
+	if(ReadNextFields())
 	{
-		if(lineData.size()==0) return false;
-		if(lineData.at(0).size() < 5) return false;
+		if(FieldsCount() < 5) return false;
 
-		data.ID 	= strtol(lineData.at(0).at(0).c_str(), NULL, 10);
-		data.VID 	= strtol(lineData.at(0).at(1).c_str(), NULL, 10);
-		data.PLID 	= strtol(lineData.at(0).at(2).c_str(), NULL, 10);
-		data.Type 	= strtol(lineData.at(0).at(3).c_str(), NULL, 10);
-		data.LinkID = strtol(lineData.at(0).at(4).c_str(), NULL, 10);
+		data.ID 	= FieldLong(0);
+		data.VID 	= FieldLong(1);
+		data.PLID 	= FieldLong(2);
+		data.Type 	= FieldLong(3);
+		data.LinkID = FieldLong(4);
 
 		return true;
 
@@ -795,16 +886,14 @@ int AisanSignalFileReader::ReadAllData(vector<AisanSignal>& data_list)
 
 bool AisanVectorFileReader::ReadNextLine(AisanVector& data)
 {
-	vector<vector<string> > lineData;
-	if(ReadSingleLine(lineData))
+	if(ReadNextFields())
 	{
-		if(lineData.size()==0) return false;
-		if(lineData.at(0).size() < 4) return false;
+		if(FieldsCount() < 4) return false;
 
-		data.VID 	= strtol(lineData.at(0).at(0).c_str(), NULL, 10);
-		data.PID 	= strtol(lineData.at(0).at(1).c_str(), NULL, 10);
-		data.Hang 	= strtod(lineData.at(0).at(2).c_str(), NULL);
-		data.Vang 	= strtod(lineData.at(0).at(3).c_str(), NULL);
+		data.VID 	= FieldLong(0);
+		data.PID 	= FieldLong(1);
+		data.Hang 	= FieldDouble(2);
+		data.Vang 	= FieldDouble(3);
 
 		return true;
 
@@ -829,16 +918,14 @@ int AisanVectorFileReader::ReadAllData(vector<AisanVector>& data_list)
 
 bool AisanDataConnFileReader::ReadNextLine(DataConn& data)
 {
-	vector<vector<string> > lineData;
-	if(ReadSingleLine(lineData))
+	if(ReadNextFields())
 	{
-		if(lineData.size()==0) return false;
-		if(lineData.at(0).size() < 4) return false;
+		if(FieldsCount() < 4) return false;
 
-		data.LID 	= strtol(lineData.at(0).at(0).c_str(), NULL, 10);
-		data.SLID 	= strtol(lineData.at(0).at(1).c_str(), NULL, 10);
-		data.SID 	= strtol(lineData.at(0).at(2).c_str(), NULL, 10);
-		data.SSID 	= strtol(lineData.at(0).at(3).c_str(), NULL, 10);
+		data.LID 	= FieldLong(0);
+		data.SLID 	= FieldLong(1);
+		data.SID 	= FieldLong(2);
+		data.SSID 	= FieldLong(3);
 
 		return true;
 
@@ -32,7 +32,31 @@
 
 namespace astar_planner
 {
-AstarSearch::AstarSearch() : node_initialized_(false), upper_bound_distance_(-1)
+namespace
+{
+// Moore neighbourhood of the wavefront search, the four side cells first
+constexpr int WAVEFRONT_DX[8] = { 0, -1, 1, 0, -1, 1, -1, 1 };
+constexpr int WAVEFRONT_DY[8] = { 1, 0, 0, -1, 1, 1, -1, -1 };
+constexpr uint8_t WAVEFRONT_NO_PARENT = 8;
+
+// Whether the robot fits in a cell, evaluated when the wavefront reaches it
+constexpr uint8_t WAVEFRONT_UNKNOWN = 0;
+constexpr uint8_t WAVEFRONT_FREE = 1;
+constexpr uint8_t WAVEFRONT_BLOCKED = 2;
+
+// Obstacle value of the cells which were out of the grid at the last update
+constexpr uint8_t WAVEFRONT_NO_OBS = 2;
+}
+
+AstarSearch::AstarSearch()
+  : node_initialized_(false)
+  , node_width_(0)
+  , node_generation_(0)
+  , wavefront_goal_index_(-1)
+  , wavefront_resolution_(0)
+  , wavefront_update_reason_()
+  , wavefront_cells_touched_(0)
+  , upper_bound_distance_(-1)
 {
   ros::NodeHandle private_nh_("~");
   private_nh_.param<bool>("use_2dnav_goal", use_2dnav_goal_, true);
@@ -68,16 +92,107 @@ void AstarSearch::initializeNode(const nav_msgs::OccupancyGrid &map)
   int height = map.info.height;
   int width = map.info.width;
 
-  nodes_.resize(height);
+  nodes_.assign(static_cast<size_t>(height) * width * angle_size_, AstarNode());
+  node_width_ = width;
+  node_generation_ = 0;
+  openlist_.clear();
 
-  for (int i = 0; i < height; i++)
-    nodes_[i].resize(width);
+  node_initialized_ = true;
+}
 
-  for (int i = 0; i < height; i++)
-    for (int j = 0; j < width; j++)
-      nodes_[i][j].resize(angle_size_);
+AstarNode &AstarSearch::getNode(int index)
+{
+  AstarNode &node = nodes_[index];
 
-  node_initialized_ = true;
+  // left from a previous search, clear what reset() used to
+  if (node.generation != node_generation_)
+  {
+    node.status = STATUS::NONE;
+    node.hc = 0;
+    node.open_index = -1;
+    node.generation = node_generation_;
+  }
+
+  return node;
+}
+
+// Add a node to the open list, or lower its cost if it is already there
+void AstarSearch::pushOpenList(const SimpleNode &sn)
+{
+  AstarNode &node = nodes_[getNodeIndex(sn.index_x, sn.index_y, sn.index_theta)];
+
+  if (node.open_index < 0)
+  {
+    node.open_index = openlist_.size();
+    openlist_.push_back(sn);
+  }
+  else
+  {
+    openlist_[node.open_index].cost = sn.cost;
+  }
+
+  siftUpOpenList(node.open_index);
+}
+
+// Remove the minimum cost node from the open list
+SimpleNode AstarSearch::popOpenList()
+{
+  SimpleNode top = openlist_.front();
+  nodes_[getNodeIndex(top.index_x, top.index_y, top.index_theta)].open_index = -1;
+
+  SimpleNode last = openlist_.back();
+  openlist_.pop_back();
+  if (!openlist_.empty())
+  {
+    openlist_[0] = last;
+    nodes_[getNodeIndex(last.index_x, last.index_y, last.index_theta)].open_index = 0;
+    siftDownOpenList(0);
+  }
+
+  return top;
+}
+
+void AstarSearch::siftUpOpenList(int position)
+{
+  SimpleNode sn = openlist_[position];
+  while (position > 0)
+  {
+    int parent = (position - 1) / 2;
+    if (!(openlist_[parent] > sn))
+      break;
+
+    openlist_[position] = openlist_[parent];
+    nodes_[getNodeIndex(openlist_[position].index_x, openlist_[position].index_y, openlist_[position].index_theta)]
+        .open_index = position;
+    position = parent;
+  }
+
+  openlist_[position] = sn;
+  nodes_[getNodeIndex(sn.index_x, sn.index_y, sn.index_theta)].open_index = position;
+}
+
+void AstarSearch::siftDownOpenList(int position)
+{
+  int size = openlist_.size();
+  SimpleNode sn = openlist_[position];
+  while (true)
+  {
+    int child = 2 * position + 1;
+    if (child >= size)
+      break;
+    if (child + 1 < size && openlist_[child] > openlist_[child + 1])
+      child++;
+    if (!(sn > openlist_[child]))
+      break;
+
+    openlist_[position] = openlist_[child];
+    nodes_[getNodeIndex(openlist_[position].index_x, openlist_[position].index_y, openlist_[position].index_theta)]
+        .open_index = position;
+    position = child;
+  }
+
+  openlist_[position] = sn;
+  nodes_[getNodeIndex(sn.index_x, sn.index_y, sn.index_theta)].open_index = position;
 }
 
 void AstarSearch::poseToIndex(const geometry_msgs::Pose &pose, int *index_x, int *index_y, int *index_theta)
@@ -264,10 +379,12 @@ void AstarSearch::setPath(const SimpleNode &goal)
   path_.header = header;
 
   // From the goal node to the start node
-  AstarNode *node = &nodes_[goal.index_y][goal.index_x][goal.index_theta];
+  int node_index = getNodeIndex(goal.index_x, goal.index_y, goal.index_theta);
 
-  while (node != NULL)
+  while (node_index >= 0)
   {
+    const AstarNode *node = &nodes_[node_index];
+
     // Set tf pose
     tf::Vector3 origin(node->x, node->y, 0);
     tf::Pose tf_pose;
@@ -284,7 +401,7 @@ void AstarSearch::setPath(const SimpleNode &goal)
     path_.poses.push_back(ros_pose);
 
     // To the next node
-    node = node->parent;
+    node_index = node->parent;
   }
 
   // Reverse the vector to be start to goal order
@@ -324,7 +441,7 @@ bool AstarSearch::isGoal(double x, double y, double theta)
 
 bool AstarSearch::isObs(int index_x, int index_y)
 {
-  if (nodes_[index_y][index_x][0].status == STATUS::OBS)
+  if (getNode(index_x, index_y, 0).status == STATUS::OBS)
     return true;
 
   return false;
@@ -360,7 +477,7 @@ bool AstarSearch::detectCollision(const SimpleNode &sn)
 
       if (isOutOfRange(index_x, index_y))
         return true;
-      if (nodes_[index_y][index_x][0].status == STATUS::OBS)
+      if (getNode(index_x, index_y, 0).status == STATUS::OBS)
         return true;
     }
   }
@@ -368,71 +485,333 @@ bool AstarSearch::detectCollision(const SimpleNode &sn)
   return false;
 }
 
+// The wavefront heuristic is the cost from each cell to the goal cell over
+// the 8-connected cells the robot fits in. It is kept between plans. The
+// costmap grid moves with the sensor, so the tables of the last update are
+// first shifted by the cells the goal moved in the grid: they then hold the
+// costs to the goal over the last obstacles, in the current grid. Only the
+// cells around the obstacles which differ, and along the grid border, are
+// re-evaluated and the costs are repaired from there.
 bool AstarSearch::calcWaveFrontHeuristic(const SimpleNode &sn)
 {
-  // Set start point for wavefront search
-  // This is goal for Astar search
-  nodes_[sn.index_y][sn.index_x][0].hc = 0;
-  WaveFrontNode wf_node(sn.index_x, sn.index_y, 1e-10);
-  std::queue<WaveFrontNode> qu;
-  qu.push(wf_node);
-
-  // State update table for wavefront search
-  // Nodes are expanded for each neighborhood cells (moore neighborhood)
-  double resolution = map_info_.resolution;
-  static std::vector<WaveFrontNode> updates = {
-    astar_planner::getWaveFrontNode(0, 1, resolution), astar_planner::getWaveFrontNode(-1, 0, resolution),
-    astar_planner::getWaveFrontNode(1, 0, resolution), astar_planner::getWaveFrontNode(0, -1, resolution),
-    astar_planner::getWaveFrontNode(-1, 1, std::hypot(resolution, resolution)),
-    astar_planner::getWaveFrontNode(1, 1, std::hypot(resolution, resolution)),
-    astar_planner::getWaveFrontNode(-1, -1, std::hypot(resolution, resolution)),
-    astar_planner::getWaveFrontNode(1, -1, std::hypot(resolution, resolution)),
-  };
-
-  // Get start index
-  int start_index_x;
-  int start_index_y;
-  int start_index_theta;
-  poseToIndex(start_pose_local_.pose, &start_index_x, &start_index_y, &start_index_theta);
+  int width = map_info_.width;
+  int height = map_info_.height;
+  int cell_num = width * height;
+  int goal_index = sn.index_y * width + sn.index_x;
+
+  wavefront_cells_touched_ = 0;
+
+  // Current obstacles, to be compared with the ones of the last update
+  std::vector<uint8_t> obs(cell_num);
+  for (int y = 0; y < height; y++)
+    for (int x = 0; x < width; x++)
+      obs[y * width + x] = isObs(x, y);
+
+  // Cells the grid moved by since the last update, the goal being fixed
+  int shift_x = sn.index_x - wavefront_goal_index_ % width;
+  int shift_y = sn.index_y - wavefront_goal_index_ / width;
+
+  // Reason for a full update, empty if the costs can be repaired
+  if (wavefront_hc_.empty())
+    wavefront_update_reason_ = "first update";
+  else if (static_cast<int>(wavefront_hc_.size()) != cell_num)
+    wavefront_update_reason_ = "map size changed";
+  else if (wavefront_resolution_ != map_info_.resolution)
+    wavefront_update_reason_ = "resolution changed";
+  else if (std::abs(shift_x) >= width || std::abs(shift_y) >= height)
+    wavefront_update_reason_ = "goal cell moved out of the last grid";
+  else
+    wavefront_update_reason_.clear();
+  bool full_update = !wavefront_update_reason_.empty();
+
+  std::vector<int> changed_cells;
+  std::vector<int> lost_cells;
+  std::vector<int> edge_cells;
+  if (!full_update)
+  {
+    if (shift_x != 0 || shift_y != 0)
+      shiftWaveFront(shift_x, shift_y, &lost_cells, &edge_cells);
+
+    // Cells which entered the grid have no obstacles of the last update and always differ
+    for (int i = 0; i < cell_num; i++)
+    {
+      if (obs[i] != wavefront_obs_[i])
+        changed_cells.push_back(i);
+    }
+
+    // The footprint of the cells along the border may now go out of the grid
+    if (shift_x != 0 || shift_y != 0)
+    {
+      for (int x = 0; x < width; x++)
+      {
+        changed_cells.push_back(x);
+        changed_cells.push_back((height - 1) * width + x);
+      }
+      for (int y = 1; y < height - 1; y++)
+      {
+        changed_cells.push_back(y * width);
+        changed_cells.push_back(y * width + width - 1);
+      }
+    }
+
+    // repairing most of the map costs more than starting over
+    if (static_cast<int>(changed_cells.size()) > cell_num / 8)
+    {
+      full_update = true;
+      wavefront_update_reason_ = "too many obstacle changes";
+    }
+  }
+
+  wavefront_obs_.swap(obs);
 
-  // Whether the robot can reach goal
-  bool reachable = false;
+  std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int>>,
+                      std::greater<std::pair<double, int>>> open;
 
-  // Start wavefront search
-  while (!qu.empty())
+  if (full_update)
+  {
+    wavefront_hc_.assign(cell_num, std::numeric_limits<double>::infinity());
+    wavefront_parent_.assign(cell_num, WAVEFRONT_NO_PARENT);
+    wavefront_state_.assign(cell_num, WAVEFRONT_UNKNOWN);
+    wavefront_goal_index_ = goal_index;
+    wavefront_resolution_ = map_info_.resolution;
+
+    // Set start point for wavefront search
+    // This is goal for Astar search
+    wavefront_hc_[goal_index] = 0;
+    wavefront_state_[goal_index] = WAVEFRONT_FREE;
+    open.push(std::make_pair(0.0, goal_index));
+  }
+  else
   {
-    WaveFrontNode ref = qu.front();
-    qu.pop();
+    // A cell is blocked by the obstacles within the robot's half width
+    int radius = std::ceil(robot_width_ / 2 / map_info_.resolution) + 1;
+    std::vector<uint8_t> dirty(cell_num, 0);
+    std::vector<int> blocked_cells;
+    std::vector<int> freed_cells;
+    for (int c : changed_cells)
+    {
+      int cx = c % width;
+      int cy = c / width;
+      for (int y = std::max(cy - radius, 0); y <= std::min(cy + radius, height - 1); y++)
+      {
+        for (int x = std::max(cx - radius, 0); x <= std::min(cx + radius, width - 1); x++)
+        {
+          int i = y * width + x;
+          if (dirty[i] || i == goal_index)
+            continue;
+          dirty[i] = 1;
+
+          // never reached so far, evaluated if the search gets there
+          if (wavefront_state_[i] == WAVEFRONT_UNKNOWN)
+            continue;
+
+          uint8_t state = isWaveFrontBlocked(x, y) ? WAVEFRONT_BLOCKED : WAVEFRONT_FREE;
+          wavefront_cells_touched_++;
+          if (state == wavefront_state_[i])
+            continue;
+
+          wavefront_state_[i] = state;
+          if (state == WAVEFRONT_BLOCKED)
+            blocked_cells.push_back(i);
+          else
+            freed_cells.push_back(i);
+        }
+      }
+    }
 
-    WaveFrontNode next;
-    for (const auto &u : updates)
+    // Drop the costs that were reached through the newly blocked cells
+    for (int c : blocked_cells)
+    {
+      if (std::isinf(wavefront_hc_[c]))
+        continue;
+      wavefront_hc_[c] = std::numeric_limits<double>::infinity();
+      wavefront_parent_[c] = WAVEFRONT_NO_PARENT;
+      lost_cells.push_back(c);
+    }
+    for (size_t k = 0; k < lost_cells.size(); k++)
     {
-      next.index_x = ref.index_x + u.index_x;
-      next.index_y = ref.index_y + u.index_y;
+      int c = lost_cells[k];
+      int cx = c % width;
+      int cy = c / width;
+      for (int u = 0; u < 8; u++)
+      {
+        int x = cx + WAVEFRONT_DX[u];
+        int y = cy + WAVEFRONT_DY[u];
+        if (isOutOfRange(x, y))
+          continue;
+        int i = y * width + x;
+        int parent = wavefront_parent_[i];
+        if (parent == WAVEFRONT_NO_PARENT || x + WAVEFRONT_DX[parent] != cx || y + WAVEFRONT_DY[parent] != cy)
+          continue;
+        wavefront_hc_[i] = std::numeric_limits<double>::infinity();
+        wavefront_parent_[i] = WAVEFRONT_NO_PARENT;
+        lost_cells.push_back(i);
+      }
+      wavefront_cells_touched_++;
+    }
 
-      // out of range OR already visited OR obstacle node
-      if (isOutOfRange(next.index_x, next.index_y) || nodes_[next.index_y][next.index_x][0].hc > 0 ||
-          nodes_[next.index_y][next.index_x][0].status == STATUS::OBS)
+    // Reached again from their neighbours, as the freed cells, and spread
+    // from the cells next to the ones which entered the grid
+    freed_cells.insert(freed_cells.end(), lost_cells.begin(), lost_cells.end());
+    freed_cells.insert(freed_cells.end(), edge_cells.begin(), edge_cells.end());
+    for (int c : freed_cells)
+    {
+      if (wavefront_state_[c] != WAVEFRONT_FREE)
+        continue;
+      int cx = c % width;
+      int cy = c / width;
+      for (int u = 0; u < 8; u++)
+      {
+        int x = cx + WAVEFRONT_DX[u];
+        int y = cy + WAVEFRONT_DY[u];
+        if (isOutOfRange(x, y))
+          continue;
+        int i = y * width + x;
+        if (wavefront_state_[i] != WAVEFRONT_FREE)
+          continue;
+        double hc = wavefront_hc_[i] + getWaveFrontStep(u);
+        if (hc < wavefront_hc_[c])
+        {
+          wavefront_hc_[c] = hc;
+          wavefront_parent_[c] = u;
+        }
+      }
+      if (!std::isinf(wavefront_hc_[c]))
+        open.push(std::make_pair(wavefront_hc_[c], c));
+    }
+  }
+
+  // Spread the costs, lowest first
+  while (!open.empty())
+  {
+    double hc = open.top().first;
+    int c = open.top().second;
+    open.pop();
+    if (hc > wavefront_hc_[c])
+      continue;
+    wavefront_cells_touched_++;
+
+    int cx = c % width;
+    int cy = c / width;
+    for (int u = 0; u < 8; u++)
+    {
+      int x = cx - WAVEFRONT_DX[u];
+      int y = cy - WAVEFRONT_DY[u];
+      if (isOutOfRange(x, y))
+        continue;
+      int i = y * width + x;
+      double next_hc = hc + getWaveFrontStep(u);
+      if (!(next_hc < wavefront_hc_[i]))
         continue;
 
       // Take the size of robot into account
-      if (detectCollisionWaveFront(next))
+      if (wavefront_state_[i] == WAVEFRONT_UNKNOWN)
+      {
+        wavefront_state_[i] = isWaveFrontBlocked(x, y) ? WAVEFRONT_BLOCKED : WAVEFRONT_FREE;
+        wavefront_cells_touched_++;
+      }
+      if (wavefront_state_[i] != WAVEFRONT_FREE)
         continue;
 
-      // Check if we can reach from start to goal
-      if (next.index_x == start_index_x && next.index_y == start_index_y)
-        reachable = true;
+      wavefront_hc_[i] = next_hc;
+      wavefront_parent_[i] = u;
+      open.push(std::make_pair(next_hc, i));
+    }
+  }
 
-      // Set wavefront heuristic cost
-      next.hc = ref.hc + u.hc;
-      nodes_[next.index_y][next.index_x][0].hc = next.hc;
+  // Check if we can reach from start to goal
+  int start_index_x;
+  int start_index_y;
+  int start_index_theta;
+  poseToIndex(start_pose_local_.pose, &start_index_x, &start_index_y, &start_index_theta);
+  if (isOutOfRange(start_index_x, start_index_y))
+    return false;
 
-      qu.push(next);
-    }
+  return !std::isinf(wavefront_hc_[start_index_y * width + start_index_x]);
+}
+
+bool AstarSearch::isWaveFrontBlocked(int index_x, int index_y)
+{
+  return isObs(index_x, index_y) || detectCollisionWaveFront(WaveFrontNode(index_x, index_y, 0));
+}
+
+double AstarSearch::getWaveFrontStep(int update) const
+{
+  // the first four are the side neighbours
+  return update < 4 ? map_info_.resolution : std::hypot(map_info_.resolution, map_info_.resolution);
+}
+
+double AstarSearch::getWaveFrontHeuristic(int index_x, int index_y) const
+{
+  // cells out of reach from the goal have no heuristic
+  double hc = wavefront_hc_[index_y * map_info_.width + index_x];
+  return std::isinf(hc) ? 0 : hc;
+}
+
+// Moves the wavefront tables with the grid: cell (x, y) of the last update
+// is now cell (x + shift_x, y + shift_y). Cells which entered the grid are
+// unknown, cells whose cost came from a cell which left it are lost, and the
+// cells next to the ones which entered are edge cells to spread the costs from.
+void AstarSearch::shiftWaveFront(int shift_x, int shift_y, std::vector<int> *lost_cells, std::vector<int> *edge_cells)
+{
+  int width = map_info_.width;
+  int height = map_info_.height;
+  int cell_num = width * height;
+
+  std::vector<double> hc(cell_num, std::numeric_limits<double>::infinity());
+  std::vector<uint8_t> parent(cell_num, WAVEFRONT_NO_PARENT);
+  std::vector<uint8_t> state(cell_num, WAVEFRONT_UNKNOWN);
+  std::vector<uint8_t> obs(cell_num, WAVEFRONT_NO_OBS);
+
+  // Cells of the last grid still in the grid, in current cells
+  int x0 = std::max(shift_x, 0);
+  int x1 = std::min(width + shift_x, width);
+  int y0 = std::max(shift_y, 0);
+  int y1 = std::min(height + shift_y, height);
+  for (int y = y0; y < y1; y++)
+  {
+    int from = (y - shift_y) * width + x0 - shift_x;
+    int to = y * width + x0;
+    std::copy(wavefront_hc_.begin() + from, wavefront_hc_.begin() + from + x1 - x0, hc.begin() + to);
+    std::copy(wavefront_parent_.begin() + from, wavefront_parent_.begin() + from + x1 - x0, parent.begin() + to);
+    std::copy(wavefront_state_.begin() + from, wavefront_state_.begin() + from + x1 - x0, state.begin() + to);
+    std::copy(wavefront_obs_.begin() + from, wavefront_obs_.begin() + from + x1 - x0, obs.begin() + to);
   }
+  wavefront_hc_.swap(hc);
+  wavefront_parent_.swap(parent);
+  wavefront_state_.swap(state);
+  wavefront_obs_.swap(obs);
+  wavefront_goal_index_ += shift_y * width + shift_x;
+
+  for (int y = y0; y < y1; y++)
+  {
+    for (int x = x0; x < x1; x++)
+    {
+      // only the cells on the sides of the kept cells can have a neighbour out of them
+      if (y != y0 && y != y1 - 1 && x == x0 + 1)
+        x = x1 - 1;
+      int i = y * width + x;
 
-  // End of search
-  return reachable;
+      bool edge = false;
+      for (int u = 0; u < 8; u++)
+      {
+        int nx = x + WAVEFRONT_DX[u];
+        int ny = y + WAVEFRONT_DY[u];
+        if (nx >= x0 && nx < x1 && ny >= y0 && ny < y1)
+          continue;
+        if (u == wavefront_parent_[i])
+        {
+          wavefront_hc_[i] = std::numeric_limits<double>::infinity();
+          wavefront_parent_[i] = WAVEFRONT_NO_PARENT;
+          lost_cells->push_back(i);
+        }
+        if (!isOutOfRange(nx, ny))
+          edge = true;
+      }
+      if (edge)
+        edge_cells->push_back(i);
+    }
+  }
 }
 
 // Simple collidion detection for wavefront search
@@ -453,7 +832,7 @@ bool AstarSearch::detectCollisionWaveFront(const WaveFrontNode &ref)
       if (isOutOfRange(index_x, index_y))
         return true;
 
-      if (nodes_[index_y][index_x][0].status == STATUS::OBS)
+      if (getNode(index_x, index_y, 0).status == STATUS::OBS)
         return true;
     }
   }
@@ -467,28 +846,19 @@ void AstarSearch::reset()
   debug_poses_.poses.clear();
 
   // Clear queue
-  std::priority_queue<SimpleNode, std::vector<SimpleNode>, std::greater<SimpleNode>> empty;
-  std::swap(openlist_, empty);
+  openlist_.clear();
 
-  ros::WallTime begin = ros::WallTime::now();
+  // Status and hc of all the nodes are cleared lazily by getNode(),
+  // other values will be updated during the search
+  node_generation_++;
 
-  // Reset node info here ...?
-  for (size_t i = 0; i < map_info_.height; i++)
+  // wrapped around, the oldest nodes would look current
+  if (node_generation_ == 0)
   {
-    for (size_t j = 0; j < map_info_.width; j++)
-    {
-      for (int k = 0; k < angle_size_; k++)
-      {
-        // other values will be updated during the search
-        nodes_[i][j][k].status = STATUS::NONE;
-        nodes_[i][j][k].hc = 0;
-      }
-    }
+    for (auto &node : nodes_)
+      node.generation = 0;
+    node_generation_ = 1;
   }
-
-  ros::WallTime end = ros::WallTime::now();
-
-  ROS_INFO("reset time: %lf [ms]", (end - begin).toSec() * 1000);
 }
 
 void AstarSearch::setMap(const nav_msgs::OccupancyGrid &map)
@@ -530,14 +900,14 @@ void AstarSearch::setMap(const nav_msgs::OccupancyGrid &map)
         // the cost more than threshold is regarded almost same as an obstacle
         // because of its very high cost
         if (cost > obstacle_threshold_)
-          nodes_[i][j][0].status = STATUS::OBS;
+          getNode(j, i, 0).status = STATUS::OBS;
         else
-          nodes_[i][j][0].hc = cost * potential_weight_;
+          getNode(j, i, 0).hc = cost * potential_weight_;
       }
 
       // obstacle or unknown area
       if (cost == 100 || cost < 0)
-        nodes_[i][j][0].status = STATUS::OBS;
+        getNode(j, i, 0).status = STATUS::OBS;
     }
   }
 }
@@ -556,7 +926,7 @@ bool AstarSearch::setStartNode()
     return false;
 
   // Set start node
-  AstarNode &start_node = nodes_[index_y][index_x][index_theta];
+  AstarNode &start_node = getNode(index_x, index_y, index_theta);
   start_node.x = start_pose_local_.pose.position.x;
   start_node.y = start_pose_local_.pose.position.y;
   start_node.theta = 2.0 * M_PI / angle_size_ * index_theta;
@@ -564,7 +934,7 @@ bool AstarSearch::setStartNode()
   start_node.move_distance = 0;
   start_node.back = false;
   start_node.status = STATUS::OPEN;
-  start_node.parent = NULL;
+  start_node.parent = -1;
 
   // set euclidean distance heuristic cost
   if (!use_wavefront_heuristic_ && !use_potential_heuristic_)
@@ -582,7 +952,7 @@ bool AstarSearch::setStartNode()
 
   // Push start node to openlist
   start_sn.cost = start_node.gc + start_node.hc;
-  openlist_.push(start_sn);
+  pushOpenList(start_sn);
   return true;
 }
 
@@ -618,7 +988,9 @@ bool AstarSearch::setGoalNode()
 
     auto end = std::chrono::system_clock::now();
     auto usec = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
-    std::cout << "wavefront : " << usec / 1000.0 << "[msec]" << std::endl;
+    std::cout << "wavefront : " << usec / 1000.0 << "[msec], " << wavefront_cells_touched_ << " cells touched ("
+              << (wavefront_update_reason_.empty() ? "incremental" : "full, " + wavefront_update_reason_) << ")"
+              << std::endl;
 
     if (!wavefront_result)
     {
@@ -648,12 +1020,11 @@ bool AstarSearch::search()
     }
 
     // Pop minimum cost node from openlist
-    SimpleNode sn;
-    sn = openlist_.top();
-    openlist_.pop();
+    SimpleNode sn = popOpenList();
 
     // Expand nodes from this node
-    AstarNode *current_node = &nodes_[sn.index_y][sn.index_x][sn.index_theta];
+    int current_index = getNodeIndex(sn.index_x, sn.index_y, sn.index_theta);
+    AstarNode *current_node = &getNode(current_index);
     current_node->status = STATUS::CLOSED;
 
     // Goal check
@@ -705,14 +1076,16 @@ bool AstarSearch::search()
         continue;
       }
 
-      AstarNode *next_node = &nodes_[next.index_y][next.index_x][next.index_theta];
+      AstarNode *next_node = &getNode(next.index_x, next.index_y, next.index_theta);
       double next_gc = current_node->gc + move_cost;
-      double next_hc = nodes_[next.index_y][next.index_x][0].hc;  // wavefront or distance transform heuristic
+      // wavefront or distance transform heuristic
+      double next_hc = use_wavefront_heuristic_ ? getWaveFrontHeuristic(next.index_x, next.index_y) :
+                                                  getNode(next.index_x, next.index_y, 0).hc;
 
       // increase the cost with euclidean distance
       if (use_potential_heuristic_)
       {
-        next_gc += nodes_[next.index_y][next.index_x][0].hc;
+        next_gc += getNode(next.index_x, next.index_y, 0).hc;
         next_hc += astar_planner::calcDistance(next_x, next_y, goal_pose_local_.pose.position.x,
                                                goal_pose_local_.pose.position.y) *
                    distance_heuristic_weight_;
@@ -735,10 +1108,10 @@ bool AstarSearch::search()
         next_node->hc = next_hc;
         next_node->move_distance = move_distance;
         next_node->back = state.back;
-        next_node->parent = current_node;
+        next_node->parent = current_index;
 
         next.cost = next_node->gc + next_node->hc;
-        openlist_.push(next);
+        pushOpenList(next);
         continue;
       }
 
@@ -755,10 +1128,11 @@ bool AstarSearch::search()
           next_node->hc = next_hc;  // already calculated ?
           next_node->move_distance = move_distance;
           next_node->back = state.back;
-          next_node->parent = current_node;
+          next_node->parent = current_index;
 
+          // lowers its cost if it is still in the open list
           next.cost = next_node->gc + next_node->hc;
-          openlist_.push(next);
+          pushOpenList(next);
           continue;
         }
       }
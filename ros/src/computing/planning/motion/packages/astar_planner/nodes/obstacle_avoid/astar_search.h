@@ -45,6 +45,8 @@
 #include <queue>
 #include <string>
 #include <chrono>
+#include <cmath>
+#include <limits>
 
 namespace astar_planner
 {
@@ -87,6 +89,27 @@ private:
   bool detectCollision(const SimpleNode &sn);
   bool calcWaveFrontHeuristic(const SimpleNode &sn);
   bool detectCollisionWaveFront(const WaveFrontNode &sn);
+  bool isWaveFrontBlocked(int index_x, int index_y);
+  double getWaveFrontStep(int update) const;
+  double getWaveFrontHeuristic(int index_x, int index_y) const;
+  void shiftWaveFront(int shift_x, int shift_y, std::vector<int> *lost_cells, std::vector<int> *edge_cells);
+
+  // nodes are reset when first accessed in a search
+  int getNodeIndex(int index_x, int index_y, int index_theta) const
+  {
+    return (index_y * node_width_ + index_x) * angle_size_ + index_theta;
+  }
+  AstarNode &getNode(int index);
+  AstarNode &getNode(int index_x, int index_y, int index_theta)
+  {
+    return getNode(getNodeIndex(index_x, index_y, index_theta));
+  }
+
+  // open list as a binary heap indexed from the nodes
+  void pushOpenList(const SimpleNode &sn);
+  SimpleNode popOpenList();
+  void siftUpOpenList(int position);
+  void siftDownOpenList(int position);
 
   // for debug
   ros::NodeHandle n_;
@@ -120,8 +143,20 @@ private:
   bool node_initialized_;
   std::vector<std::vector<NodeUpdate>> state_update_table_;
   nav_msgs::MapMetaData map_info_;
-  std::vector<std::vector<std::vector<AstarNode>>> nodes_;
-  std::priority_queue<SimpleNode, std::vector<SimpleNode>, std::greater<SimpleNode>> openlist_;
+  std::vector<AstarNode> nodes_;  // [y][x][theta] in one buffer
+  int node_width_;
+  unsigned int node_generation_;  // incremented by reset()
+  std::vector<SimpleNode> openlist_;
+
+  // wavefront heuristic kept between plans, per cell
+  std::vector<double> wavefront_hc_;       // cost to the goal, infinity if not reached
+  std::vector<uint8_t> wavefront_parent_;  // neighbour the cost comes from
+  std::vector<uint8_t> wavefront_state_;   // whether the robot fits in the cell
+  std::vector<uint8_t> wavefront_obs_;     // obstacles at the last update
+  int wavefront_goal_index_;
+  double wavefront_resolution_;
+  std::string wavefront_update_reason_;  // why the last update was full, empty if incremental
+  int wavefront_cells_touched_;  // cells evaluated or expanded by the last update
   std::vector<SimpleNode> goallist_;
 
   // Pose in global(/map) frame
@@ -46,12 +46,14 @@ enum class STATUS : uint8_t
 struct AstarNode
 {
   double x, y, theta;            // Coordinate of each node
-  STATUS status = STATUS::NONE;  // NONE, OPEN, CLOSED or OBS
   double gc = 0;                 // Actual cost
   double hc = 0;                 // heuristic cost
   double move_distance = 0;      // actual move distance
+  int parent = -1;               // index of the parent node, -1 for the start node
+  int open_index = -1;           // position in the open list while the node is in it
+  unsigned int generation = 0;   // search which status, hc and open_index belong to
+  STATUS status = STATUS::NONE;  // NONE, OPEN, CLOSED or OBS
   bool back;                     // true if the current direction of the vehicle is back
-  AstarNode *parent = NULL;      // parent node
 };
 
 struct WaveFrontNode
@@ -319,3 +319,93 @@ geometry_msgs::Point ObstaclePoints::getObstaclePoint(const EControl &kind) cons
     return point;
   }
 }
+
+void PointsGrid::build(const pcl::PointCloud<pcl::PointXYZ>& points, double cell_size)
+{
+  double min_x = std::numeric_limits<double>::max();
+  double min_y = std::numeric_limits<double>::max();
+  double max_x = std::numeric_limits<double>::lowest();
+  double max_y = std::numeric_limits<double>::lowest();
+  for (const auto& p : points)
+  {
+    if (!std::isfinite(p.x) || !std::isfinite(p.y))
+      continue;
+    min_x = std::min(min_x, static_cast<double>(p.x));
+    min_y = std::min(min_y, static_cast<double>(p.y));
+    max_x = std::max(max_x, static_cast<double>(p.x));
+    max_y = std::max(max_y, static_cast<double>(p.y));
+  }
+  if (min_x > max_x)
+  {
+    min_x = max_x = 0;
+    min_y = max_y = 0;
+  }
+
+  // keep the grid within a few million cells whatever the area
+  constexpr double MAX_CELLS = 4e6;
+  while (((max_x - min_x) / cell_size + 1) * ((max_y - min_y) / cell_size + 1) > MAX_CELLS)
+    cell_size *= 2;
+
+  min_x_ = min_x;
+  min_y_ = min_y;
+  cell_size_ = cell_size;
+  width_ = std::max(static_cast<int>(std::floor((max_x - min_x) / cell_size)) + 1, 1);
+  height_ = std::max(static_cast<int>(std::floor((max_y - min_y) / cell_size)) + 1, 1);
+
+  // counting sort of the points by cell
+  std::vector<int> point_cells(points.size(), -1);
+  cell_start_.assign(width_ * height_ + 1, 0);
+  for (size_t i = 0; i < points.size(); i++)
+  {
+    const pcl::PointXYZ& p = points[i];
+    if (!std::isfinite(p.x) || !std::isfinite(p.y))
+      continue;
+
+    int cx = std::min(static_cast<int>((p.x - min_x) / cell_size), width_ - 1);
+    int cy = std::min(static_cast<int>((p.y - min_y) / cell_size), height_ - 1);
+    point_cells[i] = cy * width_ + cx;
+    cell_start_[point_cells[i] + 1]++;
+  }
+  for (size_t c = 1; c < cell_start_.size(); c++)
+    cell_start_[c] += cell_start_[c - 1];
+
+  point_indices_.resize(cell_start_.back());
+  std::vector<int> cell_fill(cell_start_.begin(), cell_start_.end() - 1);
+  for (size_t i = 0; i < points.size(); i++)
+  {
+    if (point_cells[i] >= 0)
+      point_indices_[cell_fill[point_cells[i]]++] = i;
+  }
+}
+
+void PointsGrid::getCandidates(double x, double y, double radius, std::vector<int>* indices) const
+{
+  indices->clear();
+
+  // a little wider for the rounding of the cell coordinates
+  radius += 1e-6;
+  double x_begin_cell = std::floor((x - radius - min_x_) / cell_size_);
+  double x_end_cell = std::floor((x + radius - min_x_) / cell_size_);
+  double y_begin_cell = std::floor((y - radius - min_y_) / cell_size_);
+  double y_end_cell = std::floor((y + radius - min_y_) / cell_size_);
+  // no cell around, also for non-finite coordinates
+  if (!(x_end_cell >= 0 && x_begin_cell <= width_ - 1 && y_end_cell >= 0 && y_begin_cell <= height_ - 1))
+    return;
+
+  int x_begin = std::max(x_begin_cell, 0.0);
+  int x_end = std::min(x_end_cell, width_ - 1.0);
+  int y_begin = std::max(y_begin_cell, 0.0);
+  int y_end = std::min(y_end_cell, height_ - 1.0);
+
+  for (int cy = y_begin; cy <= y_end; cy++)
+  {
+    for (int cx = x_begin; cx <= x_end; cx++)
+    {
+      int cell = cy * width_ + cx;
+      indices->insert(indices->end(), point_indices_.begin() + cell_start_[cell], point_indices_.begin() + cell_start_[cell + 1]);
+    }
+  }
+
+  // same order as a loop over the whole cloud
+  std::sort(indices->begin(), indices->end());
+}
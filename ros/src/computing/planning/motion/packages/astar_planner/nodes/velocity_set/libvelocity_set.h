@@ -1,14 +1,19 @@
 #ifndef _VELOCITY_SET_H
 #define _VELOCITY_SET_H
 
+#include <algorithm>
+#include <limits>
 #include <iostream>
 #include <vector>
 #include <map>
 #include <unordered_map>
 #include <math.h>
+#include <cmath>
 
 #include <ros/ros.h>
 #include <geometry_msgs/Point.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
 #include <vector_map/vector_map.h>
 
 #include "waypoint_follower/libwaypoint_follower.h"
@@ -140,6 +145,33 @@ public:
   }
 };
 
+//////////////////////////////////////
+// spatial index of the obstacle points
+//////////////////////////////////////
+// points binned on a 2D grid once per cycle, so that each detection only
+// checks the points in the cells around it instead of the whole cloud
+class PointsGrid
+{
+private:
+  double min_x_;
+  double min_y_;
+  double cell_size_;
+  int width_;
+  int height_;
+  std::vector<int> cell_start_;     // first point of each cell in point_indices_, one more at the end
+  std::vector<int> point_indices_;  // increasing in each cell
+
+public:
+  // the grid covers the bounding box of the points, non-finite ones are left out
+  void build(const pcl::PointCloud<pcl::PointXYZ>& points, double cell_size);
+  // indices of the points that may be closer than radius to (x, y) on the XY plane, in increasing order
+  void getCandidates(double x, double y, double radius, std::vector<int>* indices) const;
+
+  PointsGrid() : min_x_(0), min_y_(0), cell_size_(1), width_(0), height_(0)
+  {
+  }
+};
+
 inline double calcSquareOfLength(const geometry_msgs::Point &p1, const geometry_msgs::Point &p2)
 {
   return (p1.x - p2.x) * (p1.x - p2.x) + (p1.y - p2.y) * (p1.y - p2.y) + (p1.z - p2.z) * (p1.z - p2.z);
@@ -41,6 +41,7 @@ namespace
 constexpr int LOOP_RATE = 10;
 constexpr double DECELERATION_SEARCH_DISTANCE = 30;
 constexpr double STOP_SEARCH_DISTANCE = 60;
+constexpr double POINTS_GRID_CELL_SIZE = 1.0;
 
 
 // Display a detected obstacle
@@ -195,10 +196,11 @@ void displayDetectionRange(const autoware_msgs::lane& lane, const CrossWalk& cro
 }
 
 // obstacle detection for crosswalk
-EControl crossWalkDetection(const pcl::PointCloud<pcl::PointXYZ>& points, const CrossWalk& crosswalk, const geometry_msgs::PoseStamped& localizer_pose, const int points_threshold, ObstaclePoints* obstacle_points)
+EControl crossWalkDetection(const pcl::PointCloud<pcl::PointXYZ>& points, const PointsGrid& points_grid, const CrossWalk& crosswalk, const geometry_msgs::PoseStamped& localizer_pose, const int points_threshold, ObstaclePoints* obstacle_points)
 {
   int crosswalk_id = crosswalk.getDetectionCrossWalkID();
   double search_radius = crosswalk.getDetectionPoints(crosswalk_id).width / 2;
+  std::vector<int> candidates;
 
   // Search each calculated points in the crosswalk
   for (const auto &p : crosswalk.getDetectionPoints(crosswalk_id).points)
@@ -207,9 +209,13 @@ EControl crossWalkDetection(const pcl::PointCloud<pcl::PointXYZ>& points, const
     tf::Vector3 detection_vector = point2vector(detection_point);
     detection_vector.setZ(0.0);
 
+    // only the points near the detection point can be in the area
+    points_grid.getCandidates(detection_vector.x(), detection_vector.y(), search_radius, &candidates);
+
     int stop_count = 0;  // the number of points in the detection area
-    for (const auto &p : points)
+    for (int index : candidates)
     {
+      const auto &p = points[index];
       tf::Vector3 point_vector(p.x, p.y, 0.0);
       double distance = tf::tfDistance(point_vector, detection_vector);
       if (distance < search_radius)
@@ -231,9 +237,10 @@ EControl crossWalkDetection(const pcl::PointCloud<pcl::PointXYZ>& points, const
   return EControl::KEEP;  // find no obstacles
 }
 
-int detectStopObstacle(const pcl::PointCloud<pcl::PointXYZ>& points, const int closest_waypoint, const autoware_msgs::lane& lane, const CrossWalk& crosswalk, double stop_range, double points_threshold, const geometry_msgs::PoseStamped& localizer_pose, ObstaclePoints* obstacle_points)
+int detectStopObstacle(const pcl::PointCloud<pcl::PointXYZ>& points, const PointsGrid& points_grid, const int closest_waypoint, const autoware_msgs::lane& lane, const CrossWalk& crosswalk, double stop_range, double points_threshold, const geometry_msgs::PoseStamped& localizer_pose, ObstaclePoints* obstacle_points)
 {
   int stop_obstacle_waypoint = -1;
+  std::vector<int> candidates;
   // start search from the closest waypoint
   for (int i = closest_waypoint; i < closest_waypoint + STOP_SEARCH_DISTANCE; i++)
   {
@@ -245,7 +252,7 @@ int detectStopObstacle(const pcl::PointCloud<pcl::PointXYZ>& points, const int c
     if (i == crosswalk.getDetectionWaypoint())
     {
       // found an obstacle in the cross walk
-      if (crossWalkDetection(points, crosswalk, localizer_pose, points_threshold, obstacle_points) == EControl::STOP)
+      if (crossWalkDetection(points, points_grid, crosswalk, localizer_pose, points_threshold, obstacle_points) == EControl::STOP)
       {
         stop_obstacle_waypoint = i;
         break;
@@ -257,9 +264,12 @@ int detectStopObstacle(const pcl::PointCloud<pcl::PointXYZ>& points, const int c
     tf::Vector3 tf_waypoint = point2vector(waypoint);
     tf_waypoint.setZ(0);
 
+    points_grid.getCandidates(tf_waypoint.x(), tf_waypoint.y(), stop_range, &candidates);
+
     int stop_point_count = 0;
-    for (const auto& p : points)
+    for (int index : candidates)
     {
+      const auto& p = points[index];
       tf::Vector3 point_vector(p.x, p.y, 0);
 
       // 2D distance between waypoint and points (obstacle)
@@ -290,9 +300,10 @@ int detectStopObstacle(const pcl::PointCloud<pcl::PointXYZ>& points, const int c
   return stop_obstacle_waypoint;
 }
 
-int detectDecelerateObstacle(const pcl::PointCloud<pcl::PointXYZ>& points, const int closest_waypoint, const autoware_msgs::lane& lane, const double stop_range, const double deceleration_range, const double points_threshold, const geometry_msgs::PoseStamped& localizer_pose, ObstaclePoints* obstacle_points)
+int detectDecelerateObstacle(const pcl::PointCloud<pcl::PointXYZ>& points, const PointsGrid& points_grid, const int closest_waypoint, const autoware_msgs::lane& lane, const double stop_range, const double deceleration_range, const double points_threshold, const geometry_msgs::PoseStamped& localizer_pose, ObstaclePoints* obstacle_points)
 {
   int decelerate_obstacle_waypoint = -1;
+  std::vector<int> candidates;
   // start search from the closest waypoint
   for (int i = closest_waypoint; i < closest_waypoint + DECELERATION_SEARCH_DISTANCE; i++)
   {
@@ -305,9 +316,12 @@ int detectDecelerateObstacle(const pcl::PointCloud<pcl::PointXYZ>& points, const
     tf::Vector3 tf_waypoint = point2vector(waypoint);
     tf_waypoint.setZ(0);
 
+    points_grid.getCandidates(tf_waypoint.x(), tf_waypoint.y(), stop_range + deceleration_range, &candidates);
+
     int decelerate_point_count = 0;
-    for (const auto& p : points)
+    for (int index : candidates)
     {
+      const auto& p = points[index];
       tf::Vector3 point_vector(p.x, p.y, 0);
 
       // 2D distance between waypoint and points (obstacle)
@@ -345,7 +359,11 @@ EControl pointsDetection(const pcl::PointCloud<pcl::PointXYZ>& points, const int
   if (points.empty() == true || closest_waypoint < 0)
     return EControl::KEEP;
 
-  int stop_obstacle_waypoint = detectStopObstacle(points, closest_waypoint, lane, crosswalk, vs_info.getStopRange(), vs_info.getPointsThreshold(), vs_info.getLocalizerPose(), obstacle_points);
+  // index the points once for all the waypoints searched below
+  static PointsGrid points_grid;
+  points_grid.build(points, POINTS_GRID_CELL_SIZE);
+
+  int stop_obstacle_waypoint = detectStopObstacle(points, points_grid, closest_waypoint, lane, crosswalk, vs_info.getStopRange(), vs_info.getPointsThreshold(), vs_info.getLocalizerPose(), obstacle_points);
 
   // skip searching deceleration range
   if (vs_info.getDecelerationRange() < 0.01)
@@ -354,7 +372,7 @@ EControl pointsDetection(const pcl::PointCloud<pcl::PointXYZ>& points, const int
     return stop_obstacle_waypoint < 0 ? EControl::KEEP : EControl::STOP;
   }
 
-  int decelerate_obstacle_waypoint = detectDecelerateObstacle(points, closest_waypoint, lane, vs_info.getStopRange(), vs_info.getDecelerationRange(), vs_info.getPointsThreshold(), vs_info.getLocalizerPose(), obstacle_points);
+  int decelerate_obstacle_waypoint = detectDecelerateObstacle(points, points_grid, closest_waypoint, lane, vs_info.getStopRange(), vs_info.getDecelerationRange(), vs_info.getPointsThreshold(), vs_info.getLocalizerPose(), obstacle_points);
 
   // stop obstacle was not found
   if (stop_obstacle_waypoint < 0)
@@ -388,7 +406,7 @@ EControl pointsDetection(const pcl::PointCloud<pcl::PointXYZ>& points, const int
 
 }
 
-EControl obstacleDetection(int closest_waypoint, const autoware_msgs::lane& lane, const CrossWalk& crosswalk, const VelocitySetInfo vs_info, const ros::Publisher& detection_range_pub, const ros::Publisher& obstacle_pub, int* obstacle_waypoint)
+EControl obstacleDetection(int closest_waypoint, const autoware_msgs::lane& lane, const CrossWalk& crosswalk, const VelocitySetInfo& vs_info, const ros::Publisher& detection_range_pub, const ros::Publisher& obstacle_pub, int* obstacle_waypoint)
 {
   ObstaclePoints obstacle_points;
   EControl detection_result = pointsDetection(vs_info.getPoints(), closest_waypoint, lane, crosswalk, vs_info, obstacle_waypoint, &obstacle_points);
@@ -0,0 +1,188 @@
+/*
+ *  Copyright (c) 2015, Nagoya University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of Autoware nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Checks the obstacle search of velocity_set through PointsGrid against a loop over the whole cloud.
+ *
+ * Waypoints 1 m apart along a curved path are searched as detectStopObstacle and detectDecelerateObstacle do.
+ * The points found in the stop and deceleration ranges must be the same, in the same order.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "../nodes/velocity_set/libvelocity_set.h"
+
+namespace
+{
+constexpr int STOP_SEARCH_DISTANCE = 60;
+constexpr int DECELERATION_SEARCH_DISTANCE = 30;
+constexpr double POINTS_GRID_CELL_SIZE = 1.0;
+constexpr double STOP_RANGE = 1.3;
+constexpr double DECELERATION_RANGE = 3.0;
+
+// deterministic pseudo random numbers in [-1, 1]
+float noise(unsigned int* state)
+{
+  *state = *state * 1664525u + 1013904223u;
+  return (*state >> 8) / static_cast<float>(1u << 23) - 1.f;
+}
+
+// walls along a street, parked cars, scattered points, and points velocity_set would not filter out
+pcl::PointCloud<pcl::PointXYZ> makeScan()
+{
+  pcl::PointCloud<pcl::PointXYZ> scan;
+  unsigned int state = 5;
+  for (int i = 0; i < 20000; i++)
+  {
+    float x = 80 * noise(&state);
+    scan.push_back(pcl::PointXYZ(x, (i % 2 ? 6.f : -6.f) + 0.2f * noise(&state), noise(&state)));
+  }
+  for (int car = 0; car < 15; car++)
+  {
+    float cx = 60 * noise(&state), cy = 4 * noise(&state);
+    for (int i = 0; i < 300; i++)
+      scan.push_back(pcl::PointXYZ(cx + 2 * noise(&state), cy + noise(&state), noise(&state)));
+  }
+  for (int i = 0; i < 5000; i++)
+    scan.push_back(pcl::PointXYZ(80 * noise(&state), 80 * noise(&state), noise(&state)));
+  scan.push_back(pcl::PointXYZ(std::numeric_limits<float>::quiet_NaN(), 0, 0));
+  scan.push_back(pcl::PointXYZ(10, std::numeric_limits<float>::infinity(), 0));
+  return scan;
+}
+
+// waypoints 1 m apart, turning left with a 40 m radius
+std::vector<pcl::PointXYZ> makePath()
+{
+  std::vector<pcl::PointXYZ> path;
+  for (int i = 0; i < STOP_SEARCH_DISTANCE; i++)
+  {
+    double angle = i / 40.0;
+    path.push_back(pcl::PointXYZ(40 * std::sin(angle), 40 * (1 - std::cos(angle)), 0));
+  }
+  return path;
+}
+
+// points in the stop range and in the deceleration range of a waypoint, as the searches of velocity_set count them
+struct RangePoints
+{
+  std::vector<int> stop;
+  std::vector<int> decelerate;
+};
+
+void addPoint(const pcl::PointCloud<pcl::PointXYZ>& points, int index, const pcl::PointXYZ& waypoint, bool decelerate,
+              RangePoints* range_points)
+{
+  double dx = points[index].x - waypoint.x;
+  double dy = points[index].y - waypoint.y;
+  double dt = std::sqrt(dx * dx + dy * dy);
+  if (dt < STOP_RANGE)
+    range_points->stop.push_back(index);
+  if (decelerate && dt > STOP_RANGE && dt < STOP_RANGE + DECELERATION_RANGE)
+    range_points->decelerate.push_back(index);
+}
+
+void expectSameSearch(const pcl::PointCloud<pcl::PointXYZ>& points, const PointsGrid& points_grid)
+{
+  std::vector<pcl::PointXYZ> path = makePath();
+  std::vector<int> candidates;
+  int found = 0;
+  for (int i = 0; i < STOP_SEARCH_DISTANCE; i++)
+  {
+    bool decelerate = i < DECELERATION_SEARCH_DISTANCE;
+
+    RangePoints expected;
+    for (size_t index = 0; index < points.size(); index++)
+      addPoint(points, index, path[i], decelerate, &expected);
+
+    RangePoints actual;
+    points_grid.getCandidates(path[i].x, path[i].y, decelerate ? STOP_RANGE + DECELERATION_RANGE : STOP_RANGE,
+                              &candidates);
+    for (int index : candidates)
+      addPoint(points, index, path[i], decelerate, &actual);
+
+    EXPECT_EQ(expected.stop, actual.stop) << "waypoint " << i;
+    EXPECT_EQ(expected.decelerate, actual.decelerate) << "waypoint " << i;
+    found += expected.stop.size() + expected.decelerate.size();
+  }
+  EXPECT_GT(found, 0);
+}
+
+}  // namespace
+
+TEST(PointsGrid, SameObstaclesAsWholeCloud)
+{
+  pcl::PointCloud<pcl::PointXYZ> points = makeScan();
+  PointsGrid points_grid;
+  points_grid.build(points, POINTS_GRID_CELL_SIZE);
+  expectSameSearch(points, points_grid);
+
+  // the grid of the previous scan is replaced
+  points.erase(points.begin(), points.begin() + points.size() / 2);
+  points_grid.build(points, POINTS_GRID_CELL_SIZE);
+  expectSameSearch(points, points_grid);
+}
+
+TEST(PointsGrid, FarPoint)
+{
+  // a point far away makes the cells larger, not the grid
+  pcl::PointCloud<pcl::PointXYZ> points = makeScan();
+  points.push_back(pcl::PointXYZ(1e7, -1e7, 0));
+  PointsGrid points_grid;
+  points_grid.build(points, POINTS_GRID_CELL_SIZE);
+  expectSameSearch(points, points_grid);
+}
+
+TEST(PointsGrid, Empty)
+{
+  pcl::PointCloud<pcl::PointXYZ> points;
+  PointsGrid points_grid;
+  std::vector<int> candidates(1, 0);
+  points_grid.build(points, POINTS_GRID_CELL_SIZE);
+  points_grid.getCandidates(0, 0, STOP_RANGE, &candidates);
+  EXPECT_TRUE(candidates.empty());
+
+  // non-finite query
+  points.push_back(pcl::PointXYZ(0, 0, 0));
+  points_grid.build(points, POINTS_GRID_CELL_SIZE);
+  points_grid.getCandidates(std::numeric_limits<double>::quiet_NaN(), 0, STOP_RANGE, &candidates);
+  EXPECT_TRUE(candidates.empty());
+  points_grid.getCandidates(0, 0, STOP_RANGE, &candidates);
+  EXPECT_EQ(std::vector<int>(1, 0), candidates);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -39,6 +39,8 @@
 #ifndef TRAJECTORYGENERATOR_H
 #define TRAJECTORYGENERATOR_H
 
+#include <vector>
+
 // ---------DEFINE MODE---------//
 //#define GEN_PLOT_FILES
 //#define DEBUG_OUTPUT
@@ -119,6 +121,14 @@
 
 //#define step_size (0.05)
 
+// ------------LOOKUP TABLE----------//
+// Indexed states: goal sx, goal sy, goal theta, initial kappa and velocity
+#define lut_dimensions (5)
+// Parameters stored per indexed state: s, kappa_1 and kappa_2
+#define lut_parameters (3)
+// Maximum number of corrections when generating the table
+#define lut_max_iterations (20)
+
 // ------------LOG FILES----------//
 // Open files for data logging, define globally so all functions may access:
 using namespace std;
@@ -181,6 +191,19 @@ union Spline
     double spline_value[6];
 };
 
+// Converged spline parameters over a regular grid of goal and initial states
+struct LookupTable
+{
+    // Each indexed state goes from min_value to max_value in count values (count >= 2)
+    double min_value[lut_dimensions];
+    double max_value[lut_dimensions];
+    int count[lut_dimensions];
+
+    // lut_parameters values per grid state, the first indexed state varies fastest
+    // s is NaN when the parameters did not converge
+    std::vector<double> params;
+};
+
 union Command
 {
     struct
@@ -228,6 +251,25 @@ union State nextState(union State veh, union Spline curvature, double vdes, doub
 // trajectoryGenerator is like a "main function" used to iterate through a series of goal states
 union Spline trajectoryGenerator(double sx, double sy, double theta, double v, double kappa);
 
+// optimizeParams corrects the parameters until the goal is reached, success is FALSE if it is not reached in max_iterations
+union Spline optimizeParams(union State veh, union State goal, union Spline curvature, int max_iterations);
+
+// generateLookupTable optimizes the parameters of every state of the table grid, the grid must be set
+void generateLookupTable(struct LookupTable* table);
+
+// saveLookupTable and loadLookupTable write and read the table as a binary file (native byte order)
+bool saveLookupTable(const struct LookupTable& table, const char* file_name);
+bool loadLookupTable(const char* file_name, struct LookupTable* table);
+
+// lookupParams interpolates the table as an initial guess, success is FALSE if the states are outside the table
+// or if too few of the neighbouring parameters converged
+union Spline lookupParams(const struct LookupTable& table, union State veh, union State goal);
+
+// generateTrajectories optimizes the parameters of all the goals in parallel, starting from the table,
+// or else from init_curvature, or else from initParams if init_curvature is NULL
+void generateTrajectories(union State veh, const std::vector<union State>& goals, const struct LookupTable& table,
+                          const union Spline* init_curvature, int max_iterations, std::vector<union Spline>* curvatures);
+
 // plotTraj is used by rViz to compute points for line strip, it is a lighter weight version of nextState
 union State genLineStrip(union State veh, union Spline curvature, double vdes, double t);
 
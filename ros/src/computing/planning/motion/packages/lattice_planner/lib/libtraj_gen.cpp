@@ -65,6 +65,7 @@
 #include <fstream>
 #include <stdlib.h>
 #include <stdio.h>
+#include <limits.h>
 #include "libtraj_gen.h"
 // #include "trajectorygenerator.h"
 
@@ -120,11 +121,11 @@ union Spline initParams(union State veh, union State goal)
         double b = (3/(pow(s,2))) * (kappa_0 + kappa_f) + (6*theta_f/(pow(s,3)));
 
         double si=0.00;
+        curvature.s = s;
         curvature.kappa_0 = veh.kappa;
+        curvature.kappa_3 = goal.kappa;
         curvature.kappa_1=(1.00/49.00)*(8.00*b*si - 8.00*b*curvature.s - 26.00*curvature.kappa_0 - curvature.kappa_3);
         curvature.kappa_2=0.25*(curvature.kappa_3 -2.00*curvature.kappa_0 +5.00*curvature.kappa_1);
-        curvature.kappa_3 = goal.kappa;
-        curvature.s = s;
 
     #endif
 
@@ -724,6 +725,297 @@ union State genLineStrip(union State veh, union Spline curvature, double vdes, d
     return veh_next;
 }
 
+// ------------OPTIMIZE PARAMETERS----------//
+// Same iterations as the trajectory generation of the planner
+// INPUT: Initial state, goal state, initial guess, maximum number of corrections
+// OUTPUT: Corrected parameters, success is FALSE if the goal was not reached
+
+union Spline optimizeParams(union State veh, union State goal, union Spline curvature, int max_iterations)
+{
+    curvature.success=TRUE;
+    bool convergence=FALSE;
+    int iteration = 0;
+    union State veh_next;
+    double dt = step_size;
+    veh.v=goal.v;
+
+    while(convergence == FALSE && iteration<max_iterations)
+    {
+        // Set time horizon
+        double horizon = curvature.s/veh.vdes;
+
+        // Run motion model
+        veh_next = motionModel(veh, goal, curvature, dt, horizon, 0);
+
+        // Determine convergence criteria
+        convergence = checkConvergence(veh_next, goal);
+
+        // If the motion model doesn't get us to the goal compute new parameters
+        if(convergence==FALSE)
+        {
+            curvature = generateCorrection(veh, veh_next, goal, curvature, dt, horizon);
+            iteration++;
+
+            // Escape route for poorly conditioned Jacobian
+            if(curvature.success==FALSE)
+            {
+                break;
+            }
+        }
+    }
+
+    if(convergence==FALSE)
+    {
+        curvature.success=FALSE;
+    }
+
+    return curvature;
+}
+
+// ------------LOOKUP TABLE----------//
+// Parameters converged offline over a grid of goal and initial states,
+// interpolated as the initial guess instead of the heuristic of initParams
+
+static int lookupTableSize(const struct LookupTable& table)
+{
+    int size = 1;
+    for(int i=0; i<lut_dimensions; i++)
+    {
+        size = size*table.count[i];
+    }
+    return size;
+}
+
+static double lookupTableValue(const struct LookupTable& table, int dimension, int index)
+{
+    return table.min_value[dimension] + (table.max_value[dimension]-table.min_value[dimension])*index/(table.count[dimension]-1);
+}
+
+static bool checkLookupTableGrid(const struct LookupTable& table)
+{
+    // The counts come from the file, the parameter count must fit in an int
+    int size = lut_parameters;
+    for(int i=0; i<lut_dimensions; i++)
+    {
+        if(table.count[i] < 2 || table.count[i] > INT_MAX/size || !(table.max_value[i] > table.min_value[i]))
+        {
+            return FALSE;
+        }
+        size = size*table.count[i];
+    }
+    return TRUE;
+}
+
+void generateLookupTable(struct LookupTable* table)
+{
+    int size = lookupTableSize(*table);
+    table->params.assign(size*lut_parameters, 0.0);
+
+    // Grid states take very different times to converge
+    #pragma omp parallel for schedule(dynamic)
+    for(int index=0; index<size; index++)
+    {
+        double value[lut_dimensions];
+        int remainder = index;
+        for(int i=0; i<lut_dimensions; i++)
+        {
+            value[i] = lookupTableValue(*table, i, remainder % table->count[i]);
+            remainder = remainder / table->count[i];
+        }
+
+        union State veh;
+        veh.sx = 0.0;
+        veh.sy = 0.0;
+        veh.theta = 0.0;
+        veh.kappa = value[3];
+        veh.v = value[4];
+        veh.vdes = value[4];
+
+        union State goal;
+        goal.sx = value[0];
+        goal.sy = value[1];
+        goal.theta = value[2];
+        goal.kappa = 0.0;
+        goal.v = value[4];
+
+        union Spline curvature = optimizeParams(veh, goal, initParams(veh, goal), lut_max_iterations);
+
+        double* params = &table->params[index*lut_parameters];
+        for(int i=0; i<lut_parameters; i++)
+        {
+            params[i] = curvature.spline_value[i];
+        }
+        if(curvature.success==FALSE)
+        {
+            params[0] = NAN;
+        }
+    }
+}
+
+bool saveLookupTable(const struct LookupTable& table, const char* file_name)
+{
+    if(!checkLookupTableGrid(table) || (int)table.params.size() != lookupTableSize(table)*lut_parameters)
+    {
+        return FALSE;
+    }
+
+    ofstream file(file_name, ios::out | ios::binary);
+    if(!file.is_open())
+    {
+        return FALSE;
+    }
+
+    int dimensions = lut_dimensions;
+    int parameters = lut_parameters;
+    file.write((const char*)&dimensions, sizeof(dimensions));
+    file.write((const char*)&parameters, sizeof(parameters));
+    file.write((const char*)table.min_value, sizeof(table.min_value));
+    file.write((const char*)table.max_value, sizeof(table.max_value));
+    file.write((const char*)table.count, sizeof(table.count));
+    file.write((const char*)&table.params[0], table.params.size()*sizeof(double));
+
+    return file.good();
+}
+
+bool loadLookupTable(const char* file_name, struct LookupTable* table)
+{
+    ifstream file(file_name, ios::in | ios::binary);
+    if(!file.is_open())
+    {
+        return FALSE;
+    }
+
+    int dimensions = 0;
+    int parameters = 0;
+    file.read((char*)&dimensions, sizeof(dimensions));
+    file.read((char*)&parameters, sizeof(parameters));
+    if(!file.good() || dimensions != lut_dimensions || parameters != lut_parameters)
+    {
+        return FALSE;
+    }
+
+    struct LookupTable loaded;
+    file.read((char*)loaded.min_value, sizeof(loaded.min_value));
+    file.read((char*)loaded.max_value, sizeof(loaded.max_value));
+    file.read((char*)loaded.count, sizeof(loaded.count));
+    if(!file.good() || !checkLookupTableGrid(loaded))
+    {
+        return FALSE;
+    }
+
+    // Reject a header announcing more parameters than the file holds before allocating them
+    streampos header_end = file.tellg();
+    file.seekg(0, ios::end);
+    streamoff data_size = file.tellg() - header_end;
+    file.seekg(header_end);
+    if(data_size != (streamoff)lookupTableSize(loaded)*lut_parameters*(streamoff)sizeof(double))
+    {
+        return FALSE;
+    }
+
+    loaded.params.resize(lookupTableSize(loaded)*lut_parameters);
+    file.read((char*)&loaded.params[0], loaded.params.size()*sizeof(double));
+    if(!file.good())
+    {
+        return FALSE;
+    }
+
+    *table = loaded;
+    return TRUE;
+}
+
+union Spline lookupParams(const struct LookupTable& table, union State veh, union State goal)
+{
+    union Spline curvature;
+    curvature.success=FALSE;
+
+    if(table.params.empty())
+    {
+        return curvature;
+    }
+
+    // Cell of the grid containing the states and position in the cell
+    double value[lut_dimensions] = {goal.sx, goal.sy, goal.theta, veh.kappa, goal.v};
+    int cell[lut_dimensions];
+    double ratio[lut_dimensions];
+    for(int i=0; i<lut_dimensions; i++)
+    {
+        if(!(value[i] >= table.min_value[i] && value[i] <= table.max_value[i]))
+        {
+            return curvature;
+        }
+
+        double position = (value[i]-table.min_value[i])/(table.max_value[i]-table.min_value[i])*(table.count[i]-1);
+        cell[i] = min((int)position, table.count[i]-2);
+        ratio[i] = position - cell[i];
+    }
+
+    // Multilinear interpolation over the corners of the cell which converged
+    double params[lut_parameters] = {0.0, 0.0, 0.0};
+    double total_weight = 0.0;
+    for(int corner=0; corner<(1<<lut_dimensions); corner++)
+    {
+        double weight = 1.0;
+        int index = 0;
+        int stride = 1;
+        for(int i=0; i<lut_dimensions; i++)
+        {
+            int bit = (corner>>i) & 1;
+            weight = weight*(bit ? ratio[i] : 1.0-ratio[i]);
+            index = index + (cell[i]+bit)*stride;
+            stride = stride*table.count[i];
+        }
+
+        const double* corner_params = &table.params[index*lut_parameters];
+        if(weight <= 0.0 || std::isnan(corner_params[0]))
+        {
+            continue;
+        }
+
+        for(int i=0; i<lut_parameters; i++)
+        {
+            params[i] = params[i] + weight*corner_params[i];
+        }
+        total_weight = total_weight + weight;
+    }
+
+    // The corners which converged must be closer than the ones which didn't
+    if(total_weight <= 0.5)
+    {
+        return curvature;
+    }
+
+    curvature.s = params[0]/total_weight;
+    curvature.kappa_1 = params[1]/total_weight;
+    curvature.kappa_2 = params[2]/total_weight;
+    curvature.kappa_0 = veh.kappa;
+    curvature.kappa_3 = goal.kappa;
+    curvature.success=TRUE;
+
+    return curvature;
+}
+
+// ------------BATCH GENERATION----------//
+// Computes the parameters of a whole lattice of goal states, one goal per thread
+
+void generateTrajectories(union State veh, const vector<union State>& goals, const struct LookupTable& table,
+                          const union Spline* init_curvature, int max_iterations, vector<union Spline>* curvatures)
+{
+    curvatures->resize(goals.size());
+
+    #pragma omp parallel for schedule(dynamic)
+    for(int i=0; i<(int)goals.size(); i++)
+    {
+        union Spline curvature = lookupParams(table, veh, goals[i]);
+        if(curvature.success==FALSE)
+        {
+            curvature = init_curvature ? *init_curvature : initParams(veh, goals[i]);
+        }
+
+        (*curvatures)[i] = optimizeParams(veh, goals[i], curvature, max_iterations);
+    }
+}
+
 //------------------MAIN FUNCTION AND HELPER FOR STANDALONE OPERATION------------------------//
 
 #ifdef STANDALONE
@@ -0,0 +1,103 @@
+/*
+ *  Copyright (c) 2015, Nagoya University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of Autoware nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+*/
+
+/*
+ * Offline generation of the lookup table of lattice_trajectory_gen.
+ *
+ * The spline parameters are optimized for every state of a regular grid of
+ * goal x, goal y, goal heading, initial curvature and velocity, and saved to
+ * a binary file given to lattice_trajectory_gen as its lookup_table parameter.
+ * Each grid is set from its min, max and count parameters, e.g. _min_x:=5.0.
+ *
+ * Usage: rosrun lattice_planner lattice_lookup_table_gen _output_file:=lattice_lookup_table.bin
+ */
+
+#include <ros/ros.h>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "libtraj_gen.h"
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "lattice_lookup_table_gen", ros::init_options::AnonymousName | ros::init_options::NoRosout);
+  ros::NodeHandle private_nh("~");
+
+  std::string output_file;
+  private_nh.param<std::string>("output_file", output_file, "lattice_lookup_table.bin");
+
+  // Same order as the indexed states of the table
+  const std::string names[lut_dimensions] = { "x", "y", "theta", "kappa", "v" };
+  const double default_min[lut_dimensions] = { 5.0, -12.0, -0.5, -0.1, 2.0 };
+  const double default_max[lut_dimensions] = { 40.0, 12.0, 0.5, 0.1, 14.0 };
+  const int default_count[lut_dimensions] = { 8, 13, 5, 3, 4 };
+
+  struct LookupTable table;
+  for (int i = 0; i < lut_dimensions; i++)
+  {
+    private_nh.param<double>("min_" + names[i], table.min_value[i], default_min[i]);
+    private_nh.param<double>("max_" + names[i], table.max_value[i], default_max[i]);
+    private_nh.param<int>("count_" + names[i], table.count[i], default_count[i]);
+    if (table.count[i] < 2 || !(table.max_value[i] > table.min_value[i]))
+    {
+      std::cout << "Invalid grid for " << names[i] << ", count must be at least 2 and max greater than min." << std::endl;
+      return 1;
+    }
+    std::cout << names[i] << ": " << table.count[i] << " values from " << table.min_value[i] << " to "
+              << table.max_value[i] << std::endl;
+  }
+
+  std::chrono::time_point<std::chrono::system_clock> start = std::chrono::system_clock::now();
+  generateLookupTable(&table);
+  double elapsed = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now() - start).count();
+
+  int num_converged = 0;
+  int num_states = table.params.size() / lut_parameters;
+  for (int i = 0; i < num_states; i++)
+  {
+    if (!std::isnan(table.params[i * lut_parameters]))
+      num_converged++;
+  }
+  std::cout << "Converged states: " << num_converged << "/" << num_states << " in " << elapsed << " s" << std::endl;
+
+  if (!saveLookupTable(table, output_file.c_str()))
+  {
+    std::cout << "Couldn't write " << output_file << "." << std::endl;
+    return 1;
+  }
+  std::cout << "Lookup table written to " << output_file << std::endl;
+
+  return 0;
+}
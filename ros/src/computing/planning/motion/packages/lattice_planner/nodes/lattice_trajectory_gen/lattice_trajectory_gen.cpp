@@ -67,6 +67,7 @@
 #define WHEEL_TO_STEERING_MKZ (22.00)
 
 static const int LOOP_RATE = 10; //Hz
+static const int MAX_CORRECTIONS = 4;
 
 static const std::string MAP_FRAME = "map";
 static const std::string SIM_BASE_FRAME = "sim_base_link";
@@ -93,6 +94,9 @@ static double g_mkz_info_curvature;
 
 static int SPLINE_INDEX=0;
 
+// Converged spline parameters generated offline by lattice_lookup_table_gen, empty if not given
+static struct LookupTable g_lookup_table;
+
 //config topic
 static int g_param_flag = 0; //0 = waypoint, 1 = Dialog
 static double g_lookahead_threshold = 4.0; //meter
@@ -365,61 +369,28 @@ static union State computeVeh(int old_time, double old_theta, int next_waypoint)
 /////////////////////////////////////////////////////////////////
 static union Spline waypointTrajectory(union State veh, union State goal, union Spline curvature, int next_waypoint)
 {
-    curvature.success=TRUE;  
-    bool convergence=FALSE;
-    int iteration = 0;
-    union State veh_next;
-    double dt = step_size;
     veh.v=goal.v;
+    ROS_INFO_STREAM("vdes: " << veh.vdes);
+    ROS_INFO_STREAM("horizon: " << curvature.s/veh.vdes);
 
-    // While loop for computing trajectory parameters
-    while(convergence == FALSE && iteration<4)
-    {
-        // Set time horizon
-        double horizon = curvature.s/veh.vdes;
-        ROS_INFO_STREAM("vdes: " << veh.vdes);
-        ROS_INFO_STREAM("horizon: " << horizon);
-
-        // Run motion model
-        veh_next = motionModel(veh, goal, curvature, dt, horizon, 0);
-        
-        // Determine convergence criteria
-        convergence = checkConvergence(veh_next, goal);
-
-        // If the motion model doesn't get us to the goal compute new parameters
-        if(convergence==FALSE)
-        {
-            // Update parameters
-            curvature = generateCorrection(veh, veh_next, goal, curvature, dt, horizon);
-            iteration++;
+    // Same corrections as the lattice and the lookup table
+    curvature = optimizeParams(veh, goal, curvature, MAX_CORRECTIONS);
 
-            // Escape route for poorly conditioned Jacobian
-            if(curvature.success==FALSE)
-            {
-                ROS_INFO_STREAM("Init State: sx "<<veh.sx<<" sy " <<veh.sy<<" theta "<<veh.theta<<" kappa "<<veh.kappa<<" v "<<veh.v);
-                ROS_INFO_STREAM("Goal State: sx "<<goal.sx<<" sy " <<goal.sy<<" theta "<<goal.theta<<" kappa "<<goal.kappa<<" v"<<goal.v);
-                break;
-            }
-        }    
-    }
-
-    if(convergence==FALSE)
+    if(curvature.success==FALSE)
     {
-      ROS_INFO_STREAM("Next State: sx "<<veh_next.sx<<" sy " <<veh_next.sy<<" theta "<<veh_next.theta<<" kappa "<<veh_next.kappa<<" v "<<veh_next.v);
-      ROS_INFO_STREAM("Init State: sx "<<veh.sx<<" sy " <<veh.sy<<" theta "<<veh.theta<<" kappa "<<veh.kappa);
-      ROS_INFO_STREAM("Goal State: sx "<<goal.sx<<" sy " <<goal.sy<<" theta "<<goal.theta<<" kappa "<<goal.kappa);
-      curvature.success= FALSE;
+      ROS_INFO_STREAM("Init State: sx "<<veh.sx<<" sy " <<veh.sy<<" theta "<<veh.theta<<" kappa "<<veh.kappa<<" v "<<veh.v);
+      ROS_INFO_STREAM("Goal State: sx "<<goal.sx<<" sy " <<goal.sy<<" theta "<<goal.theta<<" kappa "<<goal.kappa<<" v "<<goal.v);
     }
 
     else
     {
-        ROS_INFO_STREAM("Converged in "<<iteration<<" iterations");
+        ROS_INFO_STREAM("Converged");
 
         #ifdef LOG_OUTPUT
         // Set time horizon
          double horizon = curvature.s/v_0;
         // Run motion model and log data for plotting
-        veh_next = motionModel(veh, goal, curvature, 0.1, horizon, 1);
+        union State veh_next = motionModel(veh, goal, curvature, 0.1, horizon, 1);
         fmm_sx<<"0.0 \n";
         fmm_sy<<"0.0 \n";
         #endif
@@ -528,6 +499,16 @@ int main(int argc, char **argv)
   ROS_INFO_STREAM("prius_mode : " << g_prius_mode);
   ROS_INFO_STREAM("mkz_mode : " << g_mkz_mode);
 
+  std::string lookup_table_file;
+  private_nh.param<std::string>("lookup_table", lookup_table_file, "");
+  if (!lookup_table_file.empty())
+  {
+    if (loadLookupTable(lookup_table_file.c_str(), &g_lookup_table))
+      ROS_INFO_STREAM("lookup table : " << lookup_table_file);
+    else
+      ROS_WARN_STREAM("Couldn't load the lookup table " << lookup_table_file << ", using the heuristic initial parameters");
+  }
+
   // Publish the following topics: 
   g_vis_pub = nh.advertise<visualization_msgs::Marker>("next_waypoint_mark", 1);
   g_stat_pub = nh.advertise<std_msgs::Bool>("wf_stat", 0);
@@ -626,8 +607,12 @@ int main(int argc, char **argv)
             ROS_INFO_STREAM("est kappa: " <<veh_fmm.kappa);
           }
         
-          // Initialize the estimate for the curvature
-          union Spline curvature = initParams(veh, goal);
+          // Initialize the estimate for the curvature, from the lookup table when the goal is in it
+          union Spline curvature = lookupParams(g_lookup_table, veh, goal);
+          if(curvature.success==FALSE)
+          {
+            curvature = initParams(veh, goal);
+          }
 
           // Generate a cubic spline (trajectory) for the vehicle to follow
           curvature = waypointTrajectory(veh, goal, curvature, next_waypoint);
@@ -674,31 +659,25 @@ int main(int argc, char **argv)
                 ROS_INFO_STREAM("Spline published to RVIZ");
               }
               
-                // This is a messy for loop which generates extra trajectories for visualization
+                // Extra trajectories for visualization, goals shifted sideways from the waypoint
                 // Likely will change when valid cost map arrives.
-                // Note: pragma indicates parallelization for OpenMP
-
-                // Setup variables
-                union State tempGoal= goal;
-                int i;
-                union Spline extra;
-                
-                // Tell OpenMP how to parallelize (keep i private because it is a counter)
-                #pragma omp parallel for private(i)
-
-                // Index through all the predefined perturbations from waypoint
-                for(i=1; i<31; i++)
+                // Note: the lattice is generated in parallel by OpenMP, starting from the lookup table
+                // or else from the waypoint trajectory
+                std::vector<union State> extra_goals(30, goal);
+                for(int i=0; i<30; i++)
                 {
-                  // Shift the y-coordinate of the goal
-                  tempGoal.sy = tempGoal.sy + perturb[i-1];
+                  extra_goals[i].sy = goal.sy + perturb[i];
+                }
 
-                  // Compute new spline 
-                  extra= waypointTrajectory(veh, tempGoal, curvature, next_waypoint);
+                std::vector<union Spline> extras;
+                generateTrajectories(veh, extra_goals, g_lookup_table, &curvature, MAX_CORRECTIONS, &extras);
 
-                  // Display trajectory
-                  if(veh.v>5.00)
+                // Display trajectories
+                if(veh.v>5.00)
+                {
+                  for(int i=1; i<31; i++)
                   {
-                    drawSpline(extra, veh, i,1);
+                    drawSpline(extras[i-1], veh, i,1);
                   }
                 }
           }
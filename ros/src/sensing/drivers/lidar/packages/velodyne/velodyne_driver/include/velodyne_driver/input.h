@@ -35,6 +35,8 @@
 #include <stdio.h>
 #include <pcap.h>
 #include <netinet/in.h>
+#include <sys/socket.h>
+#include <vector>
 
 #include <ros/ros.h>
 #include <velodyne_msgs/VelodynePacket.h>
@@ -43,6 +45,19 @@ namespace velodyne_driver
 {
   static uint16_t UDP_PORT_NUMBER = 2368;
 
+  /** @brief Input statistics since they were last taken. */
+  struct InputStats
+  {
+    InputStats(): packets(0), dropped(0), stamped(0),
+                  latency_sum(0.0), latency_max(0.0) {}
+
+    uint64_t packets;           ///< packets returned
+    uint64_t dropped;           ///< packets dropped by the kernel
+    uint64_t stamped;           ///< packets with a kernel timestamp
+    double latency_sum;         ///< sum of kernel to driver latencies (s)
+    double latency_max;         ///< largest kernel to driver latency (s)
+  };
+
   /** @brief Pure virtual Velodyne input base class */
   class Input
   {
@@ -59,6 +74,26 @@ namespace velodyne_driver
      */
     virtual int getPacket(velodyne_msgs::VelodynePacket *pkt) = 0;
 
+    /** @brief Read up to count Velodyne packets.
+     *
+     * The default reads one packet with getPacket().
+     *
+     * @param pkt points to an array of count VelodynePacket messages
+     * @param count maximum number of packets to read
+     *
+     * @returns number of packets read (possibly 0),
+     *          -1 if end of file
+     */
+    virtual int getPackets(velodyne_msgs::VelodynePacket *pkt, int count);
+
+    /** @brief Return the statistics gathered since the last call. */
+    InputStats takeStats()
+    {
+      InputStats stats = stats_;
+      stats_ = InputStats();
+      return stats;
+    }
+
 
     /** @brief Set source IP, from where packets are accepted
      *
@@ -67,6 +102,7 @@ namespace velodyne_driver
     virtual void setDeviceIP( const std::string& ip ) { devip_str_ = ip; }
   protected:
     std::string devip_str_;
+    InputStats stats_;
   };
 
   /** @brief Live Velodyne input from socket. */
@@ -78,11 +114,23 @@ namespace velodyne_driver
     ~InputSocket();
 
     virtual int getPacket(velodyne_msgs::VelodynePacket *pkt);
+    virtual int getPackets(velodyne_msgs::VelodynePacket *pkt, int count);
     void setDeviceIP( const std::string& ip );
   private:
 
+    int pollSocket();
+
     int sockfd_;
     in_addr devip_;
+
+    /** batched input: recvmmsg() with kernel receive timestamps */
+    bool batch_;
+    int max_batch_;
+    uint32_t dropped_;                  ///< last kernel drop counter
+    std::vector<mmsghdr> msgs_;
+    std::vector<iovec> iovecs_;
+    std::vector<sockaddr_in> addresses_;
+    std::vector<char> control_;
   };
 
 
@@ -25,7 +25,11 @@ namespace velodyne_driver
 {
 
 VelodyneDriver::VelodyneDriver(ros::NodeHandle node,
-                               ros::NodeHandle private_nh)
+                               ros::NodeHandle private_nh):
+  nr_pending_(0),
+  next_pending_(0),
+  total_packets_(0),
+  total_dropped_(0)
 {
   // use private node handle to get parameters
   private_nh.param("frame_id", config_.frame_id, std::string("velodyne"));
@@ -80,6 +84,24 @@ VelodyneDriver::VelodyneDriver(ros::NodeHandle node,
   private_nh.getParam("npackets", config_.npackets);
   ROS_INFO_STREAM("publishing " << config_.npackets << " packets per scan");
 
+  // optionally publish azimuth sectors as soon as they are complete,
+  // instead of waiting for the whole revolution
+  private_nh.param("sector_angle", config_.sector_angle, 0.0);
+  if (config_.sector_angle != 0.0
+      && (config_.sector_angle < 1.0 || config_.sector_angle >= 360.0))
+    {
+      ROS_ERROR_STREAM("invalid sector_angle: " << config_.sector_angle);
+      config_.sector_angle = 0.0;
+    }
+  int nsectors = 1;
+  if (config_.sector_angle > 0.0)
+    {
+      nsectors = 35999 / (int) (config_.sector_angle * 100) + 1;
+      pending_.resize((int) ceil(config_.npackets / (double) nsectors));
+      ROS_INFO_STREAM("publishing sectors of " << config_.sector_angle
+                      << " degrees");
+    }
+
   std::string dump_file;
   private_nh.param("pcap", dump_file, std::string(""));
 
@@ -88,7 +110,7 @@ VelodyneDriver::VelodyneDriver(ros::NodeHandle node,
 
   // initialize diagnostics
   diagnostics_.setHardwareID(deviceName);
-  const double diag_freq = packet_rate/config_.npackets;
+  const double diag_freq = nsectors * packet_rate/config_.npackets;
   diag_max_freq_ = diag_freq;
   diag_min_freq_ = diag_freq;
   ROS_INFO("expected frequency: %.3f (Hz)", diag_freq);
@@ -99,6 +121,7 @@ VelodyneDriver::VelodyneDriver(ros::NodeHandle node,
                                                              &diag_max_freq_,
                                                              0.1, 10),
                                         TimeStampStatusParam()));
+  diagnostics_.add("Velodyne input", this, &VelodyneDriver::inputDiagnostics);
 
   // open Velodyne input device or file
   if (dump_file != "")
@@ -128,26 +151,76 @@ VelodyneDriver::VelodyneDriver(ros::NodeHandle node,
  */
 bool VelodyneDriver::poll(void)
 {
+  if (config_.sector_angle > 0.0)
+    return pollSector();
+
   // Allocate a new shared pointer for zero-copy sharing with other nodelets.
   velodyne_msgs::VelodyneScanPtr scan(new velodyne_msgs::VelodyneScan);
   scan->packets.resize(config_.npackets);
 
   // Since the velodyne delivers data at a very high rate, keep
   // reading and publishing scans as fast as possible.
-  for (int i = 0; i < config_.npackets; ++i)
+  for (int i = 0; i < config_.npackets; )
     {
-      while (true)
+      // keep reading until all packets received
+      int rc = input_->getPackets(&scan->packets[i], config_.npackets - i);
+      if (rc < 0) return false;     // end of file reached?
+      i += rc;
+    }
+
+  ROS_DEBUG("Publishing a full Velodyne scan.");
+  publishScan(scan);
+  return true;
+}
+
+/** poll the device for the packets of one azimuth sector
+ *
+ *  Sectors are aligned to multiples of sector_angle.  A sector is
+ *  complete when the first packet of the next one arrives.
+ *
+ *  @returns true unless end of file reached
+ */
+bool VelodyneDriver::pollSector(void)
+{
+  velodyne_msgs::VelodyneScanPtr scan(new velodyne_msgs::VelodyneScan);
+  scan->packets.reserve(pending_.size() + 1);
+
+  const int sector_size = (int) (config_.sector_angle * 100); // 1/100 degree
+  int sector = -1;
+  while (true)
+    {
+      if (next_pending_ == nr_pending_)
         {
-          // keep reading until full packet received
-          int rc = input_->getPacket(&scan->packets[i]);
-          if (rc == 0) break;       // got a full packet?
+          int rc = input_->getPackets(&pending_[0], pending_.size());
           if (rc < 0) return false; // end of file reached?
+          nr_pending_ = rc;
+          next_pending_ = 0;
+          continue;
         }
+
+      // azimuth of the first block, 0-35999
+      const velodyne_msgs::VelodynePacket &pkt = pending_[next_pending_];
+      int azimuth = pkt.data[2] | (pkt.data[3] << 8);
+      if (sector >= 0 && azimuth / sector_size != sector)
+        break;                      // sector complete
+      sector = azimuth / sector_size;
+
+      scan->packets.push_back(pkt);
+      ++next_pending_;
+      if ((int) scan->packets.size() >= config_.npackets)
+        break;                      // not rotating?
     }
 
+  ROS_DEBUG("Publishing a Velodyne sector.");
+  publishScan(scan);
+  return true;
+}
+
+/** publish a scan and update the diagnostics */
+void VelodyneDriver::publishScan(const velodyne_msgs::VelodyneScanPtr &scan)
+{
   // publish message using time of last packet read
-  ROS_DEBUG("Publishing a full Velodyne scan.");
-  scan->header.stamp = ros::Time(scan->packets[config_.npackets - 1].stamp);
+  scan->header.stamp = ros::Time(scan->packets.back().stamp);
   scan->header.frame_id = config_.frame_id;
   output_.publish(scan);
 
@@ -155,8 +228,32 @@ bool VelodyneDriver::poll(void)
   // its status
   diag_topic_->tick(scan->header.stamp);
   diagnostics_.update();
+}
 
-  return true;
+/** report packet loss and input latency since the last update */
+void VelodyneDriver::inputDiagnostics(
+    diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+  InputStats stats = input_->takeStats();
+  total_packets_ += stats.packets;
+  total_dropped_ += stats.dropped;
+
+  if (stats.dropped > 0)
+    stat.summaryf(diagnostic_msgs::DiagnosticStatus::WARN,
+                  "%lu packets dropped", (unsigned long) stats.dropped);
+  else
+    stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "No packets dropped");
+
+  stat.add("Packets received", stats.packets);
+  stat.add("Packets dropped", stats.dropped);
+  stat.add("Total packets received", total_packets_);
+  stat.add("Total packets dropped", total_dropped_);
+  if (stats.stamped > 0)
+    {
+      stat.addf("Mean latency (ms)", "%.3f",
+                1000.0 * stats.latency_sum / stats.stamped);
+      stat.addf("Max latency (ms)", "%.3f", 1000.0 * stats.latency_max);
+    }
 }
 
 } // namespace velodyne_driver
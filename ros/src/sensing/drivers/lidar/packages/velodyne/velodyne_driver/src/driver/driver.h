@@ -16,11 +16,13 @@
 #define _VELODYNE_DRIVER_H_ 1
 
 #include <string>
+#include <vector>
 #include <ros/ros.h>
 #include <diagnostic_updater/diagnostic_updater.h>
 #include <diagnostic_updater/publisher.h>
 
 #include <velodyne_driver/input.h>
+#include <velodyne_msgs/VelodyneScan.h>
 
 namespace velodyne_driver
 {
@@ -37,6 +39,10 @@ public:
 
 private:
 
+  bool pollSector(void);
+  void publishScan(const velodyne_msgs::VelodyneScanPtr &scan);
+  void inputDiagnostics(diagnostic_updater::DiagnosticStatusWrapper &stat);
+
   // configuration parameters
   struct
   {
@@ -44,8 +50,14 @@ private:
     std::string model;               ///< device model name
     int    npackets;                 ///< number of packets to collect
     double rpm;                      ///< device rotation rate (RPMs)
+    double sector_angle;             ///< sector to publish (degrees), 0 for revolutions
   } config_;
 
+  /** packets read but not yet published in sector mode */
+  std::vector<velodyne_msgs::VelodynePacket> pending_;
+  int nr_pending_;
+  int next_pending_;
+
   boost::shared_ptr<Input> input_;
   ros::Publisher output_;
 
@@ -54,6 +66,8 @@ private:
   double diag_min_freq_;
   double diag_max_freq_;
   boost::shared_ptr<diagnostic_updater::TopicDiagnostic> diag_topic_;
+  uint64_t total_packets_;
+  uint64_t total_dropped_;
 };
 
 } // namespace velodyne_driver
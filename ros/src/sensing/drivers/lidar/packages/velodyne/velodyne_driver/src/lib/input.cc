@@ -28,12 +28,34 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/file.h>
+#include <time.h>
+#include <algorithm>
 #include <velodyne_driver/input.h>
 
 namespace velodyne_driver
 {
   static const size_t packet_size = sizeof(velodyne_msgs::VelodynePacket().data);
 
+  // control message room for a receive timestamp and a drop counter
+  static const size_t control_size =
+    CMSG_SPACE(sizeof(timespec)) + CMSG_SPACE(sizeof(uint32_t));
+
+  ////////////////////////////////////////////////////////////////////////
+  // Input class implementation
+  ////////////////////////////////////////////////////////////////////////
+
+  /** @brief Get up to count velodyne packets, one at a time. */
+  int Input::getPackets(velodyne_msgs::VelodynePacket *pkt, int count)
+  {
+    int rc = getPacket(pkt);
+    if (rc < 0)
+      return -1;
+    if (rc > 0)
+      return 0;
+    ++stats_.packets;
+    return 1;
+  }
+
   ////////////////////////////////////////////////////////////////////////
   // InputSocket class implementation
   ////////////////////////////////////////////////////////////////////////
@@ -47,6 +69,13 @@ namespace velodyne_driver
     Input()
   {
     sockfd_ = -1;
+    dropped_ = 0;
+
+    // get parameters using private node handle
+    private_nh.param("batch_input", batch_, false);
+    private_nh.param("max_batch", max_batch_, 64);
+    if (max_batch_ < 1)
+      max_batch_ = 1;
 
     // connect to Velodyne UDP port
     ROS_INFO_STREAM("Opening UDP socket: port " << udp_port);
@@ -75,6 +104,26 @@ namespace velodyne_driver
         return;
       }
 
+    if (batch_)
+      {
+        // have the kernel stamp each packet on arrival and report the
+        // packets it dropped because the receive buffer was full
+        int on = 1;
+        if (setsockopt(sockfd_, SOL_SOCKET, SO_TIMESTAMPNS,
+                       &on, sizeof(on)) < 0)
+          perror("SO_TIMESTAMPNS");
+        if (setsockopt(sockfd_, SOL_SOCKET, SO_RXQ_OVFL,
+                       &on, sizeof(on)) < 0)
+          perror("SO_RXQ_OVFL");
+
+        msgs_.resize(max_batch_);
+        iovecs_.resize(max_batch_);
+        addresses_.resize(max_batch_);
+        control_.resize(max_batch_ * control_size);
+        ROS_INFO("Batched socket input, up to %d packets per read",
+                 max_batch_);
+      }
+
     ROS_DEBUG("Velodyne socket fd is %d\n", sockfd_);
   }
 
@@ -90,16 +139,49 @@ namespace velodyne_driver
     inet_aton(ip.c_str(),&devip_);
   }
 
-  /** @brief Get one velodyne packet. */
-  int InputSocket::getPacket(velodyne_msgs::VelodynePacket *pkt)
+  /** @brief Wait until the socket has input.
+   *
+   *  @returns 0 if input is available, 1 on timeout or error
+   */
+  int InputSocket::pollSocket()
   {
-    double time1 = ros::Time::now().toSec();
-
     struct pollfd fds[1];
     fds[0].fd = sockfd_;
     fds[0].events = POLLIN;
     static const int POLL_TIMEOUT = 1000; // one second (in msec)
 
+    // poll() until input available
+    do
+      {
+        int retval = poll(fds, 1, POLL_TIMEOUT);
+        if (retval < 0)             // poll() error?
+          {
+            if (errno != EINTR)
+              ROS_ERROR("poll() error: %s", strerror(errno));
+            return 1;
+          }
+        if (retval == 0)            // poll() timeout?
+          {
+            ROS_WARN("Velodyne poll() timeout");
+            return 1;
+          }
+        if ((fds[0].revents & POLLERR)
+            || (fds[0].revents & POLLHUP)
+            || (fds[0].revents & POLLNVAL)) // device error?
+          {
+            ROS_ERROR("poll() reports Velodyne error");
+            return 1;
+          }
+      } while ((fds[0].revents & POLLIN) == 0);
+
+    return 0;
+  }
+
+  /** @brief Get one velodyne packet. */
+  int InputSocket::getPacket(velodyne_msgs::VelodynePacket *pkt)
+  {
+    double time1 = ros::Time::now().toSec();
+
     sockaddr_in sender_address;
     socklen_t sender_address_len = sizeof(sender_address);
 
@@ -123,28 +205,8 @@ namespace velodyne_driver
         //   block.
 
         // poll() until input available
-        do
-          {
-            int retval = poll(fds, 1, POLL_TIMEOUT);
-            if (retval < 0)             // poll() error?
-              {
-                if (errno != EINTR)
-                  ROS_ERROR("poll() error: %s", strerror(errno));
-                return 1;
-              }
-            if (retval == 0)            // poll() timeout?
-              {
-                ROS_WARN("Velodyne poll() timeout");
-                return 1;
-              }
-            if ((fds[0].revents & POLLERR)
-                || (fds[0].revents & POLLHUP)
-                || (fds[0].revents & POLLNVAL)) // device error?
-              {
-                ROS_ERROR("poll() reports Velodyne error");
-                return 1;
-              }
-          } while ((fds[0].revents & POLLIN) == 0);
+        if (pollSocket() != 0)
+          return 1;
 
         // Receive packets that should now be available from the
         // socket using a blocking read.
@@ -184,6 +246,106 @@ namespace velodyne_driver
     return 0;
   }
 
+  /** @brief Get up to count velodyne packets with one recvmmsg().
+   *
+   *  Packets are received straight into the messages and stamped with
+   *  their kernel arrival time.  Packets dropped by the kernel and the
+   *  time packets spent queued in the socket are added to the input
+   *  statistics.
+   */
+  int InputSocket::getPackets(velodyne_msgs::VelodynePacket *pkt, int count)
+  {
+    if (!batch_)
+      return Input::getPackets(pkt, count);
+
+    if (pollSocket() != 0)
+      return 0;
+
+    count = std::min(count, max_batch_);
+    for (int i = 0; i < count; ++i)
+      {
+        iovecs_[i].iov_base = &pkt[i].data[0];
+        iovecs_[i].iov_len = packet_size;
+        msghdr &hdr = msgs_[i].msg_hdr;
+        hdr.msg_name = &addresses_[i];
+        hdr.msg_namelen = sizeof(sockaddr_in);
+        hdr.msg_iov = &iovecs_[i];
+        hdr.msg_iovlen = 1;
+        hdr.msg_control = &control_[i * control_size];
+        hdr.msg_controllen = control_size;
+        hdr.msg_flags = 0;
+      }
+
+    int nmsgs = recvmmsg(sockfd_, &msgs_[0], count, MSG_DONTWAIT, NULL);
+    if (nmsgs < 0)
+      {
+        if (errno != EWOULDBLOCK && errno != EINTR)
+          {
+            perror("recvfail");
+            ROS_INFO("recvfail");
+          }
+        return 0;
+      }
+    ros::Time now = ros::Time::now();
+
+    int npackets = 0;
+    for (int i = 0; i < nmsgs; ++i)
+      {
+        const msghdr &hdr = msgs_[i].msg_hdr;
+        ros::Time stamp = now;
+        bool stamped = false;
+        for (cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg != NULL;
+             cmsg = CMSG_NXTHDR(const_cast<msghdr *>(&hdr), cmsg))
+          {
+            if (cmsg->cmsg_level != SOL_SOCKET)
+              continue;
+            if (cmsg->cmsg_type == SCM_TIMESTAMPNS)
+              {
+                timespec ts;
+                memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                stamp = ros::Time(ts.tv_sec, ts.tv_nsec);
+                stamped = true;
+              }
+            else if (cmsg->cmsg_type == SO_RXQ_OVFL)
+              {
+                // cumulative count, wraps around
+                uint32_t dropped;
+                memcpy(&dropped, CMSG_DATA(cmsg), sizeof(dropped));
+                stats_.dropped += (uint32_t) (dropped - dropped_);
+                dropped_ = dropped;
+              }
+          }
+
+        if (msgs_[i].msg_len != packet_size)
+          {
+            ROS_DEBUG_STREAM("incomplete Velodyne packet read: "
+                             << msgs_[i].msg_len << " bytes");
+            continue;
+          }
+
+        // if packet is not from the lidar scanner we selected by IP, skip it
+        if (devip_str_ != ""
+            && addresses_[i].sin_addr.s_addr != devip_.s_addr)
+          continue;
+
+        if (npackets != i)
+          pkt[npackets].data = pkt[i].data;
+        pkt[npackets].stamp = stamp;
+        ++npackets;
+
+        ++stats_.packets;
+        if (stamped)
+          {
+            double latency = (now - stamp).toSec();
+            ++stats_.stamped;
+            stats_.latency_sum += latency;
+            stats_.latency_max = std::max(stats_.latency_max, latency);
+          }
+      }
+
+    return npackets;
+  }
+
   ////////////////////////////////////////////////////////////////////////
   // InputPCAP class implementation
   ////////////////////////////////////////////////////////////////////////
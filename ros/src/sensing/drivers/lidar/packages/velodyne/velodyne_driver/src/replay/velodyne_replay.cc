@@ -0,0 +1,79 @@
+/*
+ *  Copyright (C) 2012 Austin Robot Technology, Jack O'Quin
+ *
+ *  License: Modified BSD Software License Agreement
+ *
+ *  $Id$
+ */
+
+/** \file
+ *
+ *  Replay a Velodyne PCAP dump file as UDP packets, so the socket
+ *  input of the driver can be run without a device.
+ */
+
+#include <string.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <ros/ros.h>
+#include <velodyne_driver/input.h>
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "velodyne_replay");
+  ros::NodeHandle private_nh("~");
+
+  std::string dump_file;
+  private_nh.param("pcap", dump_file, std::string(""));
+  if (dump_file == "")
+    {
+      ROS_FATAL("No PCAP dump file given (~pcap).");
+      return 1;
+    }
+
+  double packet_rate;                   // packet frequency (Hz)
+  private_nh.param("packet_rate", packet_rate, 2600.0);
+  std::string host;
+  private_nh.param("host", host, std::string("127.0.0.1"));
+  int udp_port;
+  private_nh.param("port", udp_port, (int) velodyne_driver::UDP_PORT_NUMBER);
+
+  int sockfd = socket(PF_INET, SOCK_DGRAM, 0);
+  if (sockfd == -1)
+    {
+      perror("socket");
+      return 1;
+    }
+
+  sockaddr_in dest_addr;
+  memset(&dest_addr, 0, sizeof(dest_addr));
+  dest_addr.sin_family = AF_INET;
+  dest_addr.sin_port = htons(udp_port);
+  if (inet_aton(host.c_str(), &dest_addr.sin_addr) == 0)
+    {
+      ROS_FATAL_STREAM("Invalid host address: " << host);
+      return 1;
+    }
+
+  // read_once, read_fast and repeat_delay are read by InputPCAP
+  velodyne_driver::InputPCAP input(private_nh, packet_rate, dump_file);
+  ROS_INFO_STREAM("Sending packets to " << host << ":" << udp_port
+                  << " at " << packet_rate << " Hz");
+
+  velodyne_msgs::VelodynePacket pkt;
+  uint64_t npackets = 0;
+  while (ros::ok() && input.getPacket(&pkt) == 0)
+    {
+      if (sendto(sockfd, &pkt.data[0], pkt.data.size(), 0,
+                 (sockaddr *) &dest_addr, sizeof(dest_addr)) < 0)
+        perror("sendto");
+      else
+        ++npackets;
+    }
+
+  ROS_INFO_STREAM(npackets << " packets sent");
+  close(sockfd);
+  return 0;
+}
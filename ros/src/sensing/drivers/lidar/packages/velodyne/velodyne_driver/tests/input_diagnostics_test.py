@@ -0,0 +1,53 @@
+#!/usr/bin/env python
+"""Check the "Velodyne input" diagnostics of the driver socket input.
+
+Waits for a few input statuses on /diagnostics, then checks that packets
+were received, none were dropped, and their kernel arrival times were
+read, which only the batch input provides.
+"""
+
+PKG = 'velodyne_driver'
+
+import unittest
+
+import rospy
+import rostest
+from diagnostic_msgs.msg import DiagnosticArray, DiagnosticStatus
+
+
+class InputDiagnosticsTest(unittest.TestCase):
+
+    def setUp(self):
+        self.statuses = []
+
+    def callback(self, msg):
+        for status in msg.status:
+            if status.name.endswith('Velodyne input'):
+                self.statuses.append(status)
+
+    def test_input_diagnostics(self):
+        rospy.init_node('input_diagnostics_test')
+        test_duration = rospy.get_param('~test_duration', 10.0)
+        rospy.Subscriber('diagnostics', DiagnosticArray, self.callback)
+
+        # the driver updates its diagnostics about once a second
+        deadline = rospy.get_time() + test_duration
+        while (not rospy.is_shutdown() and rospy.get_time() < deadline
+               and len(self.statuses) < 3):
+            rospy.sleep(0.1)
+        self.assertTrue(self.statuses, 'no Velodyne input diagnostics')
+
+        for status in self.statuses:
+            self.assertEqual(status.level, DiagnosticStatus.OK,
+                             status.message)
+
+        values = dict((kv.key, kv.value) for kv in self.statuses[-1].values)
+        self.assertGreater(int(values['Total packets received']), 0)
+        self.assertEqual(int(values['Total packets dropped']), 0)
+        self.assertTrue(any('Mean latency (ms)' in [kv.key for kv in s.values]
+                            for s in self.statuses),
+                        'no kernel arrival times')
+
+
+if __name__ == '__main__':
+    rostest.rosrun(PKG, 'input_diagnostics_test', InputDiagnosticsTest)
@@ -21,6 +21,7 @@
 #define __VELODYNE_RAWDATA_H
 
 #include <errno.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <string>
 #include <boost/format.hpp>
@@ -28,6 +29,7 @@
 
 #include <ros/ros.h>
 #include <pcl_ros/point_cloud.h>
+#include <sensor_msgs/PointCloud2.h>
 #include <velodyne_msgs/VelodyneScan.h>
 #include <velodyne_pointcloud/point_types.h>
 #include <velodyne_pointcloud/calibration.h>
@@ -96,6 +98,7 @@ namespace velodyne_rawdata
   static const int BLOCKS_PER_PACKET = 12;
   static const int PACKET_STATUS_SIZE = 4;
   static const int SCANS_PER_PACKET = (SCANS_PER_BLOCK * BLOCKS_PER_PACKET);
+  static const int MAX_LASERS = 64;
 
   /** \brief Raw Velodyne packet.
    *
@@ -116,6 +119,43 @@ namespace velodyne_rawdata
     uint8_t status[PACKET_STATUS_SIZE]; 
   } raw_packet_t;
 
+  /** \brief Per-laser calibration values in structure-of-arrays form.
+   *
+   *  Indexed by hardware laser number, so the lasers of a block are
+   *  contiguous and can be corrected in one pass without looking up
+   *  the calibration map for every point.
+   */
+  typedef struct laser_tables
+  {
+    float dist_correction[MAX_LASERS];
+    float cos_vert_correction[MAX_LASERS];
+    float sin_vert_correction[MAX_LASERS];
+    float cos_rot_correction[MAX_LASERS];
+    float sin_rot_correction[MAX_LASERS];
+    float vert_offset_correction[MAX_LASERS];
+    float horiz_offset_correction[MAX_LASERS];
+    float dist_slope_x[MAX_LASERS];      ///< two point correction, 0 if unavailable
+    float dist_intercept_x[MAX_LASERS];
+    float dist_slope_y[MAX_LASERS];
+    float dist_intercept_y[MAX_LASERS];
+    float min_intensity[MAX_LASERS];
+    float max_intensity[MAX_LASERS];
+    float focal_offset[MAX_LASERS];
+    float focal_slope[MAX_LASERS];
+    uint16_t ring[MAX_LASERS];
+  } laser_tables_t;
+
+  /** \brief Points of one packet in structure-of-arrays form. */
+  typedef struct packet_points
+  {
+    int size;
+    float x[SCANS_PER_PACKET];
+    float y[SCANS_PER_PACKET];
+    float z[SCANS_PER_PACKET];
+    float intensity[SCANS_PER_PACKET];
+    uint16_t ring[SCANS_PER_PACKET];
+  } packet_points_t;
+
   /** \brief Velodyne data conversion class */
   class RawData
   {
@@ -138,6 +178,21 @@ namespace velodyne_rawdata
     int setup(ros::NodeHandle private_nh);
 
     void unpack(const velodyne_msgs::VelodynePacket &pkt, VPointCloud &pc);
+
+    /** \brief Prepare a PointCloud2 for the points of npackets packets.
+     *
+     *  Sets the fields to the serialized layout of VPoint and allocates
+     *  room for every return, so that unpack() writes the points in
+     *  place.  Call finishCloud() once all packets are unpacked.
+     */
+    static void setupCloud(sensor_msgs::PointCloud2 &cloud, size_t npackets);
+
+    /** \brief Append the points of a raw packet to a PointCloud2. */
+    void unpack(const velodyne_msgs::VelodynePacket &pkt,
+                sensor_msgs::PointCloud2 &cloud);
+
+    /** \brief Trim a cloud filled by unpack() to its points. */
+    static void finishCloud(sensor_msgs::PointCloud2 &cloud);
     
     void setParameters(double min_range, double max_range, double view_direction,
                        double view_width);
@@ -163,9 +218,28 @@ namespace velodyne_rawdata
     velodyne_pointcloud::Calibration calibration_;
     float sin_rot_table_[ROTATION_MAX_UNITS];
     float cos_rot_table_[ROTATION_MAX_UNITS];
-    
+    laser_tables_t laser_tables_;
+
+    /** convert a raw packet to the points in view and in range */
+    void unpackPoints(const velodyne_msgs::VelodynePacket &pkt,
+                      packet_points_t &points);
+    void unpack_hdl(const velodyne_msgs::VelodynePacket &pkt,
+                    packet_points_t &points);
+
     /** add private function to handle the VLP16 **/ 
-    void unpack_vlp16(const velodyne_msgs::VelodynePacket &pkt, VPointCloud &pc);
+    void unpack_vlp16(const velodyne_msgs::VelodynePacket &pkt,
+                      packet_points_t &points);
+
+    /** in-line test whether an azimuth (hundredths of degrees) is in view */
+    bool angleInView(int azimuth)
+    {
+      return ((azimuth >= config_.min_angle
+               && azimuth <= config_.max_angle
+               && config_.min_angle < config_.max_angle)
+              || (config_.min_angle > config_.max_angle
+                  && (azimuth <= config_.max_angle
+                      || azimuth >= config_.min_angle)));
+    }
 
     /** in-line test whether a point is in range */
     bool pointInRange(float range)
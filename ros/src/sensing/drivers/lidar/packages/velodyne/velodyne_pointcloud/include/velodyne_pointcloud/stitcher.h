@@ -0,0 +1,62 @@
+/* -*- mode: C++ -*-
+ *
+ *  Copyright (C) 2012 Austin Robot Technology, Jack O'Quin
+ *
+ *  License: Modified BSD Software License Agreement
+ *
+ *  $Id$
+ */
+
+/** @file
+ *
+ *  @brief Stitching of Velodyne sector clouds into full sweeps.
+ *
+ *  When the driver publishes azimuth sectors (~sector_angle), each
+ *  converted cloud holds only part of a revolution.  SweepStitcher
+ *  collects the sector clouds of a revolution for consumers that need
+ *  the whole sweep.
+ */
+
+#ifndef __VELODYNE_POINTCLOUD_STITCHER_H
+#define __VELODYNE_POINTCLOUD_STITCHER_H
+
+#include <sensor_msgs/PointCloud2.h>
+
+namespace velodyne_pointcloud
+{
+  /** \brief Stitches the clouds of consecutive sectors into sweeps. */
+  class SweepStitcher
+  {
+  public:
+
+    /** @param nsectors number of sectors in a revolution */
+    SweepStitcher(int nsectors = 1);
+
+    void setSectors(int nsectors);
+
+    /** \brief Add the cloud of a sector.
+     *
+     *  Sectors are numbered from 0 in order of azimuth.  The sweep is
+     *  returned when the first sector of the next revolution arrives,
+     *  since the driver may still split the last sector.  Consecutive
+     *  clouds of the same sector (cut at ~npackets) are merged into
+     *  the sweep.  All clouds must have the same fields.
+     *
+     *  @param cloud points of the sector
+     *  @param sector sector number in [0, nsectors)
+     *  @returns the previous sweep, stamped with its last sector,
+     *           or a null pointer
+     */
+    sensor_msgs::PointCloud2Ptr addSector(const sensor_msgs::PointCloud2 &cloud,
+                                          int sector);
+
+  private:
+
+    int nsectors_;
+    int last_sector_;
+    sensor_msgs::PointCloud2Ptr sweep_;   ///< sweep being stitched
+  };
+
+} // namespace velodyne_pointcloud
+
+#endif // __VELODYNE_POINTCLOUD_STITCHER_H
@@ -15,8 +15,6 @@
 
 #include "convert.h"
 
-#include <pcl_conversions/pcl_conversions.h>
-
 namespace velodyne_pointcloud
 {
   /** @brief Constructor. */
@@ -25,6 +23,22 @@ namespace velodyne_pointcloud
   {
     data_->setup(private_nh);
 
+    // the driver may publish azimuth sectors instead of revolutions
+    private_nh.param("sector_angle", config_.sector_angle, 0.0);
+    if (config_.sector_angle != 0.0
+        && (config_.sector_angle < 1.0 || config_.sector_angle >= 360.0))
+      {
+        ROS_ERROR_STREAM("invalid sector_angle: " << config_.sector_angle);
+        config_.sector_angle = 0.0;
+      }
+    if (config_.sector_angle > 0.0)
+      {
+        int sector_size = (int) (config_.sector_angle * 100);
+        stitcher_.setSectors((velodyne_rawdata::ROTATION_MAX_UNITS - 1)
+                             / sector_size + 1);
+        sector_output_ =
+          node.advertise<sensor_msgs::PointCloud2>("velodyne_points_sector", 10);
+      }
 
     // advertise output point cloud (before subscribing to input data)
     output_ =
@@ -55,27 +69,47 @@ namespace velodyne_pointcloud
   /** @brief Callback for raw scan messages. */
   void Convert::processScan(const velodyne_msgs::VelodyneScan::ConstPtr &scanMsg)
   {
-    if (output_.getNumSubscribers() == 0)         // no one listening?
+    if (output_.getNumSubscribers() == 0          // no one listening?
+        && sector_output_.getNumSubscribers() == 0)
       return;                                     // avoid much work
+    if (scanMsg->packets.empty())
+      return;
 
-    // allocate a point cloud with same time and frame ID as raw data
-    velodyne_rawdata::VPointCloud::Ptr
-      outMsg(new velodyne_rawdata::VPointCloud());
-    // outMsg's header is a pcl::PCLHeader, convert it before stamp assignment
-    outMsg->header.stamp = pcl_conversions::toPCL(scanMsg->header).stamp;
+    // allocate a point cloud with same time and frame ID as raw data,
+    // sized for every return of the scan so that packets unpack in place
+    sensor_msgs::PointCloud2Ptr outMsg(new sensor_msgs::PointCloud2());
+    outMsg->header.stamp = scanMsg->header.stamp;
     outMsg->header.frame_id = scanMsg->header.frame_id;
-    outMsg->height = 1;
+    velodyne_rawdata::RawData::setupCloud(*outMsg, scanMsg->packets.size());
 
     // process each packet provided by the driver
     for (size_t i = 0; i < scanMsg->packets.size(); ++i)
       {
         data_->unpack(scanMsg->packets[i], *outMsg);
       }
+    velodyne_rawdata::RawData::finishCloud(*outMsg);
 
-    // publish the accumulated cloud message
+    if (config_.sector_angle <= 0.0)
+      {
+        // publish the accumulated cloud message
+        ROS_DEBUG_STREAM("Publishing " << outMsg->height * outMsg->width
+                         << " Velodyne points, time: " << outMsg->header.stamp);
+        output_.publish(outMsg);
+        return;
+      }
+
+    // publish the sector right away, and the sweep once it is complete
+    const velodyne_rawdata::raw_packet_t *raw =
+      (const velodyne_rawdata::raw_packet_t *) &scanMsg->packets[0].data[0];
+    int sector = raw->blocks[0].rotation / (int) (config_.sector_angle * 100);
     ROS_DEBUG_STREAM("Publishing " << outMsg->height * outMsg->width
-                     << " Velodyne points, time: " << outMsg->header.stamp);
-    output_.publish(outMsg);
+                     << " Velodyne points of sector " << sector
+                     << ", time: " << outMsg->header.stamp);
+    sector_output_.publish(outMsg);
+
+    sensor_msgs::PointCloud2Ptr sweep = stitcher_.addSector(*outMsg, sector);
+    if (sweep)
+      output_.publish(sweep);
   }
 
 } // namespace velodyne_pointcloud
@@ -21,6 +21,7 @@
 
 #include <sensor_msgs/PointCloud2.h>
 #include <velodyne_pointcloud/rawdata.h>
+#include <velodyne_pointcloud/stitcher.h>
 
 #include <dynamic_reconfigure/server.h>
 #include <velodyne_pointcloud/VelodyneConfigConfig.h>
@@ -47,10 +48,13 @@ namespace velodyne_pointcloud
     boost::shared_ptr<velodyne_rawdata::RawData> data_;
     ros::Subscriber velodyne_scan_;
     ros::Publisher output_;
+    ros::Publisher sector_output_;
+    SweepStitcher stitcher_;
 
     /// configuration parameters
     typedef struct {
       int npackets;                    ///< number of packets to combine
+      double sector_angle;             ///< driver sector (degrees), 0 for revolutions
     } Config;
     Config config_;
   };
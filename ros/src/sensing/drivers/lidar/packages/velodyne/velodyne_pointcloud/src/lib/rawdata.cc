@@ -27,6 +27,7 @@
 
 #include <fstream>
 #include <math.h>
+#include <string.h>
 
 #include <ros/ros.h>
 #include <ros/package.h>
@@ -103,9 +104,133 @@ namespace velodyne_rawdata
       cos_rot_table_[rot_index] = cosf(rotation);
       sin_rot_table_[rot_index] = sinf(rotation);
     }
+
+    // Lay out the per-laser corrections by laser number for unpacking
+    memset(&laser_tables_, 0, sizeof(laser_tables_));
+    for (std::map<int, velodyne_pointcloud::LaserCorrection>::const_iterator
+           it = calibration_.laser_corrections.begin();
+         it != calibration_.laser_corrections.end(); ++it) {
+      if (it->first < 0 || it->first >= MAX_LASERS) {
+        ROS_WARN_STREAM("Ignoring calibration of laser " << it->first);
+        continue;
+      }
+      const velodyne_pointcloud::LaserCorrection &corrections = it->second;
+      laser_tables_t &t = laser_tables_;
+      int l = it->first;
+      t.dist_correction[l] = corrections.dist_correction;
+      t.cos_vert_correction[l] = corrections.cos_vert_correction;
+      t.sin_vert_correction[l] = corrections.sin_vert_correction;
+      t.cos_rot_correction[l] = corrections.cos_rot_correction;
+      t.sin_rot_correction[l] = corrections.sin_rot_correction;
+      t.vert_offset_correction[l] = corrections.vert_offset_correction;
+      t.horiz_offset_correction[l] = corrections.horiz_offset_correction;
+
+      // The 2 point calibration interpolates the distance correction
+      // linearly in |x| between 2.4 and 25.04 and in |y| between 1.93
+      // and 25.04, store it as slope and intercept of that line.
+      if (corrections.two_pt_correction_available) {
+        t.dist_slope_x[l] =
+          (corrections.dist_correction - corrections.dist_correction_x)
+          / (25.04 - 2.4);
+        t.dist_intercept_x[l] =
+          corrections.dist_correction_x - corrections.dist_correction
+          - 2.4 * t.dist_slope_x[l];
+        t.dist_slope_y[l] =
+          (corrections.dist_correction - corrections.dist_correction_y)
+          / (25.04 - 1.93);
+        t.dist_intercept_y[l] =
+          corrections.dist_correction_y - corrections.dist_correction
+          - 1.93 * t.dist_slope_y[l];
+      }
+
+      t.min_intensity[l] = corrections.min_intensity;
+      t.max_intensity[l] = corrections.max_intensity;
+      t.focal_offset[l] = 256
+                        * (1 - corrections.focal_distance / 13100)
+                        * (1 - corrections.focal_distance / 13100);
+      t.focal_slope[l] = corrections.focal_slope;
+      t.ring[l] = corrections.laser_ring;
+    }
    return 0;
   }
 
+  /** @brief correct a raw distance of one laser
+   *
+   *  @param t per-laser correction tables
+   *  @param l hardware laser number
+   *  @param raw_distance distance reading of the packet
+   *  @param cos_rot, sin_rot cosine and sine of the azimuth
+   *  @returns corrected distance, before the 2 point correction
+   */
+  static inline float correctPoint(const laser_tables_t &t, int l,
+                                   uint16_t raw_distance,
+                                   float cos_rot, float sin_rot,
+                                   float &x_coord, float &y_coord,
+                                   float &z_coord)
+  {
+    float distance = raw_distance * DISTANCE_RESOLUTION;
+    distance += t.dist_correction[l];
+
+    float cos_vert_angle = t.cos_vert_correction[l];
+    float sin_vert_angle = t.sin_vert_correction[l];
+
+    // cos(a-b) = cos(a)*cos(b) + sin(a)*sin(b)
+    // sin(a-b) = sin(a)*cos(b) - cos(a)*sin(b)
+    float cos_rot_angle =
+      cos_rot * t.cos_rot_correction[l] + sin_rot * t.sin_rot_correction[l];
+    float sin_rot_angle =
+      sin_rot * t.cos_rot_correction[l] - cos_rot * t.sin_rot_correction[l];
+
+    float horiz_offset = t.horiz_offset_correction[l];
+    float vert_offset = t.vert_offset_correction[l];
+
+    // Compute the distance in the xy plane (w/o accounting for rotation)
+    /**the new term of 'vert_offset * sin_vert_angle'
+     * was added to the expression due to the mathemathical
+     * model we used.
+     */
+    float xy_distance = distance * cos_vert_angle + vert_offset * sin_vert_angle;
+
+    // Calculate temporal X and Y, use absolute values.
+    float xx = fabsf(xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle);
+    float yy = fabsf(xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle);
+
+    // 2 point calibration, linear in xx and yy (zero if unavailable)
+    float distance_x = distance + t.dist_slope_x[l] * xx + t.dist_intercept_x[l];
+    float distance_y = distance + t.dist_slope_y[l] * yy + t.dist_intercept_y[l];
+
+    ///the expression wiht '-' is proved to be better than the one with '+'
+    xy_distance = distance_x * cos_vert_angle + vert_offset * sin_vert_angle;
+    float x = xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle;
+
+    xy_distance = distance_y * cos_vert_angle + vert_offset * sin_vert_angle;
+    float y = xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle;
+
+    // Using distance_y is not symmetric, but the velodyne manual
+    // does this.
+    /**the new term of 'vert_offset * cos_vert_angle'
+     * was added to the expression due to the mathemathical
+     * model we used.
+     */
+    float z = distance_y * sin_vert_angle + vert_offset * cos_vert_angle;
+
+    /** Use standard ROS coordinate system (right-hand rule) */
+    x_coord = y;
+    y_coord = -x;
+    z_coord = z;
+
+    return distance;
+  }
+
+  /** @brief clamp a focal corrected intensity to the range of a laser */
+  static inline float clampIntensity(const laser_tables_t &t, int l,
+                                     float intensity)
+  {
+    intensity = (intensity < t.min_intensity[l]) ? t.min_intensity[l] : intensity;
+    intensity = (intensity > t.max_intensity[l]) ? t.max_intensity[l] : intensity;
+    return (uint8_t) intensity;
+  }
+
   /** @brief convert raw packet to point cloud
    *
    *  @param pkt raw packet to unpack
@@ -115,333 +240,230 @@ namespace velodyne_rawdata
                        VPointCloud &pc)
   {
     ROS_DEBUG_STREAM("Received packet, time: " << pkt.stamp);
-    
+
+    packet_points_t points;
+    unpackPoints(pkt, points);
+
+    size_t n = pc.points.size();
+    pc.points.resize(n + points.size);
+    for (int i = 0; i < points.size; i++, n++) {
+      VPoint &point = pc.points[n];
+      point.x = points.x[i];
+      point.y = points.y[i];
+      point.z = points.z[i];
+      point.intensity = points.intensity[i];
+      point.ring = points.ring[i];
+    }
+    pc.width += points.size;
+  }
+
+  /** @brief prepare a PointCloud2 for unpacking npackets packets
+   *
+   *  The fields match the serialization of a VPointCloud, which some
+   *  consumers index directly.
+   */
+  void RawData::setupCloud(sensor_msgs::PointCloud2 &cloud, size_t npackets)
+  {
+    static const char *names[] = {"x", "y", "z", "intensity", "ring"};
+    static const uint32_t offsets[] = {offsetof(VPoint, x),
+                                       offsetof(VPoint, y),
+                                       offsetof(VPoint, z),
+                                       offsetof(VPoint, intensity),
+                                       offsetof(VPoint, ring)};
+    cloud.fields.resize(5);
+    for (size_t i = 0; i < cloud.fields.size(); ++i) {
+      cloud.fields[i].name = names[i];
+      cloud.fields[i].offset = offsets[i];
+      cloud.fields[i].datatype = sensor_msgs::PointField::FLOAT32;
+      cloud.fields[i].count = 1;
+    }
+    cloud.fields[4].datatype = sensor_msgs::PointField::UINT16;
+
+    cloud.height = 1;
+    cloud.width = 0;
+    cloud.is_bigendian = false;
+    cloud.is_dense = true;
+    cloud.point_step = sizeof(VPoint);
+    cloud.row_step = 0;
+    cloud.data.resize(npackets * SCANS_PER_PACKET * cloud.point_step);
+  }
+
+  /** @brief convert raw packet into a PointCloud2 set up by setupCloud()
+   *
+   *  @param pkt raw packet to unpack
+   *  @param cloud output cloud (points are appended in place)
+   */
+  void RawData::unpack(const velodyne_msgs::VelodynePacket &pkt,
+                       sensor_msgs::PointCloud2 &cloud)
+  {
+    ROS_DEBUG_STREAM("Received packet, time: " << pkt.stamp);
+
+    packet_points_t points;
+    unpackPoints(pkt, points);
+
+    size_t offset = cloud.row_step;
+    size_t end = offset + points.size * cloud.point_step;
+    if (end > cloud.data.size())        // more packets than set up for
+      cloud.data.resize(end);
+
+    uint8_t *dst = &cloud.data[offset];
+    for (int i = 0; i < points.size; i++, dst += cloud.point_step) {
+      float *xyz = reinterpret_cast<float *>(dst + offsetof(VPoint, x));
+      xyz[0] = points.x[i];
+      xyz[1] = points.y[i];
+      xyz[2] = points.z[i];
+      *reinterpret_cast<float *>(dst + offsetof(VPoint, intensity)) =
+        points.intensity[i];
+      *reinterpret_cast<uint16_t *>(dst + offsetof(VPoint, ring)) =
+        points.ring[i];
+    }
+    cloud.width += points.size;
+    cloud.row_step = cloud.width * cloud.point_step;
+  }
+
+  /** @brief drop the unused space reserved by setupCloud() */
+  void RawData::finishCloud(sensor_msgs::PointCloud2 &cloud)
+  {
+    cloud.data.resize(cloud.row_step);
+  }
+
+  /** @brief convert raw packet to the points in view and in range */
+  void RawData::unpackPoints(const velodyne_msgs::VelodynePacket &pkt,
+                             packet_points_t &points)
+  {
     /** special parsing for the VLP16 **/
     if (calibration_.num_lasers == 16)
-    {
-      unpack_vlp16(pkt, pc);
-      return;
-    }
-    
+      unpack_vlp16(pkt, points);
+    else
+      unpack_hdl(pkt, points);
+  }
+
+  /** @brief convert raw HDL-32E/64E packet to points
+   *
+   *  All lasers of a block share its rotation, so each block is
+   *  corrected in one branch free pass over the laser tables, and
+   *  the points out of range are dropped afterwards.
+   */
+  void RawData::unpack_hdl(const velodyne_msgs::VelodynePacket &pkt,
+                           packet_points_t &points)
+  {
     const raw_packet_t *raw = (const raw_packet_t *) &pkt.data[0];
+    const laser_tables_t &t = laser_tables_;
 
+    points.size = 0;
     for (int i = 0; i < BLOCKS_PER_PACKET; i++) {
+      const raw_block_t &block = raw->blocks[i];
+
+      /*condition added to avoid calculating points which are not
+        in the interesting defined area (min_angle < area < max_angle)*/
+      if (!angleInView(block.rotation))
+        continue;
 
       // upper bank lasers are numbered [0..31]
       // NOTE: this is a change from the old velodyne_common implementation
       int bank_origin = 0;
-      if (raw->blocks[i].header == LOWER_BANK) {
+      if (block.header == LOWER_BANK) {
         // lower bank lasers are [32..63]
         bank_origin = 32;
       }
 
-      for (int j = 0, k = 0; j < SCANS_PER_BLOCK; j++, k += RAW_SCAN_SIZE) {
-        
-        float x, y, z;
-        float intensity;
-        uint8_t laser_number;       ///< hardware laser number
+      float cos_rot = cos_rot_table_[block.rotation];
+      float sin_rot = sin_rot_table_[block.rotation];
 
-        laser_number = j + bank_origin;
-        velodyne_pointcloud::LaserCorrection &corrections = 
-          calibration_.laser_corrections[laser_number];
+      float x[SCANS_PER_BLOCK], y[SCANS_PER_BLOCK], z[SCANS_PER_BLOCK];
+      float distance[SCANS_PER_BLOCK], intensity[SCANS_PER_BLOCK];
 
-        /** Position Calculation */
+      for (int j = 0; j < SCANS_PER_BLOCK; j++) {
+        int l = bank_origin + j;
+        int k = j * RAW_SCAN_SIZE;
+        uint16_t raw_distance = block.data[k] | (block.data[k+1] << 8);
 
-        union two_bytes tmp;
-        tmp.bytes[0] = raw->blocks[i].data[k];
-        tmp.bytes[1] = raw->blocks[i].data[k+1];
-        /*condition added to avoid calculating points which are not
-          in the interesting defined area (min_angle < area < max_angle)*/
-        if ((raw->blocks[i].rotation >= config_.min_angle 
-             && raw->blocks[i].rotation <= config_.max_angle 
-             && config_.min_angle < config_.max_angle)
-             ||(config_.min_angle > config_.max_angle 
-             && (raw->blocks[i].rotation <= config_.max_angle 
-             || raw->blocks[i].rotation >= config_.min_angle))){
-          float distance = tmp.uint * DISTANCE_RESOLUTION;
-          distance += corrections.dist_correction;
-  
-          float cos_vert_angle = corrections.cos_vert_correction;
-          float sin_vert_angle = corrections.sin_vert_correction;
-          float cos_rot_correction = corrections.cos_rot_correction;
-          float sin_rot_correction = corrections.sin_rot_correction;
-  
-          // cos(a-b) = cos(a)*cos(b) + sin(a)*sin(b)
-          // sin(a-b) = sin(a)*cos(b) - cos(a)*sin(b)
-          float cos_rot_angle = 
-            cos_rot_table_[raw->blocks[i].rotation] * cos_rot_correction + 
-            sin_rot_table_[raw->blocks[i].rotation] * sin_rot_correction;
-          float sin_rot_angle = 
-            sin_rot_table_[raw->blocks[i].rotation] * cos_rot_correction - 
-            cos_rot_table_[raw->blocks[i].rotation] * sin_rot_correction;
-  
-          float horiz_offset = corrections.horiz_offset_correction;
-          float vert_offset = corrections.vert_offset_correction;
-  
-          // Compute the distance in the xy plane (w/o accounting for rotation)
-          /**the new term of 'vert_offset * sin_vert_angle'
-           * was added to the expression due to the mathemathical
-           * model we used.
-           */
-          float xy_distance = distance * cos_vert_angle + vert_offset * sin_vert_angle;
-  
-          // Calculate temporal X, use absolute value.
-          float xx = xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle;
-          // Calculate temporal Y, use absolute value
-          float yy = xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle;
-          if (xx < 0) xx=-xx;
-          if (yy < 0) yy=-yy;
-    
-          // Get 2points calibration values,Linear interpolation to get distance
-          // correction for X and Y, that means distance correction use
-          // different value at different distance
-          float distance_corr_x = 0;
-          float distance_corr_y = 0;
-          if (corrections.two_pt_correction_available) {
-            distance_corr_x = 
-              (corrections.dist_correction - corrections.dist_correction_x)
-                * (xx - 2.4) / (25.04 - 2.4) 
-              + corrections.dist_correction_x;
-            distance_corr_x -= corrections.dist_correction;
-            distance_corr_y = 
-              (corrections.dist_correction - corrections.dist_correction_y)
-                * (yy - 1.93) / (25.04 - 1.93)
-              + corrections.dist_correction_y;
-            distance_corr_y -= corrections.dist_correction;
-          }
-  
-          float distance_x = distance + distance_corr_x;
-          /**the new term of 'vert_offset * sin_vert_angle'
-           * was added to the expression due to the mathemathical
-           * model we used.
-           */
-          xy_distance = distance_x * cos_vert_angle + vert_offset * sin_vert_angle ;
-          ///the expression wiht '-' is proved to be better than the one with '+'
-          x = xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle;
-  
-          float distance_y = distance + distance_corr_y;
-          xy_distance = distance_y * cos_vert_angle + vert_offset * sin_vert_angle ;
-          /**the new term of 'vert_offset * sin_vert_angle'
-           * was added to the expression due to the mathemathical
-           * model we used.
-           */
-          y = xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle;
-  
-          // Using distance_y is not symmetric, but the velodyne manual
-          // does this.
-          /**the new term of 'vert_offset * cos_vert_angle'
-           * was added to the expression due to the mathemathical
-           * model we used.
-           */
-          z = distance_y * sin_vert_angle + vert_offset*cos_vert_angle;
-  
-          /** Use standard ROS coordinate system (right-hand rule) */
-          float x_coord = y;
-          float y_coord = -x;
-          float z_coord = z;
-  
-          /** Intensity Calculation */
-  
-          float min_intensity = corrections.min_intensity;
-          float max_intensity = corrections.max_intensity;
-  
-          intensity = raw->blocks[i].data[k+2];
-  
-          float focal_offset = 256 
-                             * (1 - corrections.focal_distance / 13100) 
-                             * (1 - corrections.focal_distance / 13100);
-          float focal_slope = corrections.focal_slope;
-          intensity += focal_slope * (abs(focal_offset - 256 * 
-            (1 - static_cast<float>(tmp.uint)/65535)*(1 - static_cast<float>(tmp.uint)/65535)));
-          intensity = (intensity < min_intensity) ? min_intensity : intensity;
-          intensity = (intensity > max_intensity) ? max_intensity : intensity;
-  
-          if (pointInRange(distance)) {
-  
-            // convert polar coordinates to Euclidean XYZ
-            VPoint point;
-            point.ring = corrections.laser_ring;
-            point.x = x_coord;
-            point.y = y_coord;
-            point.z = z_coord;
-            point.intensity = (uint8_t) intensity;
-  
-            // append this point to the cloud
-            pc.points.push_back(point);
-            ++pc.width;
-          }
+        distance[j] = correctPoint(t, l, raw_distance, cos_rot, sin_rot,
+                                   x[j], y[j], z[j]);
+
+        /** Intensity Calculation */
+        float range_term = 1 - raw_distance / 65535.0f;
+        intensity[j] = clampIntensity(t, l, block.data[k+2] + t.focal_slope[l]
+          * fabsf(t.focal_offset[l] - 256 * range_term * range_term));
+      }
+
+      for (int j = 0; j < SCANS_PER_BLOCK; j++) {
+        if (pointInRange(distance[j])) {
+          int n = points.size++;
+          points.x[n] = x[j];
+          points.y[n] = y[j];
+          points.z[n] = z[j];
+          points.intensity[n] = intensity[j];
+          points.ring[n] = t.ring[bank_origin + j];
         }
       }
     }
   }
-  
-  /** @brief convert raw VLP16 packet to point cloud
+
+  /** @brief convert raw VLP16 packet to points
    *
-   *  @param pkt raw packet to unpack
-   *  @param pc shared pointer to point cloud (points are appended)
+   *  A block holds two firings of the 16 lasers, each laser at its own
+   *  azimuth.  As for the HDL, a block is corrected in one pass and
+   *  the points out of view or out of range are dropped afterwards.
    */
   void RawData::unpack_vlp16(const velodyne_msgs::VelodynePacket &pkt,
-                             VPointCloud &pc)
+                             packet_points_t &points)
   {
-    float azimuth;
-    float azimuth_diff;
-    float last_azimuth_diff;
-    float azimuth_corrected_f;
-    int azimuth_corrected;
-    float x, y, z;
-    float intensity;
-    uint8_t dsr;
-    
+    static const int SCANS_PER_VLP16_BLOCK =
+      VLP16_FIRINGS_PER_BLOCK * VLP16_SCANS_PER_FIRING;
+
     const raw_packet_t *raw = (const raw_packet_t *) &pkt.data[0];
+    const laser_tables_t &t = laser_tables_;
+    float azimuth_diff = 0;
 
+    points.size = 0;
     for (int block = 0; block < BLOCKS_PER_PACKET; block++) {
       assert(0xEEFF == raw->blocks[block].header);
-      azimuth = (float)(raw->blocks[block].rotation);
+      const raw_block_t &blk = raw->blocks[block];
+      float azimuth = (float)(blk.rotation);
       if (block < (BLOCKS_PER_PACKET-1)){
-        azimuth_diff = (float)((36000 + raw->blocks[block+1].rotation - raw->blocks[block].rotation)%36000);
-        last_azimuth_diff = azimuth_diff;
-      }else{
-        azimuth_diff = last_azimuth_diff;
+        azimuth_diff = (float)((36000 + raw->blocks[block+1].rotation - blk.rotation)%36000);
       }
 
-      for (int firing=0, k=0; firing < VLP16_FIRINGS_PER_BLOCK; firing++){
-        for (int dsr=0; dsr < VLP16_SCANS_PER_FIRING; dsr++, k+=RAW_SCAN_SIZE){
-          velodyne_pointcloud::LaserCorrection &corrections = 
-            calibration_.laser_corrections[dsr];
-
-          /** Position Calculation */
-          union two_bytes tmp;
-          tmp.bytes[0] = raw->blocks[block].data[k];
-          tmp.bytes[1] = raw->blocks[block].data[k+1];
-          
-          /** correct for the laser rotation as a function of timing during the firings **/
-          azimuth_corrected_f = azimuth + (azimuth_diff * ((dsr*VLP16_DSR_TOFFSET) + (firing*VLP16_FIRING_TOFFSET)) / VLP16_BLOCK_TDURATION);
-          azimuth_corrected = ((int)round(azimuth_corrected_f)) % 36000;
-          
-          /*condition added to avoid calculating points which are not
-            in the interesting defined area (min_angle < area < max_angle)*/
-          if ((azimuth_corrected >= config_.min_angle 
-               && azimuth_corrected <= config_.max_angle 
-               && config_.min_angle < config_.max_angle)
-               ||(config_.min_angle > config_.max_angle 
-               && (azimuth_corrected <= config_.max_angle 
-               || azimuth_corrected >= config_.min_angle))){
-            float distance = tmp.uint * DISTANCE_RESOLUTION;
-            distance += corrections.dist_correction;
-            
-            float cos_vert_angle = corrections.cos_vert_correction;
-            float sin_vert_angle = corrections.sin_vert_correction;
-            float cos_rot_correction = corrections.cos_rot_correction;
-            float sin_rot_correction = corrections.sin_rot_correction;
-    
-            // cos(a-b) = cos(a)*cos(b) + sin(a)*sin(b)
-            // sin(a-b) = sin(a)*cos(b) - cos(a)*sin(b)
-            float cos_rot_angle = 
-              cos_rot_table_[azimuth_corrected] * cos_rot_correction + 
-              sin_rot_table_[azimuth_corrected] * sin_rot_correction;
-            float sin_rot_angle = 
-              sin_rot_table_[azimuth_corrected] * cos_rot_correction - 
-              cos_rot_table_[azimuth_corrected] * sin_rot_correction;
-    
-            float horiz_offset = corrections.horiz_offset_correction;
-            float vert_offset = corrections.vert_offset_correction;
-    
-            // Compute the distance in the xy plane (w/o accounting for rotation)
-            /**the new term of 'vert_offset * sin_vert_angle'
-             * was added to the expression due to the mathemathical
-             * model we used.
-             */
-            float xy_distance = distance * cos_vert_angle + vert_offset * sin_vert_angle;
-    
-            // Calculate temporal X, use absolute value.
-            float xx = xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle;
-            // Calculate temporal Y, use absolute value
-            float yy = xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle;
-            if (xx < 0) xx=-xx;
-            if (yy < 0) yy=-yy;
-      
-            // Get 2points calibration values,Linear interpolation to get distance
-            // correction for X and Y, that means distance correction use
-            // different value at different distance
-            float distance_corr_x = 0;
-            float distance_corr_y = 0;
-            if (corrections.two_pt_correction_available) {
-              distance_corr_x = 
-                (corrections.dist_correction - corrections.dist_correction_x)
-                  * (xx - 2.4) / (25.04 - 2.4) 
-                + corrections.dist_correction_x;
-              distance_corr_x -= corrections.dist_correction;
-              distance_corr_y = 
-                (corrections.dist_correction - corrections.dist_correction_y)
-                  * (yy - 1.93) / (25.04 - 1.93)
-                + corrections.dist_correction_y;
-              distance_corr_y -= corrections.dist_correction;
-            }
-    
-            float distance_x = distance + distance_corr_x;
-            /**the new term of 'vert_offset * sin_vert_angle'
-             * was added to the expression due to the mathemathical
-             * model we used.
-             */
-            xy_distance = distance_x * cos_vert_angle + vert_offset * sin_vert_angle ;
-            x = xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle;
-    
-            float distance_y = distance + distance_corr_y;
-            /**the new term of 'vert_offset * sin_vert_angle'
-             * was added to the expression due to the mathemathical
-             * model we used.
-             */
-            xy_distance = distance_y * cos_vert_angle + vert_offset * sin_vert_angle ;
-            y = xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle;
-    
-            // Using distance_y is not symmetric, but the velodyne manual
-            // does this.
-            /**the new term of 'vert_offset * cos_vert_angle'
-             * was added to the expression due to the mathemathical
-             * model we used.
-             */
-            z = distance_y * sin_vert_angle + vert_offset*cos_vert_angle;
-  
-    
-            /** Use standard ROS coordinate system (right-hand rule) */
-            float x_coord = y;
-            float y_coord = -x;
-            float z_coord = z;
-    
-            /** Intensity Calculation */
-    
-            float min_intensity = corrections.min_intensity;
-            float max_intensity = corrections.max_intensity;
-    
-            intensity = raw->blocks[block].data[k+2];
-    
-            float focal_offset = 256 
-                               * (1 - corrections.focal_distance / 13100) 
-                               * (1 - corrections.focal_distance / 13100);
-            float focal_slope = corrections.focal_slope;
-            intensity += focal_slope * (abs(focal_offset - 256 * 
-              (1 - tmp.uint/65535)*(1 - tmp.uint/65535)));
-            intensity = (intensity < min_intensity) ? min_intensity : intensity;
-            intensity = (intensity > max_intensity) ? max_intensity : intensity;
-    
-            if (pointInRange(distance)) {
-    
-              // convert polar coordinates to Euclidean XYZ
-              VPoint point;
-              point.ring = corrections.laser_ring;
-              point.x = x_coord;
-              point.y = y_coord;
-              point.z = z_coord;
-              point.intensity = (uint8_t) intensity;
-    
-              // append this point to the cloud
-              pc.points.push_back(point);
-              ++pc.width;
-            }
-          }
+      float x[SCANS_PER_VLP16_BLOCK], y[SCANS_PER_VLP16_BLOCK];
+      float z[SCANS_PER_VLP16_BLOCK], distance[SCANS_PER_VLP16_BLOCK];
+      float intensity[SCANS_PER_VLP16_BLOCK];
+      int azimuth_corrected[SCANS_PER_VLP16_BLOCK];
+
+      for (int j = 0; j < SCANS_PER_VLP16_BLOCK; j++) {
+        int firing = j / VLP16_SCANS_PER_FIRING;
+        int dsr = j % VLP16_SCANS_PER_FIRING;
+        int k = j * RAW_SCAN_SIZE;
+        uint16_t raw_distance = blk.data[k] | (blk.data[k+1] << 8);
+
+        /** correct for the laser rotation as a function of timing during the firings **/
+        float azimuth_corrected_f = azimuth + (azimuth_diff * ((dsr*VLP16_DSR_TOFFSET) + (firing*VLP16_FIRING_TOFFSET)) / VLP16_BLOCK_TDURATION);
+        azimuth_corrected[j] = ((int)round(azimuth_corrected_f)) % 36000;
+
+        distance[j] = correctPoint(t, dsr, raw_distance,
+                                   cos_rot_table_[azimuth_corrected[j]],
+                                   sin_rot_table_[azimuth_corrected[j]],
+                                   x[j], y[j], z[j]);
+
+        /** Intensity Calculation */
+        intensity[j] = clampIntensity(t, dsr, blk.data[k+2] + t.focal_slope[dsr]
+          * fabsf(t.focal_offset[dsr] - 256 *
+                  (1 - raw_distance/65535)*(1 - raw_distance/65535)));
+      }
+
+      for (int j = 0; j < SCANS_PER_VLP16_BLOCK; j++) {
+        /*condition added to avoid calculating points which are not
+          in the interesting defined area (min_angle < area < max_angle)*/
+        if (angleInView(azimuth_corrected[j]) && pointInRange(distance[j])) {
+          int n = points.size++;
+          points.x[n] = x[j];
+          points.y[n] = y[j];
+          points.z[n] = z[j];
+          points.intensity[n] = intensity[j];
+          points.ring[n] = t.ring[j % VLP16_SCANS_PER_FIRING];
         }
       }
     }
-  }  
+  }
 
 } // namespace velodyne_rawdata
@@ -0,0 +1,68 @@
+/*
+ *  Copyright (C) 2012 Austin Robot Technology, Jack O'Quin
+ *
+ *  License: Modified BSD Software License Agreement
+ *
+ *  $Id$
+ */
+
+/** @file
+ *
+ *  Stitching of Velodyne sector clouds into full sweeps.
+ */
+
+#include <velodyne_pointcloud/stitcher.h>
+
+namespace velodyne_pointcloud
+{
+  SweepStitcher::SweepStitcher(int nsectors):
+    nsectors_(nsectors),
+    last_sector_(-1)
+  {}
+
+  void SweepStitcher::setSectors(int nsectors)
+  {
+    nsectors_ = nsectors;
+    last_sector_ = -1;
+    sweep_.reset();
+  }
+
+  sensor_msgs::PointCloud2Ptr
+    SweepStitcher::addSector(const sensor_msgs::PointCloud2 &cloud, int sector)
+  {
+    sensor_msgs::PointCloud2Ptr done;
+
+    // a new revolution started; a sector repeats when the driver cut
+    // it at npackets, its clouds stay in the same sweep
+    if (sweep_ && sector < last_sector_)
+      {
+        done = sweep_;
+        sweep_.reset();
+      }
+
+    if (!sweep_)
+      {
+        sweep_.reset(new sensor_msgs::PointCloud2());
+        sweep_->header = cloud.header;
+        sweep_->fields = cloud.fields;
+        sweep_->is_bigendian = cloud.is_bigendian;
+        sweep_->point_step = cloud.point_step;
+        sweep_->is_dense = cloud.is_dense;
+        sweep_->height = 1;
+        sweep_->width = 0;
+        sweep_->row_step = 0;
+        sweep_->data.reserve(cloud.data.size() * (nsectors_ - sector));
+      }
+
+    size_t npoints = (size_t) cloud.width * cloud.height;
+    sweep_->data.insert(sweep_->data.end(), cloud.data.begin(),
+                        cloud.data.begin() + npoints * cloud.point_step);
+    sweep_->width += npoints;
+    sweep_->row_step = sweep_->width * sweep_->point_step;
+    sweep_->is_dense = sweep_->is_dense && cloud.is_dense;
+    sweep_->header.stamp = cloud.header.stamp;
+    last_sector_ = sector;
+    return done;
+  }
+
+} // namespace velodyne_pointcloud
@@ -0,0 +1,114 @@
+/*
+ *  License: Modified BSD Software License Agreement
+ */
+
+/** @file
+
+    Unit tests of SweepStitcher.
+
+*/
+
+#include <gtest/gtest.h>
+#include <velodyne_pointcloud/stitcher.h>
+
+using namespace velodyne_pointcloud;
+
+/** cloud of one sector, each point is one byte holding its value */
+static sensor_msgs::PointCloud2 makeCloud(const std::vector<uint8_t> &points,
+                                          double stamp)
+{
+  sensor_msgs::PointCloud2 cloud;
+  cloud.header.stamp = ros::Time(stamp);
+  cloud.height = 1;
+  cloud.width = points.size();
+  cloud.point_step = 1;
+  cloud.row_step = cloud.width;
+  cloud.data = points;
+  cloud.is_dense = true;
+  return cloud;
+}
+
+static sensor_msgs::PointCloud2 makeCloud(uint8_t point, double stamp)
+{
+  return makeCloud(std::vector<uint8_t>(1, point), stamp);
+}
+
+TEST(SweepStitcher, wholeRevolution)
+{
+  SweepStitcher stitcher(4);
+  for (int sector = 0; sector < 4; ++sector)
+    EXPECT_FALSE(stitcher.addSector(makeCloud(sector, sector), sector));
+
+  // returned when the next revolution starts
+  sensor_msgs::PointCloud2Ptr sweep = stitcher.addSector(makeCloud(10, 4.0), 0);
+  ASSERT_TRUE(sweep);
+  EXPECT_EQ(4u, sweep->width);
+  EXPECT_EQ(4u, sweep->row_step);
+  EXPECT_EQ(3.0, sweep->header.stamp.toSec());
+  for (int i = 0; i < 4; ++i)
+    EXPECT_EQ(i, sweep->data[i]);
+}
+
+TEST(SweepStitcher, repeatedSector)
+{
+  // the driver cut sectors 1 and 3 at npackets, the second cloud of
+  // each one stays in the sweep
+  SweepStitcher stitcher(4);
+  int sectors[] = {0, 1, 1, 2, 3, 3};
+  for (int i = 0; i < 6; ++i)
+    EXPECT_FALSE(stitcher.addSector(makeCloud(i, i), sectors[i]));
+
+  sensor_msgs::PointCloud2Ptr sweep = stitcher.addSector(makeCloud(10, 6.0), 0);
+  ASSERT_TRUE(sweep);
+  EXPECT_EQ(6u, sweep->width);
+  EXPECT_EQ(5.0, sweep->header.stamp.toSec());
+  for (int i = 0; i < 6; ++i)
+    EXPECT_EQ(i, sweep->data[i]);
+
+  // the next sweep starts with the cloud that returned the previous one
+  EXPECT_FALSE(stitcher.addSector(makeCloud(11, 7.0), 1));
+  sweep = stitcher.addSector(makeCloud(12, 8.0), 0);
+  ASSERT_TRUE(sweep);
+  ASSERT_EQ(2u, sweep->width);
+  EXPECT_EQ(10, sweep->data[0]);
+  EXPECT_EQ(11, sweep->data[1]);
+}
+
+TEST(SweepStitcher, lostSector)
+{
+  // sector 3 was lost, the sweep is returned by sector 0 of the next
+  // revolution
+  SweepStitcher stitcher(4);
+  std::vector<uint8_t> points(3, 7);
+  EXPECT_FALSE(stitcher.addSector(makeCloud(points, 0.0), 0));
+  EXPECT_FALSE(stitcher.addSector(makeCloud(points, 1.0), 1));
+  EXPECT_FALSE(stitcher.addSector(makeCloud(points, 2.0), 2));
+
+  sensor_msgs::PointCloud2Ptr sweep = stitcher.addSector(makeCloud(points, 3.0), 0);
+  ASSERT_TRUE(sweep);
+  EXPECT_EQ(9u, sweep->width);
+  EXPECT_EQ(9u, sweep->data.size());
+  EXPECT_EQ(2.0, sweep->header.stamp.toSec());
+}
+
+TEST(SweepStitcher, setSectors)
+{
+  // changing the sectors drops the sweep being stitched
+  SweepStitcher stitcher(4);
+  EXPECT_FALSE(stitcher.addSector(makeCloud(0, 0.0), 2));
+  stitcher.setSectors(2);
+  EXPECT_FALSE(stitcher.addSector(makeCloud(1, 1.0), 0));
+  EXPECT_FALSE(stitcher.addSector(makeCloud(2, 2.0), 1));
+
+  sensor_msgs::PointCloud2Ptr sweep = stitcher.addSector(makeCloud(3, 3.0), 0);
+  ASSERT_TRUE(sweep);
+  ASSERT_EQ(2u, sweep->width);
+  EXPECT_EQ(1, sweep->data[0]);
+  EXPECT_EQ(2, sweep->data[1]);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
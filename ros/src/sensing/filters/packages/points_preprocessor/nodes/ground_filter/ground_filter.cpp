@@ -6,12 +6,11 @@
  */
 #include <ros/ros.h>
 #include <pcl_conversions/pcl_conversions.h>
-#include <pcl/filters/extract_indices.h>
-#include <pcl/segmentation/sac_segmentation.h>
 #include <sensor_msgs/point_cloud_conversion.h>
 #include <sensor_msgs/PointCloud.h>
 #include <sensor_msgs/PointCloud2.h>
 
+#include "ground_segmentation.h"
 
 class GroundFilter
 {
@@ -32,6 +31,10 @@ private:
 	double 			points_distance_;
 	double 			angle_threshold_;
 
+	bool			use_ring_;
+	bool			ring_warned_;
+	RingGroundSegmentation	ring_segmentation_;
+
 
 	void VelodyneCallback(const sensor_msgs::PointCloud2::Ptr& in_sensor_cloud_ptr);
 	void RemoveFloor(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr,
@@ -52,6 +55,32 @@ GroundFilter::GroundFilter() :
 	node_handle_.param("points_distance",  points_distance_,  0.2);
 	node_handle_.param("angle_threshold",  angle_threshold_,  0.35);
 
+	// "ransac" fits one plane, "ring" segments the range image using the ring field
+	std::string ground_method;
+	node_handle_.param<std::string>("ground_method",  ground_method,  "ransac");
+	use_ring_ = (ground_method == "ring");
+	ring_warned_ = false;
+	if (use_ring_)
+	{
+		int columns, num_threads;
+		double sensor_height, max_local_slope, max_global_slope;
+		node_handle_.param("columns",  columns,  1800);
+		node_handle_.param("sensor_height",  sensor_height,  1.8);
+		node_handle_.param("max_local_slope",  max_local_slope,  8.0);
+		node_handle_.param("max_global_slope",  max_global_slope,  5.0);
+		node_handle_.param("num_threads",  num_threads,  0);
+		ring_segmentation_.SetColumns(columns);
+		ring_segmentation_.SetSensorHeight(sensor_height);
+		ring_segmentation_.SetMaxLocalSlope(max_local_slope);
+		ring_segmentation_.SetMaxGlobalSlope(max_global_slope);
+		ring_segmentation_.SetHeightTolerance(points_distance_);
+		ring_segmentation_.SetNumberOfThreads(num_threads);
+	}
+	else if (ground_method != "ransac")
+	{
+		ROS_WARN("ground_filter: unknown ground_method %s, using ransac", ground_method.c_str());
+	}
+
 	cloud_sub_ = node_handle_.subscribe(subscribe_topic_, 10, &GroundFilter::VelodyneCallback, this);
 	cloud_lanes_pub_ = node_handle_.advertise<sensor_msgs::PointCloud2>( "/points_lanes", 10);
 	cloud_ground_pub_ = node_handle_.advertise<sensor_msgs::PointCloud2>( "/points_ground", 10);
@@ -63,36 +92,8 @@ void GroundFilter::RemoveFloor(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_clou
 		float in_max_distance,
 		float in_floor_max_angle)
 {
-	pcl::SACSegmentation<pcl::PointXYZ> seg;
-	pcl::PointIndices::Ptr inliers (new pcl::PointIndices);
-	pcl::ModelCoefficients::Ptr coefficients (new pcl::ModelCoefficients);
-
-	seg.setOptimizeCoefficients (true);
-	seg.setModelType(pcl::SACMODEL_PERPENDICULAR_PLANE);
-	seg.setMethodType(pcl::SAC_RANSAC);
-	seg.setMaxIterations(100);
-	seg.setAxis(Eigen::Vector3f(0,0,1));
-	seg.setEpsAngle(in_floor_max_angle);
-
-	seg.setDistanceThreshold (in_max_distance);//floor distance
-	seg.setOptimizeCoefficients(true);
-	seg.setInputCloud(in_cloud_ptr);
-	seg.segment(*inliers, *coefficients);
-	if (inliers->indices.size () == 0)
-	{
-		std::cout << "Could not estimate a planar model for the given dataset." << std::endl;
-	}
-
-	/*REMOVE THE FLOOR FROM THE CLOUD*/
-	pcl::ExtractIndices<pcl::PointXYZ> extract;
-	extract.setInputCloud (in_cloud_ptr);
-	extract.setIndices(inliers);
-	extract.setNegative(true);//true removes the indices, false leaves only the indices
-	extract.filter(*out_nofloor_cloud_ptr);
-
-	/*EXTRACT THE FLOOR FROM THE CLOUD*/
-	extract.setNegative(false);//true removes the indices, false leaves only the indices
-	extract.filter(*out_onlyfloor_cloud_ptr);
+	SegmentGroundRansac(in_cloud_ptr, out_nofloor_cloud_ptr, out_onlyfloor_cloud_ptr,
+			in_max_distance, in_floor_max_angle);
 }
 
 void GroundFilter::VelodyneCallback(const sensor_msgs::PointCloud2::Ptr& in_sensor_cloud_ptr)
@@ -102,10 +103,32 @@ void GroundFilter::VelodyneCallback(const sensor_msgs::PointCloud2::Ptr& in_sens
 	pcl::PointCloud<pcl::PointXYZ>::Ptr lanes_cloud_ptr (new pcl::PointCloud<pcl::PointXYZ>);
 	pcl::PointCloud<pcl::PointXYZ>::Ptr output_cloud_ptr (new pcl::PointCloud<pcl::PointXYZ>);
 
-	pcl::fromROSMsg(*in_sensor_cloud_ptr, *current_sensor_cloud_ptr);
+	bool has_ring = false;
+	for (size_t i = 0; i < in_sensor_cloud_ptr->fields.size(); i++)
+	{
+		if (in_sensor_cloud_ptr->fields[i].name == "ring")
+			has_ring = true;
+	}
+	if (use_ring_ && !has_ring && !ring_warned_)
+	{
+		ROS_WARN("ground_filter: %s has no ring field, using ransac", subscribe_topic_.c_str());
+		ring_warned_ = true;
+	}
 
+	if (use_ring_ && has_ring)
+	{
+		pcl::PointCloud<velodyne_pointcloud::PointXYZIR> ring_cloud;
+		pcl::fromROSMsg(*in_sensor_cloud_ptr, ring_cloud);
+		ring_segmentation_.Segment(ring_cloud, lanes_cloud_ptr, ground_cloud_ptr);
+		if (!floor_removal_)
+			pcl::fromROSMsg(*in_sensor_cloud_ptr, *current_sensor_cloud_ptr);
+	}
+	else
+	{
+		pcl::fromROSMsg(*in_sensor_cloud_ptr, *current_sensor_cloud_ptr);
 
-	RemoveFloor(current_sensor_cloud_ptr, lanes_cloud_ptr, ground_cloud_ptr, points_distance_, angle_threshold_);
+		RemoveFloor(current_sensor_cloud_ptr, lanes_cloud_ptr, ground_cloud_ptr, points_distance_, angle_threshold_);
+	}
 
 	if (!floor_removal_)
 		output_cloud_ptr = current_sensor_cloud_ptr;
@@ -0,0 +1,222 @@
+/*
+ * ground_segmentation.cpp
+ *
+ *  Ground segmentation methods of ground_filter, shared with
+ *  test/test_ground_segmentation.cpp.
+ */
+#include "ground_segmentation.h"
+
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <pcl/filters/extract_indices.h>
+#include <pcl/segmentation/sac_segmentation.h>
+
+// Rings beyond this are treated as invalid, Velodyne sensors have at most 64
+static const int MAX_RINGS = 128;
+
+void SegmentGroundRansac(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr,
+		pcl::PointIndices::Ptr out_floor_indices,
+		float in_max_distance,
+		float in_floor_max_angle)
+{
+	pcl::SACSegmentation<pcl::PointXYZ> seg;
+	pcl::ModelCoefficients::Ptr coefficients (new pcl::ModelCoefficients);
+
+	seg.setOptimizeCoefficients (true);
+	seg.setModelType(pcl::SACMODEL_PERPENDICULAR_PLANE);
+	seg.setMethodType(pcl::SAC_RANSAC);
+	seg.setMaxIterations(100);
+	seg.setAxis(Eigen::Vector3f(0,0,1));
+	seg.setEpsAngle(in_floor_max_angle);
+
+	seg.setDistanceThreshold (in_max_distance);//floor distance
+	seg.setOptimizeCoefficients(true);
+	seg.setInputCloud(in_cloud_ptr);
+	seg.segment(*out_floor_indices, *coefficients);
+	if (out_floor_indices->indices.size () == 0)
+	{
+		std::cout << "Could not estimate a planar model for the given dataset." << std::endl;
+	}
+}
+
+void SegmentGroundRansac(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr,
+		pcl::PointCloud<pcl::PointXYZ>::Ptr out_nofloor_cloud_ptr,
+		pcl::PointCloud<pcl::PointXYZ>::Ptr out_onlyfloor_cloud_ptr,
+		float in_max_distance,
+		float in_floor_max_angle)
+{
+	pcl::PointIndices::Ptr inliers (new pcl::PointIndices);
+	SegmentGroundRansac(in_cloud_ptr, inliers, in_max_distance, in_floor_max_angle);
+
+	/*REMOVE THE FLOOR FROM THE CLOUD*/
+	pcl::ExtractIndices<pcl::PointXYZ> extract;
+	extract.setInputCloud (in_cloud_ptr);
+	extract.setIndices(inliers);
+	extract.setNegative(true);//true removes the indices, false leaves only the indices
+	extract.filter(*out_nofloor_cloud_ptr);
+
+	/*EXTRACT THE FLOOR FROM THE CLOUD*/
+	extract.setNegative(false);//true removes the indices, false leaves only the indices
+	extract.filter(*out_onlyfloor_cloud_ptr);
+}
+
+RingGroundSegmentation::RingGroundSegmentation() :
+		columns_(1800),
+		sensor_height_(1.8),
+		max_local_slope_(8.0),
+		max_global_slope_(5.0),
+		height_tolerance_(0.2),
+		num_threads_(1),
+		rings_(0)
+{
+	SetNumberOfThreads(0);
+}
+
+void RingGroundSegmentation::SetNumberOfThreads(int in_threads)
+{
+#ifdef _OPENMP
+	if (in_threads <= 0)
+		in_threads = omp_get_max_threads();
+	num_threads_ = (in_threads > 0) ? in_threads : 1;
+#else
+	num_threads_ = 1;
+#endif
+}
+
+void RingGroundSegmentation::Segment(const pcl::PointCloud<velodyne_pointcloud::PointXYZIR>& in_cloud,
+		std::vector<char>& out_ground)
+{
+	const size_t num_points = in_cloud.points.size();
+	const int columns = (columns_ > 0) ? columns_ : 1;
+
+	out_ground.assign(num_points, 0);
+	range_.resize(num_points);
+	cell_.resize(num_points);
+
+	rings_ = 0;
+	for (size_t i = 0; i < num_points; i++)
+	{
+		if (in_cloud.points[i].ring >= rings_ && in_cloud.points[i].ring < MAX_RINGS)
+			rings_ = in_cloud.points[i].ring + 1;
+	}
+
+	/*BIN THE POINTS INTO THE RANGE IMAGE (COUNTING SORT BY CELL)*/
+	const int num_cells = columns * rings_;
+	cell_start_.assign(num_cells + 1, 0);
+	for (size_t i = 0; i < num_points; i++)
+	{
+		const velodyne_pointcloud::PointXYZIR& point = in_cloud.points[i];
+		if (!pcl_isfinite(point.x) || !pcl_isfinite(point.y) || !pcl_isfinite(point.z)
+				|| point.ring >= rings_)
+		{
+			cell_[i] = -1;
+			continue;
+		}
+		range_[i] = std::sqrt(point.x * point.x + point.y * point.y);
+		int column = (int) ((std::atan2(point.y, point.x) + M_PI) * columns / (2 * M_PI));
+		if (column >= columns)
+			column = columns - 1;
+		cell_[i] = column * rings_ + point.ring;
+		cell_start_[cell_[i] + 1]++;
+	}
+	for (int c = 0; c < num_cells; c++)
+		cell_start_[c + 1] += cell_start_[c];
+
+	order_.resize(cell_start_[num_cells]);
+	std::vector<int> next(cell_start_.begin(), cell_start_.end() - 1);
+	for (size_t i = 0; i < num_points; i++)
+	{
+		if (cell_[i] >= 0)
+			order_[next[cell_[i]]++] = i;
+	}
+
+	/*CLASSIFY THE COLUMNS, ONE RANGE OF COLUMNS PER THREAD*/
+	const int num_threads = std::min(num_threads_, columns);
+#pragma omp parallel for num_threads(num_threads) schedule(static) if(num_threads > 1)
+	for (int t = 0; t < num_threads; t++)
+		SegmentColumns(in_cloud, columns * t / num_threads, columns * (t + 1) / num_threads, out_ground);
+}
+
+void RingGroundSegmentation::SegmentColumns(const pcl::PointCloud<velodyne_pointcloud::PointXYZIR>& in_cloud,
+		int in_first_column, int in_last_column,
+		std::vector<char>& out_ground)
+{
+	const float tan_local = std::tan(max_local_slope_ * M_PI / 180.0);
+	const float tan_global = std::tan(max_global_slope_ * M_PI / 180.0);
+	const float tolerance = height_tolerance_;
+	const float ground_z = -sensor_height_;
+
+	for (int column = in_first_column; column < in_last_column; column++)
+	{
+		// last ground seen in this column, starting right below the sensor
+		float last_range = 0;
+		float last_z = ground_z;
+
+		for (int ring = 0; ring < rings_; ring++)
+		{
+			const int cell = column * rings_ + ring;
+			float sum_range = 0;
+			float sum_z = 0;
+			int num_ground = 0;
+
+			for (int k = cell_start_[cell]; k < cell_start_[cell + 1]; k++)
+			{
+				const int i = order_[k];
+				const float range = range_[i];
+				const float z = in_cloud.points[i].z;
+
+				float run = range - last_range;
+				if (run < 0)
+					run = 0;
+				bool local = std::fabs(z - last_z) <= tolerance + tan_local * run;
+				bool global = std::fabs(z - ground_z) <= tolerance + tan_global * range;
+				if (local && global)
+				{
+					out_ground[i] = 1;
+					sum_range += range;
+					sum_z += z;
+					num_ground++;
+				}
+			}
+
+			if (num_ground > 0)
+			{
+				last_range = sum_range / num_ground;
+				last_z = sum_z / num_ground;
+			}
+		}
+	}
+}
+
+void RingGroundSegmentation::Segment(const pcl::PointCloud<velodyne_pointcloud::PointXYZIR>& in_cloud,
+		pcl::PointCloud<pcl::PointXYZ>::Ptr out_nofloor_cloud_ptr,
+		pcl::PointCloud<pcl::PointXYZ>::Ptr out_onlyfloor_cloud_ptr)
+{
+	std::vector<char> ground;
+	Segment(in_cloud, ground);
+
+	out_nofloor_cloud_ptr->points.clear();
+	out_onlyfloor_cloud_ptr->points.clear();
+	out_nofloor_cloud_ptr->points.reserve(in_cloud.points.size());
+	out_onlyfloor_cloud_ptr->points.reserve(in_cloud.points.size());
+	for (size_t i = 0; i < in_cloud.points.size(); i++)
+	{
+		pcl::PointXYZ point;
+		point.x = in_cloud.points[i].x;
+		point.y = in_cloud.points[i].y;
+		point.z = in_cloud.points[i].z;
+		if (ground[i])
+			out_onlyfloor_cloud_ptr->points.push_back(point);
+		else
+			out_nofloor_cloud_ptr->points.push_back(point);
+	}
+	out_nofloor_cloud_ptr->width = out_nofloor_cloud_ptr->points.size();
+	out_nofloor_cloud_ptr->height = 1;
+	out_onlyfloor_cloud_ptr->width = out_onlyfloor_cloud_ptr->points.size();
+	out_onlyfloor_cloud_ptr->height = 1;
+}
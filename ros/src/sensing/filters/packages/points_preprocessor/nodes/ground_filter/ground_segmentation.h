@@ -0,0 +1,93 @@
+/*
+ * ground_segmentation.h
+ *
+ *  Ground segmentation methods of ground_filter, shared with
+ *  test/test_ground_segmentation.cpp.
+ */
+#ifndef GROUND_SEGMENTATION_H_
+#define GROUND_SEGMENTATION_H_
+
+#include <vector>
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <pcl/PointIndices.h>
+
+#include <velodyne_pointcloud/point_types.h>
+
+/*
+ * Fits a single plane perpendicular to z with RANSAC and returns its inliers
+ * (floor).
+ */
+void SegmentGroundRansac(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr,
+			pcl::PointIndices::Ptr out_floor_indices,
+			float in_max_distance,
+			float in_floor_max_angle);
+
+/*
+ * As above, splitting the cloud into the inliers and the remaining points.
+ */
+void SegmentGroundRansac(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr,
+			pcl::PointCloud<pcl::PointXYZ>::Ptr out_nofloor_cloud_ptr,
+			pcl::PointCloud<pcl::PointXYZ>::Ptr out_onlyfloor_cloud_ptr,
+			float in_max_distance,
+			float in_floor_max_angle);
+
+/*
+ * Ground segmentation on the range image of a Velodyne scan.
+ *
+ * Points are binned by azimuth column and laser ring. Each column is then
+ * walked once from the lowest ring outwards, comparing every point with the
+ * last ground seen in the column: a point is ground if the slope to it stays
+ * under max_local_slope and its height stays within max_global_slope of the
+ * plane below the sensor, both with height_tolerance of slack. Following
+ * the last ground point lets the classification follow sloped roads.
+ * Columns are independent and split between num_threads OpenMP threads.
+ */
+class RingGroundSegmentation
+{
+public:
+	RingGroundSegmentation();
+
+	void SetColumns(int in_columns)					{ columns_ = in_columns; }
+	void SetSensorHeight(double in_height)			{ sensor_height_ = in_height; }
+	void SetMaxLocalSlope(double in_degrees)		{ max_local_slope_ = in_degrees; }
+	void SetMaxGlobalSlope(double in_degrees)		{ max_global_slope_ = in_degrees; }
+	void SetHeightTolerance(double in_tolerance)	{ height_tolerance_ = in_tolerance; }
+	void SetNumberOfThreads(int in_threads);
+
+	/*
+	 * Labels every point of in_cloud, 1 for ground and 0 otherwise. Points with an
+	 * invalid coordinate or ring are labelled as not ground.
+	 */
+	void Segment(const pcl::PointCloud<velodyne_pointcloud::PointXYZIR>& in_cloud,
+				std::vector<char>& out_ground);
+
+	/*
+	 * Splits in_cloud into ground and non ground points, in input order.
+	 */
+	void Segment(const pcl::PointCloud<velodyne_pointcloud::PointXYZIR>& in_cloud,
+				pcl::PointCloud<pcl::PointXYZ>::Ptr out_nofloor_cloud_ptr,
+				pcl::PointCloud<pcl::PointXYZ>::Ptr out_onlyfloor_cloud_ptr);
+
+private:
+	int		columns_;
+	double	sensor_height_;
+	double	max_local_slope_;
+	double	max_global_slope_;
+	double	height_tolerance_;
+	int		num_threads_;
+
+	// Range image of the last scan, cells are (column, ring)
+	int					rings_;
+	std::vector<float>	range_;			// horizontal distance of each point
+	std::vector<int>	cell_;			// cell of each point, -1 if invalid
+	std::vector<int>	cell_start_;	// first entry of each cell in order_
+	std::vector<int>	order_;			// point indices sorted by cell
+
+	void SegmentColumns(const pcl::PointCloud<velodyne_pointcloud::PointXYZIR>& in_cloud,
+				int in_first_column, int in_last_column,
+				std::vector<char>& out_ground);
+};
+
+#endif /* GROUND_SEGMENTATION_H_ */
@@ -0,0 +1,148 @@
+/*
+ * test_ground_segmentation.cpp
+ *
+ *  Checks the ring ground segmentation of ground_filter on a synthetic
+ *  64 ring scan with known ground: flat road, a road going uphill and a box.
+ */
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+
+#include "../nodes/ground_filter/ground_segmentation.h"
+
+class RingGroundSegmentationTest : public ::testing::Test
+{
+protected:
+	pcl::PointCloud<velodyne_pointcloud::PointXYZIR> scan_;
+	std::vector<char> truth_;	// 1 for ground
+
+	virtual void SetUp()
+	{
+		const double sensor_height = 1.8;
+		for (int ring = 0; ring < 64; ring++)
+		{
+			// HDL-64 like elevations, only the rings looking down hit the ground
+			double elevation = (-24.8 + ring * 26.8 / 63) * M_PI / 180;
+			if (elevation >= -0.01)
+				continue;
+			for (int a = 0; a < 2000; a++)
+			{
+				double azimuth = a * 2 * M_PI / 2000;
+				double range = sensor_height / -std::tan(elevation);
+				velodyne_pointcloud::PointXYZIR point;
+				point.x = range * std::cos(azimuth);
+				point.y = range * std::sin(azimuth);
+				point.z = -sensor_height;
+				point.intensity = 0;
+				point.ring = ring;
+				char ground = 1;
+				if (point.x > 10)
+					point.z += (point.x - 10) * std::tan(4 * M_PI / 180);	// 4 degrees uphill
+				if (point.y > 5 && point.y < 7 && point.x > -2 && point.x < 2)
+				{
+					point.z += 0.8;		// top of a box
+					ground = 0;
+				}
+				scan_.points.push_back(point);
+				truth_.push_back(ground);
+			}
+		}
+		scan_.width = scan_.points.size();
+		scan_.height = 1;
+	}
+};
+
+TEST_F(RingGroundSegmentationTest, Labels)
+{
+	RingGroundSegmentation segmentation;
+	segmentation.SetNumberOfThreads(1);
+	std::vector<char> ground;
+	segmentation.Segment(scan_, ground);
+	ASSERT_EQ(scan_.points.size(), ground.size());
+
+	size_t num_ground = 0, found_ground = 0, wrong_ground = 0;
+	for (size_t i = 0; i < ground.size(); i++)
+	{
+		if (truth_[i])
+		{
+			num_ground++;
+			if (ground[i])
+				found_ground++;
+		}
+		else if (ground[i])
+			wrong_ground++;
+	}
+	// the slope is followed, the box is never ground
+	EXPECT_GT(found_ground, 0.99 * num_ground);
+	EXPECT_EQ(0u, wrong_ground);
+}
+
+TEST_F(RingGroundSegmentationTest, SameLabelsForAnyThreadCount)
+{
+	RingGroundSegmentation single_thread;
+	single_thread.SetNumberOfThreads(1);
+	std::vector<char> reference;
+	single_thread.Segment(scan_, reference);
+
+	int thread_counts[] = {2, 3, 8, 0};
+	for (size_t t = 0; t < sizeof(thread_counts) / sizeof(int); t++)
+	{
+		RingGroundSegmentation segmentation;
+		segmentation.SetNumberOfThreads(thread_counts[t]);
+		std::vector<char> ground;
+		segmentation.Segment(scan_, ground);
+		EXPECT_TRUE(ground == reference) << thread_counts[t] << " threads";
+
+		// the buffers of the previous scan are reused
+		segmentation.Segment(scan_, ground);
+		EXPECT_TRUE(ground == reference) << thread_counts[t] << " threads, second scan";
+	}
+}
+
+TEST_F(RingGroundSegmentationTest, InvalidPoints)
+{
+	velodyne_pointcloud::PointXYZIR point = scan_.points[0];
+	point.x = std::numeric_limits<float>::quiet_NaN();
+	scan_.points.push_back(point);
+	point = scan_.points[0];
+	point.ring = 200;
+	scan_.points.push_back(point);
+
+	RingGroundSegmentation segmentation;
+	std::vector<char> ground;
+	segmentation.Segment(scan_, ground);
+	ASSERT_EQ(scan_.points.size(), ground.size());
+	EXPECT_EQ(1, ground[0]);
+	EXPECT_EQ(0, ground[ground.size() - 2]);
+	EXPECT_EQ(0, ground[ground.size() - 1]);
+}
+
+TEST_F(RingGroundSegmentationTest, SplitInInputOrder)
+{
+	RingGroundSegmentation segmentation;
+	std::vector<char> ground;
+	segmentation.Segment(scan_, ground);
+
+	pcl::PointCloud<pcl::PointXYZ>::Ptr nofloor(new pcl::PointCloud<pcl::PointXYZ>);
+	pcl::PointCloud<pcl::PointXYZ>::Ptr onlyfloor(new pcl::PointCloud<pcl::PointXYZ>);
+	segmentation.Segment(scan_, nofloor, onlyfloor);
+	ASSERT_EQ(scan_.points.size(), nofloor->points.size() + onlyfloor->points.size());
+	EXPECT_EQ(nofloor->points.size(), nofloor->width);
+	EXPECT_EQ(onlyfloor->points.size(), onlyfloor->width);
+
+	size_t n = 0, f = 0;
+	for (size_t i = 0; i < scan_.points.size(); i++)
+	{
+		const pcl::PointXYZ& point = ground[i] ? onlyfloor->points[f++] : nofloor->points[n++];
+		EXPECT_EQ(scan_.points[i].x, point.x);
+		EXPECT_EQ(scan_.points[i].y, point.y);
+		EXPECT_EQ(scan_.points[i].z, point.z);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}